@@ -1,3 +1,98 @@
 #define _CRT_SECURE_NO_WARNINGS
 #define CGLTF_IMPLEMENTATION
 #include "cgltf/cgltf.h"
+
+/*
+ * cgltf doesn't parse EXT_mesh_gpu_instancing, it only keeps the JSON of the extension, e.g.
+ * {"attributes":{"TRANSLATION":0,"ROTATION":1,"SCALE":2}}
+ * This tokenizes it with the jsmn that cgltf bundles, which is only visible in this file, and returns the accessor
+ * indices of the attributes, or -1 for the attributes that the extension doesn't have
+ * Returns 0 if the JSON isn't valid
+ */
+int cgltf_parse_mesh_gpu_instancing(const char* json, int* out_translation, int* out_rotation, int* out_scale)
+{
+	*out_translation = -1;
+	*out_rotation = -1;
+	*out_scale = -1;
+
+	if (json == NULL)
+	{
+		return 0;
+	}
+
+	const uint8_t* json_chunk = (const uint8_t*)json;
+	size_t size = strlen(json);
+
+	jsmn_parser parser;
+	jsmn_init(&parser);
+	int token_count = jsmn_parse(&parser, json, size, NULL, 0);
+	if (token_count <= 0)
+	{
+		return 0;
+	}
+
+	jsmntok_t* tokens = (jsmntok_t*)CGLTF_MALLOC(sizeof(jsmntok_t) * token_count);
+	if (tokens == NULL)
+	{
+		return 0;
+	}
+
+	jsmn_init(&parser);
+	int result = jsmn_parse(&parser, json, size, tokens, token_count) == token_count && tokens[0].type == JSMN_OBJECT;
+
+	/* In strict mode, jsmn only accepts objects whose keys are strings followed by a value */
+	int i = 1;
+	for (int key = 0; result && key < tokens[0].size; ++key)
+	{
+		if (cgltf_json_strcmp(tokens + i, json_chunk, "attributes") != 0)
+		{
+			i = cgltf_skip_json(tokens, i + 1);
+			result = i >= 0;
+			continue;
+		}
+
+		++i;
+		if (tokens[i].type != JSMN_OBJECT)
+		{
+			result = 0;
+			break;
+		}
+
+		int attribute_count = tokens[i].size;
+		++i;
+		for (int attribute = 0; result && attribute < attribute_count; ++attribute)
+		{
+			int* out_index = NULL;
+			if (cgltf_json_strcmp(tokens + i, json_chunk, "TRANSLATION") == 0)
+			{
+				out_index = out_translation;
+			}
+			else if (cgltf_json_strcmp(tokens + i, json_chunk, "ROTATION") == 0)
+			{
+				out_index = out_rotation;
+			}
+			else if (cgltf_json_strcmp(tokens + i, json_chunk, "SCALE") == 0)
+			{
+				out_index = out_scale;
+			}
+
+			if (out_index != NULL)
+			{
+				if (tokens[i + 1].type != JSMN_PRIMITIVE)
+				{
+					result = 0;
+					break;
+				}
+
+				*out_index = cgltf_json_to_int(tokens + i + 1, json_chunk);
+			}
+
+			i = cgltf_skip_json(tokens, i + 1);
+			result = i >= 0;
+		}
+	}
+
+	CGLTF_FREE(tokens);
+
+	return result;
+}
@@ -7,6 +7,8 @@
 #include "glm/glm.hpp"
 
 #include "WebAlembicViewer.h"
+#include "VertexLayout.h"
+#include "GPUHeap.h"
 
 class AlembicMesh
 {
@@ -21,16 +23,35 @@ public:
    AlembicMesh(AlembicMesh&& rhs) noexcept;
    AlembicMesh& operator=(AlembicMesh&& rhs) noexcept;
 
+   // Positions and normals change every frame, so they form the dynamic stream that UpdateBuffers uploads, in one VBO
+   // per attribute or interleaved in a single VBO
+   // The uvs, the instance matrices and the indices are kept in their own buffers, so they aren't uploaded with it
+   // The layout must be set before InitializeBuffers is called
+   void                       SetVertexLayout(VertexLayout layout) { mVertexLayout = layout; }
+   VertexLayout               GetVertexLayout() const { return mVertexLayout; }
+
    void                       InitializeBuffers(wabc::IMesh* mesh);
    void                       UpdateBuffers(wabc::IMesh* mesh);
+   void                       UpdateInstanceMatrices(wabc::span<wabc::float4x4> matrices);
+
+   unsigned int               GetNumInstances() const { return mNumInstances; }
+   // GL_UNSIGNED_SHORT when the vertices of every chunk are within 65535 of each other, GL_UNSIGNED_INT otherwise
+   unsigned int               GetIndexType() const { return mIndexType; }
 
    void                       ConfigureVAO(int posAttribLocation,
-                                           int normalAttribLocation);
+                                           int normalAttribLocation,
+                                           int texCoordsAttribLocation,
+                                           int instanceMatrixAttribLocation = -1);
 
    void                       UnconfigureVAO(int posAttribLocation,
-                                             int normalAttribLocation);
+                                             int normalAttribLocation,
+                                             int texCoordsAttribLocation,
+                                             int instanceMatrixAttribLocation = -1);
 
    void                       BindFloatAttribute(int attribLocation, unsigned int VBO, int numComponents);
+   void                       BindAttribute(int attribLocation, const VertexAttribute& attribute, unsigned int baseVertex = 0);
+   void                       BindMat4InstanceAttribute(int attribLocation, unsigned int VBO);
+   void                       UnbindMat4InstanceAttribute(int attribLocation, unsigned int VBO);
    void                       BindIntAttribute(int attribLocation, unsigned int VBO, int numComponents);
    void                       UnbindAttribute(int attribLocation, unsigned int VBO);
 
@@ -41,15 +62,43 @@ private:
 
    enum VBOTypes : unsigned int
    {
-      positions  = 0,
-      normals    = 1,
+      positions        = 0,
+      normals          = 1,
+      texCoords        = 2,
+      instanceMatrices = 3,
    };
 
+   // A range of the indices and the VAO that draws it
+   // WebGL2 has no base vertex draws, so instead the attribute pointers of the VAO of each chunk start at its base vertex
+   // The first chunk uses mVAO, and there is always at least one
+   struct IndexChunk
+   {
+      unsigned int VAO;
+      unsigned int numIndices;
+      size_t       indexOffset; // In bytes
+      unsigned int baseVertex;
+   };
+
+   void                        LoadIndices(wabc::span<int> indices);
+   void                        DeleteIndexChunks();
+   // Configures the VAOs again if the heaps have been defragmented since they were configured
+   void                        UpdateVAOs();
+
+   VertexLayout                mVertexLayout;
+   // Indexed by VBOTypes. In the interleaved layout the positions and the normals refer to the positions VBO
+   // The uvs are disabled if the mesh has none
+   std::array<VertexAttribute, 3> mAttributes;
+
    unsigned int                mNumVertices;
    unsigned int                mNumIndices;
+   unsigned int                mNumInstances;
+   unsigned int                mIndexType;
    unsigned int                mVAO;
-   std::array<unsigned int, 2> mVBOs;
-   unsigned int                mEBO;
+   std::array<unsigned int, 4> mVBOs;
+   GPUHeap::Handle             mIndexAllocation;
+   std::vector<IndexChunk>     mIndexChunks;
+   std::array<int, 4>          mAttribLocations;
+   unsigned int                mHeapGeneration;
 };
 
 #endif
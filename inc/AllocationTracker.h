@@ -0,0 +1,58 @@
+#ifndef ALLOCATION_TRACKER_H
+#define ALLOCATION_TRACKER_H
+
+#include <string>
+#include <vector>
+
+#include "WebAlembicViewer.h"
+
+namespace wabc {
+
+// opt-in heap allocation tracker. it is compiled in when wabcEnableAllocationTracker is defined
+// (cmake -DWABC_ALLOCATION_TRACKER=ON) and does nothing otherwise.
+// it hooks operator new, malloc (on glibc only) and the sfbx allocators that RawVector uses. it keeps per-frame
+// counts, the peak rss and the call sites that allocate the most. recording does not allocate and is thread safe.
+// call sites are native only: emscripten can not take return addresses, and has no malloc hook.
+
+struct AllocationFrameStats
+{
+    size_t count = 0;             // operator new and malloc, all threads
+    size_t bytes = 0;
+    size_t raw_vector_count = 0;  // sfbx allocators. on glibc the heap ones are part of the malloc numbers too
+    size_t raw_vector_bytes = 0;
+};
+
+struct AllocationSite
+{
+    void* address = nullptr;      // return address of the allocating call
+    std::string name;             // symbol + offset, or the address if it can not be resolved
+    size_t count = 0;
+    size_t bytes = 0;
+};
+
+bool IsAllocationTrackerEnabled();
+
+// closes the current frame and starts a new one. called by BeginFrame().
+void NextAllocationFrame();
+
+// the last complete frame.
+AllocationFrameStats GetLastFrameAllocations();
+// allocation counts of the last frames, oldest first. returns how many were written to dst.
+size_t GetAllocationHistory(float* dst, size_t max_frames);
+// peak resident set size of the process in bytes. the size of the wasm memory on emscripten.
+size_t GetPeakRSS();
+// call sites with the most allocations since startup, always empty on emscripten. slow: it symbolizes every site
+// (dladdr + demangling), so call it on demand rather than every frame.
+std::vector<AllocationSite> GetTopAllocationSites(size_t n);
+
+// writes everything above, plus the sfbx allocator counters, as json. the tracker also does it on exit, to the
+// path in WABC_ALLOCATION_REPORT or to allocations.json.
+bool DumpAllocationReport(const char* path);
+
+// operator new calls made by the calling thread so far. operator new is only counted when wabcEnableHeapCounter or
+// wabcEnableAllocationTracker is defined, otherwise this is 0.
+size_t GetThreadNewCount();
+
+} // namespace wabc
+
+#endif
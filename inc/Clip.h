@@ -0,0 +1,79 @@
+#ifndef CLIP_H
+#define CLIP_H
+
+#include <string>
+#include <vector>
+
+#include "Track.h"
+#include "Pose.h"
+
+// Position, rotation and scale tracks of a single joint
+// Tracks without keyframes leave the corresponding component of the pose untouched
+struct TransformTrack
+{
+   unsigned int    joint = 0;
+   VectorTrack     position;
+   QuaternionTrack rotation;
+   VectorTrack     scale;
+};
+
+class Clip
+{
+public:
+
+   Clip();
+
+   const std::string&           GetName() const { return mName; }
+   void                         SetName(const std::string& name) { mName = name; }
+
+   std::vector<TransformTrack>& GetTransformTracks() { return mTracks; }
+   const std::vector<TransformTrack>& GetTransformTracks() const { return mTracks; }
+   TransformTrack&              GetTransformTrackOfJoint(unsigned int joint);
+
+   // Must be called after modifying the tracks
+   void                         RecalculateDuration();
+   float                        GetStartTime() const { return mStartTime; }
+   float                        GetEndTime() const   { return mEndTime;   }
+   float                        GetDuration() const  { return mEndTime - mStartTime; }
+
+   bool                         GetLooping() const { return mLooping; }
+   void                         SetLooping(bool looping) { mLooping = looping; }
+
+   // Wraps the time around if the clip loops, and clamps it otherwise
+   float                        AdjustTimeToFitRange(float time) const;
+
+   // Resamples all the tracks to the given rate, which makes random access O(1)
+   void                         Resample(float sampleRate);
+
+private:
+
+   std::string                 mName;
+   std::vector<TransformTrack> mTracks;
+   float                       mStartTime;
+   float                       mEndTime;
+   bool                        mLooping;
+};
+
+// Plays back a clip
+// It stores a keyframe cursor for each track, so sampling a clip that plays forward doesn't search for keyframes
+// A clip can be shared by many samplers
+class ClipSampler
+{
+public:
+
+   ClipSampler();
+
+   // Must be called again if the tracks of the clip change
+   void        SetClip(const Clip* clip);
+   const Clip* GetClip() const { return mClip; }
+
+   // Writes the animated components of the joints into the pose and returns the adjusted time
+   float       Sample(Pose& pose, float time);
+
+private:
+
+   const Clip*               mClip;
+   std::vector<unsigned int> mCursors;
+};
+
+#endif
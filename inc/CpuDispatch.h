@@ -0,0 +1,69 @@
+#ifndef CPU_DISPATCH_H
+#define CPU_DISPATCH_H
+
+#include "WebAlembicViewer.h"
+#include "VectorMathBatch.h"
+
+namespace wabc {
+
+// instruction sets the math kernels are compiled for.
+// on native x86 builds every x86 level is compiled in and the best one the cpu supports is picked at startup.
+// other builds only have Scalar and the level they were compiled for (SSE on emscripten with the
+// WABC_WASM_SIMD cmake option, NEON on arm).
+enum class SimdLevel
+{
+    Scalar,
+    SSE,    // SSE4.2 on native x86. 4 floats per register
+    AVX2,   // AVX2 + FMA. 8 floats per register
+    AVX512, // AVX-512F. 16 floats per register
+    NEON,
+};
+
+const char* GetSimdLevelName(SimdLevel level);
+
+// best level supported by both the build and the cpu.
+SimdLevel GetSupportedSimdLevel();
+bool IsSimdLevelSupported(SimdLevel level);
+
+// level the kernels run at. the supported level unless the WABC_SIMD environment variable asks for another one
+// (scalar, sse, avx2, avx512 or neon), which is meant for A/B benchmarks. requests above the supported level are
+// clamped to it.
+SimdLevel GetSimdLevel();
+
+// the hot math kernels, compiled for one instruction set. all pointers are set.
+// float3 arrays are tightly packed AoS with no alignment requirement. dst and src may be the same array.
+struct MathKernels
+{
+    SimdLevel level;
+
+    void (*mul_p)(float3* dst, const float3* src, size_t n, const float4x4& m);
+    void (*mul_v)(float3* dst, const float3* src, size_t n, const float4x4& m);
+    void (*normalize)(float3* dst, const float3* src, size_t n);
+    void (*mul_p_soa)(float3_soa dst, float3_soa src, size_t n, const float4x4& m);
+    void (*mul_v_soa)(float3_soa dst, float3_soa src, size_t n, const float4x4& m);
+    void (*normalize_soa)(float3_soa dst, float3_soa src, size_t n);
+    // see wabc::triangle_normals(). indices has num_triangles * 3 elements.
+    void (*triangle_normals)(float3* dst, const float3* points, const int* indices, size_t num_triangles);
+    // FLT_MAX / -FLT_MAX if n is 0
+    void (*bounds)(const float3* src, size_t n, float3& bmin, float3& bmax);
+    // linear blend skinning of vertices [begin, end) with packed influences (see PackedInfluences).
+    // width must be 1, 2, 4 or 8.
+    void (*skin_points)(float3* dst, const float3* src, const float4x4* matrices,
+        const int* indices, const float* weights, int width, size_t begin, size_t end);
+    void (*skin_normals)(float3* dst, const float3* src, const float4x4* matrices,
+        const int* indices, const float* weights, int width, size_t begin, size_t end);
+};
+
+// kernels for GetSimdLevel(). selected once, on first use, which also runs BenchmarkSkinning() when
+// WABC_SKINNING_BENCHMARK is set.
+const MathKernels& GetMathKernels();
+// kernels for a specific level. nullptr if it is not supported.
+const MathKernels* GetMathKernels(SimdLevel level);
+
+// runs every supported level on the same synthetic data and compares the results with Scalar.
+// prints the mismatches and returns false if there are any. it also runs at startup when WABC_SIMD_CHECK is set.
+bool CheckMathKernels();
+
+} // namespace wabc
+
+#endif
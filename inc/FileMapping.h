@@ -0,0 +1,15 @@
+#ifndef FILE_MAPPING_H
+#define FILE_MAPPING_H
+
+#include <cstddef>
+
+// Maps a whole file into memory, so that its pages are only read from the disk when they are touched, and nothing is
+// copied into a heap allocation
+// The mapping is private, so writes to it stay in memory
+// The browser has no memory mapping, so on the web and when mapping fails the file is read into the heap instead
+// Returns nullptr if the file can't be opened
+void*       MapFile(const char* path, size_t& outSize);
+// Takes any pointer returned by MapFile
+void        UnmapFile(void* data);
+
+#endif
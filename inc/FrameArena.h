@@ -0,0 +1,44 @@
+#ifndef FRAME_ARENA_H
+#define FRAME_ARENA_H
+
+#include "WebAlembicViewer.h"
+#include "sfbxAllocator.h"
+
+namespace wabc {
+
+// bump allocator of the calling thread for data that only lives during the current frame, e.g.
+// RawVector<float3> tmp(GetFrameArena()). its memory is never given back to the heap, it is reused:
+// - BeginFrame() resets the arena of the main thread.
+// - FrameArenaScope rewinds the arena of the calling thread on exit. code that can run on worker threads or outside
+//   of the frame loop uses it.
+sfbx::ArenaAllocator* GetFrameArena();
+
+class FrameArenaScope
+{
+public:
+    FrameArenaScope();
+    ~FrameArenaScope();
+    FrameArenaScope(const FrameArenaScope&) = delete;
+    FrameArenaScope& operator=(const FrameArenaScope&) = delete;
+
+private:
+    sfbx::ArenaAllocator* m_arena;
+    sfbx::ArenaAllocator::Marker m_marker;
+};
+
+// called by the main loop at the start of every frame.
+// resets the calling thread's frame arena and its heap allocation counter, and starts a new allocation tracker frame.
+void BeginFrame();
+
+// heap allocations made by the calling thread since BeginFrame(): the ones of sfbx allocators, plus operator new when
+// wabcEnableHeapCounter is defined (the WABC_HEAP_COUNTER cmake option).
+size_t GetFrameHeapAllocations();
+
+// logs it when the calling thread has allocated from the heap in the current frame. for frames that are known to be in
+// a steady state, e.g. when the playback is paused and nothing is loading. does nothing unless wabcEnableHeapCounter
+// is defined.
+void CheckSteadyStateFrame();
+
+} // namespace wabc
+
+#endif
@@ -6,10 +6,61 @@
 #include "cgltf/cgltf.h"
 
 #include "StaticMesh.h"
+#include "Skeleton.h"
+#include "Clip.h"
 
 cgltf_data*               LoadGLTFFile(const char* path);
 void                      FreeGLTFFile(cgltf_data* handle);
 
-std::vector<StaticMesh>   LoadStaticMeshes(cgltf_data* data);
+// How the static mesh loaders apply the world transforms of the nodes
+enum class NodeTransforms
+{
+   Baked,     // Into the vertices, with one mesh per primitive of each node
+   Instanced, // As instance matrices, with one mesh per primitive of each glTF mesh, however many nodes share it
+};
+
+// The meshes are optimized for the vertex cache, overdraw and vertex fetch before they are uploaded (see StaticMesh::Optimize)
+// If meshCacheDir isn't null, the optimized index buffers are stored there and reused on the next load
+// The vertices are uploaded in vertexFormat, see StaticMesh::VertexFormat
+// Returns one mesh per primitive of each glTF mesh, however many nodes share it, with the world matrices of those nodes
+// (and of their EXT_mesh_gpu_instancing instances) as its instances. Draw them with StaticMesh::RenderInstanced and
+// an instance matrix attribute, e.g. with blinn_phong_instanced.vert
+std::vector<StaticMesh>   LoadStaticMeshes(cgltf_data* data,
+                                           const char* meshCacheDir = nullptr,
+                                           const StaticMesh::VertexFormat& vertexFormat = StaticMesh::VertexFormat());
+// Same as LoadStaticMeshes, without loading the buffers, so that the meshes can still be modified or merged into a
+// StaticModel (see StaticModel::Build)
+// By default there is one mesh per primitive of each node, with the world transform of the node baked into its
+// vertices. With NodeTransforms::Instanced, the meshes are the ones of LoadStaticMeshes, and LoadBuffers uploads their
+// instance matrices (see StaticMesh::GetInstanceMatrices)
+std::vector<StaticMesh>   LoadStaticMeshData(cgltf_data* data,
+                                             const char* meshCacheDir = nullptr,
+                                             NodeTransforms nodeTransforms = NodeTransforms::Baked);
+// Same as above for several files at once, with the primitives of all the files decoded in parallel (see wabc::ParallelFor)
+// nodeTransforms has one entry per file, and the files that it doesn't cover are baked
+// The worker threads only fill in the CPU data of the meshes. Their GL objects, morph target textures included, are
+// created by StaticMesh::LoadBuffers, which must be called on the thread that owns the GL context
+// Returns the meshes of each file in the order of the files, with no meshes for the files that are null
+std::vector<std::vector<StaticMesh>> LoadStaticMeshData(const std::vector<cgltf_data*>& files,
+                                                        const char* meshCacheDir = nullptr,
+                                                        const std::vector<NodeTransforms>& nodeTransforms = {});
+
+// The transform of the first root node of the default scene, or the identity if there is none
+// Exporters often put the conversion from their coordinate system to the one of glTF there
+Transform                 LoadRootTransform(cgltf_data* data);
+
+// Every node of the glTF file is a joint, and the index of a joint is the index of its node
+Pose                      LoadRestPose(cgltf_data* data);
+std::vector<std::string>  LoadJointNames(cgltf_data* data);
+Skeleton                  LoadSkeleton(cgltf_data* data);
+// Only the translation, rotation and scale channels are loaded, the morph target weight channels are skipped
+std::vector<Clip>         LoadAnimationClips(cgltf_data* data);
+
+// Loads the bind pose and the skin of each mesh primitive of the nodes that refer to skins
+// The static mesh loaders above skip these nodes, so a rigged file is loaded with both to get all of its meshes
+// The joint matrices of the skins can be updated with Skeleton::UpdateSkin
+void                      LoadSkinnedMeshes(cgltf_data* data,
+                                            std::vector<wabc::IMeshPtr>& outBindPoseMeshes,
+                                            std::vector<wabc::ISkinPtr>& outSkins);
 
 #endif
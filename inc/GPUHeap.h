@@ -0,0 +1,98 @@
+#ifndef GPU_HEAP_H
+#define GPU_HEAP_H
+
+#include <vector>
+
+#include "OffsetAllocator.h"
+
+// A few large GL buffers that the static vertex and index data of every mesh is sub-allocated from, instead of each
+// mesh creating buffers of its own
+// The buffers are pages of the same size, each with an OffsetAllocator. Data that doesn't fit in a page gets a page of
+// its own, and pages are deleted when their last allocation is freed
+// Allocations are referred to by handles, whose buffer and offset only change when the heap is defragmented
+class GPUHeap
+{
+public:
+
+   using Handle = unsigned int;
+   static const Handle kInvalidHandle = ~0u;
+
+   struct Stats
+   {
+      size_t       capacity              = 0;
+      size_t       used                  = 0;
+      size_t       largestFreeBlock      = 0;
+      // Sum of the largest free block of each page, which is all of the free memory right after a defragmentation
+      size_t       pageLargestFreeBlocks = 0;
+      unsigned int numFreeBlocks         = 0;
+      unsigned int numAllocations        = 0;
+      unsigned int numPages              = 0;
+
+      float        GetUtilization() const;
+      // 0 when the free memory of each page is in one block, close to 1 when it's scattered in small blocks
+      float        GetFragmentation() const;
+   };
+
+   // The heaps that every mesh shares
+   static GPUHeap&            Vertices();
+   static GPUHeap&            Indices();
+
+   // Incremented whenever an allocation of any heap moves, so that the VAOs that refer to it can be configured again
+   static unsigned int        GetGeneration() { return sGeneration; }
+
+   GPUHeap(unsigned int target, size_t pageSize);
+   // The buffers are left to the GL context, which may already be gone when the heaps are destroyed
+   ~GPUHeap() = default;
+
+   GPUHeap(const GPUHeap&) = delete;
+   GPUHeap& operator=(const GPUHeap&) = delete;
+
+   Handle                     Allocate(size_t size);
+   void                       Free(Handle handle);
+   // offset is relative to the start of the allocation
+   void                       Upload(Handle handle, const void* data, size_t size, size_t offset = 0);
+
+   unsigned int               GetBuffer(Handle handle) const;
+   size_t                     GetOffset(Handle handle) const;
+   size_t                     GetSize(Handle handle) const;
+
+   // Packs the allocations of the pages that have more than one free block at the start of a new buffer
+   // Returns the number of bytes that were moved
+   size_t                     Defragment();
+
+   Stats                      GetStats() const;
+
+private:
+
+   // Offsets and sizes are multiples of this, which satisfies the alignment of every vertex and index type
+   static const size_t        kGranularity = 16;
+
+   struct Page
+   {
+      unsigned int            buffer;
+      size_t                  size;
+      wabc::OffsetAllocator   allocator;
+   };
+
+   struct Allocation
+   {
+      unsigned int                      page;
+      wabc::OffsetAllocator::Allocation range;
+      size_t                            size;
+   };
+
+   unsigned int               CreatePage(size_t size);
+   unsigned int               CreateBuffer(size_t size);
+   void                       DeletePage(unsigned int pageIndex);
+
+   unsigned int               mTarget;
+   size_t                     mPageSize;
+   // Deleted pages and freed allocations leave holes that are reused, so that the indices stay stable
+   std::vector<Page>          mPages;
+   std::vector<Allocation>    mAllocations;
+   std::vector<Handle>        mFreeHandles;
+
+   static unsigned int        sGeneration;
+};
+
+#endif
@@ -0,0 +1,569 @@
+// kernel bodies for a single instruction set. this is not a regular header: CpuDispatch.cpp includes it once per
+// instruction set, each time inside a namespace of its own, with wabcKernelISA defined and with the intrinsics
+// headers already included. that way every variant is compiled from the same source.
+//
+// x86 variants keep AoS float3 data in registers of 1, 2 or 4 groups of 4 points (12 floats). every shuffle works
+// within 128-bit lanes, so the same code handles SSE, AVX2 and AVX-512. NEON deinterleaves with vld3q / vst3q.
+
+#if wabcKernelISA == wabcISA_SSE || wabcKernelISA == wabcISA_AVX2 || wabcKernelISA == wabcISA_AVX512
+    #define wabcKernelShuffle
+#endif
+#if wabcKernelISA != wabcISA_Scalar
+    #define wabcKernelSIMD
+#endif
+
+#if wabcKernelISA == wabcISA_SSE
+using vfloat = __m128;
+static const int kGroups = 1;
+
+inline vfloat vset(float v) { return _mm_set1_ps(v); }
+inline vfloat vset4(float a, float b, float c, float d) { return _mm_setr_ps(a, b, c, d); }
+inline vfloat vadd(vfloat a, vfloat b) { return _mm_add_ps(a, b); }
+inline vfloat vsub(vfloat a, vfloat b) { return _mm_sub_ps(a, b); }
+inline vfloat vmul(vfloat a, vfloat b) { return _mm_mul_ps(a, b); }
+inline vfloat vmadd(vfloat a, vfloat b, vfloat c) { return _mm_add_ps(_mm_mul_ps(a, b), c); }
+inline vfloat vdiv(vfloat a, vfloat b) { return _mm_div_ps(a, b); }
+inline vfloat vsqrt(vfloat a) { return _mm_sqrt_ps(a); }
+inline vfloat vmin(vfloat a, vfloat b) { return _mm_min_ps(a, b); }
+inline vfloat vmax(vfloat a, vfloat b) { return _mm_max_ps(a, b); }
+inline vfloat vload(const float* src) { return _mm_loadu_ps(src); }
+inline void vstore(float* dst, vfloat v) { _mm_storeu_ps(dst, v); }
+// 4 floats from each group of 12
+inline vfloat vload_groups(const float* src) { return _mm_loadu_ps(src); }
+inline void vstore_groups(float* dst, vfloat v) { _mm_storeu_ps(dst, v); }
+// 4 floats from each of kGroups places, and one value per 128-bit lane
+inline vfloat vload_lanes(const float* const* src, int offset) { return _mm_loadu_ps(src[0] + offset); }
+inline vfloat vset_lanes(const float* values) { return _mm_set1_ps(values[0]); }
+template<int I> inline vfloat vshuffle(vfloat a, vfloat b) { return _mm_shuffle_ps(a, b, I); }
+
+#elif wabcKernelISA == wabcISA_AVX2
+using vfloat = __m256;
+static const int kGroups = 2;
+
+inline vfloat vset(float v) { return _mm256_set1_ps(v); }
+inline vfloat vset4(float a, float b, float c, float d) { return _mm256_setr_ps(a, b, c, d, a, b, c, d); }
+inline vfloat vadd(vfloat a, vfloat b) { return _mm256_add_ps(a, b); }
+inline vfloat vsub(vfloat a, vfloat b) { return _mm256_sub_ps(a, b); }
+inline vfloat vmul(vfloat a, vfloat b) { return _mm256_mul_ps(a, b); }
+inline vfloat vmadd(vfloat a, vfloat b, vfloat c) { return _mm256_fmadd_ps(a, b, c); }
+inline vfloat vdiv(vfloat a, vfloat b) { return _mm256_div_ps(a, b); }
+inline vfloat vsqrt(vfloat a) { return _mm256_sqrt_ps(a); }
+inline vfloat vmin(vfloat a, vfloat b) { return _mm256_min_ps(a, b); }
+inline vfloat vmax(vfloat a, vfloat b) { return _mm256_max_ps(a, b); }
+inline vfloat vload(const float* src) { return _mm256_loadu_ps(src); }
+inline void vstore(float* dst, vfloat v) { _mm256_storeu_ps(dst, v); }
+inline vfloat vload_groups(const float* src)
+{
+    return _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(src)), _mm_loadu_ps(src + 12), 1);
+}
+inline void vstore_groups(float* dst, vfloat v)
+{
+    _mm_storeu_ps(dst, _mm256_castps256_ps128(v));
+    _mm_storeu_ps(dst + 12, _mm256_extractf128_ps(v, 1));
+}
+inline vfloat vload_lanes(const float* const* src, int offset)
+{
+    return _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(src[0] + offset)), _mm_loadu_ps(src[1] + offset), 1);
+}
+inline vfloat vset_lanes(const float* values)
+{
+    return _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_set1_ps(values[0])), _mm_set1_ps(values[1]), 1);
+}
+template<int I> inline vfloat vshuffle(vfloat a, vfloat b) { return _mm256_shuffle_ps(a, b, I); }
+
+#elif wabcKernelISA == wabcISA_AVX512
+using vfloat = __m512;
+static const int kGroups = 4;
+
+inline vfloat vset(float v) { return _mm512_set1_ps(v); }
+inline vfloat vset4(float a, float b, float c, float d) { return _mm512_broadcast_f32x4(_mm_setr_ps(a, b, c, d)); }
+inline vfloat vadd(vfloat a, vfloat b) { return _mm512_add_ps(a, b); }
+inline vfloat vsub(vfloat a, vfloat b) { return _mm512_sub_ps(a, b); }
+inline vfloat vmul(vfloat a, vfloat b) { return _mm512_mul_ps(a, b); }
+inline vfloat vmadd(vfloat a, vfloat b, vfloat c) { return _mm512_fmadd_ps(a, b, c); }
+inline vfloat vdiv(vfloat a, vfloat b) { return _mm512_div_ps(a, b); }
+inline vfloat vsqrt(vfloat a) { return _mm512_sqrt_ps(a); }
+inline vfloat vmin(vfloat a, vfloat b) { return _mm512_min_ps(a, b); }
+inline vfloat vmax(vfloat a, vfloat b) { return _mm512_max_ps(a, b); }
+inline vfloat vload(const float* src) { return _mm512_loadu_ps(src); }
+inline void vstore(float* dst, vfloat v) { _mm512_storeu_ps(dst, v); }
+inline vfloat vload_groups(const float* src)
+{
+    vfloat r = _mm512_castps128_ps512(_mm_loadu_ps(src));
+    r = _mm512_insertf32x4(r, _mm_loadu_ps(src + 12), 1);
+    r = _mm512_insertf32x4(r, _mm_loadu_ps(src + 24), 2);
+    r = _mm512_insertf32x4(r, _mm_loadu_ps(src + 36), 3);
+    return r;
+}
+inline void vstore_groups(float* dst, vfloat v)
+{
+    _mm_storeu_ps(dst, _mm512_castps512_ps128(v));
+    _mm_storeu_ps(dst + 12, _mm512_extractf32x4_ps(v, 1));
+    _mm_storeu_ps(dst + 24, _mm512_extractf32x4_ps(v, 2));
+    _mm_storeu_ps(dst + 36, _mm512_extractf32x4_ps(v, 3));
+}
+inline vfloat vload_lanes(const float* const* src, int offset)
+{
+    vfloat r = _mm512_castps128_ps512(_mm_loadu_ps(src[0] + offset));
+    r = _mm512_insertf32x4(r, _mm_loadu_ps(src[1] + offset), 1);
+    r = _mm512_insertf32x4(r, _mm_loadu_ps(src[2] + offset), 2);
+    r = _mm512_insertf32x4(r, _mm_loadu_ps(src[3] + offset), 3);
+    return r;
+}
+inline vfloat vset_lanes(const float* values)
+{
+    vfloat r = _mm512_castps128_ps512(_mm_set1_ps(values[0]));
+    r = _mm512_insertf32x4(r, _mm_set1_ps(values[1]), 1);
+    r = _mm512_insertf32x4(r, _mm_set1_ps(values[2]), 2);
+    r = _mm512_insertf32x4(r, _mm_set1_ps(values[3]), 3);
+    return r;
+}
+template<int I> inline vfloat vshuffle(vfloat a, vfloat b) { return _mm512_shuffle_ps(a, b, I); }
+
+#elif wabcKernelISA == wabcISA_NEON
+using vfloat = float32x4_t;
+static const int kGroups = 1;
+
+inline vfloat vset(float v) { return vdupq_n_f32(v); }
+inline vfloat vadd(vfloat a, vfloat b) { return vaddq_f32(a, b); }
+inline vfloat vsub(vfloat a, vfloat b) { return vsubq_f32(a, b); }
+inline vfloat vmul(vfloat a, vfloat b) { return vmulq_f32(a, b); }
+inline vfloat vmadd(vfloat a, vfloat b, vfloat c) { return vmlaq_f32(c, a, b); }
+#if defined(__aarch64__)
+inline vfloat vdiv(vfloat a, vfloat b) { return vdivq_f32(a, b); }
+inline vfloat vsqrt(vfloat a) { return vsqrtq_f32(a); }
+#else
+// armv7 has no vector division or square root
+inline vfloat vdiv(vfloat a, vfloat b)
+{
+    float ta[4], tb[4];
+    vst1q_f32(ta, a);
+    vst1q_f32(tb, b);
+    for (int i = 0; i < 4; ++i)
+        ta[i] /= tb[i];
+    return vld1q_f32(ta);
+}
+inline vfloat vsqrt(vfloat a)
+{
+    float t[4];
+    vst1q_f32(t, a);
+    for (int i = 0; i < 4; ++i)
+        t[i] = std::sqrt(t[i]);
+    return vld1q_f32(t);
+}
+#endif
+inline vfloat vmin(vfloat a, vfloat b) { return vminq_f32(a, b); }
+inline vfloat vmax(vfloat a, vfloat b) { return vmaxq_f32(a, b); }
+inline vfloat vload(const float* src) { return vld1q_f32(src); }
+inline void vstore(float* dst, vfloat v) { vst1q_f32(dst, v); }
+#endif
+
+#ifdef wabcKernelSIMD
+// points per register
+static const size_t kWidth = 4 * kGroups;
+
+// AoS float3 <-> SoA registers
+inline void vload3(const float3* src, vfloat& x, vfloat& y, vfloat& z)
+{
+#ifdef wabcKernelShuffle
+    const float* s = (const float*)src;
+    vfloat a = vload_groups(s + 0); // x0 y0 z0 x1
+    vfloat b = vload_groups(s + 4); // y1 z1 x2 y2
+    vfloat c = vload_groups(s + 8); // z2 x3 y3 z3
+    x = vshuffle<_MM_SHUFFLE(2, 0, 2, 0)>(vshuffle<_MM_SHUFFLE(3, 3, 0, 0)>(a, a), vshuffle<_MM_SHUFFLE(1, 1, 2, 2)>(b, c));
+    y = vshuffle<_MM_SHUFFLE(2, 0, 2, 0)>(vshuffle<_MM_SHUFFLE(0, 0, 1, 1)>(a, b), vshuffle<_MM_SHUFFLE(2, 2, 3, 3)>(b, c));
+    z = vshuffle<_MM_SHUFFLE(2, 0, 2, 0)>(vshuffle<_MM_SHUFFLE(1, 1, 2, 2)>(a, b), vshuffle<_MM_SHUFFLE(3, 3, 0, 0)>(c, c));
+#else
+    float32x4x3_t v = vld3q_f32((const float*)src);
+    x = v.val[0];
+    y = v.val[1];
+    z = v.val[2];
+#endif
+}
+
+inline void vstore3(float3* dst, vfloat x, vfloat y, vfloat z)
+{
+#ifdef wabcKernelShuffle
+    float* d = (float*)dst;
+    vstore_groups(d + 0, vshuffle<_MM_SHUFFLE(2, 0, 2, 0)>(vshuffle<_MM_SHUFFLE(0, 0, 0, 0)>(x, y), vshuffle<_MM_SHUFFLE(1, 1, 0, 0)>(z, x)));
+    vstore_groups(d + 4, vshuffle<_MM_SHUFFLE(2, 0, 2, 0)>(vshuffle<_MM_SHUFFLE(1, 1, 1, 1)>(y, z), vshuffle<_MM_SHUFFLE(2, 2, 2, 2)>(x, y)));
+    vstore_groups(d + 8, vshuffle<_MM_SHUFFLE(2, 0, 2, 0)>(vshuffle<_MM_SHUFFLE(3, 3, 2, 2)>(z, x), vshuffle<_MM_SHUFFLE(3, 3, 3, 3)>(y, z)));
+#else
+    float32x4x3_t v;
+    v.val[0] = x;
+    v.val[1] = y;
+    v.val[2] = z;
+    vst3q_f32((float*)dst, v);
+#endif
+}
+
+inline void vnormalize(vfloat& x, vfloat& y, vfloat& z)
+{
+    // divide by the length like normalize() does, so that every variant gives the same results
+    vfloat len = vsqrt(vmadd(x, x, vmadd(y, y, vmul(z, z))));
+    x = vdiv(x, len);
+    y = vdiv(y, len);
+    z = vdiv(z, len);
+}
+
+// SoA transform, row-vector convention like mul_p() / mul_v()
+template<bool Point>
+inline void vtransform(const vfloat (&m)[4][3], vfloat& x, vfloat& y, vfloat& z)
+{
+    vfloat rx = vmadd(x, m[0][0], vmadd(y, m[1][0], Point ? vmadd(z, m[2][0], m[3][0]) : vmul(z, m[2][0])));
+    vfloat ry = vmadd(x, m[0][1], vmadd(y, m[1][1], Point ? vmadd(z, m[2][1], m[3][1]) : vmul(z, m[2][1])));
+    vfloat rz = vmadd(x, m[0][2], vmadd(y, m[1][2], Point ? vmadd(z, m[2][2], m[3][2]) : vmul(z, m[2][2])));
+    x = rx;
+    y = ry;
+    z = rz;
+}
+
+inline void vbroadcast(const float4x4& src, vfloat (&dst)[4][3])
+{
+    for (int r = 0; r < 4; ++r)
+        for (int c = 0; c < 3; ++c)
+            dst[r][c] = vset(src[r][c]);
+}
+#endif // wabcKernelSIMD
+
+template<bool Point>
+inline float3 transform(const float4x4& m, const float3& v)
+{
+    return Point ? mul_p(m, v) : mul_v(m, v);
+}
+
+template<bool Point>
+void TransformAoS(float3* dst, const float3* src, size_t n, const float4x4& m)
+{
+    size_t i = 0;
+#if defined(wabcKernelShuffle)
+    // the points are transformed without a transpose. each register holds parts of 2 points, so it is computed from
+    // shuffled inputs and from matrix rows whose columns are rotated to match:
+    // (x0' y0' z0' x1') = (x0 x0 x0 x1) * (m00 m01 m02 m00) + (y0 y0 y0 y1) * (m10 m11 m12 m10) + ...
+    vfloat ma[4], mb[4], mc[4];
+    for (int r = 0; r < 4; ++r) {
+        float t = Point || r < 3 ? 1.0f : 0.0f;
+        ma[r] = vset4(m[r][0] * t, m[r][1] * t, m[r][2] * t, m[r][0] * t);
+        mb[r] = vset4(m[r][1] * t, m[r][2] * t, m[r][0] * t, m[r][1] * t);
+        mc[r] = vset4(m[r][2] * t, m[r][0] * t, m[r][1] * t, m[r][2] * t);
+    }
+    for (; i + kWidth <= n; i += kWidth) {
+        const float* s = (const float*)(src + i);
+        vfloat a = vload_groups(s + 0); // x0 y0 z0 x1
+        vfloat b = vload_groups(s + 4); // y1 z1 x2 y2
+        vfloat c = vload_groups(s + 8); // z2 x3 y3 z3
+
+        // (x0 x0 x0 x1) (y0 y0 y0 y1) (z0 z0 z0 z1)
+        vfloat xa = vshuffle<_MM_SHUFFLE(3, 0, 0, 0)>(a, a);
+        vfloat ya = vshuffle<_MM_SHUFFLE(0, 0, 1, 1)>(a, b);
+        ya = vshuffle<_MM_SHUFFLE(2, 0, 0, 0)>(ya, ya);
+        vfloat za = vshuffle<_MM_SHUFFLE(1, 1, 2, 2)>(a, b);
+        za = vshuffle<_MM_SHUFFLE(2, 0, 0, 0)>(za, za);
+        // (x1 x1 x2 x2) (y1 y1 y2 y2) (z1 z1 z2 z2)
+        vfloat xb = vshuffle<_MM_SHUFFLE(2, 2, 3, 3)>(a, b);
+        vfloat yb = vshuffle<_MM_SHUFFLE(3, 3, 0, 0)>(b, b);
+        vfloat zb = vshuffle<_MM_SHUFFLE(0, 0, 1, 1)>(b, c);
+        // (x2 x3 x3 x3) (y2 y3 y3 y3) (z2 z3 z3 z3)
+        vfloat xc = vshuffle<_MM_SHUFFLE(1, 1, 2, 2)>(b, c);
+        xc = vshuffle<_MM_SHUFFLE(2, 2, 2, 0)>(xc, xc);
+        vfloat yc = vshuffle<_MM_SHUFFLE(2, 2, 3, 3)>(b, c);
+        yc = vshuffle<_MM_SHUFFLE(2, 2, 2, 0)>(yc, yc);
+        vfloat zc = vshuffle<_MM_SHUFFLE(3, 3, 3, 0)>(c, c);
+
+        float* d = (float*)(dst + i);
+        vstore_groups(d + 0, vmadd(xa, ma[0], vmadd(ya, ma[1], vmadd(za, ma[2], ma[3]))));
+        vstore_groups(d + 4, vmadd(xb, mb[0], vmadd(yb, mb[1], vmadd(zb, mb[2], mb[3]))));
+        vstore_groups(d + 8, vmadd(xc, mc[0], vmadd(yc, mc[1], vmadd(zc, mc[2], mc[3]))));
+    }
+#elif defined(wabcKernelSIMD)
+    vfloat vm[4][3];
+    vbroadcast(m, vm);
+    for (; i + kWidth <= n; i += kWidth) {
+        vfloat x, y, z;
+        vload3(src + i, x, y, z);
+        vtransform<Point>(vm, x, y, z);
+        vstore3(dst + i, x, y, z);
+    }
+#endif
+    for (; i < n; ++i)
+        dst[i] = transform<Point>(m, src[i]);
+}
+
+template<bool Point>
+void TransformSoA(float3_soa dst, float3_soa src, size_t n, const float4x4& m)
+{
+    size_t i = 0;
+#ifdef wabcKernelSIMD
+    vfloat vm[4][3];
+    vbroadcast(m, vm);
+    for (; i + kWidth <= n; i += kWidth) {
+        vfloat x = vload(src.x + i), y = vload(src.y + i), z = vload(src.z + i);
+        vtransform<Point>(vm, x, y, z);
+        vstore(dst.x + i, x);
+        vstore(dst.y + i, y);
+        vstore(dst.z + i, z);
+    }
+#endif
+    for (; i < n; ++i) {
+        float3 r = transform<Point>(m, float3{ src.x[i], src.y[i], src.z[i] });
+        dst.x[i] = r.x;
+        dst.y[i] = r.y;
+        dst.z[i] = r.z;
+    }
+}
+
+void MulPoints(float3* dst, const float3* src, size_t n, const float4x4& m) { TransformAoS<true>(dst, src, n, m); }
+void MulVectors(float3* dst, const float3* src, size_t n, const float4x4& m) { TransformAoS<false>(dst, src, n, m); }
+void MulPointsSoA(float3_soa dst, float3_soa src, size_t n, const float4x4& m) { TransformSoA<true>(dst, src, n, m); }
+void MulVectorsSoA(float3_soa dst, float3_soa src, size_t n, const float4x4& m) { TransformSoA<false>(dst, src, n, m); }
+
+void Normalize(float3* dst, const float3* src, size_t n)
+{
+    size_t i = 0;
+#ifdef wabcKernelSIMD
+    for (; i + kWidth <= n; i += kWidth) {
+        vfloat x, y, z;
+        vload3(src + i, x, y, z);
+        vnormalize(x, y, z);
+        vstore3(dst + i, x, y, z);
+    }
+#endif
+    for (; i < n; ++i)
+        dst[i] = normalize(src[i]);
+}
+
+void NormalizeSoA(float3_soa dst, float3_soa src, size_t n)
+{
+    size_t i = 0;
+#ifdef wabcKernelSIMD
+    for (; i + kWidth <= n; i += kWidth) {
+        vfloat x = vload(src.x + i), y = vload(src.y + i), z = vload(src.z + i);
+        vnormalize(x, y, z);
+        vstore(dst.x + i, x);
+        vstore(dst.y + i, y);
+        vstore(dst.z + i, z);
+    }
+#endif
+    for (; i < n; ++i) {
+        float3 r = normalize(float3{ src.x[i], src.y[i], src.z[i] });
+        dst.x[i] = r.x;
+        dst.y[i] = r.y;
+        dst.z[i] = r.z;
+    }
+}
+
+void TriangleNormals(float3* dst, const float3* points, const int* indices, size_t num_triangles)
+{
+    size_t ti = 0;
+#ifdef wabcKernelSIMD
+    // the edges are gathered into SoA form kWidth triangles at a time, and the normals are scattered back in
+    // triangle order so that shared vertices end up with the same normal as in the scalar path
+    for (; ti + kWidth <= num_triangles; ti += kWidth) {
+        alignas(64) float e1[3][kWidth], e2[3][kWidth];
+        for (size_t l = 0; l < kWidth; ++l) {
+            const int* t = indices + (ti + l) * 3;
+            float3 v0 = points[t[0]], v1 = points[t[1]], v2 = points[t[2]];
+            float3 v20 = v2 - v0, v10 = v1 - v0;
+            e1[0][l] = v20.x; e1[1][l] = v20.y; e1[2][l] = v20.z;
+            e2[0][l] = v10.x; e2[1][l] = v10.y; e2[2][l] = v10.z;
+        }
+
+        vfloat ax = vload(e1[0]), ay = vload(e1[1]), az = vload(e1[2]);
+        vfloat bx = vload(e2[0]), by = vload(e2[1]), bz = vload(e2[2]);
+        vfloat nx = vsub(vmul(ay, bz), vmul(az, by));
+        vfloat ny = vsub(vmul(az, bx), vmul(ax, bz));
+        vfloat nz = vsub(vmul(ax, by), vmul(ay, bx));
+        vnormalize(nx, ny, nz);
+
+        alignas(64) float nrm[3][kWidth];
+        vstore(nrm[0], nx);
+        vstore(nrm[1], ny);
+        vstore(nrm[2], nz);
+        for (size_t l = 0; l < kWidth; ++l) {
+            const int* t = indices + (ti + l) * 3;
+            float3 normal{ nrm[0][l], nrm[1][l], nrm[2][l] };
+            dst[t[0]] = normal;
+            dst[t[1]] = normal;
+            dst[t[2]] = normal;
+        }
+    }
+#endif
+    for (; ti < num_triangles; ++ti) {
+        const int* t = indices + ti * 3;
+        float3 v0 = points[t[0]], v1 = points[t[1]], v2 = points[t[2]];
+        float3 normal = normalize(cross(v2 - v0, v1 - v0));
+        dst[t[0]] = normal;
+        dst[t[1]] = normal;
+        dst[t[2]] = normal;
+    }
+}
+
+void Bounds(const float3* src, size_t n, float3& bmin, float3& bmax)
+{
+    float3 rmin = float3::one() * std::numeric_limits<float>::max();
+    float3 rmax = float3::one() * std::numeric_limits<float>::lowest();
+
+    size_t i = 0;
+#ifdef wabcKernelSIMD
+    if (n >= kWidth) {
+        vfloat minx, miny, minz;
+        vload3(src, minx, miny, minz);
+        vfloat maxx = minx, maxy = miny, maxz = minz;
+        for (i = kWidth; i + kWidth <= n; i += kWidth) {
+            vfloat x, y, z;
+            vload3(src + i, x, y, z);
+            minx = vmin(minx, x); miny = vmin(miny, y); minz = vmin(minz, z);
+            maxx = vmax(maxx, x); maxy = vmax(maxy, y); maxz = vmax(maxz, z);
+        }
+
+        alignas(64) float t[6][kWidth];
+        vstore(t[0], minx); vstore(t[1], miny); vstore(t[2], minz);
+        vstore(t[3], maxx); vstore(t[4], maxy); vstore(t[5], maxz);
+        for (size_t l = 0; l < kWidth; ++l) {
+            rmin = min(rmin, float3{ t[0][l], t[1][l], t[2][l] });
+            rmax = max(rmax, float3{ t[3][l], t[4][l], t[5][l] });
+        }
+    }
+#endif
+    for (; i < n; ++i) {
+        rmin = min(rmin, src[i]);
+        rmax = max(rmax, src[i]);
+    }
+    bmin = rmin;
+    bmax = rmax;
+}
+
+// Width: influences per vertex. Point: whether the translation applies (points) or not (normals).
+// the matrices of a vertex are blended first and the result is applied once, which is equivalent
+// to blending the transformed vertices because skinning is linear.
+// x86 variants skin kGroups vertices at a time, one per 128-bit lane, so AVX2 blends 2 matrices per instruction and
+// AVX-512 blends 4. the lanes past the end repeat the last vertex and aren't stored.
+template<int Width, bool Point>
+void SkinRange(float3* dst, const float3* src, const float4x4* matrices,
+    const int* indices, const float* weights, size_t begin, size_t end)
+{
+#if defined(wabcKernelShuffle)
+    for (size_t vi = begin; vi < end; vi += kGroups) {
+        size_t lane_vertices[kGroups];
+        float x[kGroups], y[kGroups], z[kGroups];
+        for (int l = 0; l < kGroups; ++l) {
+            lane_vertices[l] = std::min(vi + l, end - 1);
+            const float3& v = src[lane_vertices[l]];
+            x[l] = v.x;
+            y[l] = v.y;
+            z[l] = v.z;
+        }
+
+        vfloat r0 = vset(0.0f);
+        vfloat r1 = vset(0.0f);
+        vfloat r2 = vset(0.0f);
+        vfloat r3 = vset(0.0f);
+        for (int i = 0; i < Width; ++i) {
+            const float* m[kGroups];
+            float w[kGroups];
+            for (int l = 0; l < kGroups; ++l) {
+                size_t slot = lane_vertices[l] * Width + i;
+                m[l] = (const float*)&matrices[indices[slot]];
+                w[l] = weights[slot];
+            }
+
+            vfloat wv = vset_lanes(w);
+            r0 = vmadd(vload_lanes(m, 0), wv, r0);
+            r1 = vmadd(vload_lanes(m, 4), wv, r1);
+            r2 = vmadd(vload_lanes(m, 8), wv, r2);
+            if (Point)
+                r3 = vmadd(vload_lanes(m, 12), wv, r3);
+        }
+
+        vfloat r = vmadd(r0, vset_lanes(x), vmadd(r1, vset_lanes(y), vmadd(r2, vset_lanes(z), r3)));
+
+        float tmp[4 * kGroups];
+        vstore(tmp, r);
+        for (int l = 0; l < kGroups && vi + l < end; ++l)
+            dst[vi + l] = { tmp[l * 4 + 0], tmp[l * 4 + 1], tmp[l * 4 + 2] };
+    }
+#else
+    for (size_t vi = begin; vi < end; ++vi) {
+        const int* vi_indices = indices + vi * Width;
+        const float* vi_weights = weights + vi * Width;
+        const float3& v = src[vi];
+
+#if defined(wabcKernelSIMD)
+        float32x4_t r0 = vdupq_n_f32(0.0f);
+        float32x4_t r1 = vdupq_n_f32(0.0f);
+        float32x4_t r2 = vdupq_n_f32(0.0f);
+        float32x4_t r3 = vdupq_n_f32(0.0f);
+        for (int i = 0; i < Width; ++i) {
+            const float* m = (const float*)&matrices[vi_indices[i]];
+            float w = vi_weights[i];
+            r0 = vmlaq_n_f32(r0, vld1q_f32(m + 0), w);
+            r1 = vmlaq_n_f32(r1, vld1q_f32(m + 4), w);
+            r2 = vmlaq_n_f32(r2, vld1q_f32(m + 8), w);
+            if (Point)
+                r3 = vmlaq_n_f32(r3, vld1q_f32(m + 12), w);
+        }
+
+        float32x4_t r = vmlaq_n_f32(vmlaq_n_f32(vmlaq_n_f32(r3, r0, v.x), r1, v.y), r2, v.z);
+        float tmp[4];
+        vst1q_f32(tmp, r);
+        dst[vi] = { tmp[0], tmp[1], tmp[2] };
+#else
+        float4 r0{}, r1{}, r2{}, r3{};
+        for (int i = 0; i < Width; ++i) {
+            const float4x4& m = matrices[vi_indices[i]];
+            float w = vi_weights[i];
+            r0 += m[0] * w;
+            r1 += m[1] * w;
+            r2 += m[2] * w;
+            if (Point)
+                r3 += m[3] * w;
+        }
+
+        float4 r = r0 * v.x + r1 * v.y + r2 * v.z + r3;
+        dst[vi] = { r.x, r.y, r.z };
+#endif
+    }
+#endif
+}
+
+template<bool Point>
+void Skin(float3* dst, const float3* src, const float4x4* matrices,
+    const int* indices, const float* weights, int width, size_t begin, size_t end)
+{
+    switch (width) {
+    case 1: SkinRange<1, Point>(dst, src, matrices, indices, weights, begin, end); break;
+    case 2: SkinRange<2, Point>(dst, src, matrices, indices, weights, begin, end); break;
+    case 4: SkinRange<4, Point>(dst, src, matrices, indices, weights, begin, end); break;
+    case 8: SkinRange<8, Point>(dst, src, matrices, indices, weights, begin, end); break;
+    default: break;
+    }
+}
+
+void SkinPoints(float3* dst, const float3* src, const float4x4* matrices,
+    const int* indices, const float* weights, int width, size_t begin, size_t end)
+{
+    Skin<true>(dst, src, matrices, indices, weights, width, begin, end);
+}
+
+void SkinNormals(float3* dst, const float3* src, const float4x4* matrices,
+    const int* indices, const float* weights, int width, size_t begin, size_t end)
+{
+    Skin<false>(dst, src, matrices, indices, weights, width, begin, end);
+}
+
+void FillKernels(MathKernels& dst)
+{
+    dst.mul_p = &MulPoints;
+    dst.mul_v = &MulVectors;
+    dst.normalize = &Normalize;
+    dst.mul_p_soa = &MulPointsSoA;
+    dst.mul_v_soa = &MulVectorsSoA;
+    dst.normalize_soa = &NormalizeSoA;
+    dst.triangle_normals = &TriangleNormals;
+    dst.bounds = &Bounds;
+    dst.skin_points = &SkinPoints;
+    dst.skin_normals = &SkinNormals;
+}
+
+#undef wabcKernelShuffle
+#undef wabcKernelSIMD
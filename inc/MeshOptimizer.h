@@ -0,0 +1,100 @@
+#ifndef MESH_OPTIMIZER_H
+#define MESH_OPTIMIZER_H
+
+#include "WebAlembicViewer.h"
+#include "sfbxRawVector.h"
+
+namespace wabc {
+
+using sfbx::make_span;
+using sfbx::RawVector;
+
+// load-time reordering of indexed triangle lists for the gpu:
+// - vertex cache: triangles in an order that reuses recently transformed vertices (tipsify)
+// - overdraw: clusters of that order sorted so that outward facing ones are drawn first
+// - vertex fetch: vertices in the order in which the triangles use them
+// none of them changes what is drawn. the overdraw pass keeps the winding and the clusters, so the vertex cache
+// efficiency is kept too.
+
+// size of the simulated fifo post-transform cache. real caches differ, but orderings that are good for 16 entries
+// are good for the others too.
+const int kVertexCacheSize = 16;
+
+struct VertexCacheStats
+{
+    float acmr = 0.0f; // average cache miss ratio: transformed vertices per triangle. 0.5 at best, 3 at worst
+    float atvr = 0.0f; // average transform to vertex ratio: transformed vertices per referenced vertex. 1 at best
+};
+
+VertexCacheStats AnalyzeVertexCache(span<unsigned int> indices, size_t num_vertices, int cache_size = kVertexCacheSize);
+
+// dst: same size as indices. clusters: if not null, receives the first triangle of each cluster, which the overdraw pass
+// takes as its hard boundaries.
+void OptimizeVertexCache(span<unsigned int> dst, span<unsigned int> indices, size_t num_vertices,
+    RawVector<unsigned int>* clusters = nullptr, int cache_size = kVertexCacheSize);
+
+// indices: output of OptimizeVertexCache() and its clusters. dst must not alias indices.
+// threshold: how much worse than the cache order the acmr may get in exchange for finer clusters. 1.05 is 5%.
+void OptimizeOverdraw(span<unsigned int> dst, span<unsigned int> indices, span<unsigned int> clusters,
+    span<float3> positions, float threshold = 1.05f, int cache_size = kVertexCacheSize);
+
+// remap: one element per vertex. receives the new index of each vertex, in the order of first use by indices.
+// vertices that no triangle uses are moved to the end. returns the number of used vertices.
+size_t OptimizeVertexFetchRemap(span<unsigned int> remap, span<unsigned int> indices);
+
+// in place. indices[i] = remap[indices[i]]
+void RemapIndices(span<unsigned int> indices, span<unsigned int> remap);
+
+// in place. vertices[remap[i]] = old vertices[i]
+template<class T>
+inline void RemapVertices(span<T> vertices, span<unsigned int> remap)
+{
+    RawVector<T> tmp;
+    tmp.assign(vertices.data(), vertices.size());
+    for (size_t i = 0; i < tmp.size(); ++i)
+        vertices[remap[i]] = tmp[i];
+}
+
+// a range of a triangle list whose indices fit in 16 bits once base_vertex is subtracted from them
+struct IndexRange
+{
+    size_t first_index = 0;
+    size_t num_indices = 0;
+    unsigned int base_vertex = 0;
+};
+
+// number of vertices that a range of 16 bit indices can address. WebGL2 always treats 0xFFFF as a primitive restart,
+// so the largest local index is 0xFFFE.
+const size_t kMaxIndices16 = 65535;
+
+// splits a triangle list, in order, into ranges whose vertices are within kMaxIndices16 of each other.
+// there is a single range with base_vertex 0 when every vertex fits. indices in vertex fetch order (see
+// OptimizeVertexFetchRemap()) split into about num_vertices / kMaxIndices16 ranges. returns false, with dst empty, if
+// a triangle spans more than that or if it would take more than twice the minimum number of ranges, in which case
+// the triangle list needs 32 bit indices.
+bool SplitIndices16(RawVector<IndexRange>& dst, span<unsigned int> indices, size_t num_vertices);
+
+// dst[i] = indices[i] - base_vertex of the range that contains i. dst: same size as indices.
+void ConvertIndices16(span<uint16_t> dst, span<unsigned int> indices, span<IndexRange> ranges);
+
+// all the passes above, with an optional disk cache.
+// the cache is keyed by the content of the indices and positions, so stale entries are never used.
+struct MeshOptimization
+{
+    RawVector<unsigned int> indices; // in the new vertex order
+    RawVector<unsigned int> remap;   // remap[old vertex] = new vertex. apply with RemapVertices()
+    VertexCacheStats before;
+    VertexCacheStats after;
+    bool from_cache = false;
+
+    // indices: triangle list. cache_dir: null to disable the cache. it is created if it doesn't exist.
+    bool optimize(span<unsigned int> indices, span<float3> positions, const char* cache_dir = nullptr);
+
+private:
+    bool load(const char* path, size_t num_indices, size_t num_vertices);
+    bool save(const char* path) const;
+};
+
+} // namespace wabc
+
+#endif
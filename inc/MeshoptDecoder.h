@@ -0,0 +1,35 @@
+#ifndef MESHOPT_DECODER_H
+#define MESHOPT_DECODER_H
+
+#include "WebAlembicViewer.h"
+
+namespace wabc {
+
+// decoders for the meshoptimizer codecs that EXT_meshopt_compression buffer views are stored in.
+// they only read src_size bytes of src, so malformed data makes them fail instead of reading past it.
+// they return false if the data is malformed or was encoded with a version that isn't supported.
+
+// attributes mode. stride must be a multiple of 4 and at most 256. dst receives count * stride bytes.
+// the bytes of each vertex are decoded 4 at a time with SSE2 when it's available and GetSimdLevel() isn't Scalar.
+bool DecodeMeshoptVertices(void* dst, size_t count, size_t stride, const uint8_t* src, size_t src_size);
+
+// triangles mode. count is the number of indices and must be a multiple of 3. index_size is 2 or 4.
+bool DecodeMeshoptTriangles(void* dst, size_t count, size_t index_size, const uint8_t* src, size_t src_size);
+
+// indices mode, for index lists that aren't triangles. index_size is 2 or 4.
+bool DecodeMeshoptIndices(void* dst, size_t count, size_t index_size, const uint8_t* src, size_t src_size);
+
+enum class MeshoptFilter
+{
+    None,
+    Octahedral,  // unit vectors. stride 4 (4 signed bytes) or 8 (4 signed shorts)
+    Quaternion,  // unit quaternions. stride 8 (4 signed shorts)
+    Exponential, // floats stored as a 24 bit mantissa and an 8 bit exponent. stride is a multiple of 4
+};
+
+// in place, on the output of DecodeMeshoptVertices(). returns false if stride doesn't suit the filter.
+bool ApplyMeshoptFilter(void* data, size_t count, size_t stride, MeshoptFilter filter);
+
+} // namespace wabc
+
+#endif
@@ -0,0 +1,68 @@
+#ifndef MORPH_TARGETS_H
+#define MORPH_TARGETS_H
+
+#include <vector>
+
+#include "glm/glm.hpp"
+
+class Shader;
+
+// Morph targets of a mesh primitive, blended in the vertex shader
+// The position and normal deltas of every target are packed once into a float texture, and after that only the indices
+// and weights of the active targets are uploaded as uniforms, so the per-frame cost is proportional to the number of
+// active targets instead of the number of vertices
+class MorphTargets
+{
+public:
+
+   // Active targets that the vertex shader can blend
+   // Must match the size of the uniform arrays in static_mesh_with_morph_targets.vert
+   static const int kMaxActiveTargets = 16;
+   // Width of the texture that stores the deltas
+   // Each vertex of each target uses 2 texels (position delta and normal delta), which are stored one after another in row-major order
+   static const int kTextureWidth     = 2048;
+
+   MorphTargets();
+   ~MorphTargets();
+
+   MorphTargets(const MorphTargets&) = delete;
+   MorphTargets& operator=(const MorphTargets&) = delete;
+
+   MorphTargets(MorphTargets&& rhs) noexcept;
+   MorphTargets& operator=(MorphTargets&& rhs) noexcept;
+
+   // The deltas are stored target by target, so the delta of vertex v of target t is at index t * numVertices + v
+   void                       SetNumTargets(unsigned int numTargets, unsigned int numVertices);
+   unsigned int               GetNumTargets() const  { return mNumTargets;     }
+   unsigned int               GetNumVertices() const { return mNumVertices;    }
+   std::vector<glm::vec3>&    GetPositionDeltas()    { return mPositionDeltas; }
+   std::vector<glm::vec3>&    GetNormalDeltas()      { return mNormalDeltas;   }
+   // False once LoadTexture has uploaded the deltas and freed them
+   bool                       HasDeltas() const;
+
+   // Creates the texture and frees the deltas. StaticMesh::LoadBuffers calls it once the vertices have their final order
+   // Does nothing if the deltas have already been uploaded
+   void                       LoadTexture();
+
+   // Only the targets with a non-zero weight are passed to the vertex shader
+   // If more than kMaxActiveTargets are active, the ones with the largest weights are kept
+   void                       SetWeights(const std::vector<float>& weights);
+   const std::vector<float>&  GetWeights() const     { return mWeights;        }
+   unsigned int               GetNumActiveTargets() const;
+
+   void                       Bind(const Shader& shader, unsigned int textureUnit) const;
+   void                       Unbind(unsigned int textureUnit) const;
+
+private:
+
+   unsigned int               mNumTargets;
+   unsigned int               mNumVertices;
+   std::vector<glm::vec3>     mPositionDeltas;
+   std::vector<glm::vec3>     mNormalDeltas;
+   std::vector<float>         mWeights;
+   std::vector<int>           mActiveTargets;
+   std::vector<float>         mActiveWeights;
+   unsigned int               mDeltasTex;
+};
+
+#endif
@@ -0,0 +1,84 @@
+#ifndef OFFSET_ALLOCATOR_H
+#define OFFSET_ALLOCATOR_H
+
+#include "WebAlembicViewer.h"
+#include "sfbxRawVector.h"
+
+namespace wabc {
+
+using sfbx::RawVector;
+
+// two-level segregated fit (tlsf) allocator of ranges of a resource that lives elsewhere, e.g. a gpu buffer.
+// it only hands out offsets, so it never touches the memory that it manages.
+// - free blocks are kept in 256 size classes: 32 powers of two, each split in 8 linear steps. allocation takes the
+//   first non-empty class that is large enough for the request, which two bitmasks find in constant time.
+// - freed blocks are merged with their free neighbors right away.
+// sizes and offsets are in units chosen by the caller, e.g. 16 bytes, so alignment is implicit.
+class OffsetAllocator
+{
+public:
+    static const uint32_t kInvalid = ~0u;
+
+    struct Allocation
+    {
+        uint32_t offset = kInvalid;
+        uint32_t node = kInvalid;
+
+        bool valid() const { return offset != kInvalid; }
+    };
+
+    struct StorageReport
+    {
+        uint32_t total_free = 0;
+        uint32_t largest_free = 0;
+        uint32_t num_free_blocks = 0;
+        uint32_t num_allocations = 0;
+    };
+
+    explicit OffsetAllocator(uint32_t size = 0);
+
+    // forgets every allocation
+    void reset(uint32_t size);
+
+    // returns an invalid allocation if there is no free block large enough
+    Allocation allocate(uint32_t size);
+    void free(Allocation allocation);
+
+    uint32_t allocationSize(Allocation allocation) const;
+    uint32_t size() const { return m_size; }
+    StorageReport storageReport() const;
+
+private:
+    static const int kNumTopBins = 32;
+    static const int kBinsPerTop = 8;
+    static const int kNumBins = kNumTopBins * kBinsPerTop;
+
+    struct Node
+    {
+        uint32_t offset = 0;
+        uint32_t size = 0;
+        uint32_t bin_prev = kInvalid;
+        uint32_t bin_next = kInvalid;
+        uint32_t neighbor_prev = kInvalid;
+        uint32_t neighbor_next = kInvalid;
+        bool used = false;
+    };
+
+    uint32_t newNode();
+    uint32_t insertFree(uint32_t offset, uint32_t size, uint32_t neighbor_prev, uint32_t neighbor_next);
+    void insertIntoBin(uint32_t node);
+    void removeFromBin(uint32_t node);
+
+    uint32_t m_size = 0;
+    uint32_t m_free_total = 0;
+    uint32_t m_num_allocations = 0;
+    uint32_t m_used_top = 0;
+    uint8_t m_used_bins[kNumTopBins] = {};
+    uint32_t m_bin_heads[kNumBins];
+    RawVector<Node> m_nodes;
+    RawVector<uint32_t> m_free_nodes;
+};
+
+} // namespace wabc
+
+#endif
@@ -0,0 +1,21 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <functional>
+
+#include "WebAlembicViewer.h"
+
+namespace wabc {
+
+// number of threads that ParallelFor() can use, including the calling thread. 1 if threads are not available.
+size_t GetConcurrency();
+
+// splits [0, n) into chunks of at least 'grain' elements and calls body(begin, end) for each of them.
+// chunks run on a persistent worker pool and the calling thread takes part too. returns when all chunks are done.
+// runs everything on the calling thread if threads are not available, if n is small, or if called from inside a chunk
+// of another ParallelFor() (nested calls run inline, whichever thread runs the chunk).
+void ParallelFor(size_t n, size_t grain, const std::function<void(size_t, size_t)>& body);
+
+} // namespace wabc
+
+#endif
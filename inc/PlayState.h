@@ -7,9 +7,16 @@
 #include "Shader.h"
 #include "Camera3.h"
 #include "WebAlembicViewer.h"
+#include "ScenePlaylist.h"
 #include "AlembicMesh.h"
-#include "StaticMesh.h"
+#include "StaticModel.h"
+#include "SkinnedMesh.h"
+#include "Skeleton.h"
+#include "Clip.h"
 #include "Texture.h"
+#include "AllocationTracker.h"
+
+struct cgltf_data;
 
 class PlayState : public State
 {
@@ -36,8 +43,30 @@ private:
    void configureLights(const std::shared_ptr<Shader>& shader);
 
    void loadHands();
-   void loadGeisha();
-   void loadSamurai();
+   void loadCharacters();
+   void loadGeisha(std::vector<StaticMesh>&& meshes);
+   void loadSamurai(std::vector<StaticMesh>&& meshes);
+
+   // The skinned meshes of a character, which are drawn with GPU skinning on top of its static meshes, and play its
+   // first animation clip in a loop
+   // Only rigged glTF files have any, so the ones of the bundled characters stay empty
+   struct SkinnedCharacter
+   {
+      Skeleton                    skeleton;
+      Pose                        pose;
+      std::vector<Clip>           clips;
+      ClipSampler                 sampler;
+      float                       playbackTime = 0.0f;
+      std::vector<wabc::ISkinPtr> skins;
+      std::vector<SkinnedMesh>    meshes;
+   };
+
+   void loadSkinnedCharacter(SkinnedCharacter& character, cgltf_data* data);
+   void updateSkinnedCharacter(SkinnedCharacter& character, float deltaTime);
+
+   // Interleaved or split vertex buffers, which can be switched at runtime to compare them
+   VertexLayout getVertexLayout() const;
+   void applyVertexLayout();
 
 #ifdef ENABLE_IMGUI
    void userInterface();
@@ -46,9 +75,43 @@ private:
    void renderHands();
    void renderGeisha();
    void renderSamurai();
+   void renderSkinnedCharacter(SkinnedCharacter& character, const glm::mat4& model, const glm::vec3& diffuseColor);
 
    void resetCamera();
 
+   // What a frame ended up showing
+   // A paused frame that shows the same as the previous one is in a steady state, and shouldn't allocate from the heap
+   struct FrameState
+   {
+      uint32_t frontSerial      = 0;
+      uint32_t backSerial       = 0;
+      int      subdivisionLevel = -1;
+      int      characterIndex   = -1;
+      bool     interleaved      = false;
+
+      bool operator==(const FrameState& rhs) const
+      {
+         return frontSerial == rhs.frontSerial && backSerial == rhs.backSerial &&
+                subdivisionLevel == rhs.subdivisionLevel && characterIndex == rhs.characterIndex &&
+                interleaved == rhs.interleaved;
+      }
+   };
+
+   void checkSteadyState();
+
+   // The GPU resources of a clip
+   // Geometry that's instanced in the Alembic file gets its own mesh that's drawn once per instance
+   struct AlembicBuffers
+   {
+      AlembicMesh              mesh;
+      std::vector<AlembicMesh> instancedMeshes;
+      uint32_t                 serial = 0;
+   };
+
+   void initializeAlembicBuffers(AlembicBuffers& buffers, wabc::IScene* scene, uint32_t serial);
+   void updateAlembicBuffers(AlembicBuffers& buffers, wabc::IScene* scene);
+   void applySubdivisionLevel(AlembicBuffers& buffers, wabc::IScene* scene);
+
    std::shared_ptr<FiniteStateMachine>          mFSM;
 
    std::shared_ptr<Window>                      mWindow;
@@ -56,25 +119,42 @@ private:
    Camera3                                      mCamera3;
 
    std::shared_ptr<Shader>                      mStaticMeshWithNormalsShader;
+   std::shared_ptr<Shader>                      mStaticMeshWithMorphTargetsShader;
    std::shared_ptr<Shader>                      mBlinnPhongShader;
+   std::shared_ptr<Shader>                      mBlinnPhongInstancedShader;
+   std::shared_ptr<Shader>                      mBlinnPhongSkinnedShader;
 
    float                                        mPlaybackSpeed = 1.0f;
+   int                                          mSubdivisionLevel = 2;
+   bool                                         mInterleavedVertices = false;
 
-   wabc::IScenePtr                              mScene;
+   wabc::ScenePlaylist                          mPlaylist;
 
-   AlembicMesh                                  mAlembicMesh;
-   float                                        mAlembicAnimationStartTime;
-   float                                        mAlembicAnimationEndTime;
-   float                                        mAlembicAnimationDuration;
-   float                                        mAlembicAnimationPlaybackTime;
+   // The buffers are double-buffered so that the clip that's preloaded in the background can be uploaded
+   // before the playlist switches to it
+   std::array<AlembicBuffers, 2>                mAlembicBuffers;
+   unsigned int                                 mFrontAlembicBuffersIndex;
 
-   std::vector<StaticMesh>                      mGeishaMeshes;
+   StaticModel                                  mGeishaModel;
    std::shared_ptr<Texture>                     mGeishaFaceTexture;
    std::shared_ptr<Texture>                     mGeishaEyesTexture;
 
+   // One mesh per primitive of samurai.glb, drawn once per instance of the nodes that refer to it
    std::vector<StaticMesh>                      mSamuraiMeshes;
+   // Undoes the transform of the root node of samurai.glb, which the instance matrices of the meshes include
+   glm::mat4                                    mSamuraiRootCorrection;
+
+   // Geisha and samurai, in the order of mCharacterIndex
+   std::array<SkinnedCharacter, 2>              mSkinnedCharacters;
 
    int                                          mCharacterIndex;
+
+   FrameState                                   mLastFrameState;
+
+#ifdef wabcEnableAllocationTracker
+   // Symbolizing the call sites is slow, so the table is only refreshed on demand
+   std::vector<wabc::AllocationSite>            mTopAllocationSites;
+#endif
 };
 
 #endif
@@ -0,0 +1,38 @@
+#ifndef POSE_H
+#define POSE_H
+
+#include <vector>
+
+#include "Transform.h"
+
+// Local transforms of the joints of a skeleton, together with the index of the parent of each joint
+// A parent index of -1 means that the joint is a root
+class Pose
+{
+public:
+
+   Pose();
+   Pose(unsigned int numJoints);
+
+   void         Resize(unsigned int numJoints);
+   unsigned int GetNumJoints() const;
+
+   int          GetParent(unsigned int jointIndex) const;
+   void         SetParent(unsigned int jointIndex, int parentIndex);
+
+   Transform    GetLocalTransform(unsigned int jointIndex) const;
+   void         SetLocalTransform(unsigned int jointIndex, const Transform& transform);
+
+   Transform    GetGlobalTransform(unsigned int jointIndex) const;
+
+   // Global matrix of each joint
+   // Parents usually come before their children, in which case the matrix of the parent is reused
+   void         GetMatrixPalette(std::vector<glm::mat4>& outMatrices) const;
+
+private:
+
+   std::vector<Transform> mJoints;
+   std::vector<int>       mParents;
+};
+
+#endif
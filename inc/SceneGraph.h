@@ -3,6 +3,7 @@
 
 #include "WebAlembicViewer.h"
 #include "sfbxRawVector.h"
+#include "Skinning.h"
 
 using namespace Alembic;
 
@@ -11,6 +12,10 @@ namespace wabc {
 using sfbx::make_span;
 using sfbx::RawVector;
 
+// geometry of Mesh and Points. 64 byte aligned so that the SIMD kernels do not split cache lines on the first
+// elements, and counted separately from the rest (see sfbx::EachAllocator()).
+sfbx::Allocator* GetMeshAllocator();
+
 class Camera : public ICamera
 {
 public:
@@ -46,16 +51,25 @@ public:
     span<JointWeight> getJointWeights() const override { return make_span(m_weights); }
     span<float4x4> getJointMatrices() const override { return make_span(m_matrices); }
 
+    // variable number of influences per vertex. used when a vertex has more than 8.
     template<class Vec, class Mul>
     bool deformImpl(span<Vec> dst, span<Vec> src, const Mul& mul) const;
 
     bool deformPoints(span<float3> dst, span<float3> src) const override;
     bool deformNormals(span<float3> dst, span<float3> src) const override;
 
+    // packs m_counts / m_weights for the fixed-width kernels. must be called again after modifying them.
+    // deformPoints() / deformNormals() call it if it has never been called.
+    void setupInfluences() const;
+
 public:
     RawVector<int> m_counts;
     RawVector<JointWeight> m_weights;
     RawVector<float4x4> m_matrices;
+
+    mutable bool m_influences_ready = false;
+    mutable PackedInfluences m_influences; // width 0: variable-length path
+    mutable RawVector<int> m_weight_offsets; // first weight of each vertex, for the variable-length path
 };
 using SkinPtr = std::shared_ptr<Skin>;
 
@@ -85,6 +99,7 @@ public:
     ~Mesh() override;
     span<float3> getPoints() const override { return make_span(m_points); }
     span<float3> getNormals() const override { return make_span(m_normals); }
+    span<float2> getUVs() const override { return make_span(m_uvs); }
     span<float3> getPointsEx() const override { return make_span(m_points_ex); }
     span<float3> getNormalsEx() const override { return make_span(m_normals_ex); }
     span<int> getCounts() const override { return make_span(m_counts); }
@@ -96,6 +111,7 @@ public:
 public:
     RawVector<float3> m_points;
     RawVector<float3> m_normals;
+    RawVector<float2> m_uvs;
     RawVector<float3> m_points_ex;
     RawVector<float3> m_normals_ex;
 
@@ -106,6 +122,21 @@ public:
 using MeshPtr = std::shared_ptr<Mesh>;
 
 
+class InstancedMesh : public IInstancedMesh
+{
+public:
+    IMesh* getMesh() override { return &m_mesh; }
+    span<float4x4> getInstanceMatrices() const override { return make_span(m_matrices); }
+
+    void clear();
+
+public:
+    Mesh m_mesh;
+    RawVector<float4x4> m_matrices;
+};
+using InstancedMeshPtr = std::shared_ptr<InstancedMesh>;
+
+
 class Points : public IPoints
 {
 public:
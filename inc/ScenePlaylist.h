@@ -0,0 +1,92 @@
+#ifndef SCENE_PLAYLIST_H
+#define SCENE_PLAYLIST_H
+
+#include <future>
+
+#include "WebAlembicViewer.h"
+
+namespace wabc {
+
+// plays a list of clips back to back.
+// while a clip is playing, the next one is opened, scanned and seeked to its start time in the background.
+// switching clips is then just a pointer swap instead of a full wabc::LoadScene().
+class ScenePlaylist
+{
+public:
+    struct Clip
+    {
+        std::string path;
+        double trim_end = 0.0; // seconds cut from the end of the clip's time range
+    };
+
+    ScenePlaylist();
+    ~ScenePlaylist();
+
+    ScenePlaylist(const ScenePlaylist&) = delete;
+    ScenePlaylist& operator=(const ScenePlaylist&) = delete;
+
+    void addClip(const std::string& path, double trim_end = 0.0);
+    void clear();
+
+    // opens the first clip synchronously and starts preloading the second one.
+    bool start();
+
+    // advances the playback time. when the current clip ends, playback switches to the next clip if it is ready.
+    // if it is not ready yet, the current clip loops until it is.
+    // clips that fail to open are skipped, and if none of the others open the current clip keeps looping.
+    // a playlist with only one clip simply loops it.
+    void update(double dt);
+
+    // seeks the current scene to the playback time.
+    void seek();
+
+    size_t getNumClips() const { return m_clips.size(); }
+    size_t getClipIndex() const { return m_clip_index; }
+    double getTime() const { return m_time; }
+    double getStartTime() const { return m_current.time_start; }
+    double getEndTime() const { return m_current.time_end; }
+
+    // serials identify opened clips. the same clip opened twice gets two serials.
+    // they can be used to know when GPU resources need to be refreshed. 0 means no clip.
+    IScene* getScene() const { return m_current.scene.get(); }
+    uint32_t getSerial() const { return m_current.serial; }
+    IScene* getNextScene() const { return m_next.scene.get(); } // nullptr while the next clip is loading
+    uint32_t getNextSerial() const { return m_next.serial; }
+
+private:
+    struct ClipState
+    {
+        IScenePtr scene;
+        uint32_t serial = 0;
+        double time_start = 0.0;
+        double time_end = 0.0;
+    };
+
+    static ClipState openClip(const Clip& clip, uint32_t serial);
+    void startPreload();
+    void pollPreload();
+    void waitPreload();
+    void onPreloaded();
+
+    std::vector<Clip> m_clips;
+    size_t m_clip_index = 0;
+    size_t m_next_offset = 1; // m_next is this many clips after the current one. grows when clips fail to open.
+    uint32_t m_serial_counter = 0;
+    double m_time = 0.0;
+
+    ClipState m_current;
+    ClipState m_next;
+#ifdef wabcEnableThreads
+    std::future<ClipState> m_preload;
+#endif
+};
+
+// plays the clip at path twice through a playlist with a missing clip in between, jumping to the end of each clip
+// once the next one is preloaded. checks that the missing clip is skipped and that every switch lands on the
+// preloaded scene. prints the failures and returns false if there are any. PlayState runs it at startup when
+// WABC_PLAYLIST_CHECK is set.
+bool CheckScenePlaylist(const std::string& path);
+
+} // namespace wabc
+
+#endif
@@ -3,6 +3,7 @@
 
 #include <map>
 #include <string>
+#include <string_view>
 #include <vector>
 
 #include "glm/glm.hpp"
@@ -26,31 +27,35 @@ public:
 
    unsigned int getID() const;
 
-   void         setUniformBool(const std::string& name, bool value) const;
-   void         setUniformInt(const std::string& name, int value) const;
-   void         setUniformFloat(const std::string& name, float value) const;
+   void         setUniformBool(std::string_view name, bool value) const;
+   void         setUniformInt(std::string_view name, int value) const;
+   void         setUniformFloat(std::string_view name, float value) const;
+   void         setUniformIntArray(std::string_view name, const std::vector<int>& values) const;
+   void         setUniformFloatArray(std::string_view name, const std::vector<float>& values) const;
 
-   void         setUniformVec2(const std::string& name, const glm::vec2& value) const;
-   void         setUniformVec2(const std::string& name, float x, float y) const;
-   void         setUniformVec3(const std::string& name, const glm::vec3& value) const;
-   void         setUniformVec3(const std::string& name, float x, float y, float z) const;
-   void         setUniformVec3Array(const std::string& name, const std::vector<glm::vec3>& values) const;
-   void         setUniformVec4(const std::string& name, const glm::vec4& value) const;
-   void         setUniformVec4(const std::string& name, float x, float y, float z, float w) const;
+   void         setUniformVec2(std::string_view name, const glm::vec2& value) const;
+   void         setUniformVec2(std::string_view name, float x, float y) const;
+   void         setUniformVec3(std::string_view name, const glm::vec3& value) const;
+   void         setUniformVec3(std::string_view name, float x, float y, float z) const;
+   void         setUniformVec3Array(std::string_view name, const std::vector<glm::vec3>& values) const;
+   void         setUniformVec4(std::string_view name, const glm::vec4& value) const;
+   void         setUniformVec4(std::string_view name, float x, float y, float z, float w) const;
 
-   void         setUniformMat2(const std::string& name, const glm::mat2& value) const;
-   void         setUniformMat3(const std::string& name, const glm::mat3& value) const;
-   void         setUniformMat4(const std::string& name, const glm::mat4& value) const;
-   void         setUniformMat4Array(const std::string& name, const std::vector<glm::mat4>& values) const;
+   void         setUniformMat2(std::string_view name, const glm::mat2& value) const;
+   void         setUniformMat3(std::string_view name, const glm::mat3& value) const;
+   void         setUniformMat4(std::string_view name, const glm::mat4& value) const;
+   void         setUniformMat4Array(std::string_view name, const std::vector<glm::mat4>& values) const;
 
-   int          getAttributeLocation(const std::string& attributeName) const;
-   int          getUniformLocation(const std::string& uniformName) const;
+   int          getAttributeLocation(std::string_view attributeName) const;
+   int          getUniformLocation(std::string_view uniformName) const;
 
 private:
 
-   unsigned int                        mShaderProgID;
-   std::map<std::string, unsigned int> mAttributes;
-   std::map<std::string, unsigned int> mUniforms;
+   // The maps are transparent so that they can be searched with a string_view
+   // Otherwise every setUniform* call would allocate a temporary std::string
+   unsigned int                                     mShaderProgID;
+   std::map<std::string, unsigned int, std::less<>> mAttributes;
+   std::map<std::string, unsigned int, std::less<>> mUniforms;
 };
 
 #endif
@@ -37,6 +37,8 @@ public:
 private:
 
    bool                    readShaderFile(const std::string& shaderFilePath, std::string& outShaderCode) const;
+   // Replaces every #include "file" line with the contents of that file, which is looked up next to the shader
+   bool                    resolveIncludes(const std::string& shaderFilePath, std::string& ioShaderCode) const;
    void                    addVersionToShaderCode(std::string& ioShaderCode, GLenum shaderType) const;
 
    unsigned int            createAndCompileShader(const std::string& shaderCode, GLenum shaderType) const;
@@ -0,0 +1,39 @@
+#ifndef SKELETON_H
+#define SKELETON_H
+
+#include <string>
+#include <vector>
+
+#include "Pose.h"
+#include "WebAlembicViewer.h"
+
+// Rest pose, inverse bind matrices and names of the joints of a rigged character
+class Skeleton
+{
+public:
+
+   Skeleton();
+   Skeleton(const Pose& restPose, const std::vector<glm::mat4>& inverseBindMatrices, const std::vector<std::string>& jointNames);
+
+   void                            Set(const Pose& restPose, const std::vector<glm::mat4>& inverseBindMatrices, const std::vector<std::string>& jointNames);
+
+   const Pose&                     GetRestPose() const            { return mRestPose;            }
+   const std::vector<glm::mat4>&   GetInverseBindMatrices() const { return mInverseBindMatrices; }
+   const std::vector<std::string>& GetJointNames() const          { return mJointNames;          }
+   unsigned int                    GetNumJoints() const           { return mRestPose.GetNumJoints(); }
+
+   // Writes the skinning matrices of a pose (the global matrix of each joint times its inverse bind matrix) into a skin
+   // The skin must have one joint matrix per joint of the skeleton
+   void                            UpdateSkin(const Pose& pose, wabc::ISkin& skin);
+
+private:
+
+   Pose                     mRestPose;
+   std::vector<glm::mat4>   mInverseBindMatrices;
+   std::vector<std::string> mJointNames;
+
+   // Reused every frame to avoid allocations
+   std::vector<glm::mat4>   mMatrixPalette;
+};
+
+#endif
@@ -0,0 +1,69 @@
+#ifndef SKINNED_MESH_H
+#define SKINNED_MESH_H
+
+#include <array>
+
+#include "WebAlembicViewer.h"
+
+// Mesh that's deformed by linear blend skinning on the GPU
+// The bind pose and the joint influences are uploaded once, and after that only the joint matrices are uploaded
+// every frame, so the per-frame upload is proportional to the number of joints instead of the number of vertices
+class SkinnedMesh
+{
+public:
+
+   // Influences per vertex in the vertex attributes
+   // Vertices with more influences keep their heaviest ones, renormalized
+   static const int kMaxInfluences = 4;
+
+   SkinnedMesh();
+   ~SkinnedMesh();
+
+   SkinnedMesh(const SkinnedMesh&) = delete;
+   SkinnedMesh& operator=(const SkinnedMesh&) = delete;
+
+   SkinnedMesh(SkinnedMesh&& rhs) noexcept;
+   SkinnedMesh& operator=(SkinnedMesh&& rhs) noexcept;
+
+   void                       InitializeBuffers(wabc::IMesh* bindPoseMesh, wabc::ISkin* skin);
+   void                       UpdateJointMatrices(wabc::span<wabc::float4x4> jointMatrices);
+
+   void                       ConfigureVAO(int posAttribLocation,
+                                           int normalAttribLocation,
+                                           int jointIndicesAttribLocation,
+                                           int jointWeightsAttribLocation);
+
+   void                       UnconfigureVAO(int posAttribLocation,
+                                             int normalAttribLocation,
+                                             int jointIndicesAttribLocation,
+                                             int jointWeightsAttribLocation);
+
+   void                       BindJointMatrices(unsigned int textureUnit, int uniformLocation) const;
+   void                       UnbindJointMatrices(unsigned int textureUnit) const;
+
+   void                       BindFloatAttribute(int attribLocation, unsigned int VBO, int numComponents);
+   void                       BindIntAttribute(int attribLocation, unsigned int VBO, int numComponents);
+   void                       UnbindAttribute(int attribLocation, unsigned int VBO);
+
+   void                       Render();
+
+private:
+
+   enum VBOTypes : unsigned int
+   {
+      positions    = 0,
+      normals      = 1,
+      jointIndices = 2,
+      jointWeights = 3,
+   };
+
+   unsigned int                mNumVertices;
+   unsigned int                mNumIndices;
+   unsigned int                mNumJoints;
+   unsigned int                mVAO;
+   std::array<unsigned int, 4> mVBOs;
+   unsigned int                mEBO;
+   unsigned int                mJointMatricesTex;
+};
+
+#endif
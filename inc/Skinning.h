@@ -0,0 +1,43 @@
+#ifndef SKINNING_H
+#define SKINNING_H
+
+#include "WebAlembicViewer.h"
+#include "sfbxRawVector.h"
+
+namespace wabc {
+
+struct MathKernels;
+
+using sfbx::RawVector;
+
+// joint influences packed to the same number of slots for every vertex.
+// vertex vi uses indices / weights [vi * width, vi * width + width). unused slots have weight 0.
+struct PackedInfluences
+{
+    int width = 0;
+    RawVector<int> indices;
+    RawVector<float> weights;
+
+    void clear();
+
+    // width: number of slots per vertex. vertices with more influences keep their heaviest ones, renormalized.
+    void pack(span<int> counts, span<JointWeight> weights, int width);
+};
+
+// narrowest specialized width (1, 2, 4 or 8) that holds the influences of every vertex.
+// 0 if a vertex has more than 8, in which case the variable-length path has to be used.
+int GetSkinningWidth(span<int> counts);
+
+// linear blend skinning with packed influences. width must be 1, 2, 4 or 8.
+// runs in parallel, with the instruction set of GetMathKernels().
+void SkinPoints(span<float3> dst, span<float3> src, span<float4x4> matrices, const PackedInfluences& influences);
+void SkinNormals(span<float3> dst, span<float3> src, span<float4x4> matrices, const PackedInfluences& influences);
+
+// times SkinPoints() with kernels against the per-vertex loop over variable-length influences that it replaced, on
+// synthetic meshes of 10k to 1M vertices with 4 influences each, and prints the timings.
+// it runs once, when the kernels are selected, if WABC_SKINNING_BENCHMARK is set (see GetMathKernels()).
+void BenchmarkSkinning(const MathKernels& kernels);
+
+} // namespace wabc
+
+#endif
@@ -6,10 +6,56 @@
 
 #include "glm/glm.hpp"
 
+#include "MorphTargets.h"
+#include "MeshOptimizer.h"
+#include "VertexLayout.h"
+#include "GPUHeap.h"
+
+class Shader;
+
 class StaticMesh
 {
 public:
 
+   // How the vertex attributes are stored on the GPU
+   // The compact encodings are decoded by the vertex shaders, which get the parameters they need from BindVertexFormat
+   struct VertexFormat
+   {
+      enum class Position : unsigned char
+      {
+         Float32, // 12 bytes
+         UNorm16, // 6 bytes, quantized to the bounding box of the mesh
+      };
+
+      enum class Normal : unsigned char
+      {
+         Float32,       // 12 bytes
+         Octahedral16,  // 4 bytes, octahedral encoding in 2 signed normalized shorts
+         Packed1010102, // 4 bytes, GL_INT_2_10_10_10_REV, decoded by the vertex fetch
+      };
+
+      enum class TexCoord : unsigned char
+      {
+         Float32, // 8 bytes
+         Half16,  // 4 bytes
+      };
+
+      Position     position = Position::Float32;
+      Normal       normal   = Normal::Float32;
+      TexCoord     texCoord = TexCoord::Float32;
+      VertexLayout layout   = VertexLayout::Split;
+
+      // 14 bytes per vertex instead of 32
+      static VertexFormat Compact() { return { Position::UNorm16, Normal::Octahedral16, TexCoord::Half16 }; }
+   };
+
+   // A range of the indices that is drawn on its own, like one of the primitives of a StaticModel
+   struct DrawRange
+   {
+      unsigned int firstIndex;
+      unsigned int numIndices;
+   };
+
    StaticMesh();
    ~StaticMesh();
 
@@ -23,24 +69,66 @@ public:
    std::vector<glm::vec3>&    GetNormals()   { return mNormals;   }
    std::vector<glm::vec2>&    GetTexCoords() { return mTexCoords; }
    std::vector<unsigned int>& GetIndices()   { return mIndices;   }
+   MorphTargets&              GetMorphTargets() { return mMorphTargets; }
+   // The world matrices of the instances, which LoadBuffers uploads with LoadInstanceMatrices when there are any
+   std::vector<glm::mat4>&    GetInstanceMatrices() { return mInstanceMatrices; }
+   bool                       HasMorphTargets() const { return mMorphTargets.GetNumTargets() > 0; }
    void                       GetMinAndMaxDimensions(glm::vec3& outMinDimensions, glm::vec3& outMaxDimensions) const;
 
+   // Reorders the triangles for the post-transform vertex cache and for overdraw, and then the vertices (morph targets
+   // included) in the order in which the triangles use them
+   // Must be called before LoadBuffers. The result is cached in cacheDir if it isn't null
+   bool                       Optimize(const char* cacheDir, wabc::MeshOptimization& outOptimization);
+
+   // The format must be set before LoadBuffers is called
+   void                       SetVertexFormat(const VertexFormat& format) { mVertexFormat = format; }
+   const VertexFormat&        GetVertexFormat() const { return mVertexFormat; }
+   // Size of the vertex data on the GPU
+   size_t                     GetVertexBufferSize() const { return mVertexBufferSize; }
+   // Size of the index data on the GPU
+   size_t                     GetIndexBufferSize() const { return mIndexBufferSize; }
+   // GL_UNSIGNED_SHORT when the vertices of every chunk are within 65535 of each other, GL_UNSIGNED_INT otherwise
+   unsigned int               GetIndexType() const { return mIndexType; }
+   unsigned int               GetNumIndexChunks() const { return static_cast<unsigned int>(mIndexChunks.size()); }
+
+   // Also uploads the deltas of the morph targets, so it must come after Optimize, and the instance matrices
    void                       LoadBuffers();
 
+   // Loads the world matrices of the instances that RenderInstanced draws into the vertex heap, next to the geometry
+   // Must be called before ConfigureVAO, unless the number of instances stays the same
+   void                       LoadInstanceMatrices(const std::vector<glm::mat4>& matrices);
+   unsigned int               GetNumInstances() const { return mNumInstances; }
+
+   // Sets the uniforms that the vertex shaders use to decode the vertex format of this mesh
+   void                       BindVertexFormat(const Shader& shader) const;
+   // Same for vertices that aren't encoded, like the ones of AlembicMesh, when they are drawn with the same shader
+   static void                BindFloatVertexFormat(const Shader& shader);
+
    void                       ConfigureVAO(int posAttribLocation,
                                            int normalAttribLocation,
-                                           int texCoordsAttribLocation);
+                                           int texCoordsAttribLocation,
+                                           int instanceMatrixAttribLocation = -1);
 
    void                       UnconfigureVAO(int posAttribLocation,
                                              int normalAttribLocation,
-                                             int texCoordsAttribLocation);
+                                             int texCoordsAttribLocation,
+                                             int instanceMatrixAttribLocation = -1);
 
    void                       BindFloatAttribute(int attribLocation, unsigned int VBO, int numComponents);
+   void                       BindAttribute(int attribLocation, const VertexAttribute& attribute, unsigned int baseVertex = 0);
    void                       BindIntAttribute(int attribLocation, unsigned int VBO, int numComponents);
    void                       UnbindAttribute(int attribLocation, unsigned int VBO);
+   void                       BindMat4InstanceAttribute(int attribLocation, unsigned int VBO, size_t offset);
+   void                       UnbindMat4InstanceAttribute(int attribLocation, unsigned int VBO);
 
    void                       Render();
    void                       RenderInstanced(unsigned int numInstances);
+   // Draws the ranges with one multi-draw call per index chunk when it's available, and with back-to-back draws otherwise
+   // Consecutive ranges are merged, so drawing all of the ranges of a mesh takes a single draw per chunk
+   void                       RenderRanges(const std::vector<DrawRange>& ranges);
+
+   // glMultiDrawElements natively, WEBGL_multi_draw on the web
+   static bool                MultiDrawIsAvailable();
 
 private:
 
@@ -48,19 +136,60 @@ private:
    std::vector<glm::vec3>      mNormals;
    std::vector<glm::vec2>      mTexCoords;
    std::vector<unsigned int>   mIndices;
+   MorphTargets                mMorphTargets;
+   std::vector<glm::mat4>      mInstanceMatrices;
 
    enum VBOTypes : unsigned int
    {
-      positions = 0,
-      normals   = 1,
-      texCoords = 2,
+      positions        = 0,
+      normals          = 1,
+      texCoords        = 2,
+      instanceMatrices = 3, // Only used to index mAttribLocations, since the matrices have their own allocation
    };
 
+   VertexFormat                mVertexFormat;
+   // Indexed by VBOTypes. The offsets are relative to the allocation of the mesh in the vertex heap, and the VBOs are
+   // only filled in by GetHeapAttributes, since defragmenting the heap moves the allocation
+   std::array<VertexAttribute, 3> mAttributes;
+   // Dequantization of UNorm16 positions: position = positionOffset + value * positionScale
+   glm::vec3                   mPositionOffset;
+   glm::vec3                   mPositionScale;
+
+   // A range of the indices and the VAO that draws it
+   // WebGL2 has no base vertex draws, so instead the attribute pointers of the VAO of each chunk start at its base vertex
+   // The first chunk uses mVAO, and there is always at least one
+   struct IndexChunk
+   {
+      unsigned int VAO;
+      unsigned int numIndices;
+      size_t       indexOffset; // In bytes
+      unsigned int baseVertex;
+   };
+
+   void                        LoadIndices();
+   void                        DeleteIndexChunks();
+   std::array<VertexAttribute, 3> GetHeapAttributes() const;
+   // Configures the VAOs again if the heaps have been defragmented since they were configured
+   void                        UpdateVAOs();
+
    unsigned int                mNumVertices;
    unsigned int                mNumIndices;
+   size_t                      mVertexBufferSize;
+   size_t                      mIndexBufferSize;
+   unsigned int                mIndexType;
    unsigned int                mVAO;
-   std::array<unsigned int, 3> mVBOs;
-   unsigned int                mEBO;
+   GPUHeap::Handle             mVertexAllocation;
+   GPUHeap::Handle             mIndexAllocation;
+   GPUHeap::Handle             mInstanceAllocation;
+   unsigned int                mNumInstances;
+   std::vector<IndexChunk>     mIndexChunks;
+   std::array<int, 4>          mAttribLocations;
+   unsigned int                mHeapGeneration;
+
+   // Reused by every call to RenderRanges, so that drawing doesn't allocate once they have grown
+   // They are scratch space, so moving a mesh doesn't move them
+   std::vector<int>            mDrawCounts;
+   std::vector<const void*>    mDrawOffsets;
 };
 
 #endif
@@ -0,0 +1,78 @@
+#ifndef STATIC_MODEL_H
+#define STATIC_MODEL_H
+
+#include <array>
+#include <vector>
+
+#include "StaticMesh.h"
+
+class Shader;
+
+// All the primitives of a model packed into a single vertex buffer and a single index buffer, with one index range per
+// primitive, so that they are drawn under one VAO and several of them can be submitted with one multi-draw call
+// Primitives with morph targets are kept in their own meshes, since the morph target shader finds their deltas with
+// gl_VertexID, and they are drawn with that shader when one is given to Render
+class StaticModel
+{
+public:
+
+   StaticModel() = default;
+   ~StaticModel() = default;
+
+   StaticModel(const StaticModel&) = delete;
+   StaticModel& operator=(const StaticModel&) = delete;
+
+   StaticModel(StaticModel&& rhs) noexcept = default;
+   StaticModel& operator=(StaticModel&& rhs) noexcept = default;
+
+   // Takes the CPU data of the meshes, whose buffers must not have been loaded yet, and loads the buffers of the model
+   // The primitives keep the order of the meshes
+   void                       Build(std::vector<StaticMesh>&& meshes, const StaticMesh::VertexFormat& vertexFormat);
+
+   unsigned int               GetNumPrimitives() const { return static_cast<unsigned int>(mPrimitives.size()); }
+   bool                       HasMorphTargets() const { return !mSeparateMeshes.empty(); }
+   // Size of the vertex and index data on the GPU
+   size_t                     GetBufferSize() const;
+
+   void                       ConfigureVAO(int posAttribLocation,
+                                           int normalAttribLocation,
+                                           int texCoordsAttribLocation);
+
+   void                       UnconfigureVAO(int posAttribLocation,
+                                             int normalAttribLocation,
+                                             int texCoordsAttribLocation);
+
+   // Configures the primitives with morph targets again for the attribute locations of the morph target shader
+   // Must be called after ConfigureVAO when they are drawn with that shader
+   void                       ConfigureMorphTargetsVAO(int posAttribLocation,
+                                                       int normalAttribLocation,
+                                                       int texCoordsAttribLocation);
+
+   // The shader is needed to bind the vertex format of each mesh (see StaticMesh::BindVertexFormat)
+   // The primitives with morph targets are drawn with morphTargetsShader if it isn't null, which must have the same
+   // uniforms set as shader, and with shader otherwise, in their rest pose. shader is in use again when these return
+   void                       Render(const Shader& shader, const Shader* morphTargetsShader = nullptr);
+   void                       RenderPrimitives(const Shader& shader, const std::vector<unsigned int>& primitives, const Shader* morphTargetsShader = nullptr);
+
+   // Texture unit of the morph target deltas, after the ones that the model's shaders use
+   static const unsigned int  kMorphTargetsTextureUnit = 1;
+
+private:
+
+   struct Primitive
+   {
+      int                     separateMesh; // Index in mSeparateMeshes, or -1 if the primitive is in mMergedMesh
+      StaticMesh::DrawRange   range;
+   };
+
+   StaticMesh                 mMergedMesh;
+   std::vector<StaticMesh>    mSeparateMeshes;
+   std::vector<Primitive>     mPrimitives;
+   std::vector<unsigned int>  mAllPrimitives;
+   std::array<int, 3>         mAttribLocations = { -1, -1, -1 };
+
+   // Reused by every call to RenderPrimitives
+   std::vector<StaticMesh::DrawRange> mDrawRanges;
+};
+
+#endif
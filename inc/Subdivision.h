@@ -0,0 +1,53 @@
+#ifndef SUBDIVISION_H
+#define SUBDIVISION_H
+
+#include "WebAlembicViewer.h"
+#include "sfbxRawVector.h"
+
+namespace wabc {
+
+using sfbx::make_span;
+using sfbx::RawVector;
+
+// Catmull-Clark refinement of a polygon cage, precomputed as stencil tables.
+// each refined point is a weighted sum of cage points. the weights only depend on topology and refinement level,
+// so they are built once and refining a frame is a sparse matrix-vector product.
+// boundaries follow the usual B-spline boundary rules. creases and corners are not supported.
+class SubdivisionStencils
+{
+public:
+    static const int kMaxLevel = 4;
+
+    // counts / indices: faces of the cage. faces with less than 3 vertices are ignored.
+    // level 0 keeps the cage as is (triangulated).
+    bool build(span<int> counts, span<int> indices, int num_points, int level);
+    void clear();
+
+    // dst must have getNumDstPoints() elements and src getNumSrcPoints(). runs in parallel.
+    bool refine(span<float3> dst, span<float3> src) const;
+
+    bool empty() const { return m_offsets.empty(); }
+    int getLevel() const { return m_level; }
+    int getNumSrcPoints() const { return m_num_src_points; }
+    int getNumDstPoints() const { return m_offsets.empty() ? 0 : (int)m_offsets.size() - 1; }
+
+    // refined topology. always triangles.
+    span<int> getCounts() const { return make_span(m_counts); }
+    span<int> getIndices() const { return make_span(m_indices); }
+
+private:
+    int m_level = 0;
+    int m_num_src_points = 0;
+
+    // stencil of dst point i: m_sources / m_weights in [m_offsets[i], m_offsets[i + 1])
+    RawVector<int> m_offsets;
+    RawVector<int> m_sources;
+    RawVector<float> m_weights;
+
+    RawVector<int> m_counts;
+    RawVector<int> m_indices;
+};
+
+} // namespace wabc
+
+#endif
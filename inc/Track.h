@@ -0,0 +1,60 @@
+#ifndef TRACK_H
+#define TRACK_H
+
+#include <vector>
+
+#include "glm/glm.hpp"
+
+#include "Quat.h"
+
+enum class Interpolation
+{
+   Constant,
+   Linear,
+   Cubic
+};
+
+// Keyframed values of a single property (e.g. the rotation of a joint)
+// Sampling takes a cursor that stores the keyframe that was used by the previous sample
+// During forward playback the next sample almost always falls in the same or in the next keyframe, so the lookup
+// is O(1) amortized, and it only falls back on a binary search when the playback jumps (e.g. when a clip loops)
+template<typename T>
+class Track
+{
+public:
+
+   Track();
+
+   // The times must be sorted
+   // For cubic interpolation there are 3 values per keyframe (in-tangent, value, out-tangent), like in glTF
+   void          SetKeyframes(std::vector<float>&& times, std::vector<T>&& values, Interpolation interpolation);
+
+   unsigned int  GetNumKeyframes() const { return static_cast<unsigned int>(mTimes.size()); }
+   Interpolation GetInterpolation() const { return mInterpolation; }
+   float         GetStartTime() const;
+   float         GetEndTime() const;
+   bool          IsResampled() const { return mSampleRate > 0.0f; }
+
+   // Times outside of the range of the track are clamped
+   T             Sample(float time, unsigned int& cursor) const;
+
+   // Replaces the keyframes with keyframes spaced uniformly at the given rate
+   // After this, sampling computes the keyframe directly from the time, which makes random access O(1) too
+   // Cubic tracks become linear, so a higher rate should be used for them
+   void          Resample(float sampleRate);
+
+private:
+
+   unsigned int  FindKeyframe(float time, unsigned int& cursor) const;
+   const T&      GetValue(unsigned int keyframe) const;
+
+   std::vector<float> mTimes;
+   std::vector<T>     mValues;
+   Interpolation      mInterpolation;
+   float              mSampleRate;
+};
+
+typedef Track<glm::vec3> VectorTrack;
+typedef Track<Q::quat>   QuaternionTrack;
+
+#endif
@@ -3,6 +3,8 @@
 
 #include "glm/glm.hpp"
 
+#include "VectorMath.h"
+
 namespace Utility
 {
    const float epsilon = 0.000001f;
@@ -11,6 +13,11 @@ namespace Utility
    glm::vec3 normalizeWithZeroLengthCheck(const glm::vec3& v);
 
    glm::vec3 hexToColor(int hex);
+
+   // wabc::float4x4 stores the translation in its last row, which is the same memory layout as a column-major glm::mat4
+   // The conversions are plain copies, and arrays of wabc::float4x4 can be uploaded as they are wherever a shader expects mat4s
+   glm::mat4      toMat4(const wabc::float4x4& m);
+   wabc::float4x4 toFloat4x4(const glm::mat4& m);
 }
 
 #endif
@@ -0,0 +1,36 @@
+#ifndef VECTOR_MATH_BATCH_H
+#define VECTOR_MATH_BATCH_H
+
+#include "WebAlembicViewer.h"
+
+namespace wabc {
+
+// span-level versions of the VectorMath functions. they run the kernels of GetMathKernels() (see CpuDispatch.h),
+// which process 4, 8 or 16 elements per iteration depending on the instruction set.
+// float3 arrays are tightly packed AoS with no alignment requirement. dst and src may be the same array.
+
+void mul_p(span<float3> dst, span<float3> src, const float4x4& m);
+void mul_v(span<float3> dst, span<float3> src, const float4x4& m);
+void normalize(span<float3> dst, span<float3> src);
+
+// flat normal of each triangle, written to its three vertices. later triangles overwrite shared vertices.
+// dst must have as many elements as the largest index + 1.
+void triangle_normals(span<float3> dst, span<float3> points, span<int> indices);
+
+// axis-aligned bounds of src. FLT_MAX / -FLT_MAX if src is empty.
+void bounds(span<float3> src, float3& bmin, float3& bmax);
+
+// SoA layout: n elements in three separate arrays.
+struct float3_soa
+{
+    float* x;
+    float* y;
+    float* z;
+};
+void mul_p(float3_soa dst, float3_soa src, size_t n, const float4x4& m);
+void mul_v(float3_soa dst, float3_soa src, size_t n, const float4x4& m);
+void normalize(float3_soa dst, float3_soa src, size_t n);
+
+} // namespace wabc
+
+#endif
@@ -0,0 +1,35 @@
+#ifndef VERTEX_LAYOUT_H
+#define VERTEX_LAYOUT_H
+
+#include <cstddef>
+
+// How the vertex attributes of a mesh are arranged in its VBOs
+enum class VertexLayout : unsigned char
+{
+   Split,       // One tightly packed VBO per attribute
+   Interleaved, // The attributes of each vertex next to each other in a single VBO, so a vertex is fetched from one place
+};
+
+// Where and how an attribute is stored, which is what glVertexAttribPointer needs
+// A numComponents of 0 means that the mesh doesn't have the attribute
+struct VertexAttribute
+{
+   unsigned int VBO           = 0;
+   int          numComponents = 0;
+   unsigned int type          = 0;
+   bool         normalized    = false;
+   unsigned int size          = 0; // Bytes per vertex
+   unsigned int stride        = 0; // 0 if tightly packed
+   size_t       offset        = 0;
+
+   bool         IsEnabled() const { return numComponents > 0; }
+};
+
+// Interleaved attributes start at multiples of 4 bytes, which WebGL requires for the packed formats and which keeps
+// every attribute aligned to its component size
+inline unsigned int AlignVertexAttributeSize(unsigned int size)
+{
+   return (size + 3) & ~3u;
+}
+
+#endif
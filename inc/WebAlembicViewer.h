@@ -4,6 +4,29 @@
 #include "VectorMath.h"
 #include "sfbxTypes.h"
 
+// background work (clip preloading etc.) needs real threads.
+// they are available on native builds, and on emscripten builds only when compiled with -pthread.
+#if !defined(__EMSCRIPTEN__) || defined(__EMSCRIPTEN_PTHREADS__)
+    #define wabcEnableThreads
+#endif
+
+// SSE is always there on x64. other targets opt in with __SSE__, like emscripten with -msimd128 -msse2 (the
+// WABC_WASM_SIMD cmake option).
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+    #define wabcEnableSSE
+#endif
+
+// NEON is always there on arm64.
+#if !defined(wabcEnableSSE) && (defined(__ARM_NEON) || defined(__ARM_NEON__))
+    #define wabcEnableNEON
+#endif
+
+// native x86 builds compile the hot math kernels for several instruction sets and pick one at startup (see
+// CpuDispatch.h). emscripten has no cpuid, so it and the other targets use the level they were compiled for.
+#if !defined(__EMSCRIPTEN__) && (defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86))
+    #define wabcEnableCpuDispatch
+#endif
+
 namespace wabc {
 
 template<class T>
@@ -33,6 +56,19 @@ public:
     virtual float getFarPlane() const = 0;
 };
 
+// per-time camera output of IScene::seekMany()
+struct CameraData
+{
+    float3 position{};
+    float3 direction{ 0.0f, 0.0f, 1.0f };
+    float3 up{ 0.0f, 1.0f, 0.0f };
+    float focal_length = 30.0f;
+    float2 aperture{ 36.0f, 24.0f };
+    float2 lens_shift{};
+    float near_plane = 0.01f;
+    float far_plane = 100.0f;
+};
+
 struct JointWeight
 {
     int index{};
@@ -65,7 +101,8 @@ class IMesh : public IEntity
 {
 public:
     virtual span<float3> getPoints() const = 0;
-    virtual span<float3> getNormals() const = 0;
+    virtual span<float3> getNormals() const = 0; // authored normals. empty if any of the source meshes has none
+    virtual span<float2> getUVs() const = 0; // authored uvs. empty if any of the source meshes has none
     virtual span<float3> getPointsEx() const = 0; // expanded (not indexed)
     virtual span<float3> getNormalsEx() const = 0; // expanded (not indexed)
     virtual span<int> getCounts() const = 0;
@@ -73,6 +110,14 @@ public:
     virtual span<int> getWireframeIndices() const = 0;
 };
 
+// geometry that is shared by several Alembic instances. it is decoded once per seek, in the local space of its source.
+class IInstancedMesh : public IEntity
+{
+public:
+    virtual IMesh* getMesh() = 0;
+    virtual span<float4x4> getInstanceMatrices() const = 0; // local to world matrix of each instance
+};
+
 class IPoints : public IEntity
 {
 public:
@@ -92,9 +137,23 @@ public:
     virtual std::tuple<double, double> getTimeRange() const = 0;
     virtual void seek(double time) = 0;
 
+    // evaluates many times at once (baking, trails, thumbnails...). the hierarchy is walked once, constant transforms
+    // are read once and topology is not read at all. times are evaluated in parallel. getTime(), getMesh() etc are not affected.
+    // dst_points: points of the monolithic mesh for each time, time-major. the stride is dst_points.size() / times.size(),
+    //             which is typically getMesh()->getPoints().size() after a regular seek(). can be empty.
+    // dst_cameras: camera data for each time, time-major with getCameras().size() elements per time. can be empty.
+    // returns false if the mesh of any time did not fit in its stride.
+    virtual bool seekMany(span<double> times, span<float3> dst_points, span<CameraData> dst_cameras) = 0;
+
+    // Catmull-Clark refinement level of subdivision surfaces. 0 draws the cages as they are.
+    // changing it rebuilds the refinement tables and evaluates the current time again.
+    virtual void setSubdivisionLevel(int level) = 0;
+    virtual int getSubdivisionLevel() const = 0;
+
     virtual double getTime() const = 0;
-    virtual IMesh* getMesh() = 0;     // monolithic mesh
+    virtual IMesh* getMesh() = 0;     // monolithic mesh. instanced geometry is not included
     virtual IPoints* getPoints() = 0; // monolithic points
+    virtual span<IInstancedMesh*> getInstancedMeshes() = 0;
     virtual span<ICamera*> getCameras() = 0;
 };
 IScene* CreateSceneABC_();
@@ -103,6 +162,15 @@ using IScenePtr = std::shared_ptr<IScene>;
 inline IScenePtr CreateSceneABC() { return IScenePtr(CreateSceneABC_(), releaser<IScene>()); }
 inline IScenePtr LoadScene(const char* path) { return IScenePtr(LoadScene_(path), releaser<IScene>()); }
 
+// meshes and skins that don't come from an Alembic scene (glTF skinned meshes etc).
+// the mesh is made of triangles. the skin has num_joints joint matrices, initialized to identity.
+IMesh* CreateMesh_(span<float3> points, span<float3> normals, span<int> triangle_indices);
+ISkin* CreateSkin_(span<int> counts, span<JointWeight> weights, size_t num_joints);
+using IMeshPtr = std::shared_ptr<IMesh>;
+using ISkinPtr = std::shared_ptr<ISkin>;
+inline IMeshPtr CreateMesh(span<float3> points, span<float3> normals, span<int> triangle_indices) { return IMeshPtr(CreateMesh_(points, normals, triangle_indices)); }
+inline ISkinPtr CreateSkin(span<int> counts, span<JointWeight> weights, size_t num_joints) { return ISkinPtr(CreateSkin_(counts, weights, num_joints)); }
+
 
 enum class SensorFitMode
 {
@@ -1,6 +1,7 @@
 #ifndef PCH_H
 #define PCH_H
 
+#include <atomic>
 #include <fstream>
 
 #include <Alembic/AbcCoreOgawa/All.h>
@@ -0,0 +1,159 @@
+#ifndef SFBX_ALLOCATOR_H
+#define SFBX_ALLOCATOR_H
+
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include "sfbxTypes.h"
+
+namespace sfbx {
+
+// where the memory of RawVector comes from.
+// every allocator has a name and byte counters, and EachAllocator() lists them, which shows where the memory goes.
+// allocators must outlive the RawVectors that use them.
+class Allocator
+{
+public:
+    struct Stats
+    {
+        size_t bytes = 0;             // currently allocated
+        size_t peak_bytes = 0;
+        size_t reserved_bytes = 0;    // taken from the system for pools and arenas. 0 for the others
+        size_t allocations = 0;       // currently allocated blocks
+        size_t total_allocations = 0;
+        size_t total_bytes = 0;       // allocated so far, growth of resized blocks included
+        size_t reallocations = 0;
+        size_t copied_bytes = 0;      // by reallocations that could not resize in place. realloc() internals excluded
+    };
+
+    // alignment: power of two, at most 4096
+    Allocator(const char* name, size_t alignment);
+    virtual ~Allocator();
+    Allocator(const Allocator&) = delete;
+    Allocator& operator=(const Allocator&) = delete;
+
+    const char* getName() const { return m_name; }
+    size_t getAlignment() const { return m_alignment; }
+    Stats getStats() const;
+
+    // size is the one that was passed to allocate() / reallocate(). it is never 0.
+    virtual void* allocate(size_t size) = 0;
+    virtual void deallocate(void* addr, size_t size) = 0;
+    // resizes a block and keeps its first used_size bytes. addr can be null and new_size can be 0.
+    // the default allocates a new block and copies.
+    virtual void* reallocate(void* addr, size_t old_size, size_t new_size, size_t used_size);
+
+protected:
+    void onAllocate(size_t size);
+    void onDeallocate(size_t size, size_t count = 1);
+    // the block was resized without a copy
+    void onResize(size_t old_size, size_t new_size);
+    void onReserve(ptrdiff_t size);
+
+private:
+    const char* m_name;
+    size_t m_alignment;
+    std::atomic<size_t> m_bytes{ 0 };
+    std::atomic<size_t> m_peak_bytes{ 0 };
+    std::atomic<size_t> m_reserved_bytes{ 0 };
+    std::atomic<size_t> m_allocations{ 0 };
+    std::atomic<size_t> m_total_allocations{ 0 };
+    std::atomic<size_t> m_total_bytes{ 0 };
+    std::atomic<size_t> m_reallocations{ 0 };
+    std::atomic<size_t> m_copied_bytes{ 0 };
+};
+
+// malloc / realloc. blocks of kLargeBlockSize bytes or more are mapped directly on linux, with transparent huge pages
+// enabled, and grow with mremap() instead of being copied. thread safe.
+class HeapAllocator : public Allocator
+{
+public:
+    static const size_t kLargeBlockSize = 1024 * 1024;
+
+    HeapAllocator(const char* name, size_t alignment = 16);
+
+    void* allocate(size_t size) override;
+    void deallocate(void* addr, size_t size) override;
+    void* reallocate(void* addr, size_t old_size, size_t new_size, size_t used_size) override;
+};
+
+// bump allocator for temporary data. deallocate() only gives memory back when it is the most recent allocation, and
+// reset() frees everything at once. the most recent allocation also grows in place.
+// the blocks come from the default allocator and are kept across reset(). not thread safe.
+class ArenaAllocator : public Allocator
+{
+public:
+    ArenaAllocator(const char* name, size_t block_size = 1024 * 1024, size_t alignment = 16);
+    ~ArenaAllocator() override;
+
+    void* allocate(size_t size) override;
+    void deallocate(void* addr, size_t size) override;
+    void* reallocate(void* addr, size_t old_size, size_t new_size, size_t used_size) override;
+
+    // invalidates every allocation.
+    void reset();
+
+    // position of the arena. rewind() gives back everything allocated after it, which must not be in use anymore.
+    struct Marker
+    {
+        size_t block_index = 0;
+        size_t offset = 0;
+    };
+    Marker getMarker() const;
+    void rewind(const Marker& marker);
+
+private:
+    struct Block
+    {
+        char* data;
+        size_t size;
+    };
+    char* bump(size_t size);
+
+    size_t m_block_size;
+    std::vector<Block> m_blocks;
+    size_t m_block_index = 0;
+    size_t m_offset = 0;
+    char* m_last = nullptr;
+};
+
+// free lists of power of two size classes, for small vectors that are created and destroyed all the time.
+// blocks larger than max_block_size are not pooled. freed blocks are kept until the pool is destroyed. thread safe.
+class PoolAllocator : public Allocator
+{
+public:
+    PoolAllocator(const char* name, size_t max_block_size = 64 * 1024, size_t alignment = 16);
+    ~PoolAllocator() override;
+
+    void* allocate(size_t size) override;
+    void deallocate(void* addr, size_t size) override;
+    void* reallocate(void* addr, size_t old_size, size_t new_size, size_t used_size) override;
+
+private:
+    static const int kMinClass = 4; // 16 bytes
+    static const int kMaxClasses = 32;
+    int getClass(size_t size) const;
+
+    struct FreeBlock { FreeBlock* next; };
+
+    std::mutex m_mutex;
+    size_t m_max_block_size;
+    FreeBlock* m_free_lists[kMaxClasses] = {};
+    std::vector<std::pair<void*, size_t>> m_chunks;
+};
+
+// malloc alignment. used by RawVector when no allocator is specified
+Allocator* GetDefaultAllocator();
+// 64 byte alignment (cache lines, AVX-512 registers)
+Allocator* GetAlignedAllocator();
+
+// calls f for every allocator that currently exists
+void EachAllocator(const std::function<void(Allocator&)>& f);
+
+// number of times the calling thread has taken memory from the system heap through any allocator, including the
+// blocks of arenas and pools. it only goes up. the difference between two points shows whether code allocates.
+size_t GetThreadHeapAllocations();
+
+} // namespace sfbx
+
+#endif
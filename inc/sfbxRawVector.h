@@ -2,6 +2,7 @@
 #define SFBX_RAW_VECTOR_H
 
 #include "sfbxTypes.h"
+#include "sfbxAllocator.h"
 
 namespace sfbx {
 
@@ -9,6 +10,8 @@ namespace sfbx {
 // T must be POD types because its constructor and destructor are never called.
 // that also means this can be significantly faster than std::vector in some specific situations.
 // (e.g. temporary buffers that can be very large and frequently resized)
+// the memory comes from an Allocator (see sfbxAllocator.h), GetDefaultAllocator() if none is specified.
+// moves and swaps take the allocator along. copies use the default allocator.
 template<class T>
 class RawVector
 {
@@ -22,6 +25,7 @@ public:
     using const_iterator = const_pointer;
 
     RawVector() {}
+    explicit RawVector(Allocator* allocator) : m_allocator(allocator) {}
     RawVector(RawVector&& v) noexcept { swap(v); }
     RawVector(const RawVector& v) { assign(v.begin(), v.end()); }
     RawVector(std::initializer_list<T> v) { assign(v); }
@@ -66,44 +70,36 @@ public:
     const_iterator begin() const { return m_data; }
     const_iterator end() const { return m_data + m_size; }
 
-    static T* allocate(size_t size) { return (T*)malloc(size); }
-    static void deallocate(T* addr, size_t /*size*/) { free(addr); }
+    Allocator* get_allocator() const { return m_allocator ? m_allocator : GetDefaultAllocator(); }
+
+    // moves the elements to memory of another allocator. null means the default allocator.
+    void set_allocator(Allocator* allocator)
+    {
+        if (get_allocator() == (allocator ? allocator : GetDefaultAllocator()))
+            return;
+        RawVector tmp(allocator);
+        tmp.assign(make_span(m_data, m_size));
+        swap(tmp);
+    }
 
     void reserve(size_t s)
     {
         if (s > m_capacity) {
             s = std::max<size_t>(s, m_size * 2);
-            size_t newsize = sizeof(T) * s;
-            size_t oldsize = sizeof(T) * m_size;
-
-            T* newdata = allocate(newsize);
-            memcpy(newdata, m_data, oldsize);
-            deallocate(m_data, oldsize);
-            m_data = newdata;
+            // the allocator grows the block in place when it can (realloc, mremap, arena top)
+            m_data = (T*)get_allocator()->reallocate(m_data, sizeof(T) * m_capacity, sizeof(T) * s, sizeof(T) * m_size);
             m_capacity = s;
         }
     }
 
     void shrink_to_fit()
     {
-        if (m_size == 0) {
-            deallocate(m_data, m_size);
-            m_data = nullptr;
-            m_size = m_capacity = 0;
-        }
-        else if (m_size == m_capacity) {
+        if (m_size == m_capacity) {
             // nothing to do
             return;
         }
-        else {
-            size_t newsize = sizeof(T) * m_size;
-            size_t oldsize = sizeof(T) * m_capacity;
-            T* newdata = allocate(newsize);
-            memcpy(newdata, m_data, newsize);
-            deallocate(m_data, oldsize);
-            m_data = newdata;
-            m_capacity = m_size;
-        }
+        m_data = (T*)get_allocator()->reallocate(m_data, sizeof(T) * m_capacity, sizeof(T) * m_size, sizeof(T) * m_size);
+        m_capacity = m_size;
     }
 
     void resize(size_t s)
@@ -130,6 +126,7 @@ public:
         std::swap(m_data, other.m_data);
         std::swap(m_size, other.m_size);
         std::swap(m_capacity, other.m_capacity);
+        std::swap(m_allocator, other.m_allocator);
     }
 
     template<class Iter>
@@ -228,6 +225,7 @@ private:
     T* m_data = nullptr;
     size_t m_size = 0;
     size_t m_capacity = 0;
+    Allocator* m_allocator = nullptr;
 };
 
 template<class T> inline constexpr bool is_RawVector = false;
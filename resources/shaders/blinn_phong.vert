@@ -5,14 +5,18 @@ uniform mat4 model;
 uniform mat4 view;
 uniform mat4 projection;
 
+#include "vertex_format.glsl"
+
 out vec3 fragPos;
 out vec3 norm;
 
 void main()
 {
-   gl_Position = projection * view * model * vec4(position, 1.0f);
+   vec3 decodedPosition = decodePosition(position);
+
+   gl_Position = projection * view * model * vec4(decodedPosition, 1.0f);
 
-   fragPos = vec3(model * vec4(position, 1.0f));
+   fragPos = vec3(model * vec4(decodedPosition, 1.0f));
    // TODO: To support non-uniform scaling we will need to change the way we transform the normals
-   norm    = normalize(mat3(model) * normal);
+   norm    = normalize(mat3(model) * decodeNormal(normal));
 }
@@ -0,0 +1,24 @@
+in vec3 position;
+in vec3 normal;
+in mat4 instanceModel;
+
+uniform mat4 model;
+uniform mat4 view;
+uniform mat4 projection;
+
+#include "vertex_format.glsl"
+
+out vec3 fragPos;
+out vec3 norm;
+
+void main()
+{
+   mat4 instanceToWorld = model * instanceModel;
+   vec3 decodedPosition = decodePosition(position);
+
+   gl_Position = projection * view * instanceToWorld * vec4(decodedPosition, 1.0f);
+
+   fragPos = vec3(instanceToWorld * vec4(decodedPosition, 1.0f));
+   // TODO: To support non-uniform scaling we will need to change the way we transform the normals
+   norm    = normalize(mat3(instanceToWorld) * decodeNormal(normal));
+}
@@ -0,0 +1,38 @@
+in vec3  position;
+in vec3  normal;
+in ivec4 jointIndices;
+in vec4  jointWeights;
+
+uniform mat4 model;
+uniform mat4 view;
+uniform mat4 projection;
+
+// One joint matrix per row, stored as 4 RGBA texels (one per column)
+uniform highp sampler2D jointMatrices;
+
+out vec3 fragPos;
+out vec3 norm;
+
+mat4 getJointMatrix(int joint)
+{
+   return mat4(texelFetch(jointMatrices, ivec2(0, joint), 0),
+               texelFetch(jointMatrices, ivec2(1, joint), 0),
+               texelFetch(jointMatrices, ivec2(2, joint), 0),
+               texelFetch(jointMatrices, ivec2(3, joint), 0));
+}
+
+void main()
+{
+   mat4 skinMatrix = getJointMatrix(jointIndices.x) * jointWeights.x +
+                     getJointMatrix(jointIndices.y) * jointWeights.y +
+                     getJointMatrix(jointIndices.z) * jointWeights.z +
+                     getJointMatrix(jointIndices.w) * jointWeights.w;
+
+   mat4 skinToWorld = model * skinMatrix;
+
+   gl_Position = projection * view * skinToWorld * vec4(position, 1.0f);
+
+   fragPos = vec3(skinToWorld * vec4(position, 1.0f));
+   // TODO: To support non-uniform scaling we will need to change the way we transform the normals
+   norm    = normalize(mat3(skinToWorld) * normal);
+}
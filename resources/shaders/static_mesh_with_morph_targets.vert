@@ -0,0 +1,50 @@
+in vec3 position;
+in vec3 normal;
+in vec2 texCoord;
+
+uniform mat4 model;
+uniform mat4 view;
+uniform mat4 projection;
+
+#include "vertex_format.glsl"
+
+// Position and normal deltas of every morph target, stored as 2 consecutive RGBA texels per vertex per target
+// The texel of the position delta of vertex v of target t is (t * numMorphTargetVertices + v) * 2
+uniform highp sampler2D morphTargetDeltas;
+uniform int             numMorphTargetVertices;
+
+// Only the targets with a non-zero weight are passed in
+// The size of these arrays must match MorphTargets::kMaxActiveTargets
+uniform int   numActiveMorphTargets;
+uniform int   activeMorphTargets[16];
+uniform float activeMorphWeights[16];
+
+out vec3 fragPos;
+out vec3 norm;
+out vec2 uv;
+
+const int kTextureWidth = 2048;
+
+vec3 getMorphTargetDelta(int texel)
+{
+   return texelFetch(morphTargetDeltas, ivec2(texel % kTextureWidth, texel / kTextureWidth), 0).xyz;
+}
+
+void main()
+{
+   // The deltas are in the space of the decoded vertices
+   vec3 morphedPosition = decodePosition(position);
+   vec3 morphedNormal   = decodeNormal(normal);
+   for (int i = 0; i < numActiveMorphTargets; ++i)
+   {
+      int texel = (activeMorphTargets[i] * numMorphTargetVertices + gl_VertexID) * 2;
+      morphedPosition += getMorphTargetDelta(texel)     * activeMorphWeights[i];
+      morphedNormal   += getMorphTargetDelta(texel + 1) * activeMorphWeights[i];
+   }
+
+   gl_Position = projection * view * model * vec4(morphedPosition, 1.0f);
+
+   fragPos = vec3(model * vec4(morphedPosition, 1.0f));
+   norm    = normalize(vec3(model * vec4(morphedNormal, 0.0f)));
+   uv      = texCoord;
+}
@@ -6,15 +6,19 @@ uniform mat4 model;
 uniform mat4 view;
 uniform mat4 projection;
 
+#include "vertex_format.glsl"
+
 out vec3 fragPos;
 out vec3 norm;
 out vec2 uv;
 
 void main()
 {
-   gl_Position = projection * view * model * vec4(position, 1.0f);
+   vec3 decodedPosition = decodePosition(position);
+
+   gl_Position = projection * view * model * vec4(decodedPosition, 1.0f);
 
-   fragPos = vec3(model * vec4(position, 1.0f));
-   norm    = normalize(vec3(model * vec4(normal, 0.0f)));
+   fragPos = vec3(model * vec4(decodedPosition, 1.0f));
+   norm    = normalize(vec3(model * vec4(decodeNormal(normal), 0.0f)));
    uv      = texCoord;
 }
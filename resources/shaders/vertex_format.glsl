@@ -0,0 +1,24 @@
+// Decoding of the compact vertex formats of StaticMesh, set by StaticMesh::BindVertexFormat
+// Included by the vertex shaders of static meshes
+uniform vec3 positionOffset;
+uniform vec3 positionScale;
+uniform bool octahedralNormals;
+
+vec3 decodePosition(vec3 p)
+{
+   return positionOffset + p * positionScale;
+}
+
+vec3 decodeOctahedral(vec2 e)
+{
+   vec3 n = vec3(e, 1.0f - abs(e.x) - abs(e.y));
+   float t = max(-n.z, 0.0f);
+   n.x += n.x >= 0.0f ? -t : t;
+   n.y += n.y >= 0.0f ? -t : t;
+   return normalize(n);
+}
+
+vec3 decodeNormal(vec3 n)
+{
+   return octahedralNormals ? decodeOctahedral(n.xy) : n;
+}
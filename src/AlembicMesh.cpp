@@ -5,38 +5,67 @@
 #endif
 
 #include "AlembicMesh.h"
+#include "VectorMathBatch.h"
+#include "FrameArena.h"
+#include "MeshOptimizer.h"
+#include "GPUHeap.h"
+#include "sfbxRawVector.h"
 
 AlembicMesh::AlembicMesh()
+   : mVertexLayout(VertexLayout::Split)
+   , mNumVertices(0)
+   , mNumIndices(0)
+   , mNumInstances(0)
+   , mIndexType(GL_UNSIGNED_INT)
+   , mIndexAllocation(GPUHeap::kInvalidHandle)
+   , mAttribLocations({ -1, -1, -1, -1 })
+   , mHeapGeneration(0)
 {
    glGenVertexArrays(1, &mVAO);
-   glGenBuffers(2, &mVBOs[0]);
-   glGenBuffers(1, &mEBO);
+   glGenBuffers(4, &mVBOs[0]);
+
+   mIndexChunks.push_back({ mVAO, 0, 0, 0 });
 }
 
 AlembicMesh::~AlembicMesh()
 {
+   DeleteIndexChunks();
    glDeleteVertexArrays(1, &mVAO);
-   glDeleteBuffers(2, &mVBOs[0]);
-   glDeleteBuffers(1, &mEBO);
+   glDeleteBuffers(4, &mVBOs[0]);
+   GPUHeap::Indices().Free(mIndexAllocation);
 }
 
 AlembicMesh::AlembicMesh(AlembicMesh&& rhs) noexcept
-   : mNumVertices(std::exchange(rhs.mNumVertices, 0))
+   : mVertexLayout(rhs.mVertexLayout)
+   , mAttributes(rhs.mAttributes)
+   , mNumVertices(std::exchange(rhs.mNumVertices, 0))
    , mNumIndices(std::exchange(rhs.mNumIndices, 0))
+   , mNumInstances(std::exchange(rhs.mNumInstances, 0))
+   , mIndexType(rhs.mIndexType)
    , mVAO(std::exchange(rhs.mVAO, 0))
-   , mVBOs(std::exchange(rhs.mVBOs, std::array<unsigned int, 2>()))
-   , mEBO(std::exchange(rhs.mEBO, 0))
+   , mVBOs(std::exchange(rhs.mVBOs, std::array<unsigned int, 4>()))
+   , mIndexAllocation(std::exchange(rhs.mIndexAllocation, GPUHeap::kInvalidHandle))
+   , mIndexChunks(std::move(rhs.mIndexChunks))
+   , mAttribLocations(rhs.mAttribLocations)
+   , mHeapGeneration(rhs.mHeapGeneration)
 {
 
 }
 
 AlembicMesh& AlembicMesh::operator=(AlembicMesh&& rhs) noexcept
 {
-   mNumVertices = std::exchange(rhs.mNumVertices, 0);
-   mNumIndices  = std::exchange(rhs.mNumIndices, 0);
-   mVAO         = std::exchange(rhs.mVAO, 0);
-   mVBOs        = std::exchange(rhs.mVBOs, std::array<unsigned int, 2>());
-   mEBO         = std::exchange(rhs.mEBO, 0);
+   mVertexLayout    = rhs.mVertexLayout;
+   mAttributes      = rhs.mAttributes;
+   mNumVertices     = std::exchange(rhs.mNumVertices, 0);
+   mNumIndices      = std::exchange(rhs.mNumIndices, 0);
+   mNumInstances    = std::exchange(rhs.mNumInstances, 0);
+   mIndexType       = rhs.mIndexType;
+   mVAO             = std::exchange(rhs.mVAO, 0);
+   mVBOs            = std::exchange(rhs.mVBOs, std::array<unsigned int, 4>());
+   mIndexAllocation = std::exchange(rhs.mIndexAllocation, GPUHeap::kInvalidHandle);
+   mIndexChunks     = std::move(rhs.mIndexChunks);
+   mAttribLocations = rhs.mAttribLocations;
+   mHeapGeneration  = rhs.mHeapGeneration;
    return *this;
 }
 
@@ -47,85 +76,263 @@ void AlembicMesh::InitializeBuffers(wabc::IMesh* mesh)
 
    glBindVertexArray(mVAO);
 
-   // Load the mesh's data into the buffers
+   // Allocate the dynamic stream, which UpdateBuffers fills every frame
+   for (size_t type = VBOTypes::positions; type <= VBOTypes::normals; ++type)
+   {
+      VertexAttribute& attribute = mAttributes[type];
+      attribute.numComponents = 3;
+      attribute.type          = GL_FLOAT;
+      attribute.normalized    = false;
+      attribute.size          = sizeof(wabc::float3);
+      if (mVertexLayout == VertexLayout::Interleaved)
+      {
+         attribute.VBO    = mVBOs[VBOTypes::positions];
+         attribute.stride = sizeof(wabc::float3) * 2;
+         attribute.offset = sizeof(wabc::float3) * type;
+      }
+      else
+      {
+         attribute.VBO    = mVBOs[type];
+         attribute.stride = 0;
+         attribute.offset = 0;
+      }
+   }
 
-   // Positions
-   glBindBuffer(GL_ARRAY_BUFFER, mVBOs[VBOTypes::positions]);
-   glBufferData(GL_ARRAY_BUFFER, mNumVertices * sizeof(wabc::float3), nullptr, GL_STREAM_DRAW);
-   // Normals
-   glBindBuffer(GL_ARRAY_BUFFER, mVBOs[VBOTypes::normals]);
-   glBufferData(GL_ARRAY_BUFFER, mNumVertices * sizeof(wabc::float3), nullptr, GL_STREAM_DRAW);
+   if (mVertexLayout == VertexLayout::Interleaved)
+   {
+      glBindBuffer(GL_ARRAY_BUFFER, mVBOs[VBOTypes::positions]);
+      glBufferData(GL_ARRAY_BUFFER, mNumVertices * sizeof(wabc::float3) * 2, nullptr, GL_STREAM_DRAW);
+   }
+   else
+   {
+      // Positions
+      glBindBuffer(GL_ARRAY_BUFFER, mVBOs[VBOTypes::positions]);
+      glBufferData(GL_ARRAY_BUFFER, mNumVertices * sizeof(wabc::float3), nullptr, GL_STREAM_DRAW);
+      // Normals
+      glBindBuffer(GL_ARRAY_BUFFER, mVBOs[VBOTypes::normals]);
+      glBufferData(GL_ARRAY_BUFFER, mNumVertices * sizeof(wabc::float3), nullptr, GL_STREAM_DRAW);
+   }
 
-   glBindBuffer(GL_ARRAY_BUFFER, 0);
+   // The uvs have their own VBO in both layouts, since most meshes don't have any
+   VertexAttribute& texCoords = mAttributes[VBOTypes::texCoords];
+   texCoords = {};
+   if (mNumVertices > 0 && mesh->getUVs().size() == mNumVertices)
+   {
+      texCoords.VBO           = mVBOs[VBOTypes::texCoords];
+      texCoords.numComponents = 2;
+      texCoords.type          = GL_FLOAT;
+      texCoords.size          = sizeof(wabc::float2);
 
-   // Indices
-   glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mEBO);
-   glBufferData(GL_ELEMENT_ARRAY_BUFFER, mNumIndices * sizeof(int), mesh->getFaceIndices().data(), GL_STATIC_DRAW);
+      glBindBuffer(GL_ARRAY_BUFFER, mVBOs[VBOTypes::texCoords]);
+      glBufferData(GL_ARRAY_BUFFER, mNumVertices * sizeof(wabc::float2), nullptr, GL_STREAM_DRAW);
+   }
+
+   glBindBuffer(GL_ARRAY_BUFFER, 0);
 
-   // Unbind the VAO first, then the EBO
    glBindVertexArray(0);
-   glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+   LoadIndices(mesh->getFaceIndices());
 }
 
-void AlembicMesh::UpdateBuffers(wabc::IMesh* mesh)
+// Indices are 16-bit whenever possible, which halves their memory and bandwidth
+// Meshes with more than 65535 vertices are split into chunks when their triangles allow it, and fall back to 32-bit
+// indices when they don't
+// The indices don't change while a clip plays, so unlike the vertices they are sub-allocated from the index heap
+void AlembicMesh::LoadIndices(wabc::span<int> indices)
 {
-   wabc::span<wabc::float3> points = mesh->getPoints();
-   wabc::span<int> indices = mesh->getFaceIndices();
+   DeleteIndexChunks();
+   GPUHeap::Indices().Free(mIndexAllocation);
+   mIndexAllocation = GPUHeap::kInvalidHandle;
+   mIndexType       = GL_UNSIGNED_INT;
 
-   std::vector<wabc::float3> normals;
-   normals.resize(points.size());
-   for (unsigned int i = 0; i < indices.size(); i += 3)
+   if (indices.empty())
    {
-      wabc::float3 v0 = points[indices[i]];
-      wabc::float3 v1 = points[indices[i + 1]];
-      wabc::float3 v2 = points[indices[i + 2]];
+      return;
+   }
 
-      wabc::float3 v20 = wabc::normalize(v2 - v0);
-      wabc::float3 v10 = wabc::normalize(v1 - v0);
+   // The face indices are never negative
+   wabc::span<unsigned int> unsignedIndices(reinterpret_cast<unsigned int*>(indices.data()), indices.size());
 
-      wabc::float3 normal = wabc::normalize(wabc::cross(v20, v10));
+   wabc::RawVector<wabc::IndexRange> ranges;
+   bool use16Bit = wabc::SplitIndices16(ranges, unsignedIndices, mNumVertices);
 
-      normals[indices[i]] = normal;
-      normals[indices[i + 1]] = normal;
-      normals[indices[i + 2]] = normal;
+   // The index buffer of the heap is bound to the VAOs by ConfigureVAO
+   GPUHeap& indexHeap = GPUHeap::Indices();
+   if (use16Bit)
+   {
+      sfbx::RawVector<uint16_t> indices16(wabc::GetFrameArena());
+      indices16.resize(indices.size());
+      wabc::ConvertIndices16(wabc::make_span(indices16), unsignedIndices, wabc::make_span(ranges));
+
+      mIndexAllocation = indexHeap.Allocate(indices16.size_bytes());
+      indexHeap.Upload(mIndexAllocation, indices16.data(), indices16.size_bytes());
+
+      mIndexType = GL_UNSIGNED_SHORT;
+   }
+   else
+   {
+      mIndexAllocation = indexHeap.Allocate(indices.size_bytes());
+      indexHeap.Upload(mIndexAllocation, indices.data(), indices.size_bytes());
+
+      ranges.clear();
+      ranges.push_back({ 0, indices.size(), 0 });
+   }
+
+   size_t indexSize = use16Bit ? sizeof(uint16_t) : sizeof(unsigned int);
+   mIndexChunks.clear();
+   for (const wabc::IndexRange& range : ranges)
+   {
+      IndexChunk chunk;
+      chunk.VAO         = mVAO;
+      chunk.numIndices  = static_cast<unsigned int>(range.num_indices);
+      chunk.indexOffset = range.first_index * indexSize;
+      chunk.baseVertex  = range.base_vertex;
+      if (!mIndexChunks.empty())
+      {
+         glGenVertexArrays(1, &chunk.VAO);
+      }
+
+      mIndexChunks.push_back(chunk);
+   }
+}
+
+void AlembicMesh::DeleteIndexChunks()
+{
+   for (size_t i = 1; i < mIndexChunks.size(); ++i)
+   {
+      glDeleteVertexArrays(1, &mIndexChunks[i].VAO);
+   }
+
+   mIndexChunks.clear();
+   mIndexChunks.push_back({ mVAO, 0, 0, 0 });
+}
+
+void AlembicMesh::UpdateBuffers(wabc::IMesh* mesh)
+{
+   wabc::span<wabc::float3> points  = mesh->getPoints();
+   wabc::span<wabc::float3> normals = mesh->getNormals();
+
+   // Compute flat normals only if the Alembic file doesn't provide its own
+   // They are only needed until they are uploaded, so they live in the frame arena instead of the heap
+   sfbx::RawVector<wabc::float3> computedNormals(wabc::GetFrameArena());
+   if (normals.size() != points.size())
+   {
+      wabc::span<int> indices = mesh->getFaceIndices();
+
+      computedNormals.resize(points.size());
+      wabc::triangle_normals(computedNormals, points, indices);
+
+      normals = computedNormals;
    }
 
    glBindVertexArray(mVAO);
 
    // Load the mesh's data into the buffers
+   if (mVertexLayout == VertexLayout::Interleaved)
+   {
+      // The interleaved copy is only needed until it's uploaded, so it lives in the frame arena too
+      sfbx::RawVector<wabc::float3> interleaved(wabc::GetFrameArena());
+      interleaved.resize(static_cast<size_t>(mNumVertices) * 2);
+      for (size_t i = 0; i < mNumVertices; ++i)
+      {
+         interleaved[i * 2 + 0] = points[i];
+         interleaved[i * 2 + 1] = normals[i];
+      }
+
+      glBindBuffer(GL_ARRAY_BUFFER, mVBOs[VBOTypes::positions]);
+      glBufferSubData(GL_ARRAY_BUFFER, 0, interleaved.size_bytes(), interleaved.data());
+   }
+   else
+   {
+      // Positions
+      glBindBuffer(GL_ARRAY_BUFFER, mVBOs[VBOTypes::positions]);
+      glBufferSubData(GL_ARRAY_BUFFER, 0, mNumVertices * sizeof(wabc::float3), points.data());
+      // Normals
+      glBindBuffer(GL_ARRAY_BUFFER, mVBOs[VBOTypes::normals]);
+      glBufferSubData(GL_ARRAY_BUFFER, 0, mNumVertices * sizeof(wabc::float3), normals.data());
+   }
 
-   // Positions
-   glBindBuffer(GL_ARRAY_BUFFER, mVBOs[VBOTypes::positions]);
-   glBufferSubData(GL_ARRAY_BUFFER, 0, mNumVertices * sizeof(wabc::float3), mesh->getPoints().data());
-   // Normals
-   glBindBuffer(GL_ARRAY_BUFFER, mVBOs[VBOTypes::normals]);
-   glBufferSubData(GL_ARRAY_BUFFER, 0, mNumVertices * sizeof(wabc::float3), &normals[0]);
+   // Alembic allows the uvs to be animated, so they are uploaded with the rest of the sample
+   wabc::span<wabc::float2> uvs = mesh->getUVs();
+   if (mAttributes[VBOTypes::texCoords].IsEnabled() && uvs.size() == mNumVertices)
+   {
+      glBindBuffer(GL_ARRAY_BUFFER, mVBOs[VBOTypes::texCoords]);
+      glBufferSubData(GL_ARRAY_BUFFER, 0, uvs.size_bytes(), uvs.data());
+   }
 
    glBindBuffer(GL_ARRAY_BUFFER, 0);
 
    glBindVertexArray(0);
 }
 
+// The matrices of all the instances are uploaded together, so the cost of this function is proportional to the
+// number of instances, while the geometry itself is only uploaded once by UpdateBuffers
+void AlembicMesh::UpdateInstanceMatrices(wabc::span<wabc::float4x4> matrices)
+{
+   mNumInstances = static_cast<unsigned int>(matrices.size());
+
+   glBindBuffer(GL_ARRAY_BUFFER, mVBOs[VBOTypes::instanceMatrices]);
+   glBufferData(GL_ARRAY_BUFFER, matrices.size_bytes(), matrices.data(), GL_STREAM_DRAW);
+   glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
 void AlembicMesh::ConfigureVAO(int posAttribLocation,
-                               int normalAttribLocation)
+                               int normalAttribLocation,
+                               int texCoordsAttribLocation,
+                               int instanceMatrixAttribLocation)
 {
-   glBindVertexArray(mVAO);
+   // The locations are remembered so that the VAOs can be configured again when the index heap is defragmented
+   mAttribLocations = { posAttribLocation, normalAttribLocation, texCoordsAttribLocation, instanceMatrixAttribLocation };
+   mHeapGeneration  = GPUHeap::GetGeneration();
+
+   unsigned int indexBuffer = GPUHeap::Indices().GetBuffer(mIndexAllocation);
 
    // Set the vertex attribute pointers
-   BindFloatAttribute(posAttribLocation,    mVBOs[VBOTypes::positions], 3);
-   BindFloatAttribute(normalAttribLocation, mVBOs[VBOTypes::normals], 3);
+   // The instance matrices are per instance, so they aren't offset by the base vertex of the chunks
+   for (const IndexChunk& chunk : mIndexChunks)
+   {
+      glBindVertexArray(chunk.VAO);
+
+      BindAttribute(posAttribLocation,       mAttributes[VBOTypes::positions], chunk.baseVertex);
+      BindAttribute(normalAttribLocation,    mAttributes[VBOTypes::normals],   chunk.baseVertex);
+      BindAttribute(texCoordsAttribLocation, mAttributes[VBOTypes::texCoords], chunk.baseVertex);
+      BindMat4InstanceAttribute(instanceMatrixAttribLocation, mVBOs[VBOTypes::instanceMatrices]);
+
+      // The element array buffer binding is part of the state of a VAO
+      if (indexBuffer != 0)
+      {
+         glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
+      }
+   }
 
+   // Unbind the VAO first, then the EBO
    glBindVertexArray(0);
+   glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
 }
 
-void AlembicMesh::UnconfigureVAO(int posAttribLocation,
-                                 int normalAttribLocation)
+void AlembicMesh::UpdateVAOs()
 {
-   glBindVertexArray(mVAO);
+   if (mHeapGeneration != GPUHeap::GetGeneration())
+   {
+      ConfigureVAO(mAttribLocations[0], mAttribLocations[1], mAttribLocations[2], mAttribLocations[3]);
+   }
+}
 
+void AlembicMesh::UnconfigureVAO(int posAttribLocation,
+                                 int normalAttribLocation,
+                                 int texCoordsAttribLocation,
+                                 int instanceMatrixAttribLocation)
+{
    // Unset the vertex attribute pointers
-   UnbindAttribute(posAttribLocation,    mVBOs[VBOTypes::positions]);
-   UnbindAttribute(normalAttribLocation, mVBOs[VBOTypes::normals]);
+   for (const IndexChunk& chunk : mIndexChunks)
+   {
+      glBindVertexArray(chunk.VAO);
+
+      UnbindAttribute(posAttribLocation,       mAttributes[VBOTypes::positions].VBO);
+      UnbindAttribute(normalAttribLocation,    mAttributes[VBOTypes::normals].VBO);
+      UnbindAttribute(texCoordsAttribLocation, mAttributes[VBOTypes::texCoords].VBO);
+      UnbindMat4InstanceAttribute(instanceMatrixAttribLocation, mVBOs[VBOTypes::instanceMatrices]);
+   }
 
    glBindVertexArray(0);
 }
@@ -141,6 +348,20 @@ void AlembicMesh::BindFloatAttribute(int attribLocation, unsigned int VBO, int n
    }
 }
 
+void AlembicMesh::BindAttribute(int attribLocation, const VertexAttribute& attribute, unsigned int baseVertex)
+{
+   if (attribLocation >= 0 && attribute.IsEnabled())
+   {
+      size_t offset = attribute.offset + static_cast<size_t>(baseVertex) * (attribute.stride ? attribute.stride : attribute.size);
+
+      glBindBuffer(GL_ARRAY_BUFFER, attribute.VBO);
+      glEnableVertexAttribArray(attribLocation);
+      glVertexAttribPointer(attribLocation, attribute.numComponents, attribute.type, attribute.normalized ? GL_TRUE : GL_FALSE,
+                            attribute.stride, (void*)offset);
+      glBindBuffer(GL_ARRAY_BUFFER, 0);
+   }
+}
+
 void AlembicMesh::BindIntAttribute(int attribLocation, unsigned int VBO, int numComponents)
 {
    if (attribLocation >= 0)
@@ -152,6 +373,36 @@ void AlembicMesh::BindIntAttribute(int attribLocation, unsigned int VBO, int num
    }
 }
 
+// A mat4 attribute occupies 4 consecutive locations, one per column
+void AlembicMesh::BindMat4InstanceAttribute(int attribLocation, unsigned int VBO)
+{
+   if (attribLocation >= 0)
+   {
+      glBindBuffer(GL_ARRAY_BUFFER, VBO);
+      for (int i = 0; i < 4; ++i)
+      {
+         glEnableVertexAttribArray(attribLocation + i);
+         glVertexAttribPointer(attribLocation + i, 4, GL_FLOAT, GL_FALSE, sizeof(wabc::float4x4), (void*)(sizeof(wabc::float4) * i));
+         glVertexAttribDivisor(attribLocation + i, 1);
+      }
+      glBindBuffer(GL_ARRAY_BUFFER, 0);
+   }
+}
+
+void AlembicMesh::UnbindMat4InstanceAttribute(int attribLocation, unsigned int VBO)
+{
+   if (attribLocation >= 0)
+   {
+      glBindBuffer(GL_ARRAY_BUFFER, VBO);
+      for (int i = 0; i < 4; ++i)
+      {
+         glVertexAttribDivisor(attribLocation + i, 0);
+         glDisableVertexAttribArray(attribLocation + i);
+      }
+      glBindBuffer(GL_ARRAY_BUFFER, 0);
+   }
+}
+
 void AlembicMesh::UnbindAttribute(int attribLocation, unsigned int VBO)
 {
    if (attribLocation >= 0)
@@ -166,14 +417,20 @@ void AlembicMesh::UnbindAttribute(int attribLocation, unsigned int VBO)
 //       Can we load that from the GLTF file?
 void AlembicMesh::Render()
 {
-   glBindVertexArray(mVAO);
+   UpdateVAOs();
 
    if (mNumIndices > 0)
    {
-      glDrawElements(GL_TRIANGLES, mNumIndices, GL_UNSIGNED_INT, 0);
+      size_t indexOffset = GPUHeap::Indices().GetOffset(mIndexAllocation);
+      for (const IndexChunk& chunk : mIndexChunks)
+      {
+         glBindVertexArray(chunk.VAO);
+         glDrawElements(GL_TRIANGLES, chunk.numIndices, mIndexType, (void*)(indexOffset + chunk.indexOffset));
+      }
    }
    else
    {
+      glBindVertexArray(mVAO);
       glDrawArrays(GL_TRIANGLES, 0, mNumVertices);
    }
 
@@ -184,14 +441,20 @@ void AlembicMesh::Render()
 //       Can we load that from the GLTF file?
 void AlembicMesh::RenderInstanced(unsigned int numInstances)
 {
-   glBindVertexArray(mVAO);
+   UpdateVAOs();
 
    if (mNumIndices > 0)
    {
-      glDrawElementsInstanced(GL_TRIANGLES, mNumIndices, GL_UNSIGNED_INT, 0, numInstances);
+      size_t indexOffset = GPUHeap::Indices().GetOffset(mIndexAllocation);
+      for (const IndexChunk& chunk : mIndexChunks)
+      {
+         glBindVertexArray(chunk.VAO);
+         glDrawElementsInstanced(GL_TRIANGLES, chunk.numIndices, mIndexType, (void*)(indexOffset + chunk.indexOffset), numInstances);
+      }
    }
    else
    {
+      glBindVertexArray(mVAO);
       glDrawArraysInstanced(GL_TRIANGLES, 0, mNumVertices, numInstances);
    }
 
@@ -0,0 +1,373 @@
+#include "pch.h"
+#include "AllocationTracker.h"
+#include "sfbxAllocator.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+#if defined(_WIN32)
+    #ifndef NOMINMAX
+        #define NOMINMAX
+    #endif
+    #include <windows.h>
+    #include <psapi.h>
+    #include <intrin.h>
+#elif !defined(__EMSCRIPTEN__)
+    #include <sys/resource.h>
+    #include <dlfcn.h>
+    #include <cxxabi.h>
+#endif
+
+// malloc can only be replaced where the libc has an entry point to forward to
+#if defined(wabcEnableAllocationTracker) && defined(__GLIBC__) && !defined(__EMSCRIPTEN__)
+    #define wabcEnableMallocHook
+extern "C" {
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t n, size_t size);
+void* __libc_realloc(void* addr, size_t size);
+void __libc_free(void* addr);
+}
+    #define wabcRawMalloc(size) __libc_malloc(size)
+    #define wabcRawFree(addr) __libc_free(addr)
+#else
+    #define wabcRawMalloc(size) malloc(size)
+    #define wabcRawFree(addr) free(addr)
+#endif
+
+// emscripten can not walk the wasm stack without the offset converter
+#if defined(_MSC_VER)
+    #define wabcReturnAddress() _ReturnAddress()
+#elif defined(__EMSCRIPTEN__)
+    #define wabcReturnAddress() nullptr
+#else
+    #define wabcReturnAddress() __builtin_return_address(0)
+#endif
+
+namespace wabc {
+
+namespace {
+
+thread_local size_t t_new_count = 0;
+
+#ifdef wabcEnableAllocationTracker
+const size_t kMaxSites = 4096; // power of two
+const size_t kMaxProbes = 64;
+const size_t kHistoryFrames = 120;
+void* const kUnknownSite = (void*)1;
+
+// fixed size and zero initialized, so that recording never allocates and works before and after static
+// construction and destruction
+struct SiteSlot
+{
+    std::atomic<void*> address;
+    std::atomic<size_t> count;
+    std::atomic<size_t> bytes;
+};
+SiteSlot g_sites[kMaxSites];
+
+std::atomic<size_t> g_frame_count;
+std::atomic<size_t> g_frame_bytes;
+
+// frame bookkeeping. only touched by the thread that runs the frame loop.
+AllocationFrameStats g_last_frame;
+size_t g_num_frames;
+float g_history[kHistoryFrames];
+size_t g_raw_vector_count;
+size_t g_raw_vector_bytes;
+
+void Record(size_t size, void* address)
+{
+    g_frame_count.fetch_add(1, std::memory_order_relaxed);
+    g_frame_bytes.fetch_add(size, std::memory_order_relaxed);
+
+    if (!address)
+        address = kUnknownSite;
+    size_t h = (size_t)(((uint64_t)(uintptr_t)address * 0x9E3779B97F4A7C15ull) >> 32);
+    for (size_t i = 0; i < kMaxProbes; ++i) {
+        SiteSlot& slot = g_sites[(h + i) & (kMaxSites - 1)];
+        void* current = slot.address.load(std::memory_order_relaxed);
+        if (!current && slot.address.compare_exchange_strong(current, address))
+            current = address;
+        if (current == address) {
+            slot.count.fetch_add(1, std::memory_order_relaxed);
+            slot.bytes.fetch_add(size, std::memory_order_relaxed);
+            return;
+        }
+    }
+    // the table is full around this hash. the allocation still shows up in the frame totals.
+}
+
+std::string GetSymbolName(void* address)
+{
+    if (address == kUnknownSite)
+        return "unknown";
+
+    char buf[64];
+#if !defined(_WIN32) && !defined(__EMSCRIPTEN__)
+    Dl_info info;
+    if (dladdr(address, &info) && info.dli_sname) {
+        int status = 0;
+        char* demangled = abi::__cxa_demangle(info.dli_sname, nullptr, nullptr, &status);
+        std::string ret = status == 0 && demangled ? demangled : info.dli_sname;
+        free(demangled);
+        snprintf(buf, sizeof(buf), "+0x%x", (unsigned)((char*)address - (char*)info.dli_saddr));
+        return ret + buf;
+    }
+#endif
+    snprintf(buf, sizeof(buf), "%p", address);
+    return buf;
+}
+
+void WriteJsonString(FILE* f, const std::string& s)
+{
+    fputc('"', f);
+    for (char c : s) {
+        if (c == '"' || c == '\\')
+            fputc('\\', f);
+        fputc(c, f);
+    }
+    fputc('"', f);
+}
+
+void DumpAtExit()
+{
+    const char* path = getenv("WABC_ALLOCATION_REPORT");
+    DumpAllocationReport(path && *path ? path : "allocations.json");
+}
+#endif // wabcEnableAllocationTracker
+
+} // namespace
+
+bool IsAllocationTrackerEnabled()
+{
+#ifdef wabcEnableAllocationTracker
+    return true;
+#else
+    return false;
+#endif
+}
+
+void NextAllocationFrame()
+{
+#ifdef wabcEnableAllocationTracker
+    // statics constructed before the handler is registered are destroyed after it runs, so create the global
+    // allocators first to keep them in the report
+    static bool s_dump_at_exit = (sfbx::GetDefaultAllocator(), sfbx::GetAlignedAllocator(), std::atexit(&DumpAtExit) == 0);
+    (void)s_dump_at_exit;
+
+    AllocationFrameStats frame;
+    frame.count = g_frame_count.exchange(0);
+    frame.bytes = g_frame_bytes.exchange(0);
+
+    // the sfbx allocators only have running totals. allocators that went away since the last frame can make them
+    // go down, in which case the frame counts nothing.
+    size_t raw_vector_count = 0, raw_vector_bytes = 0;
+    sfbx::EachAllocator([&](sfbx::Allocator& a) {
+        auto stats = a.getStats();
+        raw_vector_count += stats.total_allocations;
+        raw_vector_bytes += stats.total_bytes;
+    });
+    frame.raw_vector_count = raw_vector_count > g_raw_vector_count ? raw_vector_count - g_raw_vector_count : 0;
+    frame.raw_vector_bytes = raw_vector_bytes > g_raw_vector_bytes ? raw_vector_bytes - g_raw_vector_bytes : 0;
+    g_raw_vector_count = raw_vector_count;
+    g_raw_vector_bytes = raw_vector_bytes;
+
+    g_last_frame = frame;
+    g_history[g_num_frames % kHistoryFrames] = (float)frame.count;
+    ++g_num_frames;
+#endif
+}
+
+AllocationFrameStats GetLastFrameAllocations()
+{
+#ifdef wabcEnableAllocationTracker
+    return g_last_frame;
+#else
+    return {};
+#endif
+}
+
+size_t GetAllocationHistory(float* dst, size_t max_frames)
+{
+#ifdef wabcEnableAllocationTracker
+    size_t n = std::min({ max_frames, g_num_frames, kHistoryFrames });
+    for (size_t i = 0; i < n; ++i)
+        dst[i] = g_history[(g_num_frames - n + i) % kHistoryFrames];
+    return n;
+#else
+    (void)dst;
+    (void)max_frames;
+    return 0;
+#endif
+}
+
+size_t GetPeakRSS()
+{
+#if defined(__EMSCRIPTEN__)
+    // wasm memory only grows, so its current size is also its peak
+    return (size_t)__builtin_wasm_memory_size(0) * 65536;
+#elif defined(_WIN32)
+    PROCESS_MEMORY_COUNTERS counters;
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+        return counters.PeakWorkingSetSize;
+    return 0;
+#else
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+        return 0;
+    #if defined(__APPLE__)
+    return (size_t)usage.ru_maxrss;
+    #else
+    return (size_t)usage.ru_maxrss * 1024;
+    #endif
+#endif
+}
+
+std::vector<AllocationSite> GetTopAllocationSites(size_t n)
+{
+    std::vector<AllocationSite> ret;
+#ifdef wabcEnableAllocationTracker
+    for (auto& slot : g_sites) {
+        void* address = slot.address.load(std::memory_order_relaxed);
+        if (!address)
+            continue;
+        AllocationSite site;
+        site.address = address;
+        site.count = slot.count.load(std::memory_order_relaxed);
+        site.bytes = slot.bytes.load(std::memory_order_relaxed);
+        ret.push_back(site);
+    }
+    n = std::min(n, ret.size());
+    std::partial_sort(ret.begin(), ret.begin() + n, ret.end(),
+        [](const AllocationSite& a, const AllocationSite& b) { return a.count > b.count; });
+    ret.resize(n);
+    for (auto& site : ret)
+        site.name = GetSymbolName(site.address);
+#else
+    (void)n;
+#endif
+    return ret;
+}
+
+bool DumpAllocationReport(const char* path)
+{
+#ifdef wabcEnableAllocationTracker
+    FILE* f = fopen(path, "w");
+    if (!f) {
+        printf("DumpAllocationReport(): failed to open %s\n", path);
+        return false;
+    }
+
+    AllocationFrameStats last = GetLastFrameAllocations();
+    fprintf(f, "{\n");
+    fprintf(f, "  \"frames\": %zu,\n", g_num_frames);
+    fprintf(f, "  \"peak_rss\": %zu,\n", GetPeakRSS());
+    fprintf(f, "  \"last_frame\": { \"count\": %zu, \"bytes\": %zu, \"raw_vector_count\": %zu, \"raw_vector_bytes\": %zu },\n",
+        last.count, last.bytes, last.raw_vector_count, last.raw_vector_bytes);
+
+    float history[kHistoryFrames];
+    size_t num_history = GetAllocationHistory(history, kHistoryFrames);
+    fprintf(f, "  \"history\": [");
+    for (size_t i = 0; i < num_history; ++i)
+        fprintf(f, "%s%d", i ? ", " : "", (int)history[i]);
+    fprintf(f, "],\n");
+
+    fprintf(f, "  \"allocators\": [");
+    bool first = true;
+    sfbx::EachAllocator([&](sfbx::Allocator& a) {
+        auto stats = a.getStats();
+        fprintf(f, "%s\n    { \"name\": ", first ? "" : ",");
+        WriteJsonString(f, a.getName());
+        fprintf(f, ", \"bytes\": %zu, \"peak_bytes\": %zu, \"reserved_bytes\": %zu, \"allocations\": %zu, "
+            "\"total_allocations\": %zu, \"total_bytes\": %zu, \"reallocations\": %zu, \"copied_bytes\": %zu }",
+            stats.bytes, stats.peak_bytes, stats.reserved_bytes, stats.allocations,
+            stats.total_allocations, stats.total_bytes, stats.reallocations, stats.copied_bytes);
+        first = false;
+    });
+    fprintf(f, "\n  ],\n");
+
+    auto sites = GetTopAllocationSites(50);
+    fprintf(f, "  \"top_sites\": [");
+    for (size_t i = 0; i < sites.size(); ++i) {
+        fprintf(f, "%s\n    { \"name\": ", i ? "," : "");
+        WriteJsonString(f, sites[i].name);
+        fprintf(f, ", \"count\": %zu, \"bytes\": %zu }", sites[i].count, sites[i].bytes);
+    }
+    fprintf(f, "\n  ]\n}\n");
+    fclose(f);
+    return true;
+#else
+    (void)path;
+    return false;
+#endif
+}
+
+size_t GetThreadNewCount()
+{
+    return t_new_count;
+}
+
+} // namespace wabc
+
+
+#if defined(wabcEnableHeapCounter) || defined(wabcEnableAllocationTracker)
+// counts every allocation of std::string, std::vector, std::shared_ptr etc.
+// the over-aligned and nothrow forms are left to the standard library.
+void* operator new(size_t size)
+{
+    ++wabc::t_new_count;
+#ifdef wabcEnableAllocationTracker
+    wabc::Record(size, wabcReturnAddress());
+#endif
+    if (void* ret = wabcRawMalloc(size ? size : 1))
+        return ret;
+    throw std::bad_alloc();
+}
+
+void* operator new[](size_t size)
+{
+    ++wabc::t_new_count;
+#ifdef wabcEnableAllocationTracker
+    wabc::Record(size, wabcReturnAddress());
+#endif
+    if (void* ret = wabcRawMalloc(size ? size : 1))
+        return ret;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* addr) noexcept { wabcRawFree(addr); }
+void operator delete[](void* addr) noexcept { wabcRawFree(addr); }
+void operator delete(void* addr, size_t) noexcept { wabcRawFree(addr); }
+void operator delete[](void* addr, size_t) noexcept { wabcRawFree(addr); }
+#endif
+
+#ifdef wabcEnableMallocHook
+// c allocations (stb_image, cgltf, imgui, alembic internals). operator new above does not go through these.
+extern "C" {
+void* malloc(size_t size) noexcept
+{
+    wabc::Record(size, wabcReturnAddress());
+    return __libc_malloc(size);
+}
+
+void* calloc(size_t n, size_t size) noexcept
+{
+    wabc::Record(n * size, wabcReturnAddress());
+    return __libc_calloc(n, size);
+}
+
+void* realloc(void* addr, size_t size) noexcept
+{
+    wabc::Record(size, wabcReturnAddress());
+    return __libc_realloc(addr, size);
+}
+
+void free(void* addr) noexcept
+{
+    __libc_free(addr);
+}
+}
+#endif
@@ -0,0 +1,149 @@
+#include <cmath>
+
+#include "Clip.h"
+
+Clip::Clip()
+   : mName("No name given")
+   , mStartTime(0.0f)
+   , mEndTime(0.0f)
+   , mLooping(true)
+{
+
+}
+
+TransformTrack& Clip::GetTransformTrackOfJoint(unsigned int joint)
+{
+   for (TransformTrack& track : mTracks)
+   {
+      if (track.joint == joint)
+      {
+         return track;
+      }
+   }
+
+   mTracks.push_back(TransformTrack());
+   mTracks.back().joint = joint;
+   return mTracks.back();
+}
+
+void Clip::RecalculateDuration()
+{
+   mStartTime = 0.0f;
+   mEndTime   = 0.0f;
+
+   bool startSet = false;
+   bool endSet   = false;
+
+   for (const TransformTrack& track : mTracks)
+   {
+      float startTimes[3] = { track.position.GetStartTime(), track.rotation.GetStartTime(), track.scale.GetStartTime() };
+      float endTimes[3]   = { track.position.GetEndTime(),   track.rotation.GetEndTime(),   track.scale.GetEndTime()   };
+      bool  valid[3]      = { track.position.GetNumKeyframes() > 0, track.rotation.GetNumKeyframes() > 0, track.scale.GetNumKeyframes() > 0 };
+
+      for (int i = 0; i < 3; ++i)
+      {
+         if (!valid[i])
+         {
+            continue;
+         }
+
+         if (!startSet || startTimes[i] < mStartTime)
+         {
+            mStartTime = startTimes[i];
+            startSet   = true;
+         }
+
+         if (!endSet || endTimes[i] > mEndTime)
+         {
+            mEndTime = endTimes[i];
+            endSet   = true;
+         }
+      }
+   }
+}
+
+float Clip::AdjustTimeToFitRange(float time) const
+{
+   float duration = GetDuration();
+   if (duration <= 0.0f)
+   {
+      return mStartTime;
+   }
+
+   if (mLooping)
+   {
+      time = std::fmod(time - mStartTime, duration);
+      if (time < 0.0f)
+      {
+         time += duration;
+      }
+
+      return time + mStartTime;
+   }
+
+   return glm::clamp(time, mStartTime, mEndTime);
+}
+
+void Clip::Resample(float sampleRate)
+{
+   for (TransformTrack& track : mTracks)
+   {
+      track.position.Resample(sampleRate);
+      track.rotation.Resample(sampleRate);
+      track.scale.Resample(sampleRate);
+   }
+}
+
+ClipSampler::ClipSampler()
+   : mClip(nullptr)
+{
+
+}
+
+void ClipSampler::SetClip(const Clip* clip)
+{
+   mClip = clip;
+
+   // Three cursors per track (position, rotation and scale)
+   mCursors.assign(clip ? clip->GetTransformTracks().size() * 3 : 0, 0);
+}
+
+float ClipSampler::Sample(Pose& pose, float time)
+{
+   if (mClip == nullptr)
+   {
+      return time;
+   }
+
+   time = mClip->AdjustTimeToFitRange(time);
+
+   const std::vector<TransformTrack>& tracks = mClip->GetTransformTracks();
+   for (size_t i = 0, size = tracks.size(); i < size; ++i)
+   {
+      const TransformTrack& track = tracks[i];
+      if (track.joint >= pose.GetNumJoints())
+      {
+         continue;
+      }
+
+      Transform local = pose.GetLocalTransform(track.joint);
+      if (track.position.GetNumKeyframes() > 0)
+      {
+         local.position = track.position.Sample(time, mCursors[i * 3 + 0]);
+      }
+
+      if (track.rotation.GetNumKeyframes() > 0)
+      {
+         local.rotation = track.rotation.Sample(time, mCursors[i * 3 + 1]);
+      }
+
+      if (track.scale.GetNumKeyframes() > 0)
+      {
+         local.scale = track.scale.Sample(time, mCursors[i * 3 + 2]);
+      }
+
+      pose.SetLocalTransform(track.joint, local);
+   }
+
+   return time;
+}
@@ -0,0 +1,448 @@
+#include "pch.h"
+#include "CpuDispatch.h"
+#include "Skinning.h"
+#include "sfbxRawVector.h"
+
+#include <cstdlib>
+#include <random>
+
+#if defined(wabcEnableCpuDispatch)
+    #include <immintrin.h>
+    #if defined(_MSC_VER)
+        #include <intrin.h>
+    #else
+        #include <cpuid.h>
+    #endif
+#elif defined(wabcEnableSSE)
+    #include <xmmintrin.h>
+#elif defined(wabcEnableNEON)
+    #include <arm_neon.h>
+#endif
+
+// values of wabcKernelISA (see MathKernels.h)
+#define wabcISA_Scalar  0
+#define wabcISA_SSE     1
+#define wabcISA_AVX2    2
+#define wabcISA_AVX512  3
+#define wabcISA_NEON    4
+
+// msvc allows any intrinsic anywhere. gcc and clang need the instruction set enabled for the functions that use it.
+#define wabcPragma(P) _Pragma(#P)
+#if defined(__clang__)
+    #define wabcBeginTarget(T) wabcPragma(clang attribute push(__attribute__((target(T))), apply_to = function))
+    #define wabcEndTarget() wabcPragma(clang attribute pop)
+#elif defined(__GNUC__)
+    #define wabcBeginTarget(T) wabcPragma(GCC push_options) wabcPragma(GCC target(T))
+    #define wabcEndTarget() wabcPragma(GCC pop_options)
+#else
+    #define wabcBeginTarget(T)
+    #define wabcEndTarget()
+#endif
+
+namespace wabc {
+
+using sfbx::RawVector;
+
+namespace kernels_scalar {
+#define wabcKernelISA wabcISA_Scalar
+#include "MathKernels.h"
+#undef wabcKernelISA
+} // namespace kernels_scalar
+
+#if defined(wabcEnableCpuDispatch)
+
+wabcBeginTarget("sse4.2")
+namespace kernels_sse {
+#define wabcKernelISA wabcISA_SSE
+#include "MathKernels.h"
+#undef wabcKernelISA
+} // namespace kernels_sse
+wabcEndTarget()
+
+wabcBeginTarget("avx2,fma")
+namespace kernels_avx2 {
+#define wabcKernelISA wabcISA_AVX2
+#include "MathKernels.h"
+#undef wabcKernelISA
+} // namespace kernels_avx2
+wabcEndTarget()
+
+wabcBeginTarget("avx512f,avx2,fma")
+namespace kernels_avx512 {
+#define wabcKernelISA wabcISA_AVX512
+#include "MathKernels.h"
+#undef wabcKernelISA
+} // namespace kernels_avx512
+wabcEndTarget()
+
+#elif defined(wabcEnableSSE)
+
+namespace kernels_sse {
+#define wabcKernelISA wabcISA_SSE
+#include "MathKernels.h"
+#undef wabcKernelISA
+} // namespace kernels_sse
+
+#elif defined(wabcEnableNEON)
+
+namespace kernels_neon {
+#define wabcKernelISA wabcISA_NEON
+#include "MathKernels.h"
+#undef wabcKernelISA
+} // namespace kernels_neon
+
+#endif
+
+namespace {
+
+#if defined(wabcEnableCpuDispatch)
+struct cpuid_regs
+{
+    uint32_t eax = 0, ebx = 0, ecx = 0, edx = 0;
+};
+
+cpuid_regs cpuid(uint32_t leaf, uint32_t subleaf = 0)
+{
+    cpuid_regs r;
+#if defined(_MSC_VER)
+    int regs[4];
+    __cpuidex(regs, (int)leaf, (int)subleaf);
+    r.eax = regs[0]; r.ebx = regs[1]; r.ecx = regs[2]; r.edx = regs[3];
+#else
+    __get_cpuid_count(leaf, subleaf, &r.eax, &r.ebx, &r.ecx, &r.edx);
+#endif
+    return r;
+}
+
+// register state the os saves on context switches
+uint64_t xgetbv0()
+{
+#if defined(_MSC_VER)
+    return _xgetbv(0);
+#else
+    uint32_t eax, edx;
+    __asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+    return ((uint64_t)edx << 32) | eax;
+#endif
+}
+#endif
+
+SimdLevel DetectSimdLevel()
+{
+#if defined(wabcEnableCpuDispatch)
+    uint32_t max_leaf = cpuid(0).eax;
+    if (max_leaf < 1)
+        return SimdLevel::Scalar;
+
+    cpuid_regs r1 = cpuid(1);
+    cpuid_regs r7 = max_leaf >= 7 ? cpuid(7, 0) : cpuid_regs();
+    bool sse42 = r1.ecx & (1 << 20);
+    bool fma = r1.ecx & (1 << 12);
+    bool avx = r1.ecx & (1 << 28);
+    bool avx2 = r7.ebx & (1 << 5);
+    bool avx512f = r7.ebx & (1 << 16);
+
+    // the cpu supporting avx is not enough, the os also has to save the ymm / zmm registers
+    uint64_t xcr0 = (r1.ecx & (1 << 27)) ? xgetbv0() : 0;
+    bool ymm = (xcr0 & 0x06) == 0x06;
+    bool zmm = (xcr0 & 0xe6) == 0xe6;
+
+    if (avx512f && avx2 && fma && avx && zmm)
+        return SimdLevel::AVX512;
+    if (avx2 && fma && avx && ymm)
+        return SimdLevel::AVX2;
+    if (sse42)
+        return SimdLevel::SSE;
+    return SimdLevel::Scalar;
+#elif defined(wabcEnableSSE)
+    return SimdLevel::SSE;
+#elif defined(wabcEnableNEON)
+    return SimdLevel::NEON;
+#else
+    return SimdLevel::Scalar;
+#endif
+}
+
+const SimdLevel kSimdLevels[] = { SimdLevel::Scalar, SimdLevel::SSE, SimdLevel::AVX2, SimdLevel::AVX512, SimdLevel::NEON };
+
+bool ParseSimdLevel(const char* name, SimdLevel& dst)
+{
+    for (SimdLevel level : kSimdLevels) {
+        if (strcmp(name, GetSimdLevelName(level)) == 0) {
+            dst = level;
+            return true;
+        }
+    }
+    return false;
+}
+
+SimdLevel SelectSimdLevel()
+{
+    SimdLevel supported = GetSupportedSimdLevel();
+    const char* env = getenv("WABC_SIMD");
+    if (!env || !*env)
+        return supported;
+
+    SimdLevel requested;
+    if (!ParseSimdLevel(env, requested)) {
+        printf("GetSimdLevel(): unknown WABC_SIMD value \"%s\", using %s\n", env, GetSimdLevelName(supported));
+        return supported;
+    }
+    if (!IsSimdLevelSupported(requested)) {
+        printf("GetSimdLevel(): %s is not supported, using %s\n", GetSimdLevelName(requested), GetSimdLevelName(supported));
+        return supported;
+    }
+    printf("GetSimdLevel(): using %s (WABC_SIMD)\n", GetSimdLevelName(requested));
+    return requested;
+}
+
+struct KernelTable
+{
+    MathKernels kernels[std::size(kSimdLevels)];
+    bool valid[std::size(kSimdLevels)] = {};
+
+    KernelTable()
+    {
+        add(SimdLevel::Scalar, &kernels_scalar::FillKernels);
+#if defined(wabcEnableCpuDispatch)
+        add(SimdLevel::SSE, &kernels_sse::FillKernels);
+        add(SimdLevel::AVX2, &kernels_avx2::FillKernels);
+        add(SimdLevel::AVX512, &kernels_avx512::FillKernels);
+        // skinning gathers one matrix row per lane, and 4 lanes of inserts cost more than the wider blend saves.
+        // the avx2 variant measured faster on avx-512 cpus
+        if (valid[(int)SimdLevel::AVX512]) {
+            kernels[(int)SimdLevel::AVX512].skin_points = &kernels_avx2::SkinPoints;
+            kernels[(int)SimdLevel::AVX512].skin_normals = &kernels_avx2::SkinNormals;
+        }
+#elif defined(wabcEnableSSE)
+        add(SimdLevel::SSE, &kernels_sse::FillKernels);
+#elif defined(wabcEnableNEON)
+        add(SimdLevel::NEON, &kernels_neon::FillKernels);
+#endif
+    }
+
+    void add(SimdLevel level, void (*fill)(MathKernels&))
+    {
+        if (!IsSimdLevelSupported(level))
+            return;
+        MathKernels& k = kernels[(int)level];
+        k.level = level;
+        fill(k);
+        valid[(int)level] = true;
+    }
+
+    const MathKernels* get(SimdLevel level) const
+    {
+        return valid[(int)level] ? &kernels[(int)level] : nullptr;
+    }
+
+    static const KernelTable& instance()
+    {
+        static const KernelTable s_table;
+        return s_table;
+    }
+};
+
+// relative to the magnitude of the values. fma and the order of operations differ between levels.
+bool NearEqual(const float3& a, const float3& b, float tolerance = 1e-5f)
+{
+    float scale = std::max(1.0f, std::max(length(a), length(b)));
+    return length(a - b) <= tolerance * scale;
+}
+
+bool Compare(const char* kernel, SimdLevel level, span<float3> expected, span<float3> actual)
+{
+    for (size_t i = 0; i < expected.size(); ++i) {
+        if (!NearEqual(expected[i], actual[i])) {
+            printf("CheckMathKernels(): %s (%s) differs from scalar at %d: (%f %f %f) vs (%f %f %f)\n",
+                kernel, GetSimdLevelName(level), (int)i,
+                expected[i].x, expected[i].y, expected[i].z, actual[i].x, actual[i].y, actual[i].z);
+            return false;
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+const char* GetSimdLevelName(SimdLevel level)
+{
+    switch (level) {
+    case SimdLevel::Scalar: return "scalar";
+    case SimdLevel::SSE: return "sse";
+    case SimdLevel::AVX2: return "avx2";
+    case SimdLevel::AVX512: return "avx512";
+    case SimdLevel::NEON: return "neon";
+    default: return "unknown";
+    }
+}
+
+SimdLevel GetSupportedSimdLevel()
+{
+    static const SimdLevel s_level = DetectSimdLevel();
+    return s_level;
+}
+
+bool IsSimdLevelSupported(SimdLevel level)
+{
+    SimdLevel supported = GetSupportedSimdLevel();
+    if (level == SimdLevel::Scalar || level == supported)
+        return true;
+#if defined(wabcEnableCpuDispatch)
+    // x86 levels are supersets of each other
+    return supported != SimdLevel::NEON && level != SimdLevel::NEON && (int)level <= (int)supported;
+#else
+    return false;
+#endif
+}
+
+SimdLevel GetSimdLevel()
+{
+    return GetMathKernels().level;
+}
+
+const MathKernels& GetMathKernels()
+{
+    static const MathKernels& s_kernels = []() -> const MathKernels& {
+        if (getenv("WABC_SIMD_CHECK"))
+            CheckMathKernels();
+        const MathKernels& kernels = *KernelTable::instance().get(SelectSimdLevel());
+        if (getenv("WABC_SKINNING_BENCHMARK"))
+            BenchmarkSkinning(kernels);
+        return kernels;
+    }();
+    return s_kernels;
+}
+
+const MathKernels* GetMathKernels(SimdLevel level)
+{
+    return KernelTable::instance().get(level);
+}
+
+bool CheckMathKernels()
+{
+    // sizes that are not multiples of any register width, so that the scalar tails run too
+    const size_t num_points = 1031;
+    const size_t num_triangles = 517;
+    // skinning runs in two ranges like the chunks of ParallelFor, so that a range that doesn't start at 0 runs too
+    const size_t skin_split = 517;
+    static const int widths[] = { 1, 2, 4, 8 };
+
+    std::mt19937 rng(1234);
+    std::uniform_real_distribution<float> dist(-10.0f, 10.0f);
+    std::uniform_real_distribution<float> dist01(0.0f, 1.0f);
+    std::uniform_int_distribution<int> point_index(0, (int)num_points - 1);
+
+    RawVector<float3> points(num_points);
+    for (auto& p : points)
+        p = { dist(rng), dist(rng), dist(rng) };
+
+    // degenerate triangles have no meaningful normal, so every triangle uses 3 different points
+    RawVector<int> indices(num_triangles * 3);
+    for (size_t ti = 0; ti < num_triangles; ++ti) {
+        int* t = &indices[ti * 3];
+        t[0] = point_index(rng);
+        do { t[1] = point_index(rng); } while (t[1] == t[0]);
+        do { t[2] = point_index(rng); } while (t[2] == t[0] || t[2] == t[1]);
+    }
+
+    float4x4 m = to_mat4x4(rotate(normalize(float3{ 0.3f, 1.0f, -0.5f }), 0.7f)) * scale44(float3{ 1.5f, 0.5f, 2.0f });
+    m[3] = { 3.0f, -2.0f, 1.0f, 1.0f };
+
+    RawVector<float4x4> matrices(16);
+    for (auto& jm : matrices) {
+        jm = to_mat4x4(rotate(normalize(float3{ dist(rng), dist(rng), dist(rng) }), dist(rng)));
+        jm[3] = { dist(rng), dist(rng), dist(rng), 1.0f };
+    }
+
+    // influences for every width the skinning kernels are specialized for
+    RawVector<int> joint_indices[std::size(widths)];
+    RawVector<float> joint_weights[std::size(widths)];
+    for (size_t wi = 0; wi < std::size(widths); ++wi) {
+        int width = widths[wi];
+        joint_indices[wi].resize(num_points * width);
+        joint_weights[wi].resize(num_points * width);
+        for (size_t vi = 0; vi < num_points; ++vi) {
+            float total = 0.0f;
+            for (int i = 0; i < width; ++i) {
+                joint_indices[wi][vi * width + i] = (int)(rng() % matrices.size());
+                total += joint_weights[wi][vi * width + i] = dist01(rng);
+            }
+            for (int i = 0; i < width; ++i)
+                joint_weights[wi][vi * width + i] /= total;
+        }
+    }
+
+    // every kernel of MathKernels, and the skinning ones once per width
+    static const char* names[] = {
+        "mul_p", "mul_v", "normalize", "mul_p_soa", "mul_v_soa", "normalize_soa", "triangle_normals",
+        "skin_points (width 1)", "skin_normals (width 1)", "skin_points (width 2)", "skin_normals (width 2)",
+        "skin_points (width 4)", "skin_normals (width 4)", "skin_points (width 8)", "skin_normals (width 8)",
+    };
+    const size_t num_results = std::size(names);
+
+    // runs every kernel of k and writes the results, one array per entry of names
+    auto run = [&](const MathKernels& k, RawVector<float3>* dst, float3 (&bounds)[2]) {
+        for (size_t i = 0; i < num_results; ++i)
+            dst[i].resize(num_points);
+        k.mul_p(dst[0].data(), points.data(), num_points, m);
+        k.mul_v(dst[1].data(), points.data(), num_points, m);
+        k.normalize(dst[2].data(), points.data(), num_points);
+
+        RawVector<float> soa(num_points * 6);
+        float3_soa src_soa{ &soa[0], &soa[num_points], &soa[num_points * 2] };
+        float3_soa dst_soa{ &soa[num_points * 3], &soa[num_points * 4], &soa[num_points * 5] };
+        for (size_t i = 0; i < num_points; ++i) {
+            src_soa.x[i] = points[i].x;
+            src_soa.y[i] = points[i].y;
+            src_soa.z[i] = points[i].z;
+        }
+        auto soa_result = [&](RawVector<float3>& result) {
+            for (size_t i = 0; i < num_points; ++i)
+                result[i] = { dst_soa.x[i], dst_soa.y[i], dst_soa.z[i] };
+        };
+        k.mul_p_soa(dst_soa, src_soa, num_points, m);
+        soa_result(dst[3]);
+        k.mul_v_soa(dst_soa, src_soa, num_points, m);
+        soa_result(dst[4]);
+        k.normalize_soa(dst_soa, src_soa, num_points);
+        soa_result(dst[5]);
+
+        dst[6].zeroclear();
+        k.triangle_normals(dst[6].data(), points.data(), indices.data(), num_triangles);
+
+        for (size_t wi = 0; wi < std::size(widths); ++wi) {
+            const int* ji = joint_indices[wi].data();
+            const float* jw = joint_weights[wi].data();
+            RawVector<float3>& skinned_points = dst[7 + wi * 2];
+            RawVector<float3>& skinned_normals = dst[8 + wi * 2];
+            k.skin_points(skinned_points.data(), points.data(), matrices.data(), ji, jw, widths[wi], 0, skin_split);
+            k.skin_points(skinned_points.data(), points.data(), matrices.data(), ji, jw, widths[wi], skin_split, num_points);
+            k.skin_normals(skinned_normals.data(), points.data(), matrices.data(), ji, jw, widths[wi], 0, skin_split);
+            k.skin_normals(skinned_normals.data(), points.data(), matrices.data(), ji, jw, widths[wi], skin_split, num_points);
+        }
+
+        k.bounds(points.data(), num_points, bounds[0], bounds[1]);
+    };
+
+    RawVector<float3> expected[num_results], actual[num_results];
+    float3 expected_bounds[2], actual_bounds[2];
+    run(*GetMathKernels(SimdLevel::Scalar), expected, expected_bounds);
+
+    bool ok = true;
+    for (SimdLevel level : kSimdLevels) {
+        const MathKernels* k = GetMathKernels(level);
+        if (level == SimdLevel::Scalar || !k)
+            continue;
+
+        run(*k, actual, actual_bounds);
+        for (size_t i = 0; i < num_results; ++i)
+            ok &= Compare(names[i], level, expected[i], actual[i]);
+        ok &= Compare("bounds", level, span<float3>(expected_bounds, 2), span<float3>(actual_bounds, 2));
+    }
+    if (ok)
+        printf("CheckMathKernels(): all levels up to %s agree with scalar\n", GetSimdLevelName(GetSupportedSimdLevel()));
+    return ok;
+}
+
+} // namespace wabc
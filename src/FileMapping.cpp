@@ -0,0 +1,162 @@
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <mutex>
+#include <unordered_map>
+
+#if defined(_WIN32)
+#define NOMINMAX
+#include <windows.h>
+#elif !defined(__EMSCRIPTEN__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define FILE_MAPPING_POSIX
+#endif
+
+#include "FileMapping.h"
+
+namespace
+{
+   struct Mapping
+   {
+      size_t size;
+      bool   mapped; // False if the file was read into the heap
+   };
+
+   // munmap needs the size of the mapping, and UnmapFile needs to know how the memory was obtained
+   std::mutex                         gMappingsMutex;
+   std::unordered_map<void*, Mapping> gMappings;
+
+   void* ReadFile(const char* path, size_t& outSize)
+   {
+      FILE* file = std::fopen(path, "rb");
+      if (file == nullptr)
+      {
+         return nullptr;
+      }
+
+      std::fseek(file, 0, SEEK_END);
+      long size = std::ftell(file);
+      std::fseek(file, 0, SEEK_SET);
+
+      void* data = (size > 0) ? std::malloc(static_cast<size_t>(size)) : nullptr;
+      if (data == nullptr || std::fread(data, 1, static_cast<size_t>(size), file) != static_cast<size_t>(size))
+      {
+         std::free(data);
+         std::fclose(file);
+         return nullptr;
+      }
+
+      std::fclose(file);
+      outSize = static_cast<size_t>(size);
+      return data;
+   }
+
+   void* MapWholeFile(const char* path, size_t& outSize)
+   {
+#if defined(_WIN32)
+      HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+      if (file == INVALID_HANDLE_VALUE)
+      {
+         return nullptr;
+      }
+
+      LARGE_INTEGER size;
+      HANDLE mapping = nullptr;
+      if (GetFileSizeEx(file, &size) && size.QuadPart > 0)
+      {
+         mapping = CreateFileMappingA(file, nullptr, PAGE_WRITECOPY, 0, 0, nullptr);
+      }
+      CloseHandle(file);
+      if (mapping == nullptr)
+      {
+         return nullptr;
+      }
+
+      // The view keeps the mapping alive
+      void* data = MapViewOfFile(mapping, FILE_MAP_COPY, 0, 0, 0);
+      CloseHandle(mapping);
+      outSize = static_cast<size_t>(size.QuadPart);
+      return data;
+#elif defined(FILE_MAPPING_POSIX)
+      int file = open(path, O_RDONLY);
+      if (file < 0)
+      {
+         return nullptr;
+      }
+
+      struct stat status;
+      if (fstat(file, &status) != 0 || status.st_size <= 0)
+      {
+         close(file);
+         return nullptr;
+      }
+
+      // The descriptor can be closed once the file is mapped
+      void* data = mmap(nullptr, static_cast<size_t>(status.st_size), PROT_READ | PROT_WRITE, MAP_PRIVATE, file, 0);
+      close(file);
+      if (data == MAP_FAILED)
+      {
+         return nullptr;
+      }
+
+      outSize = static_cast<size_t>(status.st_size);
+      return data;
+#else
+      (void)path;
+      (void)outSize;
+      return nullptr;
+#endif
+   }
+}
+
+void* MapFile(const char* path, size_t& outSize)
+{
+   Mapping mapping;
+   mapping.mapped = true;
+   void* data = MapWholeFile(path, mapping.size);
+   if (data == nullptr)
+   {
+      mapping.mapped = false;
+      data = ReadFile(path, mapping.size);
+      if (data == nullptr)
+      {
+         std::cout << "Error - MapFile - Could not open the following file: " << path << '\n';
+         return nullptr;
+      }
+   }
+
+   std::lock_guard<std::mutex> lock(gMappingsMutex);
+   gMappings[data] = mapping;
+   outSize = mapping.size;
+   return data;
+}
+
+void UnmapFile(void* data)
+{
+   Mapping mapping;
+   {
+      std::lock_guard<std::mutex> lock(gMappingsMutex);
+      auto it = gMappings.find(data);
+      if (it == gMappings.end())
+      {
+         return;
+      }
+      mapping = it->second;
+      gMappings.erase(it);
+   }
+
+   if (!mapping.mapped)
+   {
+      std::free(data);
+      return;
+   }
+
+#if defined(_WIN32)
+   UnmapViewOfFile(data);
+#elif defined(FILE_MAPPING_POSIX)
+   munmap(data, mapping.size);
+#endif
+}
@@ -0,0 +1,63 @@
+#include "pch.h"
+#include "FrameArena.h"
+
+#include "AllocationTracker.h"
+
+namespace wabc {
+
+namespace {
+
+// 1MB covers the transient buffers of most frames. larger frames make the arena grow once and it keeps that size.
+const size_t kFrameArenaBlockSize = 1024 * 1024;
+
+thread_local size_t t_frame_start_allocations = 0;
+
+size_t GetThreadAllocations()
+{
+    return sfbx::GetThreadHeapAllocations() + GetThreadNewCount();
+}
+
+} // namespace
+
+sfbx::ArenaAllocator* GetFrameArena()
+{
+    thread_local sfbx::ArenaAllocator t_arena("frame", kFrameArenaBlockSize, 64);
+    return &t_arena;
+}
+
+FrameArenaScope::FrameArenaScope()
+    : m_arena(GetFrameArena())
+    , m_marker(m_arena->getMarker())
+{
+}
+
+FrameArenaScope::~FrameArenaScope()
+{
+    m_arena->rewind(m_marker);
+}
+
+void BeginFrame()
+{
+    auto* arena = GetFrameArena();
+    if (arena->getStats().allocations != 0)
+        printf("BeginFrame(): %d frame arena allocations are still alive\n", (int)arena->getStats().allocations);
+    arena->reset();
+    NextAllocationFrame();
+    t_frame_start_allocations = GetThreadAllocations();
+}
+
+size_t GetFrameHeapAllocations()
+{
+    return GetThreadAllocations() - t_frame_start_allocations;
+}
+
+void CheckSteadyStateFrame()
+{
+#ifdef wabcEnableHeapCounter
+    size_t n = GetFrameHeapAllocations();
+    if (n != 0)
+        printf("CheckSteadyStateFrame(): %d heap allocations in a steady state frame\n", (int)n);
+#endif
+}
+
+} // namespace wabc
@@ -1,12 +1,24 @@
 #pragma warning(disable : 26812)
 
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
+#include <limits>
 
 #include "glm/gtc/type_ptr.hpp"
 #include "glm/gtx/norm.hpp"
 
 #include "Transform.h"
 #include "GLTFLoader.h"
+#include "FileMapping.h"
+#include "MeshoptDecoder.h"
+#include "Parallel.h"
+
+// Defined next to the cgltf implementation, which owns the JSON tokenizer
+extern "C" int cgltf_parse_mesh_gpu_instancing(const char* json, int* out_translation, int* out_rotation, int* out_scale);
 
 namespace GLTFHelpers
 {
@@ -17,12 +29,120 @@ namespace GLTFHelpers
    //   Properties: buffer, byteOffset, byteLength, byteStride, target (optional OpenGL buffer target)
    // - An accessor defines how the data of a bufferView is interpreted
    //   Properties: bufferView, byteOffset, type (e.g. "VEC2"), componentType (e.g. GL_FLOAT), count (e.g. number of "VEC2"s in the bufferView), min, max
-   // The function below reads the values of an accessor whose componentType must be GL_FLOAT
-   // E.g. For an accessor with a type of "VEC2", a componentType of GL_FLOAT and a count of 32, componentCount should be equal to 2,
+
+   // The per-element path can be forced with the WABC_GLTF_PER_ELEMENT environment variable, which is meant for A/B
+   // benchmarks of the load times
+   bool BulkAccessorReadsAreEnabled()
+   {
+      static bool enabled = std::getenv("WABC_GLTF_PER_ELEMENT") == nullptr;
+      return enabled;
+   }
+
+   // Returns the first element of an accessor in its buffer, or nullptr for sparse accessors and the ones without data
+   const unsigned char* GetAccessorData(const cgltf_accessor& accessor)
+   {
+      const cgltf_buffer_view* bufferView = accessor.buffer_view;
+      if (accessor.is_sparse || bufferView == nullptr)
+      {
+         return nullptr;
+      }
+
+      // The data of a buffer view that an extension has decoded overrides the one of its buffer
+      const unsigned char* bufferData = static_cast<const unsigned char*>(bufferView->data ? bufferView->data : bufferView->buffer->data);
+      if (bufferData == nullptr)
+      {
+         return nullptr;
+      }
+
+      return bufferData + (bufferView->data ? 0 : bufferView->offset) + accessor.offset;
+   }
+
+   // Returns the values of an accessor where they are in its buffer, or nullptr if they can't be used as they are
+   // That's only the case for accessors that aren't sparse, whose components are of the given type without
+   // normalization, and whose elements are tightly packed
+   const void* GetTightlyPackedAccessorData(const cgltf_accessor& accessor, cgltf_component_type componentType)
+   {
+      if (!BulkAccessorReadsAreEnabled() || accessor.normalized || accessor.component_type != componentType)
+      {
+         return nullptr;
+      }
+
+      const unsigned char* data = GetAccessorData(accessor);
+      if (data == nullptr)
+      {
+         return nullptr;
+      }
+
+      // Matrices are excluded, since their columns can be padded
+      cgltf_size componentSize = (componentType == cgltf_component_type_r_8u) ? 1 : (componentType == cgltf_component_type_r_16u) ? 2 : 4;
+      cgltf_size elementSize   = cgltf_num_components(accessor.type) * componentSize;
+      if (accessor.type == cgltf_type_mat2 || accessor.type == cgltf_type_mat3 || accessor.type == cgltf_type_mat4 ||
+          accessor.stride != elementSize)
+      {
+         return nullptr;
+      }
+
+      return data;
+   }
+
+   // KHR_mesh_quantization allows the components of the attributes to be integers, normalized or not
+   // cgltf_accessor_read_float reads the signed ones that aren't normalized as unsigned, so they are converted here
+   template<typename T>
+   void ConvertIntegerComponents(const unsigned char* data, cgltf_size stride, cgltf_size count, unsigned int componentCount,
+                                 bool normalized, float* outValues)
+   {
+      const float maxValue = static_cast<float>(std::numeric_limits<T>::max());
+      for (cgltf_size i = 0; i < count; ++i)
+      {
+         const unsigned char* element = data + i * stride;
+         for (unsigned int c = 0; c < componentCount; ++c)
+         {
+            T value;
+            std::memcpy(&value, element + c * sizeof(T), sizeof(T));
+            // Signed normalized values are clamped, since both the minimum and the one above it are -1
+            outValues[i * componentCount + c] = normalized ? std::max(static_cast<float>(value) / maxValue, -1.0f) : static_cast<float>(value);
+         }
+      }
+   }
+
+   bool ReadIntegerComponentsFromAccessor(const cgltf_accessor& accessor, unsigned int componentCount, float* outValues)
+   {
+      const unsigned char* data = GetAccessorData(accessor);
+      if (data == nullptr || cgltf_num_components(accessor.type) != componentCount ||
+          accessor.type == cgltf_type_mat2 || accessor.type == cgltf_type_mat3 || accessor.type == cgltf_type_mat4)
+      {
+         return false;
+      }
+
+      bool normalized = accessor.normalized != 0;
+      switch (accessor.component_type)
+      {
+      case cgltf_component_type_r_8:   ConvertIntegerComponents<int8_t>(data, accessor.stride, accessor.count, componentCount, normalized, outValues);   return true;
+      case cgltf_component_type_r_8u:  ConvertIntegerComponents<uint8_t>(data, accessor.stride, accessor.count, componentCount, normalized, outValues);  return true;
+      case cgltf_component_type_r_16:  ConvertIntegerComponents<int16_t>(data, accessor.stride, accessor.count, componentCount, normalized, outValues);  return true;
+      case cgltf_component_type_r_16u: ConvertIntegerComponents<uint16_t>(data, accessor.stride, accessor.count, componentCount, normalized, outValues); return true;
+      default:                         return false;
+      }
+   }
+
+   // The function below reads the values of an accessor as floats
+   // E.g. For an accessor with a type of "VEC2" and a count of 32, componentCount should be equal to 2,
    //      which would result in 64 floats being read
-   void GetFloatsFromAccessor(const cgltf_accessor& accessor, unsigned int componentCount, std::vector<float>& outValues)
+   // Tightly packed float accessors are copied at once, integer ones are converted from their buffer, and the others
+   // are converted one element at a time
+   void ReadFloatsFromAccessor(const cgltf_accessor& accessor, unsigned int componentCount, float* outValues)
    {
-      outValues.resize(accessor.count * componentCount);
+      const void* packedData = GetTightlyPackedAccessorData(accessor, cgltf_component_type_r_32f);
+      if (packedData != nullptr && cgltf_num_components(accessor.type) == componentCount)
+      {
+         std::memcpy(outValues, packedData, accessor.count * componentCount * sizeof(float));
+         return;
+      }
+
+      if (accessor.component_type != cgltf_component_type_r_32f && ReadIntegerComponentsFromAccessor(accessor, componentCount, outValues))
+      {
+         return;
+      }
 
       for (cgltf_size i = 0; i < accessor.count; ++i)
       {
@@ -30,6 +150,48 @@ namespace GLTFHelpers
       }
    }
 
+   void GetFloatsFromAccessor(const cgltf_accessor& accessor, unsigned int componentCount, std::vector<float>& outValues)
+   {
+      outValues.resize(accessor.count * componentCount);
+      if (!outValues.empty())
+      {
+         ReadFloatsFromAccessor(accessor, componentCount, outValues.data());
+      }
+   }
+
+   // Tightly packed 32-bit indices are copied at once, 8 and 16-bit ones are widened in a loop over the buffer, and
+   // the others are read one at a time
+   void GetIndicesFromAccessor(const cgltf_accessor& accessor, std::vector<unsigned int>& outIndices)
+   {
+      outIndices.resize(accessor.count);
+      if (outIndices.empty())
+      {
+         return;
+      }
+
+      if (const void* packedData = GetTightlyPackedAccessorData(accessor, cgltf_component_type_r_32u))
+      {
+         std::memcpy(outIndices.data(), packedData, accessor.count * sizeof(unsigned int));
+      }
+      else if (const void* packedData = GetTightlyPackedAccessorData(accessor, cgltf_component_type_r_16u))
+      {
+         const uint16_t* indices = static_cast<const uint16_t*>(packedData);
+         std::copy(indices, indices + accessor.count, outIndices.begin());
+      }
+      else if (const void* packedData = GetTightlyPackedAccessorData(accessor, cgltf_component_type_r_8u))
+      {
+         const uint8_t* indices = static_cast<const uint8_t*>(packedData);
+         std::copy(indices, indices + accessor.count, outIndices.begin());
+      }
+      else
+      {
+         for (cgltf_size i = 0; i < accessor.count; ++i)
+         {
+            outIndices[i] = static_cast<unsigned int>(cgltf_accessor_read_index(&accessor, i));
+         }
+      }
+   }
+
    // A glTF file may contain an array of meshes
    // Each mesh may contain multiple mesh primitives, which refer to the geometry data that is required to render a mesh
    // Each mesh primitive consists of:
@@ -39,88 +201,618 @@ namespace GLTFHelpers
    // - The material that should be used for rendering
    // Each attribute is defined by mapping the attribute name (e.g. "POSITION", "NORMAL", etc.)
    // to the index of the accessor that contains the attribute data
-   void StoreValuesOfAttributeInStaticMesh(cgltf_attribute& attribute, StaticMesh& outMesh)
+   void StoreValuesOfAttributeInStaticMesh(const cgltf_attribute& attribute, StaticMesh& outMesh)
    {
-      // Get the accessor of the attribute and its component count
+      // Note that accessor.count is not equal to the number of floats in the accessor
+      // It's equal to the number of attribute values (e.g, vec2s, vec3s, vec4s, etc.) in the accessor
+      // The values are read straight into the vector of the mesh, since glm::vec3 and glm::vec2 are tightly packed floats
       cgltf_accessor& accessor = *attribute.data;
-      unsigned int componentCount = 0;
-      if (accessor.type == cgltf_type_vec2)
+      switch (attribute.type)
+      {
+      case cgltf_attribute_type_position:
+      {
+         std::vector<glm::vec3>& positions = outMesh.GetPositions();
+         positions.resize(accessor.count);
+         if (!positions.empty())
+         {
+            ReadFloatsFromAccessor(accessor, 3, glm::value_ptr(positions[0]));
+         }
+      }
+      break;
+      case cgltf_attribute_type_texcoord:
       {
-         componentCount = 2;
+         std::vector<glm::vec2>& texCoords = outMesh.GetTexCoords();
+         texCoords.resize(accessor.count);
+         if (!texCoords.empty())
+         {
+            ReadFloatsFromAccessor(accessor, 2, glm::value_ptr(texCoords[0]));
+         }
       }
-      else if (accessor.type == cgltf_type_vec3)
+      break;
+      case cgltf_attribute_type_normal:
       {
-         componentCount = 3;
+         std::vector<glm::vec3>& normals = outMesh.GetNormals();
+         normals.resize(accessor.count);
+         if (!normals.empty())
+         {
+            ReadFloatsFromAccessor(accessor, 3, glm::value_ptr(normals[0]));
+         }
+
+         for (glm::vec3& normal : normals)
+         {
+            // TODO: Use a constant here and add an error message
+            if (glm::length2(normal) < 0.000001f)
+            {
+               normal = glm::vec3(0, 1, 0);
+            }
+
+            normal = glm::normalize(normal);
+         }
       }
-      else if (accessor.type == cgltf_type_vec4)
+      break;
+      case cgltf_attribute_type_invalid:
+      case cgltf_attribute_type_tangent:
+      case cgltf_attribute_type_color:
+      case cgltf_attribute_type_joints:
+      case cgltf_attribute_type_weights:
+         break;
+      }
+   }
+
+   // A mesh primitive may also contain an array of morph targets
+   // Each morph target maps attribute names to accessors, just like the primitive itself, but its values are displacements
+   // that are added to the base attributes after being multiplied by the weight of the target
+   // The default weights are stored in the mesh, and a node can override them
+   // This runs on the worker threads of DecodePrimitives, so the deltas stay on the CPU until StaticMesh::LoadBuffers
+   void StoreMorphTargetsInStaticMesh(const cgltf_node& node, const cgltf_primitive& primitive, StaticMesh& outMesh)
+   {
+      unsigned int numTargets  = static_cast<unsigned int>(primitive.targets_count);
+      unsigned int numVertices = static_cast<unsigned int>(outMesh.GetPositions().size());
+      if (numTargets == 0 || numVertices == 0)
       {
-         componentCount = 4;
+         return;
       }
 
-      // Read the floats from the accessor
-      std::vector<float> attributeFloats;
-      GetFloatsFromAccessor(accessor, componentCount, attributeFloats);
+      MorphTargets& morphTargets = outMesh.GetMorphTargets();
+      morphTargets.SetNumTargets(numTargets, numVertices);
 
-      // Get the vectors that will store the attributes of the mesh that we are loading
-      // In each call to this function we only fill one of these, since a cgltf_attribute only describes one attribute
-      std::vector<glm::vec3>&  positions  = outMesh.GetPositions();
-      std::vector<glm::vec3>&  normals    = outMesh.GetNormals();
-      std::vector<glm::vec2>&  texCoords  = outMesh.GetTexCoords();
+      std::vector<glm::vec3>& positionDeltas = morphTargets.GetPositionDeltas();
+      std::vector<glm::vec3>& normalDeltas   = morphTargets.GetNormalDeltas();
 
-      // Loop over all the values of the accessor
-      // Note that accessor.count is not equal to the number of floats in the accessor
-      // It's equal to the number of attribute values (e.g, vec2s, vec3s, vec4s, etc.) in the accessor
-      cgltf_attribute_type attributeType = attribute.type;
-      unsigned int numAttributeValues = static_cast<unsigned int>(accessor.count);
-      for (unsigned int attributeValueIndex = 0; attributeValueIndex < numAttributeValues; ++attributeValueIndex)
-      {
-         // Store the current attribute value in the correct vector of the mesh
-         // TODO: This looks inefficient. I think it would be better to have separate for loops inside if-statements
-         //       Since this function only loads one attribute type when it's called, it doesn't make sense to check
-         //       the attribute type in each iteration of this loop
-         int indexOfFirstFloatOfCurrAttribValue = attributeValueIndex * componentCount;
-         switch (attributeType)
-         {
-         case cgltf_attribute_type_position:
-            // Store a position vec3
-            positions.push_back(glm::vec3(attributeFloats[indexOfFirstFloatOfCurrAttribValue + 0],
-                                          attributeFloats[indexOfFirstFloatOfCurrAttribValue + 1],
-                                          attributeFloats[indexOfFirstFloatOfCurrAttribValue + 2]));
+      for (unsigned int targetIndex = 0; targetIndex < numTargets; ++targetIndex)
+      {
+         const cgltf_morph_target& target = primitive.targets[targetIndex];
+         for (cgltf_size attributeIndex = 0; attributeIndex < target.attributes_count; ++attributeIndex)
+         {
+            const cgltf_attribute& attribute = target.attributes[attributeIndex];
+
+            std::vector<glm::vec3>* deltas = nullptr;
+            if (attribute.type == cgltf_attribute_type_position)
+            {
+               deltas = &positionDeltas;
+            }
+            else if (attribute.type == cgltf_attribute_type_normal)
+            {
+               deltas = &normalDeltas;
+            }
+
+            if (deltas == nullptr)
+            {
+               continue;
+            }
+
+            if (attribute.data->count != numVertices)
+            {
+               std::cout << "Error - GLTFHelpers::StoreMorphTargetsInStaticMesh - Morph target " << targetIndex << " doesn't have one value per vertex" << '\n';
+               continue;
+            }
+
+            ReadFloatsFromAccessor(*attribute.data, 3, glm::value_ptr((*deltas)[targetIndex * numVertices]));
+         }
+      }
+
+      const float* defaultWeights    = node.weights_count > 0 ? node.weights : node.mesh->weights;
+      cgltf_size   numDefaultWeights = node.weights_count > 0 ? node.weights_count : node.mesh->weights_count;
+      morphTargets.SetWeights(std::vector<float>(defaultWeights, defaultWeights + numDefaultWeights));
+   }
+
+   Transform GetLocalTransform(const cgltf_node& node)
+   {
+      Transform result;
+
+      if (node.has_matrix)
+      {
+         glm::mat4 mat = glm::make_mat4(&node.matrix[0]);
+         result = mat4ToTransform(mat);
+      }
+
+      if (node.has_translation)
+      {
+         result.position = glm::vec3(node.translation[0], node.translation[1], node.translation[2]);
+      }
+
+      if (node.has_rotation)
+      {
+         result.rotation = Q::quat(node.rotation[0], node.rotation[1], node.rotation[2], node.rotation[3]);
+      }
+
+      if (node.has_scale)
+      {
+         result.scale = glm::vec3(node.scale[0], node.scale[1], node.scale[2]);
+      }
+
+      return result;
+   }
+
+   int GetNodeIndex(const cgltf_node* target, const cgltf_data& data)
+   {
+      if (target == nullptr)
+      {
+         return -1;
+      }
+
+      return static_cast<int>(target - data.nodes);
+   }
+
+   // Combines the local transforms of the node and its ancestors
+   Transform GetWorldTransform(const cgltf_node& node)
+   {
+      Transform result = GetLocalTransform(node);
+      for (const cgltf_node* parent = node.parent; parent != nullptr; parent = parent->parent)
+      {
+         result = combine(GetLocalTransform(*parent), result);
+      }
+
+      return result;
+   }
+
+   // Returns the accessor that an attribute of EXT_mesh_gpu_instancing refers to, or null if the extension doesn't have
+   // the attribute (see cgltf_parse_mesh_gpu_instancing)
+   const cgltf_accessor* GetGPUInstancingAccessor(const cgltf_data& data, int accessorIndex, const char* attributeName)
+   {
+      if (accessorIndex < 0)
+      {
+         return nullptr;
+      }
+
+      if (static_cast<cgltf_size>(accessorIndex) >= data.accessors_count)
+      {
+         std::cout << "Error - GLTFHelpers::GetGPUInstancingAccessor - The " << attributeName << " attribute doesn't refer to an accessor" << '\n';
+         return nullptr;
+      }
+
+      return &data.accessors[accessorIndex];
+   }
+
+   // Returns the world matrix of the node, or one per instance if the node uses EXT_mesh_gpu_instancing
+   // The transforms of the instances are relative to the node, and the attributes that they don't have are the identity
+   std::vector<glm::mat4> GetInstanceMatrices(const cgltf_data& data, const cgltf_node& node)
+   {
+      Transform worldTransform = GetWorldTransform(node);
+
+      const char* json = nullptr;
+      for (cgltf_size i = 0; i < node.extensions_count; ++i)
+      {
+         if (std::strcmp(node.extensions[i].name, "EXT_mesh_gpu_instancing") == 0)
+         {
+            json = node.extensions[i].data;
+         }
+      }
+
+      if (json == nullptr)
+      {
+         return { transformToMat4(worldTransform) };
+      }
+
+      int translationIndex, rotationIndex, scaleIndex;
+      bool parsed = cgltf_parse_mesh_gpu_instancing(json, &translationIndex, &rotationIndex, &scaleIndex) != 0;
+
+      const cgltf_accessor* translations = GetGPUInstancingAccessor(data, translationIndex, "TRANSLATION");
+      const cgltf_accessor* rotations    = GetGPUInstancingAccessor(data, rotationIndex, "ROTATION");
+      const cgltf_accessor* scales       = GetGPUInstancingAccessor(data, scaleIndex, "SCALE");
+
+      // Every attribute must have one value per instance
+      cgltf_size numInstances = 0;
+      bool       valid        = parsed && (translations != nullptr || rotations != nullptr || scales != nullptr);
+      for (const cgltf_accessor* accessor : { translations, rotations, scales })
+      {
+         if (accessor != nullptr)
+         {
+            valid        = valid && (numInstances == 0 || accessor->count == numInstances);
+            numInstances = accessor->count;
+         }
+      }
+      valid = valid && (translations == nullptr || translations->type == cgltf_type_vec3)
+                    && (rotations    == nullptr || rotations->type    == cgltf_type_vec4)
+                    && (scales       == nullptr || scales->type       == cgltf_type_vec3);
+
+      if (!valid)
+      {
+         std::cout << "Error - GLTFHelpers::GetInstanceMatrices - The EXT_mesh_gpu_instancing extension of node "
+                   << (node.name ? node.name : "") << " is invalid, so it's drawn once" << '\n';
+         return { transformToMat4(worldTransform) };
+      }
+
+      std::vector<glm::vec3> instanceTranslations(numInstances, glm::vec3(0.0f));
+      std::vector<glm::vec4> instanceRotations(numInstances, glm::vec4(0.0f, 0.0f, 0.0f, 1.0f));
+      std::vector<glm::vec3> instanceScales(numInstances, glm::vec3(1.0f));
+      if (numInstances > 0)
+      {
+         if (translations != nullptr)
+         {
+            ReadFloatsFromAccessor(*translations, 3, glm::value_ptr(instanceTranslations[0]));
+         }
+
+         if (rotations != nullptr)
+         {
+            ReadFloatsFromAccessor(*rotations, 4, glm::value_ptr(instanceRotations[0]));
+         }
+
+         if (scales != nullptr)
+         {
+            ReadFloatsFromAccessor(*scales, 3, glm::value_ptr(instanceScales[0]));
+         }
+      }
+
+      std::vector<glm::mat4> matrices(numInstances);
+      for (cgltf_size i = 0; i < numInstances; ++i)
+      {
+         const glm::vec4& rotation = instanceRotations[i];
+         Transform instanceTransform(instanceTranslations[i], Q::quat(rotation.x, rotation.y, rotation.z, rotation.w), instanceScales[i]);
+         matrices[i] = transformToMat4(combine(worldTransform, instanceTransform));
+      }
+
+      return matrices;
+   }
+
+   Interpolation GetInterpolation(cgltf_interpolation_type interpolationType)
+   {
+      switch (interpolationType)
+      {
+      case cgltf_interpolation_type_step:
+         return Interpolation::Constant;
+      case cgltf_interpolation_type_cubic_spline:
+         return Interpolation::Cubic;
+      case cgltf_interpolation_type_linear:
+      default:
+         return Interpolation::Linear;
+      }
+   }
+
+   // The input accessor of an animation sampler contains the times of the keyframes,
+   // and its output accessor contains the values (3 per keyframe for cubic spline interpolation)
+   void TrackFromChannel(const cgltf_animation_channel& channel, VectorTrack& outTrack)
+   {
+      const cgltf_animation_sampler& sampler = *channel.sampler;
+
+      std::vector<float> times;
+      GetFloatsFromAccessor(*sampler.input, 1, times);
+
+      std::vector<float> floats;
+      GetFloatsFromAccessor(*sampler.output, 3, floats);
+
+      std::vector<glm::vec3> values(floats.size() / 3);
+      for (size_t i = 0; i < values.size(); ++i)
+      {
+         values[i] = glm::vec3(floats[i * 3 + 0], floats[i * 3 + 1], floats[i * 3 + 2]);
+      }
+
+      outTrack.SetKeyframes(std::move(times), std::move(values), GetInterpolation(sampler.interpolation));
+   }
+
+   void TrackFromChannel(const cgltf_animation_channel& channel, QuaternionTrack& outTrack)
+   {
+      const cgltf_animation_sampler& sampler = *channel.sampler;
+
+      std::vector<float> times;
+      GetFloatsFromAccessor(*sampler.input, 1, times);
+
+      std::vector<float> floats;
+      GetFloatsFromAccessor(*sampler.output, 4, floats);
+
+      std::vector<Q::quat> values(floats.size() / 4);
+      for (size_t i = 0; i < values.size(); ++i)
+      {
+         values[i] = Q::quat(floats[i * 4 + 0], floats[i * 4 + 1], floats[i * 4 + 2], floats[i * 4 + 3]);
+      }
+
+      outTrack.SetKeyframes(std::move(times), std::move(values), GetInterpolation(sampler.interpolation));
+   }
+
+   // The callbacks below replace the file reads of cgltf, so that the files are mapped instead of being copied into the heap
+   // The binary chunk of a .glb file then stays where it's mapped, and the buffers point into it
+   cgltf_result MapGLTFFile(const cgltf_memory_options* /*memoryOptions*/, const cgltf_file_options* /*fileOptions*/,
+                            const char* path, cgltf_size* size, void** data)
+   {
+      size_t fileSize = 0;
+      void*  fileData = MapFile(path, fileSize);
+      if (fileData == nullptr)
+      {
+         return cgltf_result_file_not_found;
+      }
+
+      if (size)
+      {
+         *size = fileSize;
+      }
+      *data = fileData;
+      return cgltf_result_success;
+   }
+
+   void UnmapGLTFFile(const cgltf_memory_options* /*memoryOptions*/, const cgltf_file_options* /*fileOptions*/, void* data)
+   {
+      UnmapFile(data);
+   }
+
+   // The buffer views that are compressed with EXT_meshopt_compression are decoded into the data of the view, which
+   // cgltf uses instead of the data of the buffer and releases in cgltf_free
+   // The uncompressed buffer of such a view is usually a fallback without data, so this must be done before anything is read
+   bool DecodeMeshoptCompression(cgltf_data* data)
+   {
+      for (cgltf_size viewIndex = 0; viewIndex < data->buffer_views_count; ++viewIndex)
+      {
+         cgltf_buffer_view& bufferView = data->buffer_views[viewIndex];
+         if (!bufferView.has_meshopt_compression || bufferView.data != nullptr)
+         {
+            continue;
+         }
+
+         const cgltf_meshopt_compression& compression = bufferView.meshopt_compression;
+         if (compression.buffer->data == nullptr)
+         {
+            std::cout << "Error - DecodeMeshoptCompression - The compressed data of buffer view " << viewIndex << " wasn't loaded" << '\n';
+            return false;
+         }
+
+         const uint8_t* source  = static_cast<const uint8_t*>(compression.buffer->data) + compression.offset;
+         void*          decoded = data->memory.alloc(data->memory.user_data, compression.count * compression.stride);
+         if (decoded == nullptr)
+         {
+            return false;
+         }
+
+         bool success = false;
+         switch (compression.mode)
+         {
+         case cgltf_meshopt_compression_mode_attributes:
+            success = wabc::DecodeMeshoptVertices(decoded, compression.count, compression.stride, source, compression.size);
+            break;
+         case cgltf_meshopt_compression_mode_triangles:
+            success = wabc::DecodeMeshoptTriangles(decoded, compression.count, compression.stride, source, compression.size);
             break;
-         case cgltf_attribute_type_texcoord:
-            // Store a texture coordinates vec2
-            texCoords.push_back(glm::vec2(attributeFloats[indexOfFirstFloatOfCurrAttribValue + 0],
-                                          attributeFloats[indexOfFirstFloatOfCurrAttribValue + 1]));
+         case cgltf_meshopt_compression_mode_indices:
+            success = wabc::DecodeMeshoptIndices(decoded, compression.count, compression.stride, source, compression.size);
             break;
-         case cgltf_attribute_type_normal:
+         case cgltf_meshopt_compression_mode_invalid:
+            break;
+         }
+
+         wabc::MeshoptFilter filter = wabc::MeshoptFilter::None;
+         switch (compression.filter)
          {
-            // Store a normal vec3
-            glm::vec3 normal = glm::vec3(attributeFloats[indexOfFirstFloatOfCurrAttribValue + 0],
-                                         attributeFloats[indexOfFirstFloatOfCurrAttribValue + 1],
-                                         attributeFloats[indexOfFirstFloatOfCurrAttribValue + 2]);
+         case cgltf_meshopt_compression_filter_none:        filter = wabc::MeshoptFilter::None;        break;
+         case cgltf_meshopt_compression_filter_octahedral:  filter = wabc::MeshoptFilter::Octahedral;  break;
+         case cgltf_meshopt_compression_filter_quaternion:  filter = wabc::MeshoptFilter::Quaternion;  break;
+         case cgltf_meshopt_compression_filter_exponential: filter = wabc::MeshoptFilter::Exponential; break;
+         }
+         success = success && wabc::ApplyMeshoptFilter(decoded, compression.count, compression.stride, filter);
 
-            // TODO: Use a constant here and add an error message
-            if (glm::length2(normal) < 0.000001f)
+         if (!success)
+         {
+            data->memory.free(data->memory.user_data, decoded);
+            std::cout << "Error - DecodeMeshoptCompression - Could not decode buffer view " << viewIndex << '\n';
+            return false;
+         }
+
+         bufferView.data = decoded;
+      }
+
+      return true;
+   }
+
+   // The extensions that a file requires must be understood to display it correctly
+   // KHR_mesh_quantization only needs its integer attributes converted to floats, which ReadFloatsFromAccessor does (see
+   // ConvertIntegerComponents), and the transforms of their nodes applied, which both static mesh loaders do
+   // EXT_mesh_gpu_instancing is only drawn by the static meshes loaded with NodeTransforms::Instanced, the other meshes
+   // are drawn once per node
+   void CheckRequiredExtensions(const cgltf_data* data, const char* path)
+   {
+      for (cgltf_size i = 0; i < data->extensions_required_count; ++i)
+      {
+         const char* extension = data->extensions_required[i];
+         if (std::strcmp(extension, "KHR_mesh_quantization") != 0 &&
+             std::strcmp(extension, "EXT_meshopt_compression") != 0 &&
+             std::strcmp(extension, "EXT_mesh_gpu_instancing") != 0)
+         {
+            std::cout << "Warning - LoadGLTFFile - " << path << " requires " << extension << ", which isn't supported" << '\n';
+         }
+      }
+   }
+
+   // Bakes the world transform of the node into the vertices, for meshes that are drawn without it
+   // KHR_mesh_quantization stores the dequantization of integer positions in that transform, so it's applied to every
+   // mesh, whatever the type of its positions, for all of them to end up in the same space
+   // The morph target deltas are transformed too, so this must run before LoadBuffers uploads them
+   void ApplyNodeTransform(const cgltf_node& node, StaticMesh& outMesh)
+   {
+      glm::mat4 transform;
+      cgltf_node_transform_world(&node, glm::value_ptr(transform));
+      if (transform == glm::mat4(1.0f))
+      {
+         return;
+      }
+
+      glm::mat3 linear       = glm::mat3(transform);
+      glm::mat3 normalMatrix = glm::transpose(glm::inverse(linear));
+
+      for (glm::vec3& position : outMesh.GetPositions())
+      {
+         position = glm::vec3(transform * glm::vec4(position, 1.0f));
+      }
+
+      for (glm::vec3& normal : outMesh.GetNormals())
+      {
+         normal = glm::normalize(normalMatrix * normal);
+      }
+
+      // The deltas are offsets, so they are only affected by the linear part of the transform
+      if (outMesh.HasMorphTargets())
+      {
+         assert(outMesh.GetMorphTargets().HasDeltas());
+         for (glm::vec3& delta : outMesh.GetMorphTargets().GetPositionDeltas())
+         {
+            delta = linear * delta;
+         }
+
+         for (glm::vec3& delta : outMesh.GetMorphTargets().GetNormalDeltas())
+         {
+            delta = normalMatrix * delta;
+         }
+      }
+   }
+
+   // A primitive of a glTF mesh, which is decoded into its own StaticMesh
+   struct PrimitiveJob
+   {
+      const cgltf_node*          node;
+      const cgltf_primitive*     primitive;
+      unsigned int               primitiveIndex;
+      StaticMesh*                mesh;
+      bool                       bakeNodeTransform; // False if the transform of the node is applied when it's drawn
+      wabc::MeshOptimization     optimization;
+      bool                       optimized;
+   };
+
+   // Adds a job per primitive that the file is decoded into, and creates the meshes that the jobs decode into
+   // The meshes are found through the nodes, so the ones that no node refers to aren't loaded, and the skinned ones are
+   // left to LoadSkinnedMeshes
+   void AddPrimitiveJobs(const cgltf_data& data, NodeTransforms nodeTransforms, std::vector<StaticMesh>& outMeshes, std::vector<PrimitiveJob>& outJobs)
+   {
+      bool   instanced = nodeTransforms == NodeTransforms::Instanced;
+      size_t firstJob  = outJobs.size();
+
+      // With instancing, each primitive of a glTF mesh is decoded once, however many nodes refer to the mesh, and the
+      // world matrices of those nodes become its instances
+      // The index of the first mesh of each glTF mesh, and the instance matrices of each mesh
+      std::vector<int>                    firstMeshIndices(data.meshes_count, -1);
+      std::vector<std::vector<glm::mat4>> instanceMatrices;
+
+      for (cgltf_size nodeIndex = 0; nodeIndex < data.nodes_count; ++nodeIndex)
+      {
+         const cgltf_node* currNode = &data.nodes[nodeIndex];
+         if (currNode->mesh == nullptr || currNode->skin != nullptr)
+         {
+            continue;
+         }
+
+         // The morph target weights of a shared mesh are the ones of the first node that refers to it
+         size_t       gltfMeshIndex = static_cast<size_t>(currNode->mesh - data.meshes);
+         unsigned int numPrimitives = static_cast<unsigned int>(currNode->mesh->primitives_count);
+         if (!instanced || firstMeshIndices[gltfMeshIndex] < 0)
+         {
+            firstMeshIndices[gltfMeshIndex] = static_cast<int>(outJobs.size() - firstJob);
+
+            for (unsigned int primitiveIndex = 0; primitiveIndex < numPrimitives; ++primitiveIndex)
             {
-               normal = glm::vec3(0, 1, 0);
+               PrimitiveJob job;
+               job.node               = currNode;
+               job.primitive          = &currNode->mesh->primitives[primitiveIndex];
+               job.primitiveIndex     = primitiveIndex;
+               job.mesh               = nullptr;
+               job.bakeNodeTransform  = !instanced;
+               job.optimized          = false;
+               outJobs.push_back(job);
             }
 
-            normals.push_back(glm::normalize(normal));
+            instanceMatrices.resize(outJobs.size() - firstJob);
          }
-         break;
-         case cgltf_attribute_type_invalid:
-         case cgltf_attribute_type_tangent:
-         case cgltf_attribute_type_color:
-         case cgltf_attribute_type_joints:
-         case cgltf_attribute_type_weights:
-            break;
+
+         if (instanced)
+         {
+            std::vector<glm::mat4> nodeMatrices = GetInstanceMatrices(data, *currNode);
+            for (unsigned int primitiveIndex = 0; primitiveIndex < numPrimitives; ++primitiveIndex)
+            {
+               std::vector<glm::mat4>& matrices = instanceMatrices[firstMeshIndices[gltfMeshIndex] + primitiveIndex];
+               matrices.insert(matrices.end(), nodeMatrices.begin(), nodeMatrices.end());
+            }
          }
       }
+
+      // The meshes are created before the jobs point to them, so that the vector isn't resized while they are decoded
+      outMeshes.resize(outJobs.size() - firstJob);
+      for (size_t meshIndex = 0; meshIndex < outMeshes.size(); ++meshIndex)
+      {
+         outJobs[firstJob + meshIndex].mesh = &outMeshes[meshIndex];
+         outMeshes[meshIndex].GetInstanceMatrices() = std::move(instanceMatrices[meshIndex]);
+      }
+   }
+
+   // The primitives of all the files are decoded and optimized on the worker threads
+   // Only the CPU data of the meshes is filled in here. The GL context belongs to the main thread, so the buffers and the
+   // morph target textures are created there afterwards, by StaticMesh::LoadBuffers
+   void DecodePrimitives(std::vector<PrimitiveJob>& jobs, size_t numFiles, const char* meshCacheDir)
+   {
+      auto startTime = std::chrono::steady_clock::now();
+      wabc::ParallelFor(jobs.size(), 1, [&jobs, meshCacheDir](size_t begin, size_t end)
+      {
+         for (size_t jobIndex = begin; jobIndex < end; ++jobIndex)
+         {
+            PrimitiveJob&          job           = jobs[jobIndex];
+            const cgltf_primitive* currPrimitive = job.primitive;
+            StaticMesh&            currMesh      = *job.mesh;
+
+            // Loop over the attributes of the current mesh primitive
+            unsigned int numAttributes = static_cast<unsigned int>(currPrimitive->attributes_count);
+            for (unsigned int attributeIndex = 0; attributeIndex < numAttributes; ++attributeIndex)
+            {
+               // Read the values of the current attribute and store them in the current mesh
+               StoreValuesOfAttributeInStaticMesh(currPrimitive->attributes[attributeIndex], currMesh);
+            }
+
+            // If the current mesh primitive has a set of indices, store them too
+            if (currPrimitive->indices != nullptr)
+            {
+               GetIndicesFromAccessor(*currPrimitive->indices, currMesh.GetIndices());
+            }
+
+            // Morph targets need the number of vertices, so they are loaded before LoadBuffers clears the positions
+            // Their texture is created by LoadBuffers, once Optimize has reordered the deltas
+            StoreMorphTargetsInStaticMesh(*job.node, *currPrimitive, currMesh);
+
+            // The vertices are brought to the space of the scene before they are optimized and encoded
+            if (job.bakeNodeTransform)
+            {
+               ApplyNodeTransform(*job.node, currMesh);
+            }
+
+            // The optimization reorders the morph targets too, so it must be done after they are loaded
+            job.optimized = currPrimitive->type == cgltf_primitive_type_triangles && currMesh.Optimize(meshCacheDir, job.optimization);
+         }
+      });
+      std::chrono::duration<double, std::milli> decodeTime = std::chrono::steady_clock::now() - startTime;
+
+      // The results are printed in order once all the threads are done
+      for (const PrimitiveJob& job : jobs)
+      {
+         if (job.optimized)
+         {
+            std::cout << "Optimized mesh " << (job.node->mesh->name ? job.node->mesh->name : "") << '[' << job.primitiveIndex << "]: "
+                      << "ACMR " << job.optimization.before.acmr << " -> " << job.optimization.after.acmr << ", "
+                      << "ATVR " << job.optimization.before.atvr << " -> " << job.optimization.after.atvr
+                      << (job.optimization.from_cache ? " (cached)\n" : "\n");
+         }
+      }
+
+      std::cout << "Decoded " << jobs.size() << " static meshes of " << numFiles << " glTF files in " << decodeTime.count()
+                << " ms on " << wabc::GetConcurrency() << " threads"
+                << (BulkAccessorReadsAreEnabled() ? "\n" : " (per element)\n");
    }
 }
 
 cgltf_data* LoadGLTFFile(const char* path)
 {
+   auto startTime = std::chrono::steady_clock::now();
+
    // The cgltf_data struct contains all the information that's stored in a glTF file:
    // scenes, nodes, meshes, materials, skins, animations, cameras, textures, images, samplers, buffers, bufferViews and accessors
    cgltf_data* data = nullptr;
@@ -129,6 +821,8 @@ cgltf_data* LoadGLTFFile(const char* path)
    // Initializing it to zero tells cgltf that we want to use the default behavior
    cgltf_options options;
    memset(&options, 0, sizeof(cgltf_options));
+   options.file.read    = GLTFHelpers::MapGLTFFile;
+   options.file.release = GLTFHelpers::UnmapGLTFFile;
 
    // Open the glTF file and parse the glTF data
    cgltf_result result = cgltf_parse_file(&options, path, &data);
@@ -157,6 +851,19 @@ cgltf_data* LoadGLTFFile(const char* path)
       return nullptr;
    }
 
+   GLTFHelpers::CheckRequiredExtensions(data, path);
+
+   // Decode the buffer views that are compressed with EXT_meshopt_compression
+   if (!GLTFHelpers::DecodeMeshoptCompression(data))
+   {
+      cgltf_free(data);
+      std::cout << "Could not decode the compressed buffers of the following glTF file: " << path << '\n';
+      return nullptr;
+   }
+
+   std::chrono::duration<double, std::milli> loadTime = std::chrono::steady_clock::now() - startTime;
+   std::cout << "Loaded " << path << " in " << loadTime.count() << " ms\n";
+
    return data;
 }
 
@@ -172,65 +879,308 @@ void FreeGLTFFile(cgltf_data* data)
    }
 }
 
-// This function is identical to the one above, except that it loads the meshes of nodes that don't refer to skins
-// In other words, it loads static meshes
-std::vector<StaticMesh> LoadStaticMeshes(cgltf_data* data)
+// The meshes are decoded like the ones of LoadStaticMeshData, and only their buffers are loaded here
+std::vector<StaticMesh> LoadStaticMeshes(cgltf_data* data, const char* meshCacheDir, const StaticMesh::VertexFormat& vertexFormat)
+{
+   std::vector<StaticMesh> staticMeshes = LoadStaticMeshData(data, meshCacheDir, NodeTransforms::Instanced);
+
+   size_t numInstances = 0;
+   for (StaticMesh& mesh : staticMeshes)
+   {
+      numInstances += mesh.GetInstanceMatrices().size();
+
+      // TODO: Perhaps we shouldn't do this here. The user should choose when this is done
+      // Once we are done loading the current mesh, we load its VBOs with the data that we read
+      mesh.SetVertexFormat(vertexFormat);
+      mesh.LoadBuffers();
+   }
+
+   std::cout << "Loaded " << staticMeshes.size() << " static meshes with " << numInstances << " instances" << '\n';
+
+   return staticMeshes;
+}
+
+std::vector<StaticMesh> LoadStaticMeshData(cgltf_data* data, const char* meshCacheDir, NodeTransforms nodeTransforms)
+{
+   std::vector<std::vector<StaticMesh>> staticMeshes = LoadStaticMeshData(std::vector<cgltf_data*>{ data }, meshCacheDir, { nodeTransforms });
+   return std::move(staticMeshes[0]);
+}
+
+std::vector<std::vector<StaticMesh>> LoadStaticMeshData(const std::vector<cgltf_data*>& files, const char* meshCacheDir, const std::vector<NodeTransforms>& nodeTransforms)
+{
+   std::vector<std::vector<StaticMesh>>   staticMeshes(files.size());
+   std::vector<GLTFHelpers::PrimitiveJob> jobs;
+
+   for (size_t fileIndex = 0; fileIndex < files.size(); ++fileIndex)
+   {
+      if (files[fileIndex] != nullptr)
+      {
+         NodeTransforms fileNodeTransforms = fileIndex < nodeTransforms.size() ? nodeTransforms[fileIndex] : NodeTransforms::Baked;
+         GLTFHelpers::AddPrimitiveJobs(*files[fileIndex], fileNodeTransforms, staticMeshes[fileIndex], jobs);
+      }
+   }
+
+   GLTFHelpers::DecodePrimitives(jobs, files.size(), meshCacheDir);
+
+   return staticMeshes;
+}
+
+Transform LoadRootTransform(cgltf_data* data)
+{
+   const cgltf_scene* scene = data->scene != nullptr ? data->scene : (data->scenes_count > 0 ? &data->scenes[0] : nullptr);
+   if (scene == nullptr || scene->nodes_count == 0)
+   {
+      return Transform();
+   }
+
+   // A root node has no parent, so its local transform is its world transform
+   return GLTFHelpers::GetLocalTransform(*scene->nodes[0]);
+}
+
+Pose LoadRestPose(cgltf_data* data)
+{
+   unsigned int numNodes = static_cast<unsigned int>(data->nodes_count);
+   Pose restPose(numNodes);
+
+   for (unsigned int nodeIndex = 0; nodeIndex < numNodes; ++nodeIndex)
+   {
+      cgltf_node* currNode = &data->nodes[nodeIndex];
+      restPose.SetLocalTransform(nodeIndex, GLTFHelpers::GetLocalTransform(*currNode));
+      restPose.SetParent(nodeIndex, GLTFHelpers::GetNodeIndex(currNode->parent, *data));
+   }
+
+   return restPose;
+}
+
+std::vector<std::string> LoadJointNames(cgltf_data* data)
+{
+   unsigned int numNodes = static_cast<unsigned int>(data->nodes_count);
+   std::vector<std::string> jointNames(numNodes, "EMPTY NODE");
+
+   for (unsigned int nodeIndex = 0; nodeIndex < numNodes; ++nodeIndex)
+   {
+      cgltf_node* currNode = &data->nodes[nodeIndex];
+      if (currNode->name)
+      {
+         jointNames[nodeIndex] = currNode->name;
+      }
+   }
+
+   return jointNames;
+}
+
+Skeleton LoadSkeleton(cgltf_data* data)
 {
-   std::vector<StaticMesh> staticMeshes;
+   Pose restPose = LoadRestPose(data);
+   unsigned int numJoints = restPose.GetNumJoints();
+
+   // Joints that aren't used by any skin are bound at their rest pose
+   std::vector<glm::mat4> inverseBindMatrices(numJoints);
+   for (unsigned int jointIndex = 0; jointIndex < numJoints; ++jointIndex)
+   {
+      inverseBindMatrices[jointIndex] = glm::inverse(transformToMat4(restPose.GetGlobalTransform(jointIndex)));
+   }
+
+   // The inverse bind matrices of a skin are stored in the same order as its joints
+   std::vector<float> matrixFloats;
+   for (cgltf_size skinIndex = 0; skinIndex < data->skins_count; ++skinIndex)
+   {
+      cgltf_skin* currSkin = &data->skins[skinIndex];
+      if (currSkin->inverse_bind_matrices == nullptr)
+      {
+         continue;
+      }
+
+      GLTFHelpers::GetFloatsFromAccessor(*currSkin->inverse_bind_matrices, 16, matrixFloats);
+      cgltf_size numMatrices = std::min<cgltf_size>(currSkin->joints_count, matrixFloats.size() / 16);
+      for (cgltf_size i = 0; i < numMatrices; ++i)
+      {
+         int jointIndex = GLTFHelpers::GetNodeIndex(currSkin->joints[i], *data);
+         if (jointIndex < 0)
+         {
+            std::cout << "Error - LoadSkeleton - Joint " << i << " of skin " << skinIndex << " isn't a node" << '\n';
+            continue;
+         }
+
+         inverseBindMatrices[jointIndex] = glm::make_mat4(&matrixFloats[i * 16]);
+      }
+   }
+
+   return Skeleton(restPose, inverseBindMatrices, LoadJointNames(data));
+}
+
+std::vector<Clip> LoadAnimationClips(cgltf_data* data)
+{
+   unsigned int numClips = static_cast<unsigned int>(data->animations_count);
+   std::vector<Clip> clips(numClips);
+
+   for (unsigned int clipIndex = 0; clipIndex < numClips; ++clipIndex)
+   {
+      cgltf_animation* currAnimation = &data->animations[clipIndex];
+      if (currAnimation->name)
+      {
+         clips[clipIndex].SetName(currAnimation->name);
+      }
+
+      // Each channel animates one property of one node
+      unsigned int numChannels = static_cast<unsigned int>(currAnimation->channels_count);
+      for (unsigned int channelIndex = 0; channelIndex < numChannels; ++channelIndex)
+      {
+         cgltf_animation_channel& channel = currAnimation->channels[channelIndex];
+         int nodeIndex = GLTFHelpers::GetNodeIndex(channel.target_node, *data);
+         if (nodeIndex < 0)
+         {
+            continue;
+         }
+
+         TransformTrack& track = clips[clipIndex].GetTransformTrackOfJoint(nodeIndex);
+         switch (channel.target_path)
+         {
+         case cgltf_animation_path_type_translation:
+            GLTFHelpers::TrackFromChannel(channel, track.position);
+            break;
+         case cgltf_animation_path_type_rotation:
+            GLTFHelpers::TrackFromChannel(channel, track.rotation);
+            break;
+         case cgltf_animation_path_type_scale:
+            GLTFHelpers::TrackFromChannel(channel, track.scale);
+            break;
+         case cgltf_animation_path_type_invalid:
+         case cgltf_animation_path_type_weights:
+            // Clips only animate transforms, so meshes with morph targets keep their default weights
+            break;
+         }
+      }
+
+      clips[clipIndex].RecalculateDuration();
+   }
+
+   return clips;
+}
+
+void LoadSkinnedMeshes(cgltf_data* data,
+                       std::vector<wabc::IMeshPtr>& outBindPoseMeshes,
+                       std::vector<wabc::ISkinPtr>& outSkins)
+{
+   size_t numJoints = data->nodes_count;
+
+   std::vector<wabc::float3>      points;
+   std::vector<wabc::float3>      normals;
+   std::vector<int>               indices;
+   std::vector<int>               counts;
+   std::vector<wabc::JointWeight> weights;
+   std::vector<float>             jointFloats;
+   std::vector<float>             weightFloats;
+   std::vector<float>             attributeFloats;
 
    // Loop over the array of nodes of the glTF file
    unsigned int numNodes = static_cast<unsigned int>(data->nodes_count);
    for (unsigned int nodeIndex = 0; nodeIndex < numNodes; ++nodeIndex)
    {
-      // This function only loads static meshes, so the node must contain a mesh for us to process it
+      // This function only loads skinned meshes, so the node must contain a mesh and a skin for us to process it
       cgltf_node* currNode = &data->nodes[nodeIndex];
-      if (currNode->mesh == nullptr)
+      if (currNode->mesh == nullptr || currNode->skin == nullptr)
       {
          continue;
       }
 
-      // Loop over the array of mesh primitives of the current node
+      cgltf_skin* currSkin = currNode->skin;
+
       unsigned int numPrimitives = static_cast<unsigned int>(currNode->mesh->primitives_count);
       for (unsigned int primitiveIndex = 0; primitiveIndex < numPrimitives; ++primitiveIndex)
       {
-         // Get the current mesh primitive
          cgltf_primitive* currPrimitive = &currNode->mesh->primitives[primitiveIndex];
 
-         // Create a StaticMesh for the current mesh primitive
-         staticMeshes.push_back(StaticMesh());
-         StaticMesh& currMesh = staticMeshes[staticMeshes.size() - 1];
+         points.clear();
+         normals.clear();
+         jointFloats.clear();
+         weightFloats.clear();
 
-         // Loop over the attributes of the current mesh primitive
          unsigned int numAttributes = static_cast<unsigned int>(currPrimitive->attributes_count);
          for (unsigned int attributeIndex = 0; attributeIndex < numAttributes; ++attributeIndex)
          {
-            // Get the current attribute
             cgltf_attribute* attribute = &currPrimitive->attributes[attributeIndex];
-            // Read the values of the current attribute and store them in the current mesh
-            GLTFHelpers::StoreValuesOfAttributeInStaticMesh(*attribute, currMesh);
+            switch (attribute->type)
+            {
+            case cgltf_attribute_type_position:
+            case cgltf_attribute_type_normal:
+            {
+               GLTFHelpers::GetFloatsFromAccessor(*attribute->data, 3, attributeFloats);
+               std::vector<wabc::float3>& values = attribute->type == cgltf_attribute_type_position ? points : normals;
+               values.resize(attribute->data->count);
+               memcpy(values.data(), attributeFloats.data(), values.size() * sizeof(wabc::float3));
+            }
+            break;
+            case cgltf_attribute_type_joints:
+               // Only the first set of joints and weights is used
+               if (attribute->index == 0)
+               {
+                  GLTFHelpers::GetFloatsFromAccessor(*attribute->data, 4, jointFloats);
+               }
+               break;
+            case cgltf_attribute_type_weights:
+               if (attribute->index == 0)
+               {
+                  GLTFHelpers::GetFloatsFromAccessor(*attribute->data, 4, weightFloats);
+               }
+               break;
+            default:
+               break;
+            }
          }
 
-         // If the current mesh primitive has a set of indices, store them too
-         if (currPrimitive->indices != nullptr)
+         size_t numVertices = points.size();
+         if (jointFloats.size() != numVertices * 4 || weightFloats.size() != numVertices * 4)
          {
-            unsigned int indexCount = static_cast<unsigned int>(currPrimitive->indices->count);
+            std::cout << "Error - LoadSkinnedMeshes - The mesh of node " << nodeIndex << " doesn't have one set of joints and weights per vertex" << '\n';
+            continue;
+         }
 
-            // Get the vector that will store the indices of the current mesh
-            std::vector<unsigned int>& indices = currMesh.GetIndices();
-            indices.resize(indexCount);
+         // The joint indices of the vertices refer to the joints of the skin, and they are converted to node indices here
+         // Influences with a weight of zero are skipped
+         counts.assign(numVertices, 0);
+         weights.clear();
+         for (size_t vertexIndex = 0; vertexIndex < numVertices; ++vertexIndex)
+         {
+            for (int i = 0; i < 4; ++i)
+            {
+               float weight = weightFloats[vertexIndex * 4 + i];
+               if (weight <= 0.0f)
+               {
+                  continue;
+               }
+
+               cgltf_size skinJoint = static_cast<cgltf_size>(jointFloats[vertexIndex * 4 + i]);
+               if (skinJoint >= currSkin->joints_count)
+               {
+                  continue;
+               }
 
-            // Loop over the indices of the current mesh primitive
-            for (unsigned int i = 0; i < indexCount; ++i)
+               weights.push_back({ GLTFHelpers::GetNodeIndex(currSkin->joints[skinJoint], *data), weight });
+               ++counts[vertexIndex];
+            }
+         }
+
+         // Primitives without indices are lists of triangles
+         if (currPrimitive->indices != nullptr)
+         {
+            indices.resize(currPrimitive->indices->count);
+            for (size_t i = 0; i < indices.size(); ++i)
             {
-               indices[i] = static_cast<unsigned int>(cgltf_accessor_read_index(currPrimitive->indices, i));
+               indices[i] = static_cast<int>(cgltf_accessor_read_index(currPrimitive->indices, i));
+            }
+         }
+         else
+         {
+            indices.resize(numVertices);
+            for (size_t i = 0; i < indices.size(); ++i)
+            {
+               indices[i] = static_cast<int>(i);
             }
          }
 
-         // TODO: Perhaps we shouldn't do this here. The user should choose when this is done
-         // Once we are done loading the current mesh, we load its VBOs with the data that we read
-         currMesh.LoadBuffers();
+         outBindPoseMeshes.push_back(wabc::CreateMesh(sfbx::make_span(points), sfbx::make_span(normals), sfbx::make_span(indices)));
+         outSkins.push_back(wabc::CreateSkin(sfbx::make_span(counts), sfbx::make_span(weights), numJoints));
       }
    }
-
-   return staticMeshes;
 }
@@ -0,0 +1,274 @@
+#ifdef __EMSCRIPTEN__
+#include <GLES3/gl3.h>
+#else
+#include "glad/glad.h"
+#endif
+
+#include <algorithm>
+#include <iostream>
+
+#include "GPUHeap.h"
+#include "sfbxAllocator.h"
+
+unsigned int GPUHeap::sGeneration = 0;
+
+float GPUHeap::Stats::GetUtilization() const
+{
+   return (capacity > 0) ? static_cast<float>(used) / static_cast<float>(capacity) : 0.0f;
+}
+
+float GPUHeap::Stats::GetFragmentation() const
+{
+   size_t freeBytes = capacity - used;
+   return (freeBytes > 0) ? 1.0f - static_cast<float>(pageLargestFreeBlocks) / static_cast<float>(freeBytes) : 0.0f;
+}
+
+// The pages use the default allocator of sfbx, which is constructed first so that it outlives the heaps
+GPUHeap& GPUHeap::Vertices()
+{
+   sfbx::GetDefaultAllocator();
+   static GPUHeap heap(GL_ARRAY_BUFFER, 8 * 1024 * 1024);
+   return heap;
+}
+
+GPUHeap& GPUHeap::Indices()
+{
+   sfbx::GetDefaultAllocator();
+   static GPUHeap heap(GL_ELEMENT_ARRAY_BUFFER, 4 * 1024 * 1024);
+   return heap;
+}
+
+GPUHeap::GPUHeap(unsigned int target, size_t pageSize)
+   : mTarget(target)
+   , mPageSize(pageSize)
+{
+
+}
+
+GPUHeap::Handle GPUHeap::Allocate(size_t size)
+{
+   if (size == 0)
+   {
+      return kInvalidHandle;
+   }
+
+   uint32_t units = static_cast<uint32_t>((size + kGranularity - 1) / kGranularity);
+
+   // First fit among the pages, then a new page
+   Allocation allocation;
+   allocation.size = size;
+   allocation.page = static_cast<unsigned int>(mPages.size());
+   for (unsigned int pageIndex = 0; pageIndex < mPages.size(); ++pageIndex)
+   {
+      if (mPages[pageIndex].buffer != 0)
+      {
+         allocation.range = mPages[pageIndex].allocator.allocate(units);
+         if (allocation.range.valid())
+         {
+            allocation.page = pageIndex;
+            break;
+         }
+      }
+   }
+
+   if (!allocation.range.valid())
+   {
+      allocation.page  = CreatePage(std::max(mPageSize, static_cast<size_t>(units) * kGranularity));
+      allocation.range = mPages[allocation.page].allocator.allocate(units);
+      if (!allocation.range.valid())
+      {
+         std::cout << "Error - GPUHeap::Allocate - Could not allocate " << size << " bytes" << '\n';
+         DeletePage(allocation.page);
+         return kInvalidHandle;
+      }
+   }
+
+   Handle handle;
+   if (!mFreeHandles.empty())
+   {
+      handle = mFreeHandles.back();
+      mFreeHandles.pop_back();
+      mAllocations[handle] = allocation;
+   }
+   else
+   {
+      handle = static_cast<Handle>(mAllocations.size());
+      mAllocations.push_back(allocation);
+   }
+
+   return handle;
+}
+
+void GPUHeap::Free(Handle handle)
+{
+   if (handle == kInvalidHandle || handle >= mAllocations.size() || mAllocations[handle].size == 0)
+   {
+      return;
+   }
+
+   Allocation& allocation = mAllocations[handle];
+   Page&       page       = mPages[allocation.page];
+   page.allocator.free(allocation.range);
+
+   if (page.allocator.storageReport().num_allocations == 0)
+   {
+      DeletePage(allocation.page);
+   }
+
+   allocation.size = 0;
+   mFreeHandles.push_back(handle);
+}
+
+// The copy write target is used so that the element array buffer binding of the current VAO isn't changed
+void GPUHeap::Upload(Handle handle, const void* data, size_t size, size_t offset)
+{
+   if (handle == kInvalidHandle || size == 0)
+   {
+      return;
+   }
+
+   glBindBuffer(GL_COPY_WRITE_BUFFER, GetBuffer(handle));
+   glBufferSubData(GL_COPY_WRITE_BUFFER, GetOffset(handle) + offset, size, data);
+   glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+unsigned int GPUHeap::GetBuffer(Handle handle) const
+{
+   return (handle != kInvalidHandle) ? mPages[mAllocations[handle].page].buffer : 0;
+}
+
+size_t GPUHeap::GetOffset(Handle handle) const
+{
+   return (handle != kInvalidHandle) ? static_cast<size_t>(mAllocations[handle].range.offset) * kGranularity : 0;
+}
+
+size_t GPUHeap::GetSize(Handle handle) const
+{
+   return (handle != kInvalidHandle) ? mAllocations[handle].size : 0;
+}
+
+size_t GPUHeap::Defragment()
+{
+   size_t movedBytes = 0;
+
+   for (unsigned int pageIndex = 0; pageIndex < mPages.size(); ++pageIndex)
+   {
+      Page& page = mPages[pageIndex];
+      if (page.buffer == 0 || page.allocator.storageReport().num_free_blocks <= 1)
+      {
+         continue;
+      }
+
+      // The allocations of the page, in the order in which they are in the buffer
+      std::vector<Handle> handles;
+      for (Handle handle = 0; handle < mAllocations.size(); ++handle)
+      {
+         if (mAllocations[handle].size > 0 && mAllocations[handle].page == pageIndex)
+         {
+            handles.push_back(handle);
+         }
+      }
+      std::sort(handles.begin(), handles.end(), [this](Handle a, Handle b) {
+         return mAllocations[a].range.offset < mAllocations[b].range.offset;
+      });
+
+      // Allocating them again from an empty allocator packs them one after another
+      unsigned int newBuffer = CreateBuffer(page.size);
+      glBindBuffer(GL_COPY_WRITE_BUFFER, newBuffer);
+      glBindBuffer(GL_COPY_READ_BUFFER, page.buffer);
+
+      page.allocator.reset(static_cast<uint32_t>(page.size / kGranularity));
+      for (Handle handle : handles)
+      {
+         Allocation& allocation = mAllocations[handle];
+         size_t      oldOffset  = GetOffset(handle);
+         uint32_t    units      = static_cast<uint32_t>((allocation.size + kGranularity - 1) / kGranularity);
+
+         allocation.range = page.allocator.allocate(units);
+         glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, oldOffset, GetOffset(handle), allocation.size);
+         movedBytes += allocation.size;
+      }
+
+      glBindBuffer(GL_COPY_READ_BUFFER, 0);
+      glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+      glDeleteBuffers(1, &page.buffer);
+      page.buffer = newBuffer;
+   }
+
+   if (movedBytes > 0)
+   {
+      ++sGeneration;
+   }
+
+   return movedBytes;
+}
+
+GPUHeap::Stats GPUHeap::GetStats() const
+{
+   Stats stats;
+   for (const Page& page : mPages)
+   {
+      if (page.buffer == 0)
+      {
+         continue;
+      }
+
+      wabc::OffsetAllocator::StorageReport report = page.allocator.storageReport();
+      stats.capacity              += page.size;
+      stats.used                  += page.size - static_cast<size_t>(report.total_free) * kGranularity;
+      stats.largestFreeBlock       = std::max(stats.largestFreeBlock, static_cast<size_t>(report.largest_free) * kGranularity);
+      stats.pageLargestFreeBlocks += static_cast<size_t>(report.largest_free) * kGranularity;
+      stats.numFreeBlocks         += report.num_free_blocks;
+      stats.numAllocations        += report.num_allocations;
+      ++stats.numPages;
+   }
+   return stats;
+}
+
+unsigned int GPUHeap::CreatePage(size_t size)
+{
+   size = (size + kGranularity - 1) / kGranularity * kGranularity;
+
+   unsigned int pageIndex = static_cast<unsigned int>(mPages.size());
+   for (unsigned int i = 0; i < mPages.size(); ++i)
+   {
+      if (mPages[i].buffer == 0)
+      {
+         pageIndex = i;
+         break;
+      }
+   }
+   if (pageIndex == mPages.size())
+   {
+      mPages.push_back(Page());
+   }
+
+   Page& page = mPages[pageIndex];
+   page.size   = size;
+   page.buffer = CreateBuffer(size);
+   page.allocator.reset(static_cast<uint32_t>(size / kGranularity));
+
+   return pageIndex;
+}
+
+// WebGL2 fixes the type of a buffer the first time it's bound, so the buffers are created with the target of the heap
+// The VAO is unbound first, since binding an element array buffer would change it
+unsigned int GPUHeap::CreateBuffer(size_t size)
+{
+   unsigned int buffer;
+   glBindVertexArray(0);
+   glGenBuffers(1, &buffer);
+   glBindBuffer(mTarget, buffer);
+   glBufferData(mTarget, size, nullptr, GL_STATIC_DRAW);
+   glBindBuffer(mTarget, 0);
+   return buffer;
+}
+
+void GPUHeap::DeletePage(unsigned int pageIndex)
+{
+   Page& page = mPages[pageIndex];
+   glDeleteBuffers(1, &page.buffer);
+   page.buffer = 0;
+   page.size   = 0;
+   page.allocator.reset(0);
+}
@@ -2,6 +2,7 @@
 
 #include "Game.h"
 #include "PlayState.h"
+#include "FrameArena.h"
 
 Game::Game()
    : mWindow()
@@ -44,6 +45,9 @@ void Game::executeGameLoop()
    static double simulationTimeSeconds = 0.0;
    static float fixedDelta = 1.0f / 60.0f;
 
+   // Transient allocations of the previous frame are released all at once
+   wabc::BeginFrame();
+
    double currentFrame = glfwGetTime();
    float deltaTime     = static_cast<float>(currentFrame - lastFrame);
    lastFrame           = currentFrame;
@@ -79,6 +83,9 @@ void Game::executeGameLoop()
 
    while (!mWindow->shouldClose())
    {
+      // Transient allocations of the previous frame are released all at once
+      wabc::BeginFrame();
+
       currentFrame = glfwGetTime();
       deltaTime    = static_cast<float>(currentFrame - lastFrame);
       lastFrame    = currentFrame;
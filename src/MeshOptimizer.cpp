@@ -0,0 +1,559 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <string>
+#include <thread>
+
+#ifdef _WIN32
+    #include <direct.h>
+#else
+    #include <sys/stat.h>
+#endif
+
+#include "pch.h"
+#include "MeshOptimizer.h"
+
+namespace wabc {
+
+namespace {
+
+const unsigned int kInvalidIndex = ~0u;
+
+// bump when the output of the passes changes, so that old cache files are ignored
+const uint32_t kCacheMagic = 0x434f4d57; // "WMOC"
+const uint32_t kCacheVersion = 1;
+
+// triangles around each vertex, in compressed sparse rows
+struct TriangleAdjacency
+{
+    RawVector<unsigned int> offsets;
+    RawVector<unsigned int> triangles;
+
+    void build(span<unsigned int> indices, size_t num_vertices)
+    {
+        size_t num_triangles = indices.size() / 3;
+        offsets.resize(num_vertices + 1);
+        offsets.zeroclear();
+        for (size_t i = 0; i < num_triangles * 3; ++i)
+            ++offsets[indices[i] + 1];
+        for (size_t v = 0; v < num_vertices; ++v)
+            offsets[v + 1] += offsets[v];
+
+        RawVector<unsigned int> cursor;
+        cursor.assign(offsets.data(), num_vertices);
+        triangles.resize(num_triangles * 3);
+        for (size_t t = 0; t < num_triangles; ++t) {
+            for (int c = 0; c < 3; ++c)
+                triangles[cursor[indices[t * 3 + c]]++] = (unsigned int)t;
+        }
+    }
+
+    span<unsigned int> get(unsigned int v) const
+    {
+        return make_span(triangles.data() + offsets[v], offsets[v + 1] - offsets[v]);
+    }
+};
+
+// fifo cache simulated with timestamps: a vertex is in the cache if it was added less than cache_size misses ago
+struct CacheSimulation
+{
+    RawVector<unsigned int> cache_time;
+    unsigned int timestamp = 0;
+    int cache_size = kVertexCacheSize;
+
+    void reset(size_t num_vertices, int size)
+    {
+        cache_size = size;
+        cache_time.resize(num_vertices);
+        cache_time.zeroclear();
+        timestamp = cache_size + 1;
+    }
+
+    // starts over with an empty cache
+    void flush() { timestamp += cache_size + 1; }
+
+    bool hit(unsigned int v) const { return timestamp - cache_time[v] <= (unsigned int)cache_size; }
+
+    // returns the number of misses
+    int add(const unsigned int* tri)
+    {
+        int misses = 0;
+        for (int c = 0; c < 3; ++c) {
+            if (!hit(tri[c])) {
+                cache_time[tri[c]] = timestamp++;
+                ++misses;
+            }
+        }
+        return misses;
+    }
+};
+
+uint64_t Hash(const void* data, size_t size, uint64_t h)
+{
+    // fnv-1a
+    const uint8_t* p = (const uint8_t*)data;
+    for (size_t i = 0; i < size; ++i) {
+        h ^= p[i];
+        h *= 0x100000001b3ull;
+    }
+    return h;
+}
+
+void MakeDirectory(const char* path)
+{
+#ifdef _WIN32
+    _mkdir(path);
+#else
+    mkdir(path, 0755);
+#endif
+}
+
+// a file next to path that no other writer uses. identical meshes hash to the same cache entry, and the jobs that
+// optimize them in parallel would otherwise write into the same file at the same time.
+std::string MakeTempPath(const std::string& path)
+{
+    static std::atomic<unsigned int> s_counter{ 0 };
+    unsigned int counter = s_counter++;
+    size_t thread_id = std::hash<std::thread::id>()(std::this_thread::get_id());
+    long long now = (long long)std::chrono::steady_clock::now().time_since_epoch().count();
+
+    uint64_t h = 0xcbf29ce484222325ull;
+    h = Hash(&counter, sizeof(counter), h);
+    h = Hash(&thread_id, sizeof(thread_id), h);
+    h = Hash(&now, sizeof(now), h);
+    char suffix[32];
+    snprintf(suffix, sizeof(suffix), ".%016llx.tmp", (unsigned long long)h);
+    return path + suffix;
+}
+
+// the indices must refer to vertices, and remap must be a permutation of them, or RemapVertices() would write out of
+// bounds or lose vertices.
+bool IsValidOptimization(span<unsigned int> indices, span<unsigned int> remap)
+{
+    size_t num_vertices = remap.size();
+    for (unsigned int i : indices) {
+        if (i >= num_vertices)
+            return false;
+    }
+
+    RawVector<char> used(num_vertices);
+    used.zeroclear();
+    for (unsigned int r : remap) {
+        if (r >= num_vertices || used[r])
+            return false;
+        used[r] = 1;
+    }
+    return true;
+}
+
+} // namespace
+
+VertexCacheStats AnalyzeVertexCache(span<unsigned int> indices, size_t num_vertices, int cache_size)
+{
+    VertexCacheStats ret;
+    size_t num_triangles = indices.size() / 3;
+    if (num_triangles == 0)
+        return ret;
+
+    CacheSimulation cache;
+    cache.reset(num_vertices, cache_size);
+    RawVector<bool> used;
+    used.resize(num_vertices);
+    used.zeroclear();
+
+    size_t misses = 0, num_used = 0;
+    for (size_t t = 0; t < num_triangles; ++t) {
+        misses += cache.add(&indices[t * 3]);
+        for (int c = 0; c < 3; ++c) {
+            unsigned int v = indices[t * 3 + c];
+            if (!used[v]) {
+                used[v] = true;
+                ++num_used;
+            }
+        }
+    }
+    ret.acmr = (float)misses / (float)num_triangles;
+    ret.atvr = (float)misses / (float)num_used;
+    return ret;
+}
+
+// tipsify, from "Fast Triangle Reordering for Vertex Locality and Reduced Overdraw" (Sander, Nehab, Barczak 2007).
+// fans around a vertex, then moves to the vertex of the fan that will stay in the cache for its remaining triangles.
+void OptimizeVertexCache(span<unsigned int> dst, span<unsigned int> indices, size_t num_vertices,
+    RawVector<unsigned int>* clusters, int cache_size)
+{
+    size_t num_triangles = indices.size() / 3;
+    if (clusters)
+        clusters->clear();
+    if (num_triangles == 0)
+        return;
+
+    TriangleAdjacency adjacency;
+    adjacency.build(indices, num_vertices);
+
+    // triangles not emitted yet around each vertex
+    RawVector<unsigned int> live;
+    live.resize(num_vertices);
+    for (size_t v = 0; v < num_vertices; ++v)
+        live[v] = adjacency.offsets[v + 1] - adjacency.offsets[v];
+
+    RawVector<bool> emitted;
+    emitted.resize(num_triangles);
+    emitted.zeroclear();
+
+    CacheSimulation cache;
+    cache.reset(num_vertices, cache_size);
+
+    // vertices of emitted triangles that may still have live triangles
+    RawVector<unsigned int> dead_end;
+    dead_end.reserve(indices.size());
+    RawVector<unsigned int> candidates;
+
+    size_t num_emitted = 0;
+    unsigned int cursor = 0;
+    unsigned int current = indices[0];
+    bool new_cluster = true;
+
+    while (current != kInvalidIndex) {
+        if (new_cluster && clusters)
+            clusters->push_back((unsigned int)num_emitted);
+        new_cluster = false;
+
+        candidates.clear();
+        for (unsigned int t : adjacency.get(current)) {
+            if (emitted[t])
+                continue;
+            emitted[t] = true;
+
+            const unsigned int* tri = &indices[t * 3];
+            unsigned int* out = &dst[num_emitted * 3];
+            for (int c = 0; c < 3; ++c) {
+                out[c] = tri[c];
+                dead_end.push_back(tri[c]);
+                candidates.push_back(tri[c]);
+                --live[tri[c]];
+            }
+            cache.add(tri);
+            ++num_emitted;
+        }
+
+        // the candidate whose remaining triangles fit in the cache and that entered it the earliest
+        unsigned int best = kInvalidIndex;
+        int best_priority = -1;
+        for (unsigned int v : candidates) {
+            if (live[v] == 0)
+                continue;
+            int priority = 0;
+            unsigned int age = cache.timestamp - cache.cache_time[v];
+            if (age + 2 * live[v] <= (unsigned int)cache_size)
+                priority = (int)age;
+            if (priority > best_priority) {
+                best = v;
+                best_priority = priority;
+            }
+        }
+
+        if (best == kInvalidIndex) {
+            // dead end. continue with a recent vertex that still has triangles, or else with the next one in order.
+            // either way the cache locality is lost, which is where a new cluster starts.
+            while (!dead_end.empty() && best == kInvalidIndex) {
+                unsigned int v = dead_end.back();
+                dead_end.pop_back();
+                if (live[v] > 0)
+                    best = v;
+            }
+            while (best == kInvalidIndex && cursor < num_vertices) {
+                if (live[cursor] > 0)
+                    best = cursor;
+                ++cursor;
+            }
+            new_cluster = true;
+        }
+        current = best;
+    }
+}
+
+// the clusters of OptimizeVertexCache() are split further where the acmr of the split is within threshold of the
+// cluster's, then sorted so that the clusters that face away from the center of the mesh are drawn first.
+// same approach as the tipsify paper and meshoptimizer.
+void OptimizeOverdraw(span<unsigned int> dst, span<unsigned int> indices, span<unsigned int> clusters,
+    span<float3> positions, float threshold, int cache_size)
+{
+    size_t num_triangles = indices.size() / 3;
+    if (num_triangles == 0)
+        return;
+    size_t num_vertices = positions.size();
+
+    CacheSimulation cache;
+    cache.reset(num_vertices, cache_size);
+
+    // soft boundaries
+    RawVector<unsigned int> splits;
+    for (size_t ci = 0; ci < clusters.size(); ++ci) {
+        size_t begin = clusters[ci];
+        size_t end = ci + 1 < clusters.size() ? clusters[ci + 1] : num_triangles;
+        if (begin >= end)
+            continue;
+
+        cache.flush();
+        size_t cluster_misses = 0;
+        for (size_t t = begin; t < end; ++t)
+            cluster_misses += cache.add(&indices[t * 3]);
+        float cluster_threshold = threshold * (float)cluster_misses / (float)(end - begin);
+
+        cache.flush();
+        splits.push_back((unsigned int)begin);
+        size_t running_misses = 0, running_triangles = 0;
+        for (size_t t = begin; t < end; ++t) {
+            running_misses += cache.add(&indices[t * 3]);
+            ++running_triangles;
+            if (t + 1 < end && (float)running_misses / (float)running_triangles <= cluster_threshold) {
+                splits.push_back((unsigned int)(t + 1));
+                cache.flush();
+                running_misses = running_triangles = 0;
+            }
+        }
+    }
+    size_t num_clusters = splits.size();
+    splits.push_back((unsigned int)num_triangles);
+
+    // area weighted centroids and normals
+    float3 mesh_centroid = float3::zero();
+    float mesh_area = 0.0f;
+    RawVector<float3> centroids, normals;
+    centroids.resize(num_clusters);
+    normals.resize(num_clusters);
+    for (size_t ci = 0; ci < num_clusters; ++ci) {
+        float3 centroid = float3::zero(), normal = float3::zero();
+        float area = 0.0f;
+        for (size_t t = splits[ci]; t < splits[ci + 1]; ++t) {
+            const float3& p0 = positions[indices[t * 3 + 0]];
+            const float3& p1 = positions[indices[t * 3 + 1]];
+            const float3& p2 = positions[indices[t * 3 + 2]];
+            float3 n = cross(p1 - p0, p2 - p0);
+            float a = length(n);
+            centroid += (p0 + p1 + p2) * (a / 3.0f);
+            normal += n;
+            area += a;
+        }
+        centroids[ci] = area > 0.0f ? centroid / area : centroid;
+        float normal_length = length(normal);
+        normals[ci] = normal_length > 0.0f ? normal / normal_length : normal;
+        mesh_centroid += centroid;
+        mesh_area += area;
+    }
+    if (mesh_area > 0.0f)
+        mesh_centroid /= mesh_area;
+
+    RawVector<float> keys;
+    RawVector<unsigned int> order;
+    keys.resize(num_clusters);
+    order.resize(num_clusters);
+    for (size_t ci = 0; ci < num_clusters; ++ci) {
+        keys[ci] = dot(centroids[ci] - mesh_centroid, normals[ci]);
+        order[ci] = (unsigned int)ci;
+    }
+    std::stable_sort(order.begin(), order.end(), [&](unsigned int a, unsigned int b) { return keys[a] > keys[b]; });
+
+    size_t pos = 0;
+    for (unsigned int ci : order) {
+        size_t n = (splits[ci + 1] - splits[ci]) * 3;
+        std::copy_n(&indices[splits[ci] * 3], n, &dst[pos]);
+        pos += n;
+    }
+}
+
+size_t OptimizeVertexFetchRemap(span<unsigned int> remap, span<unsigned int> indices)
+{
+    std::fill(remap.begin(), remap.end(), kInvalidIndex);
+    unsigned int next = 0;
+    for (unsigned int v : indices) {
+        if (remap[v] == kInvalidIndex)
+            remap[v] = next++;
+    }
+    size_t num_used = next;
+    for (unsigned int& r : remap) {
+        if (r == kInvalidIndex)
+            r = next++;
+    }
+    return num_used;
+}
+
+void RemapIndices(span<unsigned int> indices, span<unsigned int> remap)
+{
+    for (unsigned int& i : indices)
+        i = remap[i];
+}
+
+bool SplitIndices16(RawVector<IndexRange>& dst, span<unsigned int> indices, size_t num_vertices)
+{
+    dst.clear();
+    size_t num_indices = indices.size() - indices.size() % 3;
+    if (num_indices == 0)
+        return true;
+    if (num_vertices <= kMaxIndices16) {
+        dst.push_back({ 0, num_indices, 0 });
+        return true;
+    }
+
+    size_t max_ranges = (num_vertices + kMaxIndices16 - 1) / kMaxIndices16 * 2;
+    IndexRange range;
+    unsigned int range_min = ~0u, range_max = 0;
+    for (size_t i = 0; i < num_indices; i += 3) {
+        unsigned int tri_min = std::min({ indices[i], indices[i + 1], indices[i + 2] });
+        unsigned int tri_max = std::max({ indices[i], indices[i + 1], indices[i + 2] });
+        if (tri_max - tri_min >= kMaxIndices16) {
+            dst.clear();
+            return false;
+        }
+
+        unsigned int new_min = std::min(range_min, tri_min);
+        unsigned int new_max = std::max(range_max, tri_max);
+        if (range.num_indices > 0 && new_max - new_min >= kMaxIndices16) {
+            range.base_vertex = range_min;
+            dst.push_back(range);
+            if (dst.size() >= max_ranges) {
+                dst.clear();
+                return false;
+            }
+
+            range.first_index = i;
+            range.num_indices = 0;
+            new_min = tri_min;
+            new_max = tri_max;
+        }
+        range_min = new_min;
+        range_max = new_max;
+        range.num_indices += 3;
+    }
+    range.base_vertex = range_min;
+    dst.push_back(range);
+    return true;
+}
+
+void ConvertIndices16(span<uint16_t> dst, span<unsigned int> indices, span<IndexRange> ranges)
+{
+    for (const IndexRange& range : ranges) {
+        for (size_t i = range.first_index; i < range.first_index + range.num_indices; ++i)
+            dst[i] = (uint16_t)(indices[i] - range.base_vertex);
+    }
+}
+
+bool MeshOptimization::optimize(span<unsigned int> src_indices, span<float3> positions, const char* cache_dir)
+{
+    from_cache = false;
+    size_t num_indices = src_indices.size();
+    size_t num_vertices = positions.size();
+    if (num_indices == 0 || num_indices % 3 != 0) {
+        printf("MeshOptimization::optimize(): not a triangle list\n");
+        return false;
+    }
+    for (unsigned int i : src_indices) {
+        if (i >= num_vertices) {
+            printf("MeshOptimization::optimize(): index out of range\n");
+            return false;
+        }
+    }
+
+    std::string path;
+    if (cache_dir) {
+        uint64_t h = 0xcbf29ce484222325ull;
+        h = Hash(&kCacheVersion, sizeof(kCacheVersion), h);
+        h = Hash(src_indices.data(), src_indices.size_bytes(), h);
+        h = Hash(positions.data(), positions.size_bytes(), h);
+        char name[32];
+        snprintf(name, sizeof(name), "/%016llx.wmoc", (unsigned long long)h);
+        path = std::string(cache_dir) + name;
+        if (load(path.c_str(), num_indices, num_vertices)) {
+            from_cache = true;
+            return true;
+        }
+    }
+
+    before = AnalyzeVertexCache(src_indices, num_vertices);
+
+    RawVector<unsigned int> cache_order, clusters;
+    cache_order.resize(num_indices);
+    OptimizeVertexCache(make_span(cache_order), src_indices, num_vertices, &clusters);
+
+    indices.resize(num_indices);
+    OptimizeOverdraw(make_span(indices), make_span(cache_order), make_span(clusters), positions);
+
+    remap.resize(num_vertices);
+    OptimizeVertexFetchRemap(make_span(remap), make_span(indices));
+    RemapIndices(make_span(indices), make_span(remap));
+
+    after = AnalyzeVertexCache(make_span(indices), num_vertices);
+
+    if (cache_dir) {
+        MakeDirectory(cache_dir);
+        save(path.c_str());
+    }
+    return true;
+}
+
+bool MeshOptimization::load(const char* path, size_t num_indices, size_t num_vertices)
+{
+    FILE* f = fopen(path, "rb");
+    if (!f)
+        return false;
+
+    // the file may be truncated or corrupted, so its size is checked before anything is allocated, and its data
+    // before it is used. the mesh is optimized again if either is wrong.
+    uint32_t header[4] = {};
+    size_t expected_size = sizeof(header) + sizeof(before) + sizeof(after) + (num_indices + num_vertices) * sizeof(unsigned int);
+    bool ok = fseek(f, 0, SEEK_END) == 0 && (size_t)ftell(f) == expected_size && fseek(f, 0, SEEK_SET) == 0 &&
+        fread(header, sizeof(header), 1, f) == 1 &&
+        header[0] == kCacheMagic && header[1] == kCacheVersion &&
+        header[2] == (uint32_t)num_indices && header[3] == (uint32_t)num_vertices;
+    if (ok) {
+        indices.resize(num_indices);
+        remap.resize(num_vertices);
+        ok = fread(&before, sizeof(before), 1, f) == 1 &&
+            fread(&after, sizeof(after), 1, f) == 1 &&
+            fread(indices.data(), indices.size_bytes(), 1, f) == 1 &&
+            fread(remap.data(), remap.size_bytes(), 1, f) == 1 &&
+            IsValidOptimization(make_span(indices), make_span(remap));
+    }
+    fclose(f);
+
+    if (!ok) {
+        printf("MeshOptimization::load(): %s is invalid, the mesh is optimized again\n", path);
+        indices.clear();
+        remap.clear();
+    }
+    return ok;
+}
+
+bool MeshOptimization::save(const char* path) const
+{
+    // the entry is written to a file of its own and then renamed into place, so that readers and the other writers of
+    // the same entry never see it half written
+    std::string tmp_path = MakeTempPath(path);
+    FILE* f = fopen(tmp_path.c_str(), "wb");
+    if (!f) {
+        printf("MeshOptimization::save(): failed to open %s\n", tmp_path.c_str());
+        return false;
+    }
+
+    uint32_t header[4] = { kCacheMagic, kCacheVersion, (uint32_t)indices.size(), (uint32_t)remap.size() };
+    bool ok = fwrite(header, sizeof(header), 1, f) == 1 &&
+        fwrite(&before, sizeof(before), 1, f) == 1 &&
+        fwrite(&after, sizeof(after), 1, f) == 1 &&
+        fwrite(indices.data(), indices.size_bytes(), 1, f) == 1 &&
+        fwrite(remap.data(), remap.size_bytes(), 1, f) == 1;
+    ok = fclose(f) == 0 && ok;
+
+    // rename() fails on windows if the entry exists, which only happens if another writer of the same content got
+    // there first
+    if (!ok || rename(tmp_path.c_str(), path) != 0) {
+        remove(tmp_path.c_str());
+        return false;
+    }
+    return true;
+}
+
+} // namespace wabc
@@ -0,0 +1,506 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "pch.h"
+#include "MeshoptDecoder.h"
+#include "CpuDispatch.h"
+
+#if defined(wabcEnableSSE) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+    #include <emmintrin.h>
+    #define wabcEnableMeshoptSSE2
+#endif
+
+namespace wabc {
+
+namespace {
+
+// vertex codec, version 0.
+// vertices are encoded in blocks. each byte of the vertex is a separate stream of zigzag deltas from the same byte of
+// the previous vertex, and each stream is stored in groups of 16 bytes of 0, 2, 4 or 8 bits.
+const uint8_t kVertexHeader = 0xa0;
+const size_t kVertexBlockSizeBytes = 8192;
+const size_t kVertexBlockMaxSize = 256;
+const size_t kByteGroupSize = 16;
+// the most bytes a group can use: a 4 bit group in which every value is an 8 bit exception
+const size_t kByteGroupDecodeLimit = 24;
+const size_t kTailMaxSize = 32;
+
+// index codecs, versions 0 and 1
+const uint8_t kIndexHeader = 0xe0;
+const uint8_t kSequenceHeader = 0xd0;
+
+size_t GetVertexBlockSize(size_t stride)
+{
+    // a block must fit in the scratch buffer, and it's truncated to whole byte groups
+    size_t result = kVertexBlockSizeBytes / stride;
+    result &= ~(kByteGroupSize - 1);
+    return result < kVertexBlockMaxSize ? result : kVertexBlockMaxSize;
+}
+
+inline uint8_t Unzigzag8(uint8_t v)
+{
+    return (uint8_t)(-(v & 1) ^ (v >> 1));
+}
+
+// values of 'bits' bits, most significant first. the ones with every bit set are exceptions whose byte follows the
+// packed values.
+template<int bits>
+const uint8_t* DecodeBitsGroup(const uint8_t* data, uint8_t* dst)
+{
+    const int per_byte = 8 / bits;
+    const uint8_t sentinel = (1 << bits) - 1;
+    const uint8_t* exceptions = data + kByteGroupSize * bits / 8;
+    for (size_t i = 0; i < kByteGroupSize; i += per_byte) {
+        uint8_t byte = *data++;
+        for (int j = 0; j < per_byte; ++j) {
+            uint8_t enc = byte >> (8 - bits);
+            byte <<= bits;
+            dst[i + j] = enc == sentinel ? *exceptions++ : enc;
+        }
+    }
+    return exceptions;
+}
+
+const uint8_t* DecodeBytesGroup(const uint8_t* data, uint8_t* dst, int bitslog2)
+{
+    switch (bitslog2) {
+    case 0:
+        memset(dst, 0, kByteGroupSize);
+        return data;
+    case 1:
+        return DecodeBitsGroup<2>(data, dst);
+    case 2:
+        return DecodeBitsGroup<4>(data, dst);
+    default:
+        memcpy(dst, data, kByteGroupSize);
+        return data + kByteGroupSize;
+    }
+}
+
+// size must be a multiple of kByteGroupSize. the 2 bit modes of the groups come first, 4 per byte
+const uint8_t* DecodeBytes(const uint8_t* data, const uint8_t* data_end, uint8_t* dst, size_t size)
+{
+    const uint8_t* header = data;
+    size_t header_size = (size / kByteGroupSize + 3) / 4;
+    if (size_t(data_end - data) < header_size)
+        return nullptr;
+    data += header_size;
+
+    for (size_t i = 0; i < size; i += kByteGroupSize) {
+        // the tail of the buffer is at least this large, so a malformed group can't read past the end
+        if (size_t(data_end - data) < kByteGroupDecodeLimit)
+            return nullptr;
+        size_t group = i / kByteGroupSize;
+        int bitslog2 = (header[group / 4] >> ((group % 4) * 2)) & 3;
+        data = DecodeBytesGroup(data, dst + i, bitslog2);
+    }
+    return data;
+}
+
+void UnzigzagDeltas(uint8_t* dst, const uint8_t* deltas, size_t count, size_t stride, uint8_t& last)
+{
+    uint8_t p = last;
+    for (size_t i = 0; i < count; ++i) {
+        p += Unzigzag8(deltas[i]);
+        dst[i * stride] = p;
+    }
+    last = p;
+}
+
+#ifdef wabcEnableMeshoptSSE2
+// the same for 4 consecutive bytes of the vertex at once. the streams are transposed so that each 32 bit lane holds
+// the 4 bytes of a vertex, and the deltas are summed over 4 vertices with 2 shifts.
+// count_aligned is a multiple of kByteGroupSize, and dst has room for count_aligned vertices.
+void UnzigzagDeltas4(uint8_t* dst, uint8_t (*deltas)[kVertexBlockMaxSize], size_t count_aligned, size_t stride, uint8_t* last)
+{
+    const __m128i one = _mm_set1_epi8(1);
+    const __m128i low7 = _mm_set1_epi8(0x7f);
+    uint32_t last4;
+    memcpy(&last4, last, 4);
+    __m128i p = _mm_set1_epi32((int)last4);
+
+    for (size_t i = 0; i < count_aligned; i += kByteGroupSize) {
+        __m128i r0 = _mm_loadu_si128((const __m128i*)&deltas[0][i]);
+        __m128i r1 = _mm_loadu_si128((const __m128i*)&deltas[1][i]);
+        __m128i r2 = _mm_loadu_si128((const __m128i*)&deltas[2][i]);
+        __m128i r3 = _mm_loadu_si128((const __m128i*)&deltas[3][i]);
+
+        __m128i t0 = _mm_unpacklo_epi8(r0, r1);
+        __m128i t1 = _mm_unpackhi_epi8(r0, r1);
+        __m128i t2 = _mm_unpacklo_epi8(r2, r3);
+        __m128i t3 = _mm_unpackhi_epi8(r2, r3);
+        __m128i v[4] = {
+            _mm_unpacklo_epi16(t0, t2),
+            _mm_unpackhi_epi16(t0, t2),
+            _mm_unpacklo_epi16(t1, t3),
+            _mm_unpackhi_epi16(t1, t3),
+        };
+
+        for (int j = 0; j < 4; ++j) {
+            __m128i x = v[j];
+            __m128i sign = _mm_sub_epi8(_mm_setzero_si128(), _mm_and_si128(x, one));
+            x = _mm_xor_si128(_mm_and_si128(_mm_srli_epi16(x, 1), low7), sign);
+            x = _mm_add_epi8(x, _mm_slli_si128(x, 4));
+            x = _mm_add_epi8(x, _mm_slli_si128(x, 8));
+            p = _mm_add_epi8(x, _mm_shuffle_epi32(p, 0xff));
+
+            uint8_t* out = dst + (i + j * 4) * stride;
+            uint32_t w[4];
+            _mm_storeu_si128((__m128i*)w, p);
+            memcpy(out, &w[0], 4);
+            memcpy(out + stride, &w[1], 4);
+            memcpy(out + stride * 2, &w[2], 4);
+            memcpy(out + stride * 3, &w[3], 4);
+        }
+    }
+}
+#endif
+
+const uint8_t* DecodeVertexBlock(const uint8_t* data, const uint8_t* data_end, uint8_t* dst, size_t count, size_t stride,
+    uint8_t* last_vertex, bool simd)
+{
+    uint8_t deltas[4][kVertexBlockMaxSize];
+    uint8_t transposed[kVertexBlockSizeBytes];
+    size_t count_aligned = (count + kByteGroupSize - 1) & ~(kByteGroupSize - 1);
+
+    for (size_t k = 0; k < stride; k += 4) {
+        for (size_t b = 0; b < 4; ++b) {
+            data = DecodeBytes(data, data_end, deltas[b], count_aligned);
+            if (!data)
+                return nullptr;
+        }
+
+#ifdef wabcEnableMeshoptSSE2
+        if (simd) {
+            UnzigzagDeltas4(transposed + k, deltas, count_aligned, stride, last_vertex + k);
+            continue;
+        }
+#endif
+        (void)simd;
+        for (size_t b = 0; b < 4; ++b)
+            UnzigzagDeltas(transposed + k + b, deltas[b], count, stride, last_vertex[k + b]);
+    }
+
+    memcpy(dst, transposed, count * stride);
+    memcpy(last_vertex, transposed + (count - 1) * stride, stride);
+    return data;
+}
+
+inline void WriteTriangle(void* dst, size_t offset, size_t index_size, unsigned int a, unsigned int b, unsigned int c)
+{
+    if (index_size == 2) {
+        uint16_t* d = (uint16_t*)dst + offset;
+        d[0] = (uint16_t)a;
+        d[1] = (uint16_t)b;
+        d[2] = (uint16_t)c;
+    }
+    else {
+        uint32_t* d = (uint32_t*)dst + offset;
+        d[0] = a;
+        d[1] = b;
+        d[2] = c;
+    }
+}
+
+// 7 bits per byte, least significant first, at most 5 bytes
+unsigned int DecodeVByte(const uint8_t*& data)
+{
+    uint8_t lead = *data++;
+    if (lead < 128)
+        return lead;
+
+    unsigned int result = lead & 127;
+    unsigned int shift = 7;
+    for (int i = 0; i < 4; ++i) {
+        uint8_t group = *data++;
+        result |= unsigned(group & 127) << shift;
+        shift += 7;
+        if (group < 128)
+            break;
+    }
+    return result;
+}
+
+// zigzag delta from the previous explicit index
+unsigned int DecodeIndex(const uint8_t*& data, unsigned int last)
+{
+    unsigned int v = DecodeVByte(data);
+    unsigned int d = (v >> 1) ^ (0u - (v & 1));
+    return last + d;
+}
+
+template<class T>
+void DecodeOctahedral(T* data, size_t count)
+{
+    const float max = float((1 << (sizeof(T) * 8 - 1)) - 1);
+    for (size_t i = 0; i < count; ++i) {
+        // z holds 1 at the same precision, so that x and y can be reconstructed from it
+        float x = float(data[i * 4 + 0]);
+        float y = float(data[i * 4 + 1]);
+        float z = float(data[i * 4 + 2]) - std::fabs(x) - std::fabs(y);
+
+        // the lower hemisphere is folded over the diagonals
+        float t = z >= 0.0f ? 0.0f : z;
+        x += x >= 0.0f ? t : -t;
+        y += y >= 0.0f ? t : -t;
+
+        float s = max / std::sqrt(x * x + y * y + z * z);
+        data[i * 4 + 0] = T(int(x * s + (x >= 0.0f ? 0.5f : -0.5f)));
+        data[i * 4 + 1] = T(int(y * s + (y >= 0.0f ? 0.5f : -0.5f)));
+        data[i * 4 + 2] = T(int(z * s + (z >= 0.0f ? 0.5f : -0.5f)));
+    }
+}
+
+void DecodeQuaternion(int16_t* data, size_t count)
+{
+    const float scale = 1.0f / std::sqrt(2.0f);
+    for (size_t i = 0; i < count; ++i) {
+        // the 4th component holds the scale of the others in its high bits and the index of the largest one in the low 2
+        int16_t* q = data + i * 4;
+        int sf = q[3] | 3;
+        float ss = scale / float(sf);
+
+        float x = float(q[0]) * ss;
+        float y = float(q[1]) * ss;
+        float z = float(q[2]) * ss;
+        float ww = 1.0f - x * x - y * y - z * z;
+        float w = std::sqrt(ww >= 0.0f ? ww : 0.0f);
+
+        int qc = q[3] & 3;
+        int xf = int(x * 32767.0f + (x >= 0.0f ? 0.5f : -0.5f));
+        int yf = int(y * 32767.0f + (y >= 0.0f ? 0.5f : -0.5f));
+        int zf = int(z * 32767.0f + (z >= 0.0f ? 0.5f : -0.5f));
+        int wf = int(w * 32767.0f + 0.5f);
+        q[(qc + 1) & 3] = int16_t(xf);
+        q[(qc + 2) & 3] = int16_t(yf);
+        q[(qc + 3) & 3] = int16_t(zf);
+        q[(qc + 0) & 3] = int16_t(wf);
+    }
+}
+
+void DecodeExponential(uint32_t* data, size_t count)
+{
+    for (size_t i = 0; i < count; ++i) {
+        // signed 24 bit mantissa and signed 8 bit exponent. ldexp(m, e), with the power of 2 built directly
+        uint32_t v = data[i];
+        int m = int(v << 8) >> 8;
+        int e = int(v) >> 24;
+        uint32_t bits = uint32_t(e + 127) << 23;
+        float f;
+        memcpy(&f, &bits, 4);
+        f *= float(m);
+        memcpy(&data[i], &f, 4);
+    }
+}
+
+} // namespace
+
+bool DecodeMeshoptVertices(void* dst, size_t count, size_t stride, const uint8_t* src, size_t src_size)
+{
+    if (stride == 0 || stride > 256 || stride % 4 != 0)
+        return false;
+
+    const uint8_t* data = src;
+    const uint8_t* data_end = src + src_size;
+    if (src_size < 1 + stride || (*data & 0xf0) != kVertexHeader || (*data & 0x0f) > 0)
+        return false;
+    ++data;
+
+    // the first vertex is predicted from the one at the end of the data
+    uint8_t last_vertex[256];
+    memcpy(last_vertex, data_end - stride, stride);
+
+    bool simd = GetSimdLevel() != SimdLevel::Scalar;
+    size_t block_size = GetVertexBlockSize(stride);
+    for (size_t offset = 0; offset < count; offset += block_size) {
+        size_t n = std::min(block_size, count - offset);
+        data = DecodeVertexBlock(data, data_end, (uint8_t*)dst + offset * stride, n, stride, last_vertex, simd);
+        if (!data)
+            return false;
+    }
+
+    size_t tail_size = stride < kTailMaxSize ? kTailMaxSize : stride;
+    return size_t(data_end - data) == tail_size;
+}
+
+// each triangle is a byte of code, with its free indices in the data that follows the codes. a triangle either shares
+// an edge with one of the last 16 triangles, or starts at the next new vertex. the other vertices are new, come from a
+// fifo of the last 16 vertices, or are explicit deltas from the previous explicit index.
+// the last 16 bytes are a table of the most common vertex fifo pairs for triangles that don't share an edge.
+bool DecodeMeshoptTriangles(void* dst, size_t count, size_t index_size, const uint8_t* src, size_t src_size)
+{
+    if (count % 3 != 0 || (index_size != 2 && index_size != 4))
+        return false;
+    if (src_size < 1 + count / 3 + 16 || (src[0] & 0xf0) != kIndexHeader)
+        return false;
+    int version = src[0] & 0x0f;
+    if (version > 1)
+        return false;
+
+    unsigned int edge_fifo[16][2];
+    unsigned int vertex_fifo[16];
+    memset(edge_fifo, -1, sizeof(edge_fifo));
+    memset(vertex_fifo, -1, sizeof(vertex_fifo));
+    size_t edge_offset = 0;
+    size_t vertex_offset = 0;
+    auto push_edge = [&](unsigned int a, unsigned int b) {
+        edge_fifo[edge_offset][0] = a;
+        edge_fifo[edge_offset][1] = b;
+        edge_offset = (edge_offset + 1) & 15;
+    };
+    auto push_vertex = [&](unsigned int v, bool cond = true) {
+        vertex_fifo[vertex_offset] = v;
+        vertex_offset = (vertex_offset + (cond ? 1 : 0)) & 15;
+    };
+
+    unsigned int next = 0;
+    unsigned int last = 0;
+    // version 1 uses fifo entries 13 and 14 for +1 and -1 from the previous explicit index
+    int fec_max = version >= 1 ? 13 : 15;
+
+    const uint8_t* code = src + 1;
+    const uint8_t* data = code + count / 3;
+    const uint8_t* data_safe_end = src + src_size - 16;
+    const uint8_t* codeaux_table = data_safe_end;
+
+    for (size_t i = 0; i < count; i += 3) {
+        // a triangle reads at most 16 bytes of data, which the table after data_safe_end makes room for
+        if (data > data_safe_end)
+            return false;
+
+        uint8_t codetri = *code++;
+        if (codetri < 0xf0) {
+            int fe = codetri >> 4;
+            unsigned int a = edge_fifo[(edge_offset - 1 - fe) & 15][0];
+            unsigned int b = edge_fifo[(edge_offset - 1 - fe) & 15][1];
+            int fec = codetri & 15;
+
+            unsigned int c;
+            if (fec < fec_max) {
+                bool is_new = fec == 0;
+                c = is_new ? next++ : vertex_fifo[(vertex_offset - 1 - fec) & 15];
+                push_vertex(c, is_new);
+            }
+            else {
+                // fec - (fec ^ 3) turns 13 and 14 into -1 and 1
+                last = c = fec != 15 ? last + (fec - (fec ^ 3)) : DecodeIndex(data, last);
+                push_vertex(c);
+            }
+            WriteTriangle(dst, i, index_size, a, b, c);
+            push_edge(c, b);
+            push_edge(a, c);
+        }
+        else if (codetri < 0xfe) {
+            // the first vertex is the next new one, and the others come from the table
+            uint8_t codeaux = codeaux_table[codetri & 15];
+            int feb = codeaux >> 4;
+            int fec = codeaux & 15;
+
+            unsigned int a = next++;
+            unsigned int b = feb == 0 ? next : vertex_fifo[(vertex_offset - feb) & 15];
+            next += feb == 0;
+            unsigned int c = fec == 0 ? next : vertex_fifo[(vertex_offset - fec) & 15];
+            next += fec == 0;
+
+            WriteTriangle(dst, i, index_size, a, b, c);
+            push_vertex(a);
+            push_vertex(b, feb == 0);
+            push_vertex(c, fec == 0);
+            push_edge(b, a);
+            push_edge(c, b);
+            push_edge(a, c);
+        }
+        else {
+            // the same with a byte of data instead of the table. 0xff makes the first vertex explicit too
+            uint8_t codeaux = *data++;
+            int fea = codetri == 0xfe ? 0 : 15;
+            int feb = codeaux >> 4;
+            int fec = codeaux & 15;
+
+            // a codeaux of 0 restarts the new vertices
+            if (codeaux == 0)
+                next = 0;
+
+            unsigned int a = fea == 0 ? next++ : 0;
+            unsigned int b = feb == 0 ? next++ : vertex_fifo[(vertex_offset - feb) & 15];
+            unsigned int c = fec == 0 ? next++ : vertex_fifo[(vertex_offset - fec) & 15];
+            if (fea == 15)
+                last = a = DecodeIndex(data, last);
+            if (feb == 15)
+                last = b = DecodeIndex(data, last);
+            if (fec == 15)
+                last = c = DecodeIndex(data, last);
+
+            WriteTriangle(dst, i, index_size, a, b, c);
+            push_vertex(a);
+            push_vertex(b, feb == 0 || feb == 15);
+            push_vertex(c, fec == 0 || fec == 15);
+            push_edge(b, a);
+            push_edge(c, b);
+            push_edge(a, c);
+        }
+    }
+
+    // all the data is read, up to the table
+    return data == data_safe_end;
+}
+
+// each index is a zigzag delta from one of two baselines, whose choice is the low bit of its vbyte
+bool DecodeMeshoptIndices(void* dst, size_t count, size_t index_size, const uint8_t* src, size_t src_size)
+{
+    if (index_size != 2 && index_size != 4)
+        return false;
+    if (src_size < 1 + count + 4 || (src[0] & 0xf0) != kSequenceHeader || (src[0] & 0x0f) > 1)
+        return false;
+
+    const uint8_t* data = src + 1;
+    const uint8_t* data_safe_end = src + src_size - 4;
+    unsigned int last[2] = {};
+    for (size_t i = 0; i < count; ++i) {
+        // an index reads at most 5 bytes, which the 4 byte tail makes room for
+        if (data >= data_safe_end)
+            return false;
+
+        unsigned int v = DecodeVByte(data);
+        unsigned int baseline = v & 1;
+        v >>= 1;
+        unsigned int index = last[baseline] + ((v >> 1) ^ (0u - (v & 1)));
+        last[baseline] = index;
+
+        if (index_size == 2)
+            ((uint16_t*)dst)[i] = (uint16_t)index;
+        else
+            ((uint32_t*)dst)[i] = index;
+    }
+    return data == data_safe_end;
+}
+
+bool ApplyMeshoptFilter(void* data, size_t count, size_t stride, MeshoptFilter filter)
+{
+    switch (filter) {
+    case MeshoptFilter::None:
+        return true;
+    case MeshoptFilter::Octahedral:
+        if (stride == 4)
+            DecodeOctahedral((int8_t*)data, count);
+        else if (stride == 8)
+            DecodeOctahedral((int16_t*)data, count);
+        else
+            return false;
+        return true;
+    case MeshoptFilter::Quaternion:
+        if (stride != 8)
+            return false;
+        DecodeQuaternion((int16_t*)data, count);
+        return true;
+    case MeshoptFilter::Exponential:
+        if (stride % 4 != 0)
+            return false;
+        DecodeExponential((uint32_t*)data, count * stride / 4);
+        return true;
+    }
+    return false;
+}
+
+} // namespace wabc
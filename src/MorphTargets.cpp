@@ -0,0 +1,181 @@
+#ifdef __EMSCRIPTEN__
+#include <GLES3/gl3.h>
+#else
+#include "glad/glad.h"
+#endif
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+#include "Shader.h"
+#include "MorphTargets.h"
+
+// Most meshes have no morph targets, so the texture is only created by LoadTexture
+MorphTargets::MorphTargets()
+   : mNumTargets(0)
+   , mNumVertices(0)
+   , mDeltasTex(0)
+{
+   mActiveTargets.reserve(kMaxActiveTargets);
+   mActiveWeights.reserve(kMaxActiveTargets);
+}
+
+MorphTargets::~MorphTargets()
+{
+   if (mDeltasTex != 0)
+   {
+      glDeleteTextures(1, &mDeltasTex);
+   }
+}
+
+MorphTargets::MorphTargets(MorphTargets&& rhs) noexcept
+   : mNumTargets(std::exchange(rhs.mNumTargets, 0))
+   , mNumVertices(std::exchange(rhs.mNumVertices, 0))
+   , mPositionDeltas(std::move(rhs.mPositionDeltas))
+   , mNormalDeltas(std::move(rhs.mNormalDeltas))
+   , mWeights(std::move(rhs.mWeights))
+   , mActiveTargets(std::move(rhs.mActiveTargets))
+   , mActiveWeights(std::move(rhs.mActiveWeights))
+   , mDeltasTex(std::exchange(rhs.mDeltasTex, 0))
+{
+
+}
+
+MorphTargets& MorphTargets::operator=(MorphTargets&& rhs) noexcept
+{
+   mNumTargets     = std::exchange(rhs.mNumTargets, 0);
+   mNumVertices    = std::exchange(rhs.mNumVertices, 0);
+   mPositionDeltas = std::move(rhs.mPositionDeltas);
+   mNormalDeltas   = std::move(rhs.mNormalDeltas);
+   mWeights        = std::move(rhs.mWeights);
+   mActiveTargets  = std::move(rhs.mActiveTargets);
+   mActiveWeights  = std::move(rhs.mActiveWeights);
+   mDeltasTex      = std::exchange(rhs.mDeltasTex, 0);
+   return *this;
+}
+
+void MorphTargets::SetNumTargets(unsigned int numTargets, unsigned int numVertices)
+{
+   mNumTargets  = numTargets;
+   mNumVertices = numVertices;
+
+   // Targets that don't provide normal deltas leave them at zero
+   mPositionDeltas.assign(numTargets * numVertices, glm::vec3(0.0f));
+   mNormalDeltas.assign(numTargets * numVertices, glm::vec3(0.0f));
+   mWeights.assign(numTargets, 0.0f);
+
+   mActiveTargets.clear();
+   mActiveWeights.clear();
+}
+
+bool MorphTargets::HasDeltas() const
+{
+   size_t numDeltas = static_cast<size_t>(mNumTargets) * mNumVertices;
+   return mPositionDeltas.size() == numDeltas && mNormalDeltas.size() == numDeltas;
+}
+
+void MorphTargets::LoadTexture()
+{
+   if (mNumTargets == 0 || mNumVertices == 0 || !HasDeltas())
+   {
+      return;
+   }
+
+   // Interleave the position and normal deltas so that the vertex shader can compute the texel of both from the same index
+   unsigned int numTexels = mNumTargets * mNumVertices * 2;
+   unsigned int height    = (numTexels + kTextureWidth - 1) / kTextureWidth;
+   std::vector<glm::vec4> texels(height * kTextureWidth, glm::vec4(0.0f));
+   for (unsigned int i = 0; i < mNumTargets * mNumVertices; ++i)
+   {
+      texels[i * 2]     = glm::vec4(mPositionDeltas[i], 0.0f);
+      texels[i * 2 + 1] = glm::vec4(mNormalDeltas[i], 0.0f);
+   }
+
+   if (mDeltasTex == 0)
+   {
+      glGenTextures(1, &mDeltasTex);
+   }
+
+   glBindTexture(GL_TEXTURE_2D, mDeltasTex);
+   glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, kTextureWidth, height, 0, GL_RGBA, GL_FLOAT, &texels[0]);
+   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+   glBindTexture(GL_TEXTURE_2D, 0);
+
+   // This data has already been passed to the GPU, so it's not necessary to store it anymore
+   mPositionDeltas.clear();
+   mNormalDeltas.clear();
+
+   // Apply the default weights
+   SetWeights(mWeights);
+}
+
+void MorphTargets::SetWeights(const std::vector<float>& weights)
+{
+   if (&weights != &mWeights)
+   {
+      mWeights.assign(weights.begin(), weights.end());
+      mWeights.resize(mNumTargets, 0.0f);
+   }
+
+   // Gather the targets that actually contribute
+   mActiveTargets.clear();
+   mActiveWeights.clear();
+   for (unsigned int i = 0; i < mNumTargets; ++i)
+   {
+      if (mWeights[i] != 0.0f)
+      {
+         mActiveTargets.push_back(static_cast<int>(i));
+      }
+   }
+
+   // Keep the ones with the largest weights if the vertex shader can't blend all of them
+   if (mActiveTargets.size() > kMaxActiveTargets)
+   {
+      std::partial_sort(mActiveTargets.begin(), mActiveTargets.begin() + kMaxActiveTargets, mActiveTargets.end(),
+                        [this](int lhs, int rhs) { return std::abs(mWeights[lhs]) > std::abs(mWeights[rhs]); });
+      mActiveTargets.resize(kMaxActiveTargets);
+   }
+
+   for (int target : mActiveTargets)
+   {
+      mActiveWeights.push_back(mWeights[target]);
+   }
+}
+
+unsigned int MorphTargets::GetNumActiveTargets() const
+{
+   return static_cast<unsigned int>(mActiveTargets.size());
+}
+
+void MorphTargets::Bind(const Shader& shader, unsigned int textureUnit) const
+{
+   // Activate the proper texture unit before binding the texture
+   glActiveTexture(GL_TEXTURE0 + textureUnit);
+   // Bind the texture
+   glBindTexture(GL_TEXTURE_2D, mDeltasTex);
+   // Tell the appropriate sampler2D uniform in what texture unit to look for the texture data
+   shader.setUniformInt("morphTargetDeltas", textureUnit);
+
+   // Only the active targets are uploaded
+   shader.setUniformInt("numMorphTargetVertices", static_cast<int>(mNumVertices));
+   shader.setUniformInt("numActiveMorphTargets", static_cast<int>(mActiveTargets.size()));
+   if (!mActiveTargets.empty())
+   {
+      shader.setUniformIntArray("activeMorphTargets[0]", mActiveTargets);
+      shader.setUniformFloatArray("activeMorphWeights[0]", mActiveWeights);
+   }
+}
+
+void MorphTargets::Unbind(unsigned int textureUnit) const
+{
+   // Activate the proper texture unit before unbinding the texture
+   glActiveTexture(GL_TEXTURE0 + textureUnit);
+   // Unbind the texture
+   glBindTexture(GL_TEXTURE_2D, 0);
+   // Disactivate the texture unit
+   glActiveTexture(GL_TEXTURE0);
+}
@@ -0,0 +1,263 @@
+#include <algorithm>
+
+#include "pch.h"
+#include "OffsetAllocator.h"
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace wabc {
+
+namespace {
+
+// sizes are mapped to bins like a float with a 3 bit mantissa: the bin of a size is
+// (exponent << 3) | mantissa, with sizes below 8 in bins 0-7. the bins are 12.5% apart.
+const uint32_t kMantissaBits = 3;
+const uint32_t kMantissaValue = 1 << kMantissaBits;
+const uint32_t kMantissaMask = kMantissaValue - 1;
+
+inline uint32_t HighestBit(uint32_t v)
+{
+#ifdef _MSC_VER
+    unsigned long r;
+    _BitScanReverse(&r, v);
+    return r;
+#else
+    return 31 - __builtin_clz(v);
+#endif
+}
+
+inline uint32_t LowestBit(uint32_t v)
+{
+#ifdef _MSC_VER
+    unsigned long r;
+    _BitScanForward(&r, v);
+    return r;
+#else
+    return __builtin_ctz(v);
+#endif
+}
+
+// smallest bin whose blocks are all at least size large. used to allocate
+uint32_t SizeToBinRoundUp(uint32_t size)
+{
+    if (size < kMantissaValue)
+        return size;
+
+    uint32_t mantissa_start = HighestBit(size) - kMantissaBits;
+    uint32_t exponent = mantissa_start + 1;
+    uint32_t mantissa = (size >> mantissa_start) & kMantissaMask;
+    if (size & ((1u << mantissa_start) - 1))
+        ++mantissa; // a carry into the exponent gives the next bin, which is what we want
+    return (exponent << kMantissaBits) + mantissa;
+}
+
+// largest bin whose blocks are all at most size large. used to store free blocks
+uint32_t SizeToBinRoundDown(uint32_t size)
+{
+    if (size < kMantissaValue)
+        return size;
+
+    uint32_t mantissa_start = HighestBit(size) - kMantissaBits;
+    uint32_t exponent = mantissa_start + 1;
+    uint32_t mantissa = (size >> mantissa_start) & kMantissaMask;
+    return (exponent << kMantissaBits) | mantissa;
+}
+
+} // namespace
+
+OffsetAllocator::OffsetAllocator(uint32_t size)
+{
+    reset(size);
+}
+
+void OffsetAllocator::reset(uint32_t size)
+{
+    m_size = size;
+    m_free_total = 0;
+    m_num_allocations = 0;
+    m_used_top = 0;
+    std::fill(std::begin(m_used_bins), std::end(m_used_bins), 0);
+    std::fill(std::begin(m_bin_heads), std::end(m_bin_heads), kInvalid);
+    m_nodes.clear();
+    m_free_nodes.clear();
+
+    if (size > 0)
+        insertFree(0, size, kInvalid, kInvalid);
+}
+
+uint32_t OffsetAllocator::newNode()
+{
+    uint32_t index;
+    if (!m_free_nodes.empty()) {
+        index = m_free_nodes.back();
+        m_free_nodes.pop_back();
+    }
+    else {
+        index = (uint32_t)m_nodes.size();
+        m_nodes.resize(m_nodes.size() + 1);
+    }
+    m_nodes[index] = Node();
+    return index;
+}
+
+uint32_t OffsetAllocator::insertFree(uint32_t offset, uint32_t size, uint32_t neighbor_prev, uint32_t neighbor_next)
+{
+    uint32_t index = newNode();
+    Node& node = m_nodes[index];
+    node.offset = offset;
+    node.size = size;
+    node.neighbor_prev = neighbor_prev;
+    node.neighbor_next = neighbor_next;
+    if (neighbor_prev != kInvalid)
+        m_nodes[neighbor_prev].neighbor_next = index;
+    if (neighbor_next != kInvalid)
+        m_nodes[neighbor_next].neighbor_prev = index;
+
+    insertIntoBin(index);
+    return index;
+}
+
+void OffsetAllocator::insertIntoBin(uint32_t index)
+{
+    Node& node = m_nodes[index];
+    uint32_t bin = SizeToBinRoundDown(node.size);
+    uint32_t top = bin / kBinsPerTop;
+    uint32_t leaf = bin % kBinsPerTop;
+
+    node.bin_prev = kInvalid;
+    node.bin_next = m_bin_heads[bin];
+    if (node.bin_next != kInvalid)
+        m_nodes[node.bin_next].bin_prev = index;
+    m_bin_heads[bin] = index;
+
+    m_used_bins[top] |= (uint8_t)(1u << leaf);
+    m_used_top |= 1u << top;
+    m_free_total += node.size;
+}
+
+void OffsetAllocator::removeFromBin(uint32_t index)
+{
+    Node& node = m_nodes[index];
+    if (node.bin_prev != kInvalid) {
+        m_nodes[node.bin_prev].bin_next = node.bin_next;
+    }
+    else {
+        uint32_t bin = SizeToBinRoundDown(node.size);
+        m_bin_heads[bin] = node.bin_next;
+        if (node.bin_next == kInvalid) {
+            uint32_t top = bin / kBinsPerTop;
+            m_used_bins[top] &= (uint8_t)~(1u << (bin % kBinsPerTop));
+            if (m_used_bins[top] == 0)
+                m_used_top &= ~(1u << top);
+        }
+    }
+    if (node.bin_next != kInvalid)
+        m_nodes[node.bin_next].bin_prev = node.bin_prev;
+
+    m_free_total -= node.size;
+}
+
+OffsetAllocator::Allocation OffsetAllocator::allocate(uint32_t size)
+{
+    Allocation ret;
+    if (size == 0 || size > m_free_total)
+        return ret;
+
+    // first non-empty bin at or above the one of the size: in the same top bin, then in the next used top bin
+    uint32_t min_bin = SizeToBinRoundUp(size);
+    uint32_t top = min_bin / kBinsPerTop;
+    if (top >= kNumTopBins)
+        return ret;
+
+    uint32_t bin = kInvalid;
+    uint32_t leaf_mask = m_used_bins[top] & (0xffu << (min_bin % kBinsPerTop)) & 0xffu;
+    if (leaf_mask) {
+        bin = top * kBinsPerTop + LowestBit(leaf_mask);
+    }
+    else if (top + 1 < kNumTopBins) {
+        uint32_t top_mask = m_used_top & (~0u << (top + 1));
+        if (top_mask) {
+            top = LowestBit(top_mask);
+            bin = top * kBinsPerTop + LowestBit(m_used_bins[top]);
+        }
+    }
+    if (bin == kInvalid)
+        return ret;
+
+    uint32_t index = m_bin_heads[bin];
+    removeFromBin(index);
+
+    // the rest of the block goes back to the bins, right after the allocation
+    Node& node = m_nodes[index];
+    uint32_t remainder = node.size - size;
+    node.size = size;
+    node.used = true;
+    if (remainder > 0) {
+        uint32_t offset = node.offset + size;
+        uint32_t next = node.neighbor_next;
+        insertFree(offset, remainder, index, next); // may reallocate m_nodes
+    }
+
+    ++m_num_allocations;
+    ret.offset = m_nodes[index].offset;
+    ret.node = index;
+    return ret;
+}
+
+void OffsetAllocator::free(Allocation allocation)
+{
+    if (!allocation.valid() || allocation.node >= m_nodes.size() || !m_nodes[allocation.node].used)
+        return;
+
+    uint32_t index = allocation.node;
+    uint32_t offset = m_nodes[index].offset;
+    uint32_t size = m_nodes[index].size;
+    uint32_t neighbor_prev = m_nodes[index].neighbor_prev;
+    uint32_t neighbor_next = m_nodes[index].neighbor_next;
+    m_free_nodes.push_back(index);
+    --m_num_allocations;
+
+    // merge with the free neighbors
+    if (neighbor_prev != kInvalid && !m_nodes[neighbor_prev].used) {
+        Node& prev = m_nodes[neighbor_prev];
+        removeFromBin(neighbor_prev);
+        offset = prev.offset;
+        size += prev.size;
+        m_free_nodes.push_back(neighbor_prev);
+        neighbor_prev = prev.neighbor_prev;
+    }
+    if (neighbor_next != kInvalid && !m_nodes[neighbor_next].used) {
+        Node& next = m_nodes[neighbor_next];
+        removeFromBin(neighbor_next);
+        size += next.size;
+        m_free_nodes.push_back(neighbor_next);
+        neighbor_next = next.neighbor_next;
+    }
+
+    insertFree(offset, size, neighbor_prev, neighbor_next);
+}
+
+uint32_t OffsetAllocator::allocationSize(Allocation allocation) const
+{
+    if (!allocation.valid() || allocation.node >= m_nodes.size())
+        return 0;
+    return m_nodes[allocation.node].size;
+}
+
+OffsetAllocator::StorageReport OffsetAllocator::storageReport() const
+{
+    StorageReport ret;
+    ret.total_free = m_free_total;
+    ret.num_allocations = m_num_allocations;
+    for (uint32_t bin = 0; bin < kNumBins; ++bin) {
+        for (uint32_t index = m_bin_heads[bin]; index != kInvalid; index = m_nodes[index].bin_next) {
+            ret.largest_free = std::max(ret.largest_free, m_nodes[index].size);
+            ++ret.num_free_blocks;
+        }
+    }
+    return ret;
+}
+
+} // namespace wabc
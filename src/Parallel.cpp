@@ -0,0 +1,177 @@
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "Parallel.h"
+
+namespace wabc {
+
+#ifdef wabcEnableThreads
+
+class WorkerPool
+{
+public:
+    static WorkerPool& instance()
+    {
+        static WorkerPool s_instance;
+        return s_instance;
+    }
+
+    size_t getConcurrency() const { return m_workers.size() + 1; }
+
+    void run(size_t n, size_t grain, const std::function<void(size_t, size_t)>& body)
+    {
+        // one job at a time. other callers wait here.
+        std::lock_guard<std::mutex> run_lock(m_run_mutex);
+
+        Job job;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            job.body = &body;
+            job.n = n;
+            job.grain = grain;
+            job.num_chunks = ceildiv(n, grain);
+            job.generation = ++m_generation;
+            m_job = job;
+            m_next_chunk = 0;
+            m_pending_chunks = job.num_chunks;
+        }
+        m_job_cond.notify_all();
+
+        // the calling thread runs chunks too, and a ParallelFor() inside them must not come back here
+        s_in_job = true;
+        processChunks(job);
+        s_in_job = false;
+
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_done_cond.wait(lock, [this]() { return m_pending_chunks == 0; });
+        m_job = {};
+    }
+
+    // true on the workers, and on the thread that called run() while it takes part in the job
+    static bool isInJob() { return s_in_job; }
+
+private:
+    WorkerPool()
+    {
+        size_t hc = std::thread::hardware_concurrency();
+        size_t num_workers = hc > 1 ? hc - 1 : 0;
+        for (size_t i = 0; i < num_workers; ++i)
+            m_workers.emplace_back([this]() { workerMain(); });
+    }
+
+    ~WorkerPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stop = true;
+        }
+        m_job_cond.notify_all();
+        for (auto& t : m_workers)
+            t.join();
+    }
+
+    // the parameters of a job. workers take a copy under the lock, so that run() can set up the next job while a
+    // late worker still looks at the previous one.
+    struct Job
+    {
+        const std::function<void(size_t, size_t)>* body = nullptr;
+        size_t n = 0;
+        size_t grain = 1;
+        size_t num_chunks = 0;
+        uint64_t generation = 0;
+    };
+
+    void workerMain()
+    {
+        s_in_job = true;
+        uint64_t seen = 0;
+        for (;;) {
+            Job job;
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_job_cond.wait(lock, [&]() { return m_stop || m_generation != seen; });
+                if (m_stop)
+                    return;
+                seen = m_generation;
+                job = m_job;
+            }
+            processChunks(job);
+        }
+    }
+
+    // chunks are claimed under the lock and only while the job is still the current one. a claimed chunk is
+    // pending, so run() can't return and the body stays alive until the chunk is done.
+    void processChunks(const Job& job)
+    {
+        for (;;) {
+            size_t ci;
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                if (m_generation != job.generation || m_next_chunk >= job.num_chunks)
+                    break;
+                ci = m_next_chunk++;
+            }
+
+            size_t begin = ci * job.grain;
+            size_t end = std::min(begin + job.grain, job.n);
+            (*job.body)(begin, end);
+
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (--m_pending_chunks == 0)
+                m_done_cond.notify_all();
+        }
+    }
+
+    std::vector<std::thread> m_workers;
+    std::mutex m_run_mutex;
+    std::mutex m_mutex;
+    std::condition_variable m_job_cond;
+    std::condition_variable m_done_cond;
+    bool m_stop = false;
+    uint64_t m_generation = 0;
+
+    // guarded by m_mutex
+    Job m_job;
+    size_t m_next_chunk = 0;
+    size_t m_pending_chunks = 0;
+
+    static thread_local bool s_in_job;
+};
+thread_local bool WorkerPool::s_in_job = false;
+
+size_t GetConcurrency()
+{
+    return WorkerPool::instance().getConcurrency();
+}
+
+void ParallelFor(size_t n, size_t grain, const std::function<void(size_t, size_t)>& body)
+{
+    if (n == 0)
+        return;
+    grain = std::max<size_t>(grain, 1);
+    // nested calls from a chunk would deadlock on the pool. run them inline.
+    if (n <= grain || WorkerPool::isInJob() || GetConcurrency() == 1) {
+        body(0, n);
+        return;
+    }
+    WorkerPool::instance().run(n, grain, body);
+}
+
+#else // wabcEnableThreads
+
+size_t GetConcurrency()
+{
+    return 1;
+}
+
+void ParallelFor(size_t n, size_t /*grain*/, const std::function<void(size_t, size_t)>& body)
+{
+    if (n > 0)
+        body(0, n);
+}
+
+#endif // wabcEnableThreads
+
+} // namespace wabc
@@ -1,3 +1,5 @@
+#include <cstdlib>
+#include <iostream>
 #include <random>
 
 #include "glm/gtx/compatibility.hpp"
@@ -17,8 +19,12 @@
 #include "ResourceManager.h"
 #include "ShaderLoader.h"
 #include "GLTFLoader.h"
+#include "Subdivision.h"
 #include "TextureLoader.h"
 #include "Transform.h"
+#include "FrameArena.h"
+#include "AllocationTracker.h"
+#include "GPUHeap.h"
 
 
 PlayState::PlayState(const std::shared_ptr<FiniteStateMachine>& finiteStateMachine,
@@ -26,20 +32,35 @@ PlayState::PlayState(const std::shared_ptr<FiniteStateMachine>& finiteStateMachi
    : mFSM(finiteStateMachine)
    , mWindow(window)
    , mCamera3(0.85f, 10.0f, glm::vec3(0.0f, 1.1f, 0.0), Q::angleAxis(glm::radians(180.0f), glm::vec3(0.0f, 1.0f, 0.0f)), glm::vec3(0.0f, 0.0f, 0.0f), 0.5f, 10.0f, -90.0f, 90.0f, 45.0f, 1280.0f / 720.0f, 0.1f, 130.0f, 0.25f)
+   , mFrontAlembicBuffersIndex(0)
 {
    // Initialize the static mesh with normals shader
    mStaticMeshWithNormalsShader = ResourceManager<Shader>().loadUnmanagedResource<ShaderLoader>("resources/shaders/static_mesh_with_normals.vert",
                                                                                                 "resources/shaders/diffuse_illumination.frag");
    configureLights(mStaticMeshWithNormalsShader);
 
+   // Initialize the shader of the primitives with morph targets
+   mStaticMeshWithMorphTargetsShader = ResourceManager<Shader>().loadUnmanagedResource<ShaderLoader>("resources/shaders/static_mesh_with_morph_targets.vert",
+                                                                                                     "resources/shaders/diffuse_illumination.frag");
+   configureLights(mStaticMeshWithMorphTargetsShader);
+
    // Initialize the hands shader
    mBlinnPhongShader = ResourceManager<Shader>().loadUnmanagedResource<ShaderLoader>("resources/shaders/blinn_phong.vert",
                                                                                      "resources/shaders/blinn_phong.frag");
    configureLights(mBlinnPhongShader);
 
+   // Initialize the instanced shader of the hands and the samurai
+   mBlinnPhongInstancedShader = ResourceManager<Shader>().loadUnmanagedResource<ShaderLoader>("resources/shaders/blinn_phong_instanced.vert",
+                                                                                              "resources/shaders/blinn_phong.frag");
+   configureLights(mBlinnPhongInstancedShader);
+
+   // Initialize the skinned characters shader
+   mBlinnPhongSkinnedShader = ResourceManager<Shader>().loadUnmanagedResource<ShaderLoader>("resources/shaders/blinn_phong_skinned.vert",
+                                                                                            "resources/shaders/blinn_phong.frag");
+   configureLights(mBlinnPhongSkinnedShader);
+
    loadHands();
-   loadGeisha();
-   loadSamurai();
+   loadCharacters();
 
    std::random_device rd;
    std::mt19937 gen(rd());
@@ -93,11 +114,11 @@ void PlayState::processInput()
 void PlayState::update(float deltaTime)
 {
    // Update the hands
-   mAlembicAnimationPlaybackTime += deltaTime * mPlaybackSpeed;
-   if (mAlembicAnimationPlaybackTime > mAlembicAnimationEndTime)
-   {
-      mAlembicAnimationPlaybackTime -= mAlembicAnimationDuration;
-   }
+   // The playlist loops the current clip, or switches to the next one once it has been preloaded
+   mPlaylist.update(deltaTime * mPlaybackSpeed);
+
+   // Update the character that's shown
+   updateSkinnedCharacter(mSkinnedCharacters[mCharacterIndex], deltaTime * mPlaybackSpeed);
 }
 
 void PlayState::render()
@@ -134,6 +155,8 @@ void PlayState::render()
    ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
 #endif
 
+   checkSteadyState();
+
 #ifndef __EMSCRIPTEN__
    mWindow->generateAntiAliasedImage();
 #endif
@@ -147,6 +170,24 @@ void PlayState::exit()
 
 }
 
+void PlayState::checkSteadyState()
+{
+   FrameState state;
+   state.frontSerial      = mAlembicBuffers[mFrontAlembicBuffersIndex].serial;
+   state.backSerial       = mAlembicBuffers[1 - mFrontAlembicBuffersIndex].serial;
+   state.subdivisionLevel = mSubdivisionLevel;
+   state.characterIndex   = mCharacterIndex;
+   state.interleaved      = mInterleavedVertices;
+
+   // Transient data goes to the frame arena, so a paused frame in which nothing changed shouldn't touch the heap
+   if (mPlaybackSpeed == 0.0f && state == mLastFrameState)
+   {
+      wabc::CheckSteadyStateFrame();
+   }
+
+   mLastFrameState = state;
+}
+
 void PlayState::configureLights(const std::shared_ptr<Shader>& shader)
 {
    shader->use(true);
@@ -161,64 +202,210 @@ void PlayState::configureLights(const std::shared_ptr<Shader>& shader)
 
 void PlayState::loadHands()
 {
-   mScene = wabc::LoadScene("resources/animations/motion_capture_data.abc");
+   const char* capturePath = "resources/animations/motion_capture_data.abc";
 
-   mScene->seek(0.0);
-   wabc::IMesh* mesh = mScene->getMesh();
-   mAlembicMesh.InitializeBuffers(mesh);
+   // The last half second of the capture is trimmed
+   mPlaylist.addClip(capturePath, 0.5);
 
-   int positionsAttribLoc = mBlinnPhongShader->getAttributeLocation("position");
-   int normalsAttribLoc   = mBlinnPhongShader->getAttributeLocation("normal");
-   mAlembicMesh.ConfigureVAO(positionsAttribLoc, normalsAttribLoc);
+   // There is only one bundled clip, so the check plays it twice to run the clip preloading and switching,
+   // and so does the playlist to also run the double buffering of the Alembic buffers
+   if (std::getenv("WABC_PLAYLIST_CHECK"))
+   {
+      wabc::CheckScenePlaylist(capturePath);
+      mPlaylist.addClip(capturePath, 0.5);
+   }
 
-   std::tuple<double, double> timeRange = mScene->getTimeRange();
-   mAlembicAnimationStartTime    = static_cast<float>(std::get<0>(timeRange));
-   mAlembicAnimationEndTime      = static_cast<float>(std::get<1>(timeRange)) - 0.5f;
-   mAlembicAnimationDuration     = mAlembicAnimationEndTime - mAlembicAnimationStartTime;
-   mAlembicAnimationPlaybackTime = mAlembicAnimationStartTime;
+   mPlaylist.start();
+
+   // The playlist seeks the first clip to its start time when it opens it
+   initializeAlembicBuffers(mAlembicBuffers[mFrontAlembicBuffersIndex], mPlaylist.getScene(), mPlaylist.getSerial());
 }
 
-void PlayState::loadGeisha()
+void PlayState::initializeAlembicBuffers(AlembicBuffers& buffers, wabc::IScene* scene, uint32_t serial)
 {
-   cgltf_data* data = LoadGLTFFile("resources/models/geisha/geisha.glb");
-   mGeishaMeshes = LoadStaticMeshes(data);
-   FreeGLTFFile(data);
+   buffers.mesh.SetVertexLayout(getVertexLayout());
+   buffers.mesh.InitializeBuffers(scene->getMesh());
+   buffers.mesh.ConfigureVAO(mBlinnPhongShader->getAttributeLocation("position"),
+                             mBlinnPhongShader->getAttributeLocation("normal"),
+                             -1);
+
+   wabc::span<wabc::IInstancedMesh*> instancedMeshes = scene->getInstancedMeshes();
+   buffers.instancedMeshes.clear();
+   buffers.instancedMeshes.resize(instancedMeshes.size());
+   for (size_t i = 0; i < instancedMeshes.size(); ++i)
+   {
+      buffers.instancedMeshes[i].SetVertexLayout(getVertexLayout());
+      buffers.instancedMeshes[i].InitializeBuffers(instancedMeshes[i]->getMesh());
+      buffers.instancedMeshes[i].ConfigureVAO(mBlinnPhongInstancedShader->getAttributeLocation("position"),
+                                              mBlinnPhongInstancedShader->getAttributeLocation("normal"),
+                                              -1,
+                                              mBlinnPhongInstancedShader->getAttributeLocation("instanceModel"));
+   }
+
+   buffers.serial = serial;
+}
+
+void PlayState::updateAlembicBuffers(AlembicBuffers& buffers, wabc::IScene* scene)
+{
+   buffers.mesh.UpdateBuffers(scene->getMesh());
+
+   wabc::span<wabc::IInstancedMesh*> instancedMeshes = scene->getInstancedMeshes();
+   for (size_t i = 0; i < instancedMeshes.size(); ++i)
+   {
+      buffers.instancedMeshes[i].UpdateBuffers(instancedMeshes[i]->getMesh());
+      buffers.instancedMeshes[i].UpdateInstanceMatrices(instancedMeshes[i]->getInstanceMatrices());
+   }
+}
+
+// The optimized index buffers of the glTF meshes are cached here, so that only the first run pays for the optimization
+// The file system of the browser doesn't persist, so there is nothing to gain from it there
+#ifdef __EMSCRIPTEN__
+static const char* kMeshCacheDir = nullptr;
+#else
+static const char* kMeshCacheDir = "mesh_cache";
+#endif
+
+// The files are parsed one after the other, which is fast since they are mapped, and then the primitives of both
+// characters are decoded and optimized in parallel, so that loading takes as long as the slowest character instead of
+// the sum of both
+// The geisha is merged into a StaticModel, so its node transforms are baked into its vertices. The samurai is drawn
+// with instancing instead, once per node that refers to each of its meshes, with the world matrix of the node as the
+// instance matrix (see LoadStaticMeshes)
+// The buffers are loaded afterwards on this thread, which owns the GL context
+void PlayState::loadCharacters()
+{
+   std::vector<cgltf_data*> files = { LoadGLTFFile("resources/models/geisha/geisha.glb"),
+                                      LoadGLTFFile("resources/models/samurai/samurai.glb") };
+
+   std::vector<std::vector<StaticMesh>> meshes = LoadStaticMeshData(files, kMeshCacheDir, { NodeTransforms::Baked, NodeTransforms::Instanced });
+
+   loadSkinnedCharacter(mSkinnedCharacters[0], files[0]);
+   loadSkinnedCharacter(mSkinnedCharacters[1], files[1]);
 
-   int positionsAttribLoc = mStaticMeshWithNormalsShader->getAttributeLocation("position");
-   int normalsAttribLoc   = mStaticMeshWithNormalsShader->getAttributeLocation("normal");
-   int texCoordsAttribLoc = mStaticMeshWithNormalsShader->getAttributeLocation("texCoord");
+   // The placement of the samurai in renderSamurai was made for its meshes without the transform of their root node
+   mSamuraiRootCorrection = files[1] ? transformToMat4(inverse(LoadRootTransform(files[1]))) : glm::mat4(1.0f);
 
-   for (unsigned int i = 0,
-        size = static_cast<unsigned int>(mGeishaMeshes.size());
-        i < size;
-        ++i)
+   for (cgltf_data* data : files)
    {
-      mGeishaMeshes[i].ConfigureVAO(positionsAttribLoc,
-                                    normalsAttribLoc,
-                                    texCoordsAttribLoc);
+      if (data)
+      {
+         FreeGLTFFile(data);
+      }
    }
 
+   loadGeisha(std::move(meshes[0]));
+   loadSamurai(std::move(meshes[1]));
+}
+
+void PlayState::loadGeisha(std::vector<StaticMesh>&& meshes)
+{
+   StaticMesh::VertexFormat vertexFormat = StaticMesh::VertexFormat::Compact();
+   vertexFormat.layout = getVertexLayout();
+   mGeishaModel.Build(std::move(meshes), vertexFormat);
+
+   mGeishaModel.ConfigureVAO(mStaticMeshWithNormalsShader->getAttributeLocation("position"),
+                             mStaticMeshWithNormalsShader->getAttributeLocation("normal"),
+                             mStaticMeshWithNormalsShader->getAttributeLocation("texCoord"));
+   mGeishaModel.ConfigureMorphTargetsVAO(mStaticMeshWithMorphTargetsShader->getAttributeLocation("position"),
+                                         mStaticMeshWithMorphTargetsShader->getAttributeLocation("normal"),
+                                         mStaticMeshWithMorphTargetsShader->getAttributeLocation("texCoord"));
+
    mGeishaFaceTexture = ResourceManager<Texture>().loadUnmanagedResource<TextureLoader>("resources/models/geisha/face.jpeg", nullptr, nullptr, GL_REPEAT, GL_REPEAT, GL_LINEAR_MIPMAP_LINEAR, GL_LINEAR, true, true);
    mGeishaEyesTexture = ResourceManager<Texture>().loadUnmanagedResource<TextureLoader>("resources/models/geisha/eyes.png", nullptr, nullptr, GL_REPEAT, GL_REPEAT, GL_LINEAR_MIPMAP_LINEAR, GL_LINEAR, true, true);
 }
 
-void PlayState::loadSamurai()
+void PlayState::loadSamurai(std::vector<StaticMesh>&& meshes)
+{
+   StaticMesh::VertexFormat vertexFormat = StaticMesh::VertexFormat::Compact();
+   vertexFormat.layout = getVertexLayout();
+   mSamuraiMeshes = std::move(meshes);
+
+   // The samurai isn't textured
+   for (StaticMesh& mesh : mSamuraiMeshes)
+   {
+      mesh.SetVertexFormat(vertexFormat);
+      mesh.LoadBuffers();
+      mesh.ConfigureVAO(mBlinnPhongInstancedShader->getAttributeLocation("position"),
+                        mBlinnPhongInstancedShader->getAttributeLocation("normal"),
+                        -1,
+                        mBlinnPhongInstancedShader->getAttributeLocation("instanceModel"));
+   }
+}
+
+// The bind poses are only needed to initialize the buffers, while the skins are kept to hold the joint matrices
+void PlayState::loadSkinnedCharacter(SkinnedCharacter& character, cgltf_data* data)
+{
+   character.sampler.SetClip(nullptr);
+   character.clips.clear();
+   character.skins.clear();
+   character.meshes.clear();
+   if (data == nullptr || data->skins_count == 0)
+   {
+      return;
+   }
+
+   std::vector<wabc::IMeshPtr> bindPoseMeshes;
+   LoadSkinnedMeshes(data, bindPoseMeshes, character.skins);
+   character.skeleton = LoadSkeleton(data);
+   character.pose     = character.skeleton.GetRestPose();
+
+   // The clip is sampled in a loop from its start
+   character.clips = LoadAnimationClips(data);
+   if (!character.clips.empty())
+   {
+      character.sampler.SetClip(&character.clips[0]);
+      character.playbackTime = character.clips[0].GetStartTime();
+   }
+
+   character.meshes.resize(character.skins.size());
+   for (size_t meshIndex = 0; meshIndex < character.meshes.size(); ++meshIndex)
+   {
+      character.skeleton.UpdateSkin(character.pose, *character.skins[meshIndex]);
+
+      SkinnedMesh& mesh = character.meshes[meshIndex];
+      mesh.InitializeBuffers(bindPoseMeshes[meshIndex].get(), character.skins[meshIndex].get());
+      mesh.ConfigureVAO(mBlinnPhongSkinnedShader->getAttributeLocation("position"),
+                        mBlinnPhongSkinnedShader->getAttributeLocation("normal"),
+                        mBlinnPhongSkinnedShader->getAttributeLocation("jointIndices"),
+                        mBlinnPhongSkinnedShader->getAttributeLocation("jointWeights"));
+   }
+
+   std::cout << "Loaded " << character.meshes.size() << " skinned meshes with " << character.skeleton.GetNumJoints() << " joints" << '\n';
+}
+
+// The joints are the nodes of the file, so every skin of a character has the same joint matrices, which are computed
+// once and uploaded to each mesh
+void PlayState::updateSkinnedCharacter(SkinnedCharacter& character, float deltaTime)
+{
+   if (character.meshes.empty() || character.sampler.GetClip() == nullptr)
+   {
+      return;
+   }
+
+   character.playbackTime = character.sampler.Sample(character.pose, character.playbackTime + deltaTime);
+
+   wabc::ISkin& skin = *character.skins[0];
+   character.skeleton.UpdateSkin(character.pose, skin);
+   for (SkinnedMesh& mesh : character.meshes)
+   {
+      mesh.UpdateJointMatrices(skin.getJointMatrices());
+   }
+}
+
+VertexLayout PlayState::getVertexLayout() const
 {
-   cgltf_data* data = LoadGLTFFile("resources/models/samurai/samurai.glb");
-   mSamuraiMeshes = LoadStaticMeshes(data);
-   FreeGLTFFile(data);
+   return mInterleavedVertices ? VertexLayout::Interleaved : VertexLayout::Split;
+}
 
-   int positionsAttribLoc = mBlinnPhongShader->getAttributeLocation("position");
-   int normalsAttribLoc   = mBlinnPhongShader->getAttributeLocation("normal");
+// The layout is chosen when the buffers are created, so the characters are loaded again and the Alembic buffers are
+// initialized again the next time they are rendered
+void PlayState::applyVertexLayout()
+{
+   loadCharacters();
 
-   for (unsigned int i = 0,
-        size = static_cast<unsigned int>(mSamuraiMeshes.size());
-        i < size;
-        ++i)
+   for (AlembicBuffers& buffers : mAlembicBuffers)
    {
-      mSamuraiMeshes[i].ConfigureVAO(positionsAttribLoc,
-                                     normalsAttribLoc,
-                                     -1);
+      buffers.serial = 0;
    }
 }
 
@@ -264,47 +451,170 @@ void PlayState::userInterface()
       ImGui::SliderFloat("Playback speed", &mPlaybackSpeed, 0.0f, 2.0f, "%.3f");
 #endif
 
+      ImGui::SliderInt("Subdivision level", &mSubdivisionLevel, 0, wabc::SubdivisionStencils::kMaxLevel);
+
+      if (ImGui::Checkbox("Interleaved vertices", &mInterleavedVertices))
+      {
+         applyVertexLayout();
+      }
+
       ImGui::RadioButton("Geisha", &mCharacterIndex, 0);
       ImGui::RadioButton("Samurai", &mCharacterIndex, 1);
    }
 
+   if (ImGui::CollapsingHeader("GPU heap"))
+   {
+      auto heapStats = [](const char* name, const GPUHeap& heap) {
+         GPUHeap::Stats stats = heap.GetStats();
+         ImGui::Text("%s: %u allocations, %u pages", name, stats.numAllocations, stats.numPages);
+         ImGui::Text("   %.1f / %.1f MB used (%.0f%%), fragmentation %.0f%%", stats.used / (1024.0f * 1024.0f), stats.capacity / (1024.0f * 1024.0f),
+                     stats.GetUtilization() * 100.0f, stats.GetFragmentation() * 100.0f);
+      };
+      heapStats("Vertices", GPUHeap::Vertices());
+      heapStats("Indices", GPUHeap::Indices());
+
+      // The meshes configure their VAOs again the next time they are rendered
+      if (ImGui::Button("Defragment"))
+      {
+         GPUHeap::Vertices().Defragment();
+         GPUHeap::Indices().Defragment();
+      }
+   }
+
+#ifdef wabcEnableAllocationTracker
+   if (ImGui::CollapsingHeader("Allocations"))
+   {
+      wabc::AllocationFrameStats lastFrame = wabc::GetLastFrameAllocations();
+      ImGui::Text("Last frame: %zu allocations (%.1f KB)", lastFrame.count, lastFrame.bytes / 1024.0f);
+      ImGui::Text("RawVector:  %zu allocations (%.1f KB)", lastFrame.raw_vector_count, lastFrame.raw_vector_bytes / 1024.0f);
+      ImGui::Text("Peak RSS:   %.1f MB", wabc::GetPeakRSS() / (1024.0f * 1024.0f));
+
+      static float history[120];
+      size_t numFrames = wabc::GetAllocationHistory(history, 120);
+      ImGui::PlotLines("##AllocationHistory", history, static_cast<int>(numFrames), 0, "Allocations per frame", 0.0f, FLT_MAX, ImVec2(0.0f, 60.0f));
+
+#ifdef __EMSCRIPTEN__
+      ImGui::TextDisabled("Call sites are only captured on native builds");
+#else
+      if (ImGui::TreeNode("Top call sites"))
+      {
+         if (ImGui::Button("Refresh") || mTopAllocationSites.empty())
+         {
+            mTopAllocationSites = wabc::GetTopAllocationSites(10);
+         }
+
+         for (const wabc::AllocationSite& site : mTopAllocationSites)
+         {
+            ImGui::BulletText("%zu (%.1f KB) %s", site.count, site.bytes / 1024.0f, site.name.c_str());
+         }
+         ImGui::TreePop();
+      }
+#endif
+
+      if (ImGui::TreeNode("Allocators"))
+      {
+         sfbx::EachAllocator([](sfbx::Allocator& allocator) {
+            sfbx::Allocator::Stats stats = allocator.getStats();
+            ImGui::BulletText("%s: %zu live (%.1f KB), %zu total", allocator.getName(), stats.allocations, stats.bytes / 1024.0f, stats.total_allocations);
+         });
+         ImGui::TreePop();
+      }
+   }
+#endif
+
    ImGui::End();
 }
 #endif
 
+// Changing the subdivision level changes the topology of the scene, so its buffers have to be initialized again
+void PlayState::applySubdivisionLevel(AlembicBuffers& buffers, wabc::IScene* scene)
+{
+   if (scene && scene->getSubdivisionLevel() != mSubdivisionLevel)
+   {
+      scene->setSubdivisionLevel(mSubdivisionLevel);
+      buffers.serial = 0;
+   }
+}
+
 void PlayState::renderHands()
 {
-   mScene->seek(mAlembicAnimationPlaybackTime);
-   wabc::IMesh* mesh = mScene->getMesh();
-   mAlembicMesh.UpdateBuffers(mesh);
+   // Upload the clip that's been preloaded in the background to the back buffers
+   // By the time the playlist switches to it, its topology and first frame are already on the GPU
+   AlembicBuffers& backBuffers = mAlembicBuffers[1 - mFrontAlembicBuffersIndex];
+   wabc::IScene*   nextScene   = mPlaylist.getNextScene();
+   applySubdivisionLevel(backBuffers, nextScene);
+   if (nextScene && mPlaylist.getNextSerial() != backBuffers.serial)
+   {
+      initializeAlembicBuffers(backBuffers, nextScene, mPlaylist.getNextSerial());
+      updateAlembicBuffers(backBuffers, nextScene);
+   }
 
-   mBlinnPhongShader->use(true);
-   mBlinnPhongShader->setUniformMat4("model", glm::mat4(1.0f));
-   mBlinnPhongShader->setUniformMat4("view", mCamera3.getViewMatrix());
-   mBlinnPhongShader->setUniformMat4("projection", mCamera3.getPerspectiveProjectionMatrix());
-   mBlinnPhongShader->setUniformVec3("cameraPos",    mCamera3.getPosition());
+   // Swap the buffers when the playlist switches clips
+   if (mPlaylist.getSerial() != mAlembicBuffers[mFrontAlembicBuffersIndex].serial && mPlaylist.getSerial() == backBuffers.serial)
+   {
+      mFrontAlembicBuffersIndex = 1 - mFrontAlembicBuffersIndex;
+   }
+
+   mPlaylist.seek();
+   wabc::IScene*   scene        = mPlaylist.getScene();
+   AlembicBuffers& frontBuffers = mAlembicBuffers[mFrontAlembicBuffersIndex];
+   applySubdivisionLevel(frontBuffers, scene);
+
+   // The playlist switched before the back buffers could be filled, so we have no choice but to do it now
+   if (mPlaylist.getSerial() != frontBuffers.serial)
+   {
+      initializeAlembicBuffers(frontBuffers, scene, mPlaylist.getSerial());
+   }
+
+   updateAlembicBuffers(frontBuffers, scene);
 
+   glm::vec3 diffuseColor;
    if (mCharacterIndex == 0) // Geisha
    {
       // Red
-      mBlinnPhongShader->setUniformVec3("diffuseColor", Utility::hexToColor(0xaf3d4d));
+      diffuseColor = Utility::hexToColor(0xaf3d4d);
    }
    else // Samurai
    {
       // Blue
-      mBlinnPhongShader->setUniformVec3("diffuseColor", Utility::hexToColor(0x73b1ff));
+      diffuseColor = Utility::hexToColor(0x73b1ff);
    }
 
    glFrontFace(GL_CW);
-   mAlembicMesh.Render();
-   glFrontFace(GL_CCW);
 
+   mBlinnPhongShader->use(true);
+   mBlinnPhongShader->setUniformMat4("model", glm::mat4(1.0f));
+   mBlinnPhongShader->setUniformMat4("view", mCamera3.getViewMatrix());
+   mBlinnPhongShader->setUniformMat4("projection", mCamera3.getPerspectiveProjectionMatrix());
+   mBlinnPhongShader->setUniformVec3("cameraPos",    mCamera3.getPosition());
+   mBlinnPhongShader->setUniformVec3("diffuseColor", diffuseColor);
+   StaticMesh::BindFloatVertexFormat(*mBlinnPhongShader);
+   frontBuffers.mesh.Render();
    mBlinnPhongShader->use(false);
+
+   // Each instanced mesh is decoded once and drawn once per instance with its own transform
+   if (!frontBuffers.instancedMeshes.empty())
+   {
+      mBlinnPhongInstancedShader->use(true);
+      mBlinnPhongInstancedShader->setUniformMat4("model", glm::mat4(1.0f));
+      mBlinnPhongInstancedShader->setUniformMat4("view", mCamera3.getViewMatrix());
+      mBlinnPhongInstancedShader->setUniformMat4("projection", mCamera3.getPerspectiveProjectionMatrix());
+      mBlinnPhongInstancedShader->setUniformVec3("cameraPos",    mCamera3.getPosition());
+      mBlinnPhongInstancedShader->setUniformVec3("diffuseColor", diffuseColor);
+      StaticMesh::BindFloatVertexFormat(*mBlinnPhongInstancedShader);
+      for (AlembicMesh& instancedMesh : frontBuffers.instancedMeshes)
+      {
+         instancedMesh.RenderInstanced(instancedMesh.GetNumInstances());
+      }
+      mBlinnPhongInstancedShader->use(false);
+   }
+
+   glFrontFace(GL_CCW);
 }
 
 void PlayState::renderGeisha()
 {
-   wabc::span<wabc::ICamera*> cameras = mScene->getCameras();
+   wabc::span<wabc::ICamera*> cameras = mPlaylist.getScene()->getCameras();
    wabc::float3 cameraPosition        = cameras[0]->getPosition();
    wabc::float3 cameraDirection       = cameras[0]->getDirection();
    wabc::float3 cameraUp              = cameras[0]->getUp();
@@ -313,27 +623,46 @@ void PlayState::renderGeisha()
                             Q::lookRotation(glm::vec3(cameraDirection.x, cameraDirection.y, cameraDirection.z),
                             glm::vec3(cameraUp.x, cameraUp.y, cameraUp.z)), glm::vec3(0.1f));
 
+   // The primitives with morph targets are drawn with their own shader, which needs the same uniforms
+   const Shader* morphTargetsShader = nullptr;
+   if (mGeishaModel.HasMorphTargets())
+   {
+      morphTargetsShader = mStaticMeshWithMorphTargetsShader.get();
+      morphTargetsShader->use(true);
+      morphTargetsShader->setUniformMat4("model", transformToMat4(modelTransform));
+      morphTargetsShader->setUniformMat4("view", mCamera3.getViewMatrix());
+      morphTargetsShader->setUniformMat4("projection", mCamera3.getPerspectiveProjectionMatrix());
+      morphTargetsShader->setUniformVec3("cameraPos", mCamera3.getPosition());
+      morphTargetsShader->setUniformInt("diffuseTex", 0);
+   }
+
    mStaticMeshWithNormalsShader->use(true);
    mStaticMeshWithNormalsShader->setUniformMat4("model", transformToMat4(modelTransform));
    mStaticMeshWithNormalsShader->setUniformMat4("view", mCamera3.getViewMatrix());
    mStaticMeshWithNormalsShader->setUniformMat4("projection", mCamera3.getPerspectiveProjectionMatrix());
    mStaticMeshWithNormalsShader->setUniformVec3("cameraPos", mCamera3.getPosition());
 
+   // The primitives that share a texture are drawn together
+   static const std::vector<unsigned int> faceTexturePrimitives = { 1 };
+   static const std::vector<unsigned int> eyesTexturePrimitives = { 0, 2 };
+
    mGeishaFaceTexture->bind(0, mStaticMeshWithNormalsShader->getUniformLocation("diffuseTex"));
-   mGeishaMeshes[1].Render();
+   mGeishaModel.RenderPrimitives(*mStaticMeshWithNormalsShader, faceTexturePrimitives, morphTargetsShader);
    mGeishaFaceTexture->unbind(0);
 
    mGeishaEyesTexture->bind(0, mStaticMeshWithNormalsShader->getUniformLocation("diffuseTex"));
-   mGeishaMeshes[0].Render();
-   mGeishaMeshes[2].Render();
+   mGeishaModel.RenderPrimitives(*mStaticMeshWithNormalsShader, eyesTexturePrimitives, morphTargetsShader);
    mGeishaEyesTexture->unbind(0);
 
    mStaticMeshWithNormalsShader->use(false);
+
+   // The skinned meshes aren't textured
+   renderSkinnedCharacter(mSkinnedCharacters[0], transformToMat4(modelTransform), glm::vec3(1.0f));
 }
 
 void PlayState::renderSamurai()
 {
-   wabc::span<wabc::ICamera*> cameras = mScene->getCameras();
+   wabc::span<wabc::ICamera*> cameras = mPlaylist.getScene()->getCameras();
    wabc::float3 cameraPosition        = cameras[0]->getPosition();
    wabc::float3 cameraDirection       = cameras[0]->getDirection();
    wabc::float3 cameraUp              = cameras[0]->getUp();
@@ -342,23 +671,52 @@ void PlayState::renderSamurai()
                             Q::lookRotation(glm::vec3(cameraDirection.x, cameraDirection.y, cameraDirection.z),
                             glm::vec3(cameraUp.x, cameraUp.y, cameraUp.z)), glm::vec3(0.001f));
 
-   mBlinnPhongShader->use(true);
-   mBlinnPhongShader->setUniformMat4("model", transformToMat4(modelTransform));
-   mBlinnPhongShader->setUniformMat4("view", mCamera3.getViewMatrix());
-   mBlinnPhongShader->setUniformMat4("projection", mCamera3.getPerspectiveProjectionMatrix());
-   mBlinnPhongShader->setUniformVec3("cameraPos", mCamera3.getPosition());
+   // The instance matrices of the meshes are the world matrices of their nodes, which include the transform of the root
+   // node of samurai.glb. The placement above doesn't expect it, so it's undone first
+   // The skinned meshes are drawn without the transforms of the nodes, so they don't need the correction
+   mBlinnPhongInstancedShader->use(true);
+   mBlinnPhongInstancedShader->setUniformMat4("model", transformToMat4(modelTransform) * mSamuraiRootCorrection);
+   mBlinnPhongInstancedShader->setUniformMat4("view", mCamera3.getViewMatrix());
+   mBlinnPhongInstancedShader->setUniformMat4("projection", mCamera3.getPerspectiveProjectionMatrix());
+   mBlinnPhongInstancedShader->setUniformVec3("cameraPos", mCamera3.getPosition());
    // Gold
-   mBlinnPhongShader->setUniformVec3("diffuseColor", Utility::hexToColor(0xffc173));
+   mBlinnPhongInstancedShader->setUniformVec3("diffuseColor", Utility::hexToColor(0xffc173));
 
-   for (unsigned int i = 0,
-        size = static_cast<unsigned int>(mSamuraiMeshes.size());
-        i < size;
-        ++i)
+   // The instanced shader doesn't apply morph targets, so the primitives that have them are drawn in their rest pose
+   for (StaticMesh& mesh : mSamuraiMeshes)
    {
-      mSamuraiMeshes[i].Render();
+      mesh.BindVertexFormat(*mBlinnPhongInstancedShader);
+      mesh.RenderInstanced(mesh.GetNumInstances());
    }
 
-   mBlinnPhongShader->use(false);
+   mBlinnPhongInstancedShader->use(false);
+
+   renderSkinnedCharacter(mSkinnedCharacters[1], transformToMat4(modelTransform), Utility::hexToColor(0xffc173));
+}
+
+void PlayState::renderSkinnedCharacter(SkinnedCharacter& character, const glm::mat4& model, const glm::vec3& diffuseColor)
+{
+   if (character.meshes.empty())
+   {
+      return;
+   }
+
+   mBlinnPhongSkinnedShader->use(true);
+   mBlinnPhongSkinnedShader->setUniformMat4("model", model);
+   mBlinnPhongSkinnedShader->setUniformMat4("view", mCamera3.getViewMatrix());
+   mBlinnPhongSkinnedShader->setUniformMat4("projection", mCamera3.getPerspectiveProjectionMatrix());
+   mBlinnPhongSkinnedShader->setUniformVec3("cameraPos", mCamera3.getPosition());
+   mBlinnPhongSkinnedShader->setUniformVec3("diffuseColor", diffuseColor);
+
+   int jointMatricesLocation = mBlinnPhongSkinnedShader->getUniformLocation("jointMatrices");
+   for (SkinnedMesh& mesh : character.meshes)
+   {
+      mesh.BindJointMatrices(0, jointMatricesLocation);
+      mesh.Render();
+      mesh.UnbindJointMatrices(0);
+   }
+
+   mBlinnPhongSkinnedShader->use(false);
 }
 
 void PlayState::resetCamera()
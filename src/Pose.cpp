@@ -0,0 +1,78 @@
+#include "Pose.h"
+
+Pose::Pose()
+{
+
+}
+
+Pose::Pose(unsigned int numJoints)
+{
+   Resize(numJoints);
+}
+
+void Pose::Resize(unsigned int numJoints)
+{
+   mJoints.resize(numJoints);
+   mParents.resize(numJoints, -1);
+}
+
+unsigned int Pose::GetNumJoints() const
+{
+   return static_cast<unsigned int>(mJoints.size());
+}
+
+int Pose::GetParent(unsigned int jointIndex) const
+{
+   return mParents[jointIndex];
+}
+
+void Pose::SetParent(unsigned int jointIndex, int parentIndex)
+{
+   mParents[jointIndex] = parentIndex;
+}
+
+Transform Pose::GetLocalTransform(unsigned int jointIndex) const
+{
+   return mJoints[jointIndex];
+}
+
+void Pose::SetLocalTransform(unsigned int jointIndex, const Transform& transform)
+{
+   mJoints[jointIndex] = transform;
+}
+
+Transform Pose::GetGlobalTransform(unsigned int jointIndex) const
+{
+   // Combine the local transform of the joint with the local transforms of all its ancestors
+   Transform result = mJoints[jointIndex];
+   for (int parentIndex = mParents[jointIndex]; parentIndex >= 0; parentIndex = mParents[parentIndex])
+   {
+      result = combine(mJoints[parentIndex], result);
+   }
+
+   return result;
+}
+
+void Pose::GetMatrixPalette(std::vector<glm::mat4>& outMatrices) const
+{
+   unsigned int numJoints = GetNumJoints();
+   outMatrices.resize(numJoints);
+
+   for (unsigned int i = 0; i < numJoints; ++i)
+   {
+      int parentIndex = mParents[i];
+      if (parentIndex < 0)
+      {
+         outMatrices[i] = transformToMat4(mJoints[i]);
+      }
+      else if (parentIndex < static_cast<int>(i))
+      {
+         // The matrix of the parent has already been computed
+         outMatrices[i] = outMatrices[parentIndex] * transformToMat4(mJoints[i]);
+      }
+      else
+      {
+         outMatrices[i] = transformToMat4(GetGlobalTransform(i));
+      }
+   }
+}
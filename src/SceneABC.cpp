@@ -1,17 +1,49 @@
 #include "pch.h"
 #include "SceneGraph.h"
+#include "Parallel.h"
+#include "Subdivision.h"
+#include "VectorMathBatch.h"
+#include "FrameArena.h"
 
 namespace wabc {
 
+// vertex layout of a polymesh once its normals and uvs are taken into account.
+// points are split where the face corners that share them disagree on the normal or uv index (face-varying attributes).
+// the table only depends on topology, so it is built once and every seek just gathers points, normals and uvs through it.
+struct VertexRemap
+{
+    bool built = false;
+    bool heterogeneous = false; // topology changes every sample. the table has to be rebuilt on every seek.
+    int num_points = 0;
+    RawVector<int> corner_vertices; // output vertex of each face corner
+    RawVector<int> vertex_points;   // source point of each output vertex. the first num_points vertices are the points themselves.
+    RawVector<int> vertex_normals;  // source normal of each output vertex. empty if there are no normals. -1 if unused.
+    RawVector<int> vertex_uvs;      // source uv of each output vertex. empty if there are no uvs. -1 if unused.
+
+    // scratch buffers. kept here so that rebuilding the table does not allocate.
+    RawVector<int> corner_normals;
+    RawVector<int> corner_uvs;
+    RawVector<int> next_vertices;
+
+    int getNumVertices() const { return (int)vertex_points.size(); }
+    bool isSplit() const { return getNumVertices() > num_points; }
+};
+
+// refinement of a subdivision surface cage. shared by all the references of a source.
+struct SubDStencils
+{
+    bool heterogeneous = false; // topology changes every sample. the stencils have to be rebuilt on every seek.
+    uint64_t failed_topology = 0; // topology and level whose stencils could not be built (see buildStencils())
+    SubdivisionStencils stencils;
+};
+
 class SceneABC : public IScene
 {
 public:
     struct ImportContext
     {
         Abc::IObject obj;
-        double time = 0.0;
-        float4x4 local_matrix = float4x4::identity();
-        float4x4 global_matrix = float4x4::identity();
+        int parent = -1; // index in m_nodes
     };
 
     void release() override;
@@ -22,18 +54,55 @@ public:
 
     std::tuple<double, double> getTimeRange() const override;
     void seek(double time) override;
+    bool seekMany(span<double> times, span<float3> dst_points, span<CameraData> dst_cameras) override;
+
+    void setSubdivisionLevel(int level) override;
+    int getSubdivisionLevel() const override { return m_subdivision_level; }
 
     double getTime() const override { return m_time; }
     IMesh* getMesh() override { return m_mono_mesh.get(); }
     IPoints* getPoints() override { return m_mono_points.get(); }
+    span<IInstancedMesh*> getInstancedMeshes() override { return make_span(m_instanced_mesh_ptrs); }
     span<ICamera*> getCameras() override { return make_span(m_cameras); }
 
 private:
+    // flattened hierarchy built by scanNodes(). parents always come before their children.
+    struct Node
+    {
+        enum class Type
+        {
+            Other,
+            Xform,
+            Camera,
+            PolyMesh,
+            SubD,
+            Points,
+        };
+
+        Type type = Type::Other;
+        int parent = -1;
+        int camera_index = -1;
+        int instance_index = -1; // index in m_instanced_meshes if this mesh's geometry is shared with others
+        void* source = nullptr; // instances share the source's object reader
+        VertexRemap* remap = nullptr; // shared by all the instances of a source
+        SubDStencils* stencils = nullptr;
+        bool constant = false;
+        float4x4 constant_matrix = float4x4::identity(); // local matrix of constant xforms
+        AbcGeom::IXformSchema xform;
+        AbcGeom::ICameraSchema camera;
+        AbcGeom::IPolyMeshSchema mesh;
+        AbcGeom::ISubDSchema subd;
+        AbcGeom::IPointsSchema points;
+    };
+
     // ctx is not a reference. that is intended.
     void scanNodes(ImportContext ctx);
-    void seekImpl(ImportContext ctx);
+    void seekImpl(double time);
+    void setupInstances();
+    void evaluate(double time);
+    void buildStencils(SubDStencils& dst, AbcGeom::ISubDSchema& schema, const Abc::ISampleSelector& ss);
 
-    std::shared_ptr<std::fstream> m_stream;
+    std::vector<std::shared_ptr<std::fstream>> m_streams;
     Abc::IArchive m_archive;
 
     std::map<void*, size_t> m_sample_counts;
@@ -43,8 +112,16 @@ private:
     MeshPtr m_mono_mesh;
     PointsPtr m_mono_points;
 
+    std::map<void*, VertexRemap> m_remap_table; // source object reader -> vertex layout
+    std::map<void*, SubDStencils> m_stencil_table; // source object reader -> refinement
+    int m_subdivision_level = 2;
+    std::map<void*, size_t> m_instance_table; // source object reader -> index in m_instanced_meshes
+    std::vector<InstancedMeshPtr> m_instanced_meshes;
+    std::vector<IInstancedMesh*> m_instanced_mesh_ptrs;
+
     std::map<std::string, CameraPtr> m_camera_table;
     std::vector<ICamera*> m_cameras;
+    std::vector<Node> m_nodes;
 };
 
 
@@ -66,6 +143,296 @@ template<class Cont> inline auto expand(Cont& v, size_t n)
     return v.data() + pos;
 }
 
+// value index of each face corner of a geom param
+template<class GeomParam>
+static bool GetCornerValueIndices(RawVector<int>& dst, GeomParam param, const Abc::ISampleSelector& ss,
+    span<int32_t> counts, span<int32_t> indices)
+{
+    if (!param.valid())
+        return false;
+
+    Abc::UInt32ArraySamplePtr value_indices_sample;
+    if (param.isIndexed())
+        value_indices_sample = param.getIndexProperty().getValue(ss);
+    auto value_indices = make_span(value_indices_sample);
+
+    AbcGeom::GeometryScope scope = param.getScope();
+    int num_faces = (int)counts.size();
+    dst.resize(indices.size());
+    int ci = 0;
+    for (int fi = 0; fi < num_faces; ++fi) {
+        int c = counts[fi];
+        for (int i = 0; i < c; ++i, ++ci) {
+            int e;
+            switch (scope) {
+            case AbcGeom::kFacevaryingScope: e = ci; break;
+            case AbcGeom::kVaryingScope:
+            case AbcGeom::kVertexScope: e = indices[ci]; break;
+            case AbcGeom::kUniformScope: e = fi; break;
+            default: e = 0; break;
+            }
+            if (!value_indices.empty())
+                e = e < (int)value_indices.size() ? (int)value_indices[e] : -1;
+            dst[ci] = e;
+        }
+    }
+    return true;
+}
+
+static void BuildVertexRemap(VertexRemap& dst, AbcGeom::IPolyMeshSchema& schema, const Abc::ISampleSelector& ss,
+    span<int32_t> counts, span<int32_t> indices, int num_points)
+{
+    bool has_normals = GetCornerValueIndices(dst.corner_normals, schema.getNormalsParam(), ss, counts, indices);
+    bool has_uvs = GetCornerValueIndices(dst.corner_uvs, schema.getUVsParam(), ss, counts, indices);
+
+    int num_corners = (int)indices.size();
+    dst.built = true;
+    dst.num_points = num_points;
+    dst.corner_vertices.resize(num_corners);
+    dst.vertex_points.resize(num_points);
+    for (int pi = 0; pi < num_points; ++pi)
+        dst.vertex_points[pi] = pi;
+    dst.vertex_normals.clear();
+    dst.vertex_uvs.clear();
+    if (has_normals)
+        dst.vertex_normals.resize(num_points, -1);
+    if (has_uvs)
+        dst.vertex_uvs.resize(num_points, -1);
+
+    // vertices that are split from the same point form a chain. -2: the point has not been referenced yet.
+    dst.next_vertices.clear();
+    dst.next_vertices.resize(num_points, -2);
+
+    for (int ci = 0; ci < num_corners; ++ci) {
+        int pi = indices[ci];
+        if (pi < 0 || pi >= num_points) {
+            dst.corner_vertices[ci] = 0;
+            continue;
+        }
+        int ni = has_normals ? dst.corner_normals[ci] : -1;
+        int ui = has_uvs ? dst.corner_uvs[ci] : -1;
+
+        int vi = pi;
+        for (;;) {
+            if (dst.next_vertices[vi] == -2) {
+                if (has_normals)
+                    dst.vertex_normals[vi] = ni;
+                if (has_uvs)
+                    dst.vertex_uvs[vi] = ui;
+                dst.next_vertices[vi] = -1;
+                break;
+            }
+            if ((!has_normals || dst.vertex_normals[vi] == ni) && (!has_uvs || dst.vertex_uvs[vi] == ui))
+                break;
+            if (dst.next_vertices[vi] == -1) {
+                int new_vi = dst.getNumVertices();
+                dst.next_vertices[vi] = new_vi;
+                dst.next_vertices.push_back(-1);
+                dst.vertex_points.push_back(pi);
+                if (has_normals)
+                    dst.vertex_normals.push_back(ni);
+                if (has_uvs)
+                    dst.vertex_uvs.push_back(ui);
+                vi = new_vi;
+                break;
+            }
+            vi = dst.next_vertices[vi];
+        }
+        dst.corner_vertices[ci] = vi;
+    }
+}
+
+// appends faces whose vertices have already been appended to dst.m_points at index_offset.
+// indices are relative to index_offset. normals can be null.
+static void AppendFaces(Mesh& dst, span<int32_t> counts, const int* src_indices, int index_offset, const float3* normals)
+{
+    int num_faces = (int)counts.size();
+    int num_indices = 0;
+    for (int c : counts)
+        num_indices += c;
+
+    // count primitives and allocate space
+    int num_lines = 0;
+    int num_triangles = 0;
+    for (int c : counts) {
+        if (c == 2) {
+            num_lines += 1;
+        }
+        else if (c >= 3) {
+            num_triangles += c - 2;
+            num_lines += c;
+        }
+    }
+
+
+    const float3* src_points = dst.m_points.data() + index_offset;
+    int* dst_counts = expand(dst.m_counts, num_faces);
+    int* dst_findices = expand(dst.m_face_indices, num_indices);
+    int* dst_windices = expand(dst.m_wireframe_indices, num_lines * 2);
+    float3* dst_points_ex = expand(dst.m_points_ex, num_triangles * 3);
+    float3* dst_normals_ex = normals && dst.m_normals_ex.size() + num_triangles * 3 == dst.m_points_ex.size() ?
+        expand(dst.m_normals_ex, num_triangles * 3) : nullptr;
+
+    // setup indices & vertices
+
+    for (int i = 0; i < num_faces; ++i)
+        dst_counts[i] = counts[i];
+
+    for (int i = 0; i < num_indices; ++i)
+        dst_findices[i] = src_indices[i] + index_offset;
+
+    for (int c : counts) {
+        if (c == 2) {
+            // add wire frame indices
+            *dst_windices++ = src_indices[0] + index_offset;
+            *dst_windices++ = src_indices[1] + index_offset;
+        }
+        else if (c > 2) {
+            // add wire frame indices
+            for (int fi = 0; fi < c; ++fi) {
+                *dst_windices++ = src_indices[fi] + index_offset;
+                *dst_windices++ = (fi == c - 1 ? src_indices[0] : src_indices[fi + 1]) + index_offset;
+            }
+
+            // add triangle vertices
+            // todo: handle flip faces option
+            for (int fi = 0; fi < c - 2; ++fi) {
+                int i0 = src_indices[0];
+                int i1 = src_indices[1 + fi];
+                int i2 = src_indices[2 + fi];
+                *dst_points_ex++ = src_points[i0];
+                *dst_points_ex++ = src_points[i1];
+                *dst_points_ex++ = src_points[i2];
+                if (dst_normals_ex) {
+                    *dst_normals_ex++ = normals[i0];
+                    *dst_normals_ex++ = normals[i1];
+                    *dst_normals_ex++ = normals[i2];
+                }
+            }
+        }
+        src_indices += c;
+    }
+}
+
+static void AppendPolyMesh(Mesh& dst, AbcGeom::IPolyMeshSchema& schema, const Abc::ISampleSelector& ss,
+    VertexRemap& remap, const float4x4* matrix)
+{
+    AbcGeom::IPolyMeshSchema::Sample sample;
+    schema.get(sample, ss);
+    auto counts = make_span(sample.getFaceCounts());
+    auto indices = make_span(sample.getFaceIndices());
+    auto points = make_span(sample.getPositions());
+
+    int num_points = (int)points.size();
+    if (!remap.built || remap.heterogeneous || remap.num_points != num_points)
+        BuildVertexRemap(remap, schema, ss, counts, indices, num_points);
+
+    // make points in global space (or keep them in local space if matrix is null)
+    // the first num_points vertices are the points themselves. split vertices follow them.
+    int num_vertices = remap.getNumVertices();
+    int index_offset = (int)dst.m_points.size();
+    float3* dst_points = expand(dst.m_points, num_vertices);
+    if (matrix) {
+        mul_p({ dst_points, (size_t)num_points }, { (float3*)points.data(), (size_t)num_points }, *matrix);
+    }
+    else {
+        memcpy(dst_points, points.data(), sizeof(float3) * num_points);
+    }
+    for (int vi = num_points; vi < num_vertices; ++vi)
+        dst_points[vi] = dst_points[remap.vertex_points[vi]];
+
+    // gather authored normals and uvs. they are kept only if every mesh so far has them, so that they stay
+    // in sync with m_points. SceneABC::seek() drops them if a later mesh does not have them.
+    float3* dst_normals = nullptr;
+    if (!remap.vertex_normals.empty() && (int)dst.m_normals.size() == index_offset) {
+        Abc::N3fArraySamplePtr normals_sample = schema.getNormalsParam().getValueProperty().getValue(ss);
+        auto normals = make_span(normals_sample);
+        int num_normals = (int)normals.size();
+
+        dst_normals = expand(dst.m_normals, num_vertices);
+        for (int vi = 0; vi < num_vertices; ++vi) {
+            int ni = remap.vertex_normals[vi];
+            dst_normals[vi] = ni >= 0 && ni < num_normals ? (float3&)normals[ni] : float3{};
+        }
+        if (matrix) {
+            // normals take the inverse transpose of the matrix, or non-uniform scales and shears would skew them.
+            // mul_v() only reads the upper 3x3, which for an affine matrix is the inverse transpose of the upper 3x3.
+            float4x4 normal_matrix = transpose(invert(*matrix));
+            span<float3> n{ dst_normals, (size_t)num_vertices };
+            mul_v(n, n, normal_matrix);
+            normalize(n, n);
+        }
+    }
+    if (!remap.vertex_uvs.empty() && (int)dst.m_uvs.size() == index_offset) {
+        Abc::V2fArraySamplePtr uvs_sample = schema.getUVsParam().getValueProperty().getValue(ss);
+        auto uvs = make_span(uvs_sample);
+        int num_uvs = (int)uvs.size();
+
+        float2* dst_uvs = expand(dst.m_uvs, num_vertices);
+        for (int vi = 0; vi < num_vertices; ++vi) {
+            int ui = remap.vertex_uvs[vi];
+            dst_uvs[vi] = ui >= 0 && ui < num_uvs ? (float2&)uvs[ui] : float2{};
+        }
+    }
+
+    AppendFaces(dst, counts, remap.corner_vertices.data(), index_offset, dst_normals);
+}
+
+// fnv-1a of the faces of a cage and of the subdivision level
+static uint64_t HashTopology(span<int32_t> counts, span<int32_t> indices, int num_points, int level)
+{
+    uint64_t h = 0xcbf29ce484222325ull;
+    auto hash = [&h](const void* data, size_t size) {
+        const uint8_t* p = (const uint8_t*)data;
+        for (size_t i = 0; i < size; ++i) {
+            h ^= p[i];
+            h *= 0x100000001b3ull;
+        }
+    };
+    hash(counts.data(), counts.size_bytes());
+    hash(indices.data(), indices.size_bytes());
+    hash(&num_points, sizeof(num_points));
+    hash(&level, sizeof(level));
+    return h;
+}
+
+static void AppendSubD(Mesh& dst, span<float3> points, const SubdivisionStencils& stencils, const float4x4& matrix)
+{
+    int num_points = stencils.getNumDstPoints();
+    if (num_points == 0)
+        return;
+
+    int index_offset = (int)dst.m_points.size();
+    float3* dst_points = expand(dst.m_points, num_points);
+    span<float3> refined{ dst_points, (size_t)num_points };
+    stencils.refine(refined, points);
+    mul_p(refined, refined, matrix);
+
+    AppendFaces(dst, stencils.getCounts(), stencils.getIndices().data(), index_offset, nullptr);
+}
+
+static CameraData ToCameraData(const float4x4& global_matrix, const AbcGeom::CameraSample& sample)
+{
+    CameraData ret;
+    ret.position = extract_position(global_matrix);
+    ret.direction = normalize(mul_v(global_matrix, float3{ 0.0f, 0.0f, -1.0f }));
+    ret.up = normalize(mul_v(global_matrix, float3{ 0.0f, 1.0f, 0.0f }));
+
+    ret.focal_length = (float)sample.getFocalLength();
+    ret.aperture = float2{
+        (float)sample.getHorizontalAperture(),
+        (float)sample.getVerticalAperture()
+    } *10.0f; // cm to mm
+    ret.lens_shift = float2{
+        (float)(sample.getHorizontalFilmOffset() / sample.getHorizontalAperture()),
+        (float)(sample.getVerticalFilmOffset() / sample.getVerticalAperture())
+    };
+
+    ret.near_plane = std::max((float)sample.getNearClippingPlane(), 0.01f);
+    ret.far_plane = std::max((float)sample.getFarClippingPlane(), ret.near_plane);
+    return ret;
+}
+
 
 void SceneABC::release()
 {
@@ -75,7 +442,7 @@ void SceneABC::release()
 void SceneABC::unload()
 {
     m_archive = {};
-    m_stream = {};
+    m_streams = {};
 
     m_sample_counts = {};
     m_time_range = {};
@@ -84,8 +451,15 @@ void SceneABC::unload()
     m_mono_mesh = {};
     m_mono_points = {};
 
+    m_remap_table = {};
+    m_stencil_table = {};
+    m_instance_table = {};
+    m_instanced_meshes = {};
+    m_instanced_mesh_ptrs = {};
+
     m_cameras = {};
     m_camera_table = {};
+    m_nodes = {};
 }
 
 bool SceneABC::load(const char* path)
@@ -96,14 +470,20 @@ bool SceneABC::load(const char* path)
     {
         // Abc::IArchive doesn't accept wide string path. so create file stream with wide string path and pass it.
         // (VisualC++'s std::ifstream accepts wide string)
-        m_stream.reset(new std::fstream());
-        m_stream->open(path, std::ios::in | std::ios::binary);
-        if (!m_stream->is_open()) {
-            unload();
-            return false;
+        // Ogawa gives each reading thread its own stream, so open as many as seekMany() can use.
+        std::vector<std::istream*> streams;
+        size_t num_streams = GetConcurrency();
+        for (size_t si = 0; si < num_streams; ++si) {
+            std::shared_ptr<std::fstream> stream(new std::fstream());
+            stream->open(path, std::ios::in | std::ios::binary);
+            if (!stream->is_open()) {
+                unload();
+                return false;
+            }
+            m_streams.push_back(stream);
+            streams.push_back(stream.get());
         }
 
-        std::vector<std::istream*> streams{ m_stream.get() };
         Alembic::AbcCoreOgawa::ReadArchive archive_reader(streams);
         m_archive = Abc::IArchive(archive_reader(path), Abc::kWrapExisting, Abc::ErrorHandler::kThrowPolicy);
     }
@@ -140,6 +520,7 @@ bool SceneABC::load(const char* path)
         ImportContext ctx;
         ctx.obj = m_archive.getTop();
         scanNodes(ctx);
+        setupInstances();
 
         // setup time range
         m_time_range = { 0.0, 0.0 };
@@ -209,10 +590,25 @@ void SceneABC::scanNodes(ImportContext ctx)
     };
 
     auto obj = ctx.obj;
+    int node_index = (int)m_nodes.size();
+    m_nodes.push_back({});
+    Node& node = m_nodes.back();
+    node.parent = ctx.parent;
+
     const auto& metadata = obj.getMetaData();
     if (AbcGeom::IXformSchema::matches(metadata)) {
         auto schema = AbcGeom::IXform(obj).getSchema();
         update_sample_count(schema);
+
+        node.type = Node::Type::Xform;
+        node.xform = schema;
+        node.constant = schema.isConstant();
+        if (node.constant) {
+            AbcGeom::XformSample sample;
+            schema.get(sample);
+            auto m = sample.getMatrix();
+            node.constant_matrix.assign((double4x4&)m);
+        }
     }
     else if (AbcGeom::ICameraSchema::matches(metadata)) {
         auto schema = AbcGeom::ICamera(obj).getSchema();
@@ -222,18 +618,60 @@ void SceneABC::scanNodes(ImportContext ctx)
         cam->m_path = obj.getFullName();
         m_camera_table[cam->m_path] = cam;
         m_cameras.push_back(cam.get());
+
+        node.type = Node::Type::Camera;
+        node.camera = schema;
+        node.camera_index = (int)m_cameras.size() - 1;
     }
     else if (AbcGeom::IPolyMeshSchema::matches(metadata)) {
         auto schema = AbcGeom::IPolyMesh(obj).getSchema();
         update_sample_count(schema);
+
+        node.type = Node::Type::PolyMesh;
+        node.mesh = schema;
+        node.source = obj.getPtr().get();
+
+        // build the vertex layout from the first sample. it holds for every sample unless the topology changes.
+        auto ins = m_remap_table.insert({ node.source, VertexRemap() });
+        node.remap = &ins.first->second;
+        if (ins.second) {
+            node.remap->heterogeneous = schema.getTopologyVariance() == AbcGeom::kHeterogeneousTopology;
+            if (!node.remap->heterogeneous && schema.getNumSamples() > 0) {
+                Abc::ISampleSelector ss;
+                auto counts = schema.getFaceCountsProperty().getValue(ss);
+                auto indices = schema.getFaceIndicesProperty().getValue(ss);
+                int num_points = (int)schema.getPositionsProperty().getValue(ss)->size();
+                BuildVertexRemap(*node.remap, schema, ss, make_span(counts), make_span(indices), num_points);
+            }
+        }
+    }
+    else if (AbcGeom::ISubDSchema::matches(metadata)) {
+        auto schema = AbcGeom::ISubD(obj).getSchema();
+        update_sample_count(schema);
+
+        node.type = Node::Type::SubD;
+        node.subd = schema;
+        node.source = obj.getPtr().get();
+
+        auto ins = m_stencil_table.insert({ node.source, SubDStencils() });
+        node.stencils = &ins.first->second;
+        if (ins.second) {
+            node.stencils->heterogeneous = schema.getTopologyVariance() == AbcGeom::kHeterogeneousTopology;
+            if (!node.stencils->heterogeneous && schema.getNumSamples() > 0)
+                buildStencils(*node.stencils, schema, Abc::ISampleSelector());
+        }
     }
     else if (AbcGeom::IPointsSchema::matches(metadata)) {
         auto schema = AbcGeom::IPoints(obj).getSchema();
         update_sample_count(schema);
+
+        node.type = Node::Type::Points;
+        node.points = schema;
     }
     else {
     }
 
+    ctx.parent = node_index;
     size_t n = obj.getNumChildren();
     for (size_t ci = 0; ci < n; ++ci) {
         ctx.obj = obj.getChild(ci);
@@ -241,162 +679,301 @@ void SceneABC::scanNodes(ImportContext ctx)
     }
 }
 
+// meshes whose object reader is referenced more than once are instanced.
+// they are decoded once per seek and exposed with one matrix per instance instead of being flattened into m_mono_mesh.
+void SceneABC::setupInstances()
+{
+    std::map<void*, int> ref_counts;
+    for (auto& node : m_nodes) {
+        if (node.type == Node::Type::PolyMesh)
+            ++ref_counts[node.source];
+    }
+
+    for (auto& node : m_nodes) {
+        if (node.type != Node::Type::PolyMesh || ref_counts[node.source] < 2)
+            continue;
+
+        auto it = m_instance_table.find(node.source);
+        if (it == m_instance_table.end()) {
+            it = m_instance_table.insert({ node.source, m_instanced_meshes.size() }).first;
+            auto inst = std::make_shared<InstancedMesh>();
+            m_instanced_meshes.push_back(inst);
+            m_instanced_mesh_ptrs.push_back(inst.get());
+        }
+        node.instance_index = (int)it->second;
+    }
+}
+
 void SceneABC::seek(double time)
 {
     if (!m_archive || time == m_time)
         return;
 
-    m_time = time;
-    m_mono_mesh->clear();
-    m_mono_points->clear();
-
-    ImportContext ctx;
-    ctx.obj = m_archive.getTop();
-    ctx.time = time;
-    seekImpl(ctx);
+    evaluate(time);
 }
 
-void SceneABC::seekImpl(ImportContext ctx)
+// stencils are rebuilt for the new level and the current time is evaluated again,
+// so getMesh() reflects the new level right away.
+void SceneABC::setSubdivisionLevel(int level)
 {
-    auto obj = ctx.obj;
-    auto ss = Abc::ISampleSelector(ctx.time);
+    level = clamp(level, 0, SubdivisionStencils::kMaxLevel);
+    if (level == m_subdivision_level)
+        return;
 
-    const auto& metadata = obj.getMetaData();
-    if (AbcGeom::IXformSchema::matches(metadata)) {
-        auto schema = AbcGeom::IXform(obj).getSchema();
+    m_subdivision_level = level;
+    if (!m_archive)
+        return;
 
-        AbcGeom::XformSample sample;
-        schema.get(sample, ss);
-        auto m = sample.getMatrix();
-        ctx.local_matrix.assign((double4x4&)m);
-        ctx.global_matrix = ctx.local_matrix * ctx.global_matrix;
+    for (auto& node : m_nodes) {
+        if (node.type == Node::Type::SubD && !node.stencils->heterogeneous && node.subd.getNumSamples() > 0 &&
+            node.stencils->stencils.getLevel() != level)
+            buildStencils(*node.stencils, node.subd, Abc::ISampleSelector());
     }
-    else if (AbcGeom::ICameraSchema::matches(metadata)) {
-        auto schema = AbcGeom::ICamera(obj).getSchema();
+    evaluate(m_time);
+}
 
-        AbcGeom::CameraSample sample;
-        schema.get(sample, ss);
-
-        auto& dst = m_camera_table[obj.getFullName()];
-        if (dst) {
-            float3 pos = extract_position(ctx.global_matrix);
-            float3 dir = normalize(mul_v(ctx.global_matrix, float3{ 0.0f, 0.0f, -1.0f }));
-            float3 up = normalize(mul_v(ctx.global_matrix, float3{ 0.0f, 1.0f, 0.0f }));
-
-            dst->m_position = pos;
-            dst->m_direction = dir;
-            dst->m_up = up;
-
-            dst->m_focal_length = (float)sample.getFocalLength();
-            dst->m_aperture = float2{
-                (float)sample.getHorizontalAperture(),
-                (float)sample.getVerticalAperture()
-            } *10.0f; // cm to mm
-            dst->m_lens_shift = float2{
-                (float)(sample.getHorizontalFilmOffset() / sample.getHorizontalAperture()),
-                (float)(sample.getVerticalFilmOffset() / sample.getVerticalAperture())
-            };
-
-            dst->m_near = std::max((float)sample.getNearClippingPlane(), 0.01f);
-            dst->m_far = std::max((float)sample.getFarClippingPlane(), dst->m_near);
-        }
-        else {
-            // should not be here
-        }
+void SceneABC::buildStencils(SubDStencils& dst, AbcGeom::ISubDSchema& schema, const Abc::ISampleSelector& ss)
+{
+    auto counts = schema.getFaceCountsProperty().getValue(ss);
+    auto indices = schema.getFaceIndicesProperty().getValue(ss);
+    int num_points = (int)schema.getPositionsProperty().getValue(ss)->size();
+
+    // a topology that failed once is neither built nor reported again. the cage is refined at level 0 instead, which
+    // only triangulates it, so the mesh is drawn unsubdivided and seek() finds stencils that match its points.
+    uint64_t topology = HashTopology(make_span(counts), make_span(indices), num_points, m_subdivision_level);
+    if (topology != dst.failed_topology) {
+        if (dst.stencils.build(make_span(counts), make_span(indices), num_points, m_subdivision_level))
+            return;
+        printf("SceneABC::buildStencils(): failed to build stencils, the mesh is drawn unsubdivided\n");
+        dst.failed_topology = topology;
     }
-    else if (AbcGeom::IPolyMeshSchema::matches(metadata)) {
-        auto schema = AbcGeom::IPolyMesh(obj).getSchema();
+    dst.stencils.build(make_span(counts), make_span(indices), num_points, 0);
+}
+
+void SceneABC::evaluate(double time)
+{
+    m_time = time;
+    m_mono_mesh->clear();
+    m_mono_points->clear();
+    for (auto& inst : m_instanced_meshes)
+        inst->clear();
+
+    seekImpl(time);
+
+    // authored normals and uvs are all or nothing. AlembicMesh computes normals if there are none.
+    auto& mesh = *m_mono_mesh;
+    if (mesh.m_normals.size() != mesh.m_points.size())
+        mesh.m_normals.clear();
+    if (mesh.m_normals_ex.size() != mesh.m_points_ex.size())
+        mesh.m_normals_ex.clear();
+    if (mesh.m_uvs.size() != mesh.m_points.size())
+        mesh.m_uvs.clear();
+}
 
-        AbcGeom::IPolyMeshSchema::Sample sample;
-        schema.get(sample, ss);
-        auto counts = make_span(sample.getFaceCounts());
-        auto indices = make_span(sample.getFaceIndices());
-        auto points = make_span(sample.getPositions());
-
-        // make points in global space
-        int num_faces = (int)counts.size();
-        int num_indices = (int)indices.size();
-        int num_points = (int)points.size();
-        int index_offset = (int)m_mono_mesh->m_points.size();
-        float3* dst_points = expand(m_mono_mesh->m_points, num_points);
-        for (int i = 0; i < num_points; ++i)
-            dst_points[i] = mul_p(ctx.global_matrix, (float3&)points[i]);
-
-        // count primitives and allocate space
-        int num_lines = 0;
-        int num_triangles = 0;
-        for (int c : counts) {
-            if (c == 2) {
-                num_lines += 1;
+// walks the node list built by scanNodes() instead of the object hierarchy, so the schemas, vertex layouts,
+// stencils and instance slots are all at hand and nothing has to be looked up or opened again.
+void SceneABC::seekImpl(double time)
+{
+    auto ss = Abc::ISampleSelector(time);
+    size_t num_nodes = m_nodes.size();
+
+    FrameArenaScope scope;
+    RawVector<float4x4> global_matrices(GetFrameArena());
+    global_matrices.resize(num_nodes);
+
+    for (size_t ni = 0; ni < num_nodes; ++ni) {
+        Node& node = m_nodes[ni];
+        const float4x4& parent_matrix = node.parent >= 0 ? global_matrices[node.parent] : float4x4::identity();
+        float4x4& global_matrix = global_matrices[ni];
+        global_matrix = parent_matrix;
+
+        switch (node.type) {
+        case Node::Type::Xform:
+            if (node.constant) {
+                global_matrix = node.constant_matrix * parent_matrix;
             }
-            else if (c >= 3) {
-                num_triangles += c - 2;
-                num_lines += c;
+            else {
+                AbcGeom::XformSample sample;
+                node.xform.get(sample, ss);
+                auto m = sample.getMatrix();
+                float4x4 local_matrix;
+                local_matrix.assign((double4x4&)m);
+                global_matrix = local_matrix * parent_matrix;
             }
-        }
+            break;
 
+        case Node::Type::Camera:
+        {
+            AbcGeom::CameraSample sample;
+            node.camera.get(sample, ss);
+
+            auto* dst = static_cast<Camera*>(m_cameras[node.camera_index]);
+            CameraData data = ToCameraData(global_matrix, sample);
+            dst->m_position = data.position;
+            dst->m_direction = data.direction;
+            dst->m_up = data.up;
+            dst->m_focal_length = data.focal_length;
+            dst->m_aperture = data.aperture;
+            dst->m_lens_shift = data.lens_shift;
+            dst->m_near = data.near_plane;
+            dst->m_far = data.far_plane;
+            break;
+        }
 
-        const float3* src_points = dst_points;
-        const int* src_indices = indices.data();
-        int* dst_counts = expand(m_mono_mesh->m_counts, num_faces);
-        int* dst_findices = expand(m_mono_mesh->m_face_indices, num_indices);
-        int* dst_windices = expand(m_mono_mesh->m_wireframe_indices, num_lines * 2);
-        float3* dst_points_ex = expand(m_mono_mesh->m_points_ex, num_triangles * 3);
+        case Node::Type::PolyMesh:
+            if (node.instance_index >= 0) {
+                // instanced geometry is decoded once, in local space, by its first reference in this seek
+                auto& dst = m_instanced_meshes[node.instance_index];
+                if (dst->m_matrices.empty())
+                    AppendPolyMesh(dst->m_mesh, node.mesh, ss, *node.remap, nullptr);
+                dst->m_matrices.push_back(global_matrix);
+            }
+            else {
+                AppendPolyMesh(*m_mono_mesh, node.mesh, ss, *node.remap, &global_matrix);
+            }
+            break;
 
-        // setup indices & vertices
+        case Node::Type::SubD:
+        {
+            auto& dst = *node.stencils;
+            auto points = node.subd.getPositionsProperty().getValue(ss);
+            if (dst.heterogeneous || dst.stencils.getNumSrcPoints() != (int)points->size())
+                buildStencils(dst, node.subd, ss);
+            auto src = make_span(points);
+            AppendSubD(*m_mono_mesh, { (float3*)src.data(), src.size() }, dst.stencils, global_matrix);
+            break;
+        }
 
-        for (int i = 0; i < num_faces; ++i)
-            dst_counts[i] = counts[i];
+        case Node::Type::Points:
+        {
+            AbcGeom::IPointsSchema::Sample sample;
+            node.points.get(sample, ss);
 
-        for (int i = 0; i < num_indices; ++i)
-            dst_findices[i] = src_indices[i] + index_offset;
+            auto points_orig = make_span(sample.getPositions());
+            size_t num_points = points_orig.size();
 
-        for (int c : counts) {
-            if (c == 2) {
-                // add wire frame indices
-                *dst_windices++ = src_indices[0] + index_offset;
-                *dst_windices++ = src_indices[1] + index_offset;
-            }
-            else if (c > 2) {
-                // add wire frame indices
-                for (int fi = 0; fi < c; ++fi) {
-                    *dst_windices++ = src_indices[fi] + index_offset;
-                    *dst_windices++ = (fi == c - 1 ? src_indices[0] : src_indices[fi + 1]) + index_offset;
-                }
+            float3* points = expand(m_mono_points->m_points, num_points);
+            mul_p({ points, num_points }, { (float3*)points_orig.data(), num_points }, global_matrix);
+            break;
+        }
 
-                // add triangle vertices
-                // todo: handle flip faces option
-                for (int fi = 0; fi < c - 2; ++fi) {
-                    int i0 = src_indices[0];
-                    int i1 = src_indices[1 + fi];
-                    int i2 = src_indices[2 + fi];
-                    *dst_points_ex++ = src_points[i0];
-                    *dst_points_ex++ = src_points[i1];
-                    *dst_points_ex++ = src_points[i2];
-                }
-            }
-            src_indices += c;
+        default:
+            break;
         }
     }
-    else if (AbcGeom::IPointsSchema::matches(metadata)) {
-        auto schema = AbcGeom::IPoints(obj).getSchema();
+}
 
-        AbcGeom::IPointsSchema::Sample sample;
-        schema.get(sample, ss);
+bool SceneABC::seekMany(span<double> times, span<float3> dst_points, span<CameraData> dst_cameras)
+{
+    size_t num_times = times.size();
+    if (!m_archive || num_times == 0)
+        return false;
+
+    size_t points_stride = dst_points.size() / num_times;
+    size_t num_cameras = m_cameras.size();
+    bool want_cameras = !dst_cameras.empty() && num_cameras > 0;
+    if (want_cameras && dst_cameras.size() < num_cameras * num_times) {
+        printf("SceneABC::seekMany(): dst_cameras is too small\n");
+        return false;
+    }
 
-        auto points_orig = make_span(sample.getPositions());
-        size_t num_points = points_orig.size();
+    std::atomic<bool> ok{ true };
+    size_t num_nodes = m_nodes.size();
 
-        float3* points = expand(m_mono_points->m_points, num_points);
-        for (size_t i = 0; i < num_points; ++i)
-            points[i] = mul_p(ctx.global_matrix, (float3&)points_orig[i]);
-    }
+    // every time is independent. the node list and constant transforms are shared by all of them.
+    ParallelFor(num_times, 1, [&](size_t begin, size_t end) {
+        RawVector<float4x4> global_matrices;
+        global_matrices.resize(num_nodes);
 
-    size_t n = obj.getNumChildren();
-    for (size_t ci = 0; ci < n; ++ci) {
-        ctx.obj = obj.getChild(ci);
-        seekImpl(ctx);
-    }
+        for (size_t ti = begin; ti < end; ++ti) {
+            auto ss = Abc::ISampleSelector(times[ti]);
+            float3* dst = dst_points.data() + points_stride * ti;
+            size_t num_points = 0;
+
+            for (size_t ni = 0; ni < num_nodes; ++ni) {
+                const Node& node = m_nodes[ni];
+                const float4x4& parent_matrix = node.parent >= 0 ? global_matrices[node.parent] : float4x4::identity();
+                float4x4& global_matrix = global_matrices[ni];
+
+                switch (node.type) {
+                case Node::Type::Xform:
+                    if (node.constant) {
+                        global_matrix = node.constant_matrix * parent_matrix;
+                    }
+                    else {
+                        AbcGeom::XformSample sample;
+                        node.xform.get(sample, ss);
+                        auto m = sample.getMatrix();
+                        float4x4 local_matrix;
+                        local_matrix.assign((double4x4&)m);
+                        global_matrix = local_matrix * parent_matrix;
+                    }
+                    break;
+
+                case Node::Type::Camera:
+                    global_matrix = parent_matrix;
+                    if (want_cameras) {
+                        AbcGeom::CameraSample sample;
+                        node.camera.get(sample, ss);
+                        dst_cameras[num_cameras * ti + node.camera_index] = ToCameraData(global_matrix, sample);
+                    }
+                    break;
+
+                case Node::Type::PolyMesh:
+                    global_matrix = parent_matrix;
+                    // instanced geometry is not part of the monolithic mesh
+                    if (points_stride > 0 && node.instance_index < 0) {
+                        // positions only. counts and indices are not needed here.
+                        // points are split with the vertex layout built at load time, as seek() does.
+                        // meshes with changing topology have no such layout and are written unsplit.
+                        auto points = make_span(node.mesh.getPositionsProperty().getValue(ss));
+                        const VertexRemap& remap = *node.remap;
+                        bool split = remap.built && !remap.heterogeneous && remap.num_points == (int)points.size();
+                        size_t n = split ? (size_t)remap.getNumVertices() : points.size();
+                        if (num_points + n > points_stride) {
+                            ok = false;
+                            n = points_stride - num_points;
+                        }
+                        // the points themselves come first and are transformed in bulk. split vertices are gathered.
+                        size_t np = std::min(n, points.size());
+                        mul_p({ dst + num_points, np }, { (float3*)points.data(), np }, global_matrix);
+                        for (size_t i = np; i < n; ++i)
+                            dst[num_points + i] = mul_p(global_matrix, (float3&)points[remap.vertex_points[i]]);
+                        num_points += n;
+                    }
+                    break;
+
+                case Node::Type::SubD:
+                    global_matrix = parent_matrix;
+                    if (points_stride > 0) {
+                        // stencils of meshes with changing topology are not known ahead. they are skipped.
+                        auto points = make_span(node.subd.getPositionsProperty().getValue(ss));
+                        const auto& stencils = node.stencils->stencils;
+                        if (node.stencils->heterogeneous || stencils.getNumSrcPoints() != (int)points.size())
+                            break;
+                        size_t n = stencils.getNumDstPoints();
+                        if (num_points + n > points_stride) {
+                            ok = false;
+                            break;
+                        }
+                        span<float3> refined{ dst + num_points, n };
+                        stencils.refine(refined, { (float3*)points.data(), points.size() });
+                        mul_p(refined, refined, global_matrix);
+                        num_points += n;
+                    }
+                    break;
+
+                default:
+                    global_matrix = parent_matrix;
+                    break;
+                }
+            }
+        }
+    });
+
+    if (!ok)
+        printf("SceneABC::seekMany(): mesh did not fit in the points stride\n");
+    return ok;
 }
 
 IScene* CreateSceneABC_()
@@ -1,6 +1,7 @@
 #include "pch.h"
 #include "WebAlembicViewer.h"
 #include "SceneGraph.h"
+#include "Parallel.h"
 
 namespace wabc {
 
@@ -8,35 +9,74 @@ namespace wabc {
 template<class Vec, class Mul>
 bool Skin::deformImpl(span<Vec> dst, span<Vec> src, const Mul& mul) const
 {
-    if (m_counts.size() != src.size() || m_counts.size() != dst.size()) {
-        printf("Skin::deformImpl(): vertex count mismatch\n");
-        return false;
-    }
-
     const JointWeight* weights = m_weights.data();
-    size_t nvertices = src.size();
-    for (size_t vi = 0; vi < nvertices; ++vi) {
-        Vec p = src[vi];
-        Vec r{};
-        int cjoints = m_counts[vi];
-        for (int bi = 0; bi < cjoints; ++bi) {
-            JointWeight w = weights[bi];
-            r += mul(m_matrices[w.index], p) * w.weight;
+    const int* offsets = m_weight_offsets.data();
+    ParallelFor(src.size(), 4096, [&](size_t begin, size_t end) {
+        for (size_t vi = begin; vi < end; ++vi) {
+            Vec p = src[vi];
+            Vec r{};
+            const JointWeight* vw = weights + offsets[vi];
+            int cjoints = m_counts[vi];
+            for (int bi = 0; bi < cjoints; ++bi) {
+                JointWeight w = vw[bi];
+                r += mul(m_matrices[w.index], p) * w.weight;
+            }
+            dst[vi] = r;
         }
-        dst[vi] = r;
-        weights += cjoints;
-    }
+    });
     return true;
 }
 
+void Skin::setupInfluences() const
+{
+    int width = GetSkinningWidth(make_span(m_counts));
+    if (width > 0) {
+        m_influences.pack(make_span(m_counts), make_span(m_weights), width);
+        m_weight_offsets.clear();
+    }
+    else {
+        m_influences.clear();
+        size_t nvertices = m_counts.size();
+        m_weight_offsets.resize(nvertices);
+        int offset = 0;
+        for (size_t vi = 0; vi < nvertices; ++vi) {
+            m_weight_offsets[vi] = offset;
+            offset += m_counts[vi];
+        }
+    }
+    m_influences_ready = true;
+}
+
 bool Skin::deformPoints(span<float3> dst, span<float3> src) const
 {
+    if (m_counts.size() != src.size() || m_counts.size() != dst.size()) {
+        printf("Skin::deformPoints(): vertex count mismatch\n");
+        return false;
+    }
+    if (!m_influences_ready)
+        setupInfluences();
+
+    if (m_influences.width > 0) {
+        SkinPoints(dst, src, make_span(m_matrices), m_influences);
+        return true;
+    }
     return deformImpl(dst, src,
         [](float4x4 m, float3 p) { return mul_p(m, p); });
 }
 
 bool Skin::deformNormals(span<float3> dst, span<float3> src) const
 {
+    if (m_counts.size() != src.size() || m_counts.size() != dst.size()) {
+        printf("Skin::deformNormals(): vertex count mismatch\n");
+        return false;
+    }
+    if (!m_influences_ready)
+        setupInfluences();
+
+    if (m_influences.width > 0) {
+        SkinNormals(dst, src, make_span(m_matrices), m_influences);
+        return true;
+    }
     return deformImpl(dst, src,
         [](float4x4 m, float3 p) { return mul_v(m, p); });
 }
@@ -46,10 +86,12 @@ bool BlendShape::deformPoints(span<float3> dst, span<float3> src, float w) const
 {
     if (dst.data() != src.data())
         memcpy(dst.data(), src.data(), src.size_bytes());
+    if (w == 0.0f)
+        return true;
 
     size_t c = m_indices.size();
     for (size_t i = 0; i < c; ++i)
-        dst[m_indices[i]] += m_delta_points[i];
+        dst[m_indices[i]] += m_delta_points[i] * w;
     return true;
 }
 
@@ -57,14 +99,31 @@ bool BlendShape::deformNormals(span<float3> dst, span<float3> src, float w) cons
 {
     if (dst.data() != src.data())
         memcpy(dst.data(), src.data(), src.size_bytes());
+    if (w == 0.0f || m_delta_normals.empty())
+        return true;
 
     size_t c = m_indices.size();
     for (size_t i = 0; i < c; ++i)
-        dst[m_indices[i]] += m_delta_normals[i];
+        dst[m_indices[i]] += m_delta_normals[i] * w;
     return true;
 }
 
+
+sfbx::Allocator* GetMeshAllocator()
+{
+    static sfbx::HeapAllocator s_instance("mesh", 64);
+    return &s_instance;
+}
+
 Mesh::Mesh()
+    : m_points(GetMeshAllocator())
+    , m_normals(GetMeshAllocator())
+    , m_uvs(GetMeshAllocator())
+    , m_points_ex(GetMeshAllocator())
+    , m_normals_ex(GetMeshAllocator())
+    , m_counts(GetMeshAllocator())
+    , m_face_indices(GetMeshAllocator())
+    , m_wireframe_indices(GetMeshAllocator())
 {
 
 }
@@ -79,6 +138,7 @@ void Mesh::clear()
     m_points.clear();
     m_points_ex.clear();
     m_normals.clear();
+    m_uvs.clear();
     m_normals_ex.clear();
 
     m_counts.clear();
@@ -86,7 +146,14 @@ void Mesh::clear()
     m_wireframe_indices.clear();
 }
 
+void InstancedMesh::clear()
+{
+    m_mesh.clear();
+    m_matrices.clear();
+}
+
 Points::Points()
+    : m_points(GetMeshAllocator())
 {
 
 }
@@ -101,6 +168,37 @@ void Points::clear()
     m_points.clear();
 }
 
+IMesh* CreateMesh_(span<float3> points, span<float3> normals, span<int> triangle_indices)
+{
+    auto ret = new Mesh();
+    ret->m_points.assign(points);
+    if (normals.size() == points.size())
+        ret->m_normals.assign(normals);
+
+    size_t num_triangles = triangle_indices.size() / 3;
+    ret->m_counts.resize(num_triangles, 3);
+    ret->m_face_indices.assign(triangle_indices.data(), num_triangles * 3);
+
+    ret->m_wireframe_indices.resize(num_triangles * 6);
+    for (size_t ti = 0; ti < num_triangles; ++ti) {
+        const int* t = &triangle_indices[ti * 3];
+        int* w = &ret->m_wireframe_indices[ti * 6];
+        w[0] = t[0]; w[1] = t[1];
+        w[2] = t[1]; w[3] = t[2];
+        w[4] = t[2]; w[5] = t[0];
+    }
+    return ret;
+}
+
+ISkin* CreateSkin_(span<int> counts, span<JointWeight> weights, size_t num_joints)
+{
+    auto ret = new Skin();
+    ret->m_counts.assign(counts);
+    ret->m_weights.assign(weights);
+    ret->m_matrices.resize(num_joints, float4x4::identity());
+    return ret;
+}
+
 IScene* LoadScene_(const char* path)
 {
     if (!path)
@@ -0,0 +1,212 @@
+#include "pch.h"
+#include "ScenePlaylist.h"
+
+#include <chrono>
+#include <thread>
+
+namespace wabc {
+
+ScenePlaylist::ScenePlaylist()
+{
+
+}
+
+ScenePlaylist::~ScenePlaylist()
+{
+    waitPreload();
+}
+
+void ScenePlaylist::addClip(const std::string& path, double trim_end)
+{
+    m_clips.push_back({ path, trim_end });
+}
+
+void ScenePlaylist::clear()
+{
+    waitPreload();
+
+    m_clips = {};
+    m_clip_index = 0;
+    m_next_offset = 1;
+    m_time = 0.0;
+    m_current = {};
+    m_next = {};
+}
+
+bool ScenePlaylist::start()
+{
+    waitPreload();
+    m_next = {};
+    m_clip_index = 0;
+    m_next_offset = 1;
+
+    if (m_clips.empty())
+        return false;
+
+    m_current = openClip(m_clips[0], ++m_serial_counter);
+    if (!m_current.scene) {
+        printf("ScenePlaylist::start(): failed to open %s\n", m_clips[0].path.c_str());
+        return false;
+    }
+    m_time = m_current.time_start;
+
+    startPreload();
+    return true;
+}
+
+void ScenePlaylist::update(double dt)
+{
+    if (!m_current.scene)
+        return;
+
+    pollPreload();
+
+    m_time += dt;
+    if (m_time <= m_current.time_end)
+        return;
+
+    double overflow = m_time - m_current.time_end;
+    if (m_next.scene) {
+        m_current = std::move(m_next);
+        m_next = {};
+        m_clip_index = (m_clip_index + m_next_offset) % m_clips.size();
+        m_next_offset = 1;
+        m_time = std::min(m_current.time_start + overflow, m_current.time_end);
+        startPreload();
+    }
+    else {
+        // the next clip is not ready (or there is only one clip). keep looping the current one.
+        m_time = std::min(m_current.time_start + overflow, m_current.time_end);
+    }
+}
+
+void ScenePlaylist::seek()
+{
+    if (m_current.scene)
+        m_current.scene->seek(m_time);
+}
+
+// runs on the preload thread. the returned scene is not touched by anyone else until the future is consumed.
+ScenePlaylist::ClipState ScenePlaylist::openClip(const Clip& clip, uint32_t serial)
+{
+    ClipState ret;
+    ret.scene = LoadScene(clip.path.c_str());
+    if (!ret.scene)
+        return ret;
+
+    auto range = ret.scene->getTimeRange();
+    ret.serial = serial;
+    ret.time_start = std::get<0>(range);
+    ret.time_end = std::max(std::get<1>(range) - clip.trim_end, ret.time_start);
+
+    // pre-seek so that the first frame of the clip is already decoded when we switch to it
+    ret.scene->seek(ret.time_start);
+    return ret;
+}
+
+void ScenePlaylist::startPreload()
+{
+    // every other clip has failed to open
+    if (m_clips.size() < 2 || m_next_offset >= m_clips.size())
+        return;
+
+    const Clip& clip = m_clips[(m_clip_index + m_next_offset) % m_clips.size()];
+    uint32_t serial = ++m_serial_counter;
+#ifdef wabcEnableThreads
+    m_preload = std::async(std::launch::async, [clip, serial]() { return openClip(clip, serial); });
+#else
+    // no threads. the load stalls right after the switch instead of at the end of the clip,
+    // which at least keeps the switch itself seamless.
+    m_next = openClip(clip, serial);
+    onPreloaded();
+#endif
+}
+
+void ScenePlaylist::pollPreload()
+{
+#ifdef wabcEnableThreads
+    if (m_preload.valid() && m_preload.wait_for(std::chrono::seconds(0)) == std::future_status::ready) {
+        m_next = m_preload.get();
+        onPreloaded();
+    }
+#endif
+}
+
+// a clip that fails to open is skipped and the one after it is preloaded instead,
+// so that playback doesn't stay stuck on the current clip.
+void ScenePlaylist::onPreloaded()
+{
+    if (m_next.scene)
+        return;
+
+    printf("ScenePlaylist::onPreloaded(): failed to open %s, skipping it\n",
+        m_clips[(m_clip_index + m_next_offset) % m_clips.size()].path.c_str());
+    m_next = {};
+    ++m_next_offset;
+    startPreload();
+}
+
+void ScenePlaylist::waitPreload()
+{
+#ifdef wabcEnableThreads
+    if (m_preload.valid())
+        m_preload.get();
+#endif
+}
+
+bool CheckScenePlaylist(const std::string& path)
+{
+    ScenePlaylist playlist;
+    playlist.addClip(path);
+    playlist.addClip(path + ".missing");
+    playlist.addClip(path, 0.1);
+    if (!playlist.start()) {
+        printf("CheckScenePlaylist(): failed to open %s\n", path.c_str());
+        return false;
+    }
+
+    // the missing clip is skipped every time, so playback alternates between the first and the last clip
+    static const size_t expected_indices[] = { 0, 2, 0, 2, 0 };
+    const double overshoot = 0.001;
+    int failures = 0;
+    auto check = [&](bool ok, size_t step, const char* what) {
+        if (!ok) {
+            printf("CheckScenePlaylist(): switch %d: %s\n", (int)step, what);
+            ++failures;
+        }
+    };
+
+    for (size_t step = 1; step < std::size(expected_indices); ++step) {
+        // update(0.0) only polls the preload
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(60);
+        while (!playlist.getNextScene() && std::chrono::steady_clock::now() < deadline) {
+            playlist.update(0.0);
+#ifdef wabcEnableThreads
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+#endif
+        }
+        IScene* next_scene = playlist.getNextScene();
+        uint32_t next_serial = playlist.getNextSerial();
+        uint32_t prev_serial = playlist.getSerial();
+        if (!next_scene) {
+            check(false, step, "the next clip was not preloaded");
+            break;
+        }
+
+        playlist.update(playlist.getEndTime() - playlist.getTime() + overshoot);
+        check(playlist.getClipIndex() == expected_indices[step], step, "wrong clip index");
+        check(playlist.getScene() == next_scene, step, "the current scene is not the preloaded one");
+        check(playlist.getSerial() == next_serial && next_serial > prev_serial, step, "wrong serial");
+        check(std::abs(playlist.getTime() - std::min(playlist.getStartTime() + overshoot, playlist.getEndTime())) < 1e-9,
+            step, "the overflow was not carried over to the next clip");
+
+        playlist.seek();
+        check(!playlist.getScene()->getMesh()->getPoints().empty(), step, "the seeked scene has no points");
+    }
+
+    if (failures == 0)
+        printf("CheckScenePlaylist(): %d switches ok\n", (int)std::size(expected_indices) - 1);
+    return failures == 0;
+}
+
+} // namespace wabc
@@ -13,8 +13,8 @@ Shader::Shader(unsigned int shaderProgID,
                std::map<std::string, unsigned int>&& attributes,
                std::map<std::string, unsigned int>&& uniforms)
    : mShaderProgID(shaderProgID)
-   , mAttributes(std::move(attributes))
-   , mUniforms(std::move(uniforms))
+   , mAttributes(std::make_move_iterator(attributes.begin()), std::make_move_iterator(attributes.end()))
+   , mUniforms(std::make_move_iterator(uniforms.begin()), std::make_move_iterator(uniforms.end()))
 {
 
 }
@@ -50,79 +50,89 @@ unsigned int Shader::getID() const
    return mShaderProgID;
 }
 
-void Shader::setUniformBool(const std::string& name, bool value) const
+void Shader::setUniformBool(std::string_view name, bool value) const
 {
-   glUniform1i(getUniformLocation(name.c_str()), static_cast<int>(value));
+   glUniform1i(getUniformLocation(name), static_cast<int>(value));
 }
 
-void Shader::setUniformInt(const std::string& name, int value) const
+void Shader::setUniformInt(std::string_view name, int value) const
 {
-   glUniform1i(getUniformLocation(name.c_str()), value);
+   glUniform1i(getUniformLocation(name), value);
 }
 
-void Shader::setUniformFloat(const std::string& name, float value) const
+void Shader::setUniformFloat(std::string_view name, float value) const
 {
-   glUniform1f(getUniformLocation(name.c_str()), value);
+   glUniform1f(getUniformLocation(name), value);
 }
 
-void Shader::setUniformVec2(const std::string& name, const glm::vec2 &value) const
+void Shader::setUniformIntArray(std::string_view name, const std::vector<int>& values) const
 {
-   glUniform2fv(getUniformLocation(name.c_str()), 1, &value[0]);
+   glUniform1iv(getUniformLocation(name), static_cast<GLsizei>(values.size()), &values[0]);
 }
 
-void Shader::setUniformVec2(const std::string& name, float x, float y) const
+void Shader::setUniformFloatArray(std::string_view name, const std::vector<float>& values) const
 {
-   glUniform2f(getUniformLocation(name.c_str()), x, y);
+   glUniform1fv(getUniformLocation(name), static_cast<GLsizei>(values.size()), &values[0]);
 }
 
-void Shader::setUniformVec3(const std::string& name, const glm::vec3 &value) const
+void Shader::setUniformVec2(std::string_view name, const glm::vec2 &value) const
 {
-   glUniform3fv(getUniformLocation(name.c_str()), 1, &value[0]);
+   glUniform2fv(getUniformLocation(name), 1, &value[0]);
 }
 
-void Shader::setUniformVec3(const std::string& name, float x, float y, float z) const
+void Shader::setUniformVec2(std::string_view name, float x, float y) const
 {
-   glUniform3f(getUniformLocation(name.c_str()), x, y, z);
+   glUniform2f(getUniformLocation(name), x, y);
 }
 
-void Shader::setUniformVec3Array(const std::string& name, const std::vector<glm::vec3>& values) const
+void Shader::setUniformVec3(std::string_view name, const glm::vec3 &value) const
 {
-   glUniform3fv(getUniformLocation(name.c_str()), static_cast<GLsizei>(values.size()), glm::value_ptr(values[0]));
+   glUniform3fv(getUniformLocation(name), 1, &value[0]);
 }
 
-void Shader::setUniformVec4(const std::string& name, const glm::vec4 &value) const
+void Shader::setUniformVec3(std::string_view name, float x, float y, float z) const
 {
-   glUniform4fv(getUniformLocation(name.c_str()), 1, &value[0]);
+   glUniform3f(getUniformLocation(name), x, y, z);
 }
 
-void Shader::setUniformVec4(const std::string& name, float x, float y, float z, float w) const
+void Shader::setUniformVec3Array(std::string_view name, const std::vector<glm::vec3>& values) const
 {
-   glUniform4f(getUniformLocation(name.c_str()), x, y, z, w);
+   glUniform3fv(getUniformLocation(name), static_cast<GLsizei>(values.size()), glm::value_ptr(values[0]));
 }
 
-void Shader::setUniformMat2(const std::string& name, const glm::mat2& value) const
+void Shader::setUniformVec4(std::string_view name, const glm::vec4 &value) const
 {
-   glUniformMatrix2fv(getUniformLocation(name.c_str()), 1, GL_FALSE, &value[0][0]);
+   glUniform4fv(getUniformLocation(name), 1, &value[0]);
 }
 
-void Shader::setUniformMat3(const std::string& name, const glm::mat3& value) const
+void Shader::setUniformVec4(std::string_view name, float x, float y, float z, float w) const
 {
-   glUniformMatrix3fv(getUniformLocation(name.c_str()), 1, GL_FALSE, &value[0][0]);
+   glUniform4f(getUniformLocation(name), x, y, z, w);
 }
 
-void Shader::setUniformMat4(const std::string& name, const glm::mat4& value) const
+void Shader::setUniformMat2(std::string_view name, const glm::mat2& value) const
 {
-   glUniformMatrix4fv(getUniformLocation(name.c_str()), 1, GL_FALSE, &value[0][0]);
+   glUniformMatrix2fv(getUniformLocation(name), 1, GL_FALSE, &value[0][0]);
 }
 
-void Shader::setUniformMat4Array(const std::string& name, const std::vector<glm::mat4>& values) const
+void Shader::setUniformMat3(std::string_view name, const glm::mat3& value) const
 {
-   glUniformMatrix4fv(getUniformLocation(name.c_str()), static_cast<GLsizei>(values.size()), GL_FALSE, glm::value_ptr(values[0]));
+   glUniformMatrix3fv(getUniformLocation(name), 1, GL_FALSE, &value[0][0]);
 }
 
-int Shader::getAttributeLocation(const std::string& attributeName) const
+void Shader::setUniformMat4(std::string_view name, const glm::mat4& value) const
 {
-   std::map<std::string, unsigned int>::const_iterator it = mAttributes.find(attributeName);
+   glUniformMatrix4fv(getUniformLocation(name), 1, GL_FALSE, &value[0][0]);
+}
+
+void Shader::setUniformMat4Array(std::string_view name, const std::vector<glm::mat4>& values) const
+{
+   glUniformMatrix4fv(getUniformLocation(name), static_cast<GLsizei>(values.size()), GL_FALSE, glm::value_ptr(values[0]));
+}
+
+int Shader::getAttributeLocation(std::string_view attributeName) const
+{
+   auto it = mAttributes.find(attributeName);
 
    if (it == mAttributes.end())
    {
@@ -133,9 +143,9 @@ int Shader::getAttributeLocation(const std::string& attributeName) const
    return it->second;
 }
 
-int Shader::getUniformLocation(const std::string& uniformName) const
+int Shader::getUniformLocation(std::string_view uniformName) const
 {
-   std::map<std::string, unsigned int>::const_iterator it = mUniforms.find(uniformName);
+   auto it = mUniforms.find(uniformName);
 
    if (it == mUniforms.end())
    {
@@ -168,7 +168,7 @@ bool ShaderLoader::readShaderFile(const std::string& shaderFilePath, std::string
       shaderStream << shaderFile.rdbuf();
       outShaderCode = shaderStream.str();
       shaderFile.close();
-      return true;
+      return resolveIncludes(shaderFilePath, outShaderCode);
    }
    else
    {
@@ -177,6 +177,37 @@ bool ShaderLoader::readShaderFile(const std::string& shaderFilePath, std::string
    }
 }
 
+bool ShaderLoader::resolveIncludes(const std::string& shaderFilePath, std::string& ioShaderCode) const
+{
+   // GLSL has no #include, so the code that several shaders share is pasted in before they are compiled
+   std::string       directory = shaderFilePath.substr(0, shaderFilePath.find_last_of("/\\") + 1);
+   const std::string includeDirective("#include \"");
+
+   std::size_t directivePos = 0;
+   while ((directivePos = ioShaderCode.find(includeDirective, directivePos)) != std::string::npos)
+   {
+      std::size_t nameBegin = directivePos + includeDirective.size();
+      std::size_t nameEnd   = ioShaderCode.find('"', nameBegin);
+      if (nameEnd == std::string::npos)
+      {
+         std::cout << "Error - ShaderLoader::resolveIncludes - The following shader file has an unterminated #include: " << shaderFilePath << "\n";
+         return false;
+      }
+
+      // Included files can include other files too
+      std::string includedCode;
+      if (!readShaderFile(directory + ioShaderCode.substr(nameBegin, nameEnd - nameBegin), includedCode))
+      {
+         return false;
+      }
+
+      ioShaderCode.replace(directivePos, nameEnd + 1 - directivePos, includedCode);
+      directivePos += includedCode.size();
+   }
+
+   return true;
+}
+
 void ShaderLoader::addVersionToShaderCode(std::string& ioShaderCode, GLenum shaderType) const
 {
 #ifdef __EMSCRIPTEN__
@@ -0,0 +1,38 @@
+#include <iostream>
+
+#include "Skeleton.h"
+#include "Utility.h"
+
+Skeleton::Skeleton()
+{
+
+}
+
+Skeleton::Skeleton(const Pose& restPose, const std::vector<glm::mat4>& inverseBindMatrices, const std::vector<std::string>& jointNames)
+{
+   Set(restPose, inverseBindMatrices, jointNames);
+}
+
+void Skeleton::Set(const Pose& restPose, const std::vector<glm::mat4>& inverseBindMatrices, const std::vector<std::string>& jointNames)
+{
+   mRestPose            = restPose;
+   mInverseBindMatrices = inverseBindMatrices;
+   mJointNames          = jointNames;
+}
+
+void Skeleton::UpdateSkin(const Pose& pose, wabc::ISkin& skin)
+{
+   wabc::span<wabc::float4x4> jointMatrices = skin.getJointMatrices();
+   unsigned int numJoints = GetNumJoints();
+   if (pose.GetNumJoints() != numJoints || jointMatrices.size() != numJoints)
+   {
+      std::cout << "Error - Skeleton::UpdateSkin - The pose and the skin must have the same number of joints as the skeleton" << '\n';
+      return;
+   }
+
+   pose.GetMatrixPalette(mMatrixPalette);
+   for (unsigned int i = 0; i < numJoints; ++i)
+   {
+      jointMatrices[i] = Utility::toFloat4x4(mMatrixPalette[i] * mInverseBindMatrices[i]);
+   }
+}
@@ -0,0 +1,233 @@
+#ifdef __EMSCRIPTEN__
+#include <GLES3/gl3.h>
+#else
+#include "glad/glad.h"
+#endif
+
+#include <vector>
+
+#include "Skinning.h"
+#include "VectorMathBatch.h"
+#include "SkinnedMesh.h"
+
+SkinnedMesh::SkinnedMesh()
+   : mNumVertices(0)
+   , mNumIndices(0)
+   , mNumJoints(0)
+{
+   glGenVertexArrays(1, &mVAO);
+   glGenBuffers(4, &mVBOs[0]);
+   glGenBuffers(1, &mEBO);
+   glGenTextures(1, &mJointMatricesTex);
+}
+
+SkinnedMesh::~SkinnedMesh()
+{
+   glDeleteVertexArrays(1, &mVAO);
+   glDeleteBuffers(4, &mVBOs[0]);
+   glDeleteBuffers(1, &mEBO);
+   glDeleteTextures(1, &mJointMatricesTex);
+}
+
+SkinnedMesh::SkinnedMesh(SkinnedMesh&& rhs) noexcept
+   : mNumVertices(std::exchange(rhs.mNumVertices, 0))
+   , mNumIndices(std::exchange(rhs.mNumIndices, 0))
+   , mNumJoints(std::exchange(rhs.mNumJoints, 0))
+   , mVAO(std::exchange(rhs.mVAO, 0))
+   , mVBOs(std::exchange(rhs.mVBOs, std::array<unsigned int, 4>()))
+   , mEBO(std::exchange(rhs.mEBO, 0))
+   , mJointMatricesTex(std::exchange(rhs.mJointMatricesTex, 0))
+{
+
+}
+
+SkinnedMesh& SkinnedMesh::operator=(SkinnedMesh&& rhs) noexcept
+{
+   mNumVertices      = std::exchange(rhs.mNumVertices, 0);
+   mNumIndices       = std::exchange(rhs.mNumIndices, 0);
+   mNumJoints        = std::exchange(rhs.mNumJoints, 0);
+   mVAO              = std::exchange(rhs.mVAO, 0);
+   mVBOs             = std::exchange(rhs.mVBOs, std::array<unsigned int, 4>());
+   mEBO              = std::exchange(rhs.mEBO, 0);
+   mJointMatricesTex = std::exchange(rhs.mJointMatricesTex, 0);
+   return *this;
+}
+
+void SkinnedMesh::InitializeBuffers(wabc::IMesh* bindPoseMesh, wabc::ISkin* skin)
+{
+   wabc::span<wabc::float3> points  = bindPoseMesh->getPoints();
+   wabc::span<wabc::float3> normals = bindPoseMesh->getNormals();
+   wabc::span<int>          indices = bindPoseMesh->getFaceIndices();
+
+   mNumVertices = static_cast<unsigned int>(points.size());
+   mNumIndices  = static_cast<unsigned int>(indices.size());
+   mNumJoints   = static_cast<unsigned int>(skin->getJointMatrices().size());
+
+   // Compute flat normals only if the mesh doesn't provide its own
+   std::vector<wabc::float3> computedNormals;
+   if (normals.size() != points.size())
+   {
+      computedNormals.resize(points.size());
+      wabc::triangle_normals(computedNormals, points, indices);
+
+      normals = computedNormals;
+   }
+
+   // Pack the variable number of influences of each vertex into fixed-width attributes
+   wabc::PackedInfluences influences;
+   influences.pack(skin->getJointCounts(), skin->getJointWeights(), kMaxInfluences);
+
+   glBindVertexArray(mVAO);
+
+   // Load the mesh's data into the buffers
+   // Everything but the joint matrices is static
+
+   // Positions
+   glBindBuffer(GL_ARRAY_BUFFER, mVBOs[VBOTypes::positions]);
+   glBufferData(GL_ARRAY_BUFFER, points.size_bytes(), points.data(), GL_STATIC_DRAW);
+   // Normals
+   glBindBuffer(GL_ARRAY_BUFFER, mVBOs[VBOTypes::normals]);
+   glBufferData(GL_ARRAY_BUFFER, normals.size_bytes(), normals.data(), GL_STATIC_DRAW);
+   // Joint indices
+   glBindBuffer(GL_ARRAY_BUFFER, mVBOs[VBOTypes::jointIndices]);
+   glBufferData(GL_ARRAY_BUFFER, influences.indices.size_bytes(), influences.indices.data(), GL_STATIC_DRAW);
+   // Joint weights
+   glBindBuffer(GL_ARRAY_BUFFER, mVBOs[VBOTypes::jointWeights]);
+   glBufferData(GL_ARRAY_BUFFER, influences.weights.size_bytes(), influences.weights.data(), GL_STATIC_DRAW);
+
+   glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+   // Indices
+   glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mEBO);
+   glBufferData(GL_ELEMENT_ARRAY_BUFFER, mNumIndices * sizeof(int), indices.data(), GL_STATIC_DRAW);
+
+   // Unbind the VAO first, then the EBO
+   glBindVertexArray(0);
+   glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+   // Joint matrices
+   // Each row of the texture holds one matrix in 4 RGBA texels, which the vertex shader reads with texelFetch
+   glBindTexture(GL_TEXTURE_2D, mJointMatricesTex);
+   glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, 4, mNumJoints, 0, GL_RGBA, GL_FLOAT, nullptr);
+   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+   glBindTexture(GL_TEXTURE_2D, 0);
+
+   UpdateJointMatrices(skin->getJointMatrices());
+}
+
+void SkinnedMesh::UpdateJointMatrices(wabc::span<wabc::float4x4> jointMatrices)
+{
+   if (jointMatrices.size() != mNumJoints || mNumJoints == 0)
+   {
+      return;
+   }
+
+   glBindTexture(GL_TEXTURE_2D, mJointMatricesTex);
+   glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, 4, mNumJoints, GL_RGBA, GL_FLOAT, jointMatrices.data());
+   glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+void SkinnedMesh::ConfigureVAO(int posAttribLocation,
+                               int normalAttribLocation,
+                               int jointIndicesAttribLocation,
+                               int jointWeightsAttribLocation)
+{
+   glBindVertexArray(mVAO);
+
+   // Set the vertex attribute pointers
+   BindFloatAttribute(posAttribLocation,          mVBOs[VBOTypes::positions], 3);
+   BindFloatAttribute(normalAttribLocation,       mVBOs[VBOTypes::normals], 3);
+   BindIntAttribute(jointIndicesAttribLocation,   mVBOs[VBOTypes::jointIndices], kMaxInfluences);
+   BindFloatAttribute(jointWeightsAttribLocation, mVBOs[VBOTypes::jointWeights], kMaxInfluences);
+
+   glBindVertexArray(0);
+}
+
+void SkinnedMesh::UnconfigureVAO(int posAttribLocation,
+                                 int normalAttribLocation,
+                                 int jointIndicesAttribLocation,
+                                 int jointWeightsAttribLocation)
+{
+   glBindVertexArray(mVAO);
+
+   // Unset the vertex attribute pointers
+   UnbindAttribute(posAttribLocation,          mVBOs[VBOTypes::positions]);
+   UnbindAttribute(normalAttribLocation,       mVBOs[VBOTypes::normals]);
+   UnbindAttribute(jointIndicesAttribLocation, mVBOs[VBOTypes::jointIndices]);
+   UnbindAttribute(jointWeightsAttribLocation, mVBOs[VBOTypes::jointWeights]);
+
+   glBindVertexArray(0);
+}
+
+void SkinnedMesh::BindJointMatrices(unsigned int textureUnit, int uniformLocation) const
+{
+   // Activate the proper texture unit before binding the texture
+   glActiveTexture(GL_TEXTURE0 + textureUnit);
+   // Bind the texture
+   glBindTexture(GL_TEXTURE_2D, mJointMatricesTex);
+   // Tell the appropriate sampler2D uniform in what texture unit to look for the texture data
+   glUniform1i(uniformLocation, textureUnit);
+}
+
+void SkinnedMesh::UnbindJointMatrices(unsigned int textureUnit) const
+{
+   // Activate the proper texture unit before unbinding the texture
+   glActiveTexture(GL_TEXTURE0 + textureUnit);
+   // Unbind the texture
+   glBindTexture(GL_TEXTURE_2D, 0);
+   // Disactivate the texture unit
+   glActiveTexture(GL_TEXTURE0);
+}
+
+void SkinnedMesh::BindFloatAttribute(int attribLocation, unsigned int VBO, int numComponents)
+{
+   if (attribLocation >= 0)
+   {
+      glBindBuffer(GL_ARRAY_BUFFER, VBO);
+      glEnableVertexAttribArray(attribLocation);
+      glVertexAttribPointer(attribLocation, numComponents, GL_FLOAT, GL_FALSE, 0, (void*)0);
+      glBindBuffer(GL_ARRAY_BUFFER, 0);
+   }
+}
+
+void SkinnedMesh::BindIntAttribute(int attribLocation, unsigned int VBO, int numComponents)
+{
+   if (attribLocation >= 0)
+   {
+      glBindBuffer(GL_ARRAY_BUFFER, VBO);
+      glEnableVertexAttribArray(attribLocation);
+      glVertexAttribIPointer(attribLocation, numComponents, GL_INT, 0, (void*)0);
+      glBindBuffer(GL_ARRAY_BUFFER, 0);
+   }
+}
+
+void SkinnedMesh::UnbindAttribute(int attribLocation, unsigned int VBO)
+{
+   if (attribLocation >= 0)
+   {
+      glBindBuffer(GL_ARRAY_BUFFER, VBO);
+      glDisableVertexAttribArray(attribLocation);
+      glBindBuffer(GL_ARRAY_BUFFER, 0);
+   }
+}
+
+// TODO: GL_TRIANGLES shouldn't be hardcoded here
+//       Can we load that from the GLTF file?
+void SkinnedMesh::Render()
+{
+   glBindVertexArray(mVAO);
+
+   if (mNumIndices > 0)
+   {
+      glDrawElements(GL_TRIANGLES, mNumIndices, GL_UNSIGNED_INT, 0);
+   }
+   else
+   {
+      glDrawArrays(GL_TRIANGLES, 0, mNumVertices);
+   }
+
+   glBindVertexArray(0);
+}
@@ -0,0 +1,203 @@
+#include <algorithm>
+#include <chrono>
+#include <iterator>
+#include <random>
+
+#include "pch.h"
+#include "Skinning.h"
+#include "Parallel.h"
+#include "CpuDispatch.h"
+
+namespace wabc {
+
+// vertices per ParallelFor() chunk
+static const size_t kSkinningGrain = 4096;
+
+void PackedInfluences::clear()
+{
+    width = 0;
+    indices.clear();
+    weights.clear();
+}
+
+void PackedInfluences::pack(span<int> counts, span<JointWeight> src, int w)
+{
+    size_t num_vertices = counts.size();
+    width = w;
+    indices.resize(num_vertices * width);
+    weights.resize(num_vertices * width);
+
+    JointWeight sorted[64];
+    const JointWeight* vertex_weights = src.data();
+    for (size_t vi = 0; vi < num_vertices; ++vi) {
+        int count = counts[vi];
+        const JointWeight* jw = vertex_weights;
+        int n = count;
+        float scale = 1.0f;
+
+        if (count > width) {
+            // keep the heaviest influences and renormalize them
+            int ns = std::min(count, (int)std::size(sorted));
+            std::partial_sort_copy(jw, jw + count, sorted, sorted + ns,
+                [](const JointWeight& a, const JointWeight& b) { return a.weight > b.weight; });
+            jw = sorted;
+            n = width;
+
+            float total = 0.0f, kept = 0.0f;
+            for (int i = 0; i < count; ++i)
+                total += vertex_weights[i].weight;
+            for (int i = 0; i < n; ++i)
+                kept += sorted[i].weight;
+            if (kept > 0.0f)
+                scale = total / kept;
+        }
+
+        int* dst_indices = &indices[vi * width];
+        float* dst_weights = &weights[vi * width];
+        for (int i = 0; i < width; ++i) {
+            if (i < n) {
+                dst_indices[i] = jw[i].index;
+                dst_weights[i] = jw[i].weight * scale;
+            }
+            else {
+                dst_indices[i] = 0;
+                dst_weights[i] = 0.0f;
+            }
+        }
+        vertex_weights += count;
+    }
+}
+
+int GetSkinningWidth(span<int> counts)
+{
+    int max_count = 0;
+    for (int c : counts)
+        max_count = std::max(max_count, c);
+
+    if (max_count <= 1)
+        return 1;
+    else if (max_count <= 2)
+        return 2;
+    else if (max_count <= 4)
+        return 4;
+    else if (max_count <= 8)
+        return 8;
+    else
+        return 0;
+}
+
+template<bool Point>
+static void SkinImpl(const MathKernels& kernels, span<float3> dst, span<float3> src, span<float4x4> matrices, const PackedInfluences& influences)
+{
+    const float3* s = src.data();
+    float3* d = dst.data();
+    const float4x4* m = matrices.data();
+    const int* indices = influences.indices.data();
+    const float* weights = influences.weights.data();
+    int width = influences.width;
+
+    auto skin = Point ? kernels.skin_points : kernels.skin_normals;
+    ParallelFor(src.size(), kSkinningGrain, [&](size_t begin, size_t end) {
+        skin(d, s, m, indices, weights, width, begin, end);
+    });
+}
+
+void SkinPoints(span<float3> dst, span<float3> src, span<float4x4> matrices, const PackedInfluences& influences)
+{
+    SkinImpl<true>(GetMathKernels(), dst, src, matrices, influences);
+}
+
+void SkinNormals(span<float3> dst, span<float3> src, span<float4x4> matrices, const PackedInfluences& influences)
+{
+    SkinImpl<false>(GetMathKernels(), dst, src, matrices, influences);
+}
+
+// the loop that Skin::deformPoints() ran for every vertex before the influences were packed
+static void SkinPointsPerVertex(span<float3> dst, span<float3> src, span<float4x4> matrices, span<int> counts, span<JointWeight> weights)
+{
+    const JointWeight* w = weights.data();
+    size_t nvertices = src.size();
+    for (size_t vi = 0; vi < nvertices; ++vi) {
+        float3 p = src[vi];
+        float3 r{};
+        int cjoints = counts[vi];
+        for (int bi = 0; bi < cjoints; ++bi)
+            r += mul_p(matrices[w[bi].index], p) * w[bi].weight;
+        dst[vi] = r;
+        w += cjoints;
+    }
+}
+
+void BenchmarkSkinning(const MathKernels& kernels)
+{
+    static const size_t sizes[] = { 10000, 100000, 1000000 };
+    const int influences_per_vertex = 4;
+    const int num_joints = 64;
+    const int repeats = 5;
+
+    std::mt19937 rng(1234);
+    std::uniform_real_distribution<float> dist(-10.0f, 10.0f);
+    std::uniform_real_distribution<float> dist01(0.0f, 1.0f);
+
+    RawVector<float4x4> matrices(num_joints);
+    for (auto& m : matrices) {
+        m = to_mat4x4(rotate(normalize(float3{ dist(rng), dist(rng), dist(rng) }), dist(rng)));
+        m[3] = { dist(rng), dist(rng), dist(rng), 1.0f };
+    }
+
+    // best of a few runs, so that the first touch of the buffers and the wake up of the threads don't count
+    auto time = [repeats](const auto& body) {
+        double best = 0.0;
+        for (int i = 0; i < repeats; ++i) {
+            auto start = std::chrono::steady_clock::now();
+            body();
+            std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+            best = i == 0 ? elapsed.count() : std::min(best, elapsed.count());
+        }
+        return best;
+    };
+
+    printf("BenchmarkSkinning(): %s, %d influences per vertex, best of %d runs\n",
+        GetSimdLevelName(kernels.level), influences_per_vertex, repeats);
+    for (size_t num_vertices : sizes) {
+        RawVector<float3> points(num_vertices), expected(num_vertices), actual(num_vertices);
+        RawVector<int> counts(num_vertices);
+        RawVector<JointWeight> weights(num_vertices * influences_per_vertex);
+        for (size_t vi = 0; vi < num_vertices; ++vi) {
+            points[vi] = { dist(rng), dist(rng), dist(rng) };
+            counts[vi] = influences_per_vertex;
+            JointWeight* w = &weights[vi * influences_per_vertex];
+            float total = 0.0f;
+            for (int i = 0; i < influences_per_vertex; ++i) {
+                w[i].index = (int)(rng() % num_joints);
+                total += w[i].weight = dist01(rng);
+            }
+            for (int i = 0; i < influences_per_vertex; ++i)
+                w[i].weight /= total;
+        }
+
+        PackedInfluences influences;
+        influences.pack(make_span(counts), make_span(weights), GetSkinningWidth(make_span(counts)));
+
+        double per_vertex = time([&]() {
+            SkinPointsPerVertex(make_span(expected), make_span(points), make_span(matrices), make_span(counts), make_span(weights));
+        });
+        double packed_1_thread = time([&]() {
+            kernels.skin_points(actual.data(), points.data(), matrices.data(), influences.indices.data(),
+                influences.weights.data(), influences.width, 0, num_vertices);
+        });
+        double packed = time([&]() {
+            SkinImpl<true>(kernels, make_span(actual), make_span(points), make_span(matrices), influences);
+        });
+
+        float max_difference = 0.0f;
+        for (size_t vi = 0; vi < num_vertices; ++vi)
+            max_difference = std::max(max_difference, length(actual[vi] - expected[vi]));
+
+        printf("  %7zu vertices: per-vertex %8.3f ms, packed %8.3f ms on 1 thread (%.1fx), %8.3f ms on %zu threads (%.1fx), max difference %g\n",
+            num_vertices, per_vertex, packed_1_thread, per_vertex / packed_1_thread, packed, GetConcurrency(),
+            per_vertex / packed, max_difference);
+    }
+}
+
+} // namespace wabc
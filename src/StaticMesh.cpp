@@ -1,23 +1,151 @@
 #ifdef __EMSCRIPTEN__
 #include <GLES3/gl3.h>
+#include <webgl/webgl1_ext.h>
+#include <emscripten/html5.h>
 #else
 #include "glad/glad.h"
 #endif
 
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+
 #include "StaticMesh.h"
+#include "Shader.h"
+#include "GPUHeap.h"
+
+namespace VertexEncoding
+{
+   int16_t FloatToSNorm16(float value)
+   {
+      return static_cast<int16_t>(std::round(glm::clamp(value, -1.0f, 1.0f) * 32767.0f));
+   }
+
+   uint16_t FloatToUNorm16(float value)
+   {
+      return static_cast<uint16_t>(std::round(glm::clamp(value, 0.0f, 1.0f) * 65535.0f));
+   }
+
+   // Round to nearest, with overflow to infinity and denormals
+   uint16_t FloatToHalf(float value)
+   {
+      uint32_t bits;
+      std::memcpy(&bits, &value, sizeof(bits));
+
+      uint32_t sign     = (bits >> 16) & 0x8000;
+      int      exponent = static_cast<int>((bits >> 23) & 0xff) - 127 + 15;
+      uint32_t mantissa = bits & 0x7fffff;
+
+      if (((bits >> 23) & 0xff) == 0xff)
+      {
+         return static_cast<uint16_t>(sign | 0x7c00 | (mantissa ? 0x200 : 0));
+      }
+      if (exponent >= 31)
+      {
+         return static_cast<uint16_t>(sign | 0x7c00);
+      }
+      if (exponent <= 0)
+      {
+         if (exponent < -10)
+         {
+            return static_cast<uint16_t>(sign);
+         }
+         mantissa |= 0x800000;
+         int shift = 14 - exponent;
+         uint32_t half = mantissa >> shift;
+         half += (mantissa >> (shift - 1)) & 1;
+         return static_cast<uint16_t>(sign | half);
+      }
+
+      // A carry out of the mantissa correctly increments the exponent
+      uint32_t half = sign | (static_cast<uint32_t>(exponent) << 10) | (mantissa >> 13);
+      half += (mantissa >> 12) & 1;
+      return static_cast<uint16_t>(half);
+   }
+
+   // Projects the normal onto the octahedron |x| + |y| + |z| = 1 and unfolds the lower half onto the outer triangles of
+   // the square, which is decoded by decodeOctahedral in the vertex shaders
+   glm::vec2 OctahedralEncode(const glm::vec3& normal)
+   {
+      float l1Norm = std::abs(normal.x) + std::abs(normal.y) + std::abs(normal.z);
+      if (l1Norm == 0.0f)
+      {
+         return glm::vec2(0.0f);
+      }
+
+      glm::vec2 encoded = glm::vec2(normal.x, normal.y) / l1Norm;
+      if (normal.z < 0.0f)
+      {
+         encoded = glm::vec2((1.0f - std::abs(encoded.y)) * (encoded.x >= 0.0f ? 1.0f : -1.0f),
+                             (1.0f - std::abs(encoded.x)) * (encoded.y >= 0.0f ? 1.0f : -1.0f));
+      }
+      return encoded;
+   }
+
+   // x, y and z in signed normalized 10 bit integers, w unused
+   uint32_t PackInt2101010(const glm::vec3& normal)
+   {
+      auto toSNorm10 = [](float value) {
+         int i = static_cast<int>(std::round(glm::clamp(value, -1.0f, 1.0f) * 511.0f));
+         return static_cast<uint32_t>(i) & 0x3ff;
+      };
+      return toSNorm10(normal.x) | (toSNorm10(normal.y) << 10) | (toSNorm10(normal.z) << 20);
+   }
+
+   // The encoded attribute of every vertex, one after another
+   template<typename T, typename Source, typename Encode>
+   std::vector<unsigned char> EncodeAttribute(const std::vector<Source>& values, Encode encode)
+   {
+      std::vector<unsigned char> encoded(values.size() * sizeof(T));
+      for (size_t i = 0; i < values.size(); ++i)
+      {
+         T value = encode(values[i]);
+         std::memcpy(&encoded[i * sizeof(T)], &value, sizeof(T));
+      }
+      return encoded;
+   }
+
+   VertexAttribute DescribeAttribute(int numComponents, unsigned int type, bool normalized, unsigned int size)
+   {
+      VertexAttribute attribute;
+      attribute.numComponents = numComponents;
+      attribute.type          = type;
+      attribute.normalized    = normalized;
+      attribute.size          = size;
+      return attribute;
+   }
+}
 
 StaticMesh::StaticMesh()
+   : mPositionOffset(0.0f)
+   , mPositionScale(1.0f)
+   , mNumVertices(0)
+   , mNumIndices(0)
+   , mVertexBufferSize(0)
+   , mIndexBufferSize(0)
+   , mIndexType(GL_UNSIGNED_INT)
+   , mVertexAllocation(GPUHeap::kInvalidHandle)
+   , mIndexAllocation(GPUHeap::kInvalidHandle)
+   , mInstanceAllocation(GPUHeap::kInvalidHandle)
+   , mNumInstances(0)
+   , mAttribLocations({ -1, -1, -1, -1 })
+   , mHeapGeneration(0)
 {
    glGenVertexArrays(1, &mVAO);
-   glGenBuffers(3, &mVBOs[0]);
-   glGenBuffers(1, &mEBO);
+
+   mIndexChunks.push_back({ mVAO, 0, 0, 0 });
 }
 
 StaticMesh::~StaticMesh()
 {
+   DeleteIndexChunks();
    glDeleteVertexArrays(1, &mVAO);
-   glDeleteBuffers(3, &mVBOs[0]);
-   glDeleteBuffers(1, &mEBO);
+   GPUHeap::Vertices().Free(mVertexAllocation);
+   GPUHeap::Indices().Free(mIndexAllocation);
+   GPUHeap::Vertices().Free(mInstanceAllocation);
 }
 
 StaticMesh::StaticMesh(StaticMesh&& rhs) noexcept
@@ -25,26 +153,54 @@ StaticMesh::StaticMesh(StaticMesh&& rhs) noexcept
    , mNormals(std::move(rhs.mNormals))
    , mTexCoords(std::move(rhs.mTexCoords))
    , mIndices(std::move(rhs.mIndices))
+   , mMorphTargets(std::move(rhs.mMorphTargets))
+   , mInstanceMatrices(std::move(rhs.mInstanceMatrices))
+   , mVertexFormat(rhs.mVertexFormat)
+   , mAttributes(rhs.mAttributes)
+   , mPositionOffset(rhs.mPositionOffset)
+   , mPositionScale(rhs.mPositionScale)
    , mNumVertices(std::exchange(rhs.mNumVertices, 0))
    , mNumIndices(std::exchange(rhs.mNumIndices, 0))
+   , mVertexBufferSize(std::exchange(rhs.mVertexBufferSize, 0))
+   , mIndexBufferSize(std::exchange(rhs.mIndexBufferSize, 0))
+   , mIndexType(rhs.mIndexType)
    , mVAO(std::exchange(rhs.mVAO, 0))
-   , mVBOs(std::exchange(rhs.mVBOs, std::array<unsigned int, 3>()))
-   , mEBO(std::exchange(rhs.mEBO, 0))
+   , mVertexAllocation(std::exchange(rhs.mVertexAllocation, GPUHeap::kInvalidHandle))
+   , mIndexAllocation(std::exchange(rhs.mIndexAllocation, GPUHeap::kInvalidHandle))
+   , mInstanceAllocation(std::exchange(rhs.mInstanceAllocation, GPUHeap::kInvalidHandle))
+   , mNumInstances(std::exchange(rhs.mNumInstances, 0))
+   , mIndexChunks(std::move(rhs.mIndexChunks))
+   , mAttribLocations(rhs.mAttribLocations)
+   , mHeapGeneration(rhs.mHeapGeneration)
 {
 
 }
 
 StaticMesh& StaticMesh::operator=(StaticMesh&& rhs) noexcept
 {
-   mPositions   = std::move(rhs.mPositions);
-   mNormals     = std::move(rhs.mNormals);
-   mTexCoords   = std::move(rhs.mTexCoords);
-   mIndices     = std::move(rhs.mIndices);
-   mNumVertices = std::exchange(rhs.mNumVertices, 0);
-   mNumIndices  = std::exchange(rhs.mNumIndices, 0);
-   mVAO         = std::exchange(rhs.mVAO, 0);
-   mVBOs        = std::exchange(rhs.mVBOs, std::array<unsigned int, 3>());
-   mEBO         = std::exchange(rhs.mEBO, 0);
+   mPositions          = std::move(rhs.mPositions);
+   mNormals            = std::move(rhs.mNormals);
+   mTexCoords          = std::move(rhs.mTexCoords);
+   mIndices            = std::move(rhs.mIndices);
+   mMorphTargets       = std::move(rhs.mMorphTargets);
+   mInstanceMatrices   = std::move(rhs.mInstanceMatrices);
+   mVertexFormat       = rhs.mVertexFormat;
+   mAttributes         = rhs.mAttributes;
+   mPositionOffset     = rhs.mPositionOffset;
+   mPositionScale      = rhs.mPositionScale;
+   mNumVertices        = std::exchange(rhs.mNumVertices, 0);
+   mNumIndices         = std::exchange(rhs.mNumIndices, 0);
+   mVertexBufferSize   = std::exchange(rhs.mVertexBufferSize, 0);
+   mIndexBufferSize    = std::exchange(rhs.mIndexBufferSize, 0);
+   mIndexType          = rhs.mIndexType;
+   mVAO                = std::exchange(rhs.mVAO, 0);
+   mVertexAllocation   = std::exchange(rhs.mVertexAllocation, GPUHeap::kInvalidHandle);
+   mIndexAllocation    = std::exchange(rhs.mIndexAllocation, GPUHeap::kInvalidHandle);
+   mInstanceAllocation = std::exchange(rhs.mInstanceAllocation, GPUHeap::kInvalidHandle);
+   mNumInstances       = std::exchange(rhs.mNumInstances, 0);
+   mIndexChunks        = std::move(rhs.mIndexChunks);
+   mAttribLocations    = rhs.mAttribLocations;
+   mHeapGeneration     = rhs.mHeapGeneration;
    return *this;
 }
 
@@ -64,92 +220,432 @@ void StaticMesh::GetMinAndMaxDimensions(glm::vec3& outMinDimensions, glm::vec3&
    }
 }
 
+bool StaticMesh::Optimize(const char* cacheDir, wabc::MeshOptimization& outOptimization)
+{
+   // Non-indexed meshes have no vertex reuse to optimize
+   if (mIndices.empty())
+   {
+      return false;
+   }
+
+   // The deltas of the morph targets are reordered with the vertices, so they must still be on the CPU
+   assert(mMorphTargets.HasDeltas());
+   if (!mMorphTargets.HasDeltas())
+   {
+      std::cout << "Error - StaticMesh::Optimize - The morph target deltas have already been uploaded" << '\n';
+      return false;
+   }
+
+   // glm::vec3 and wabc::float3 have the same layout
+   wabc::span<wabc::float3> positions = wabc::make_span(reinterpret_cast<const wabc::float3*>(mPositions.data()), mPositions.size());
+   if (!outOptimization.optimize(wabc::make_span(mIndices), positions, cacheDir))
+   {
+      return false;
+   }
+
+   wabc::span<unsigned int> remap = wabc::make_span(outOptimization.remap);
+   mIndices.assign(outOptimization.indices.begin(), outOptimization.indices.end());
+   wabc::RemapVertices(wabc::make_span(mPositions), remap);
+   if (mNormals.size() == mPositions.size())
+   {
+      wabc::RemapVertices(wabc::make_span(mNormals), remap);
+   }
+   if (mTexCoords.size() == mPositions.size())
+   {
+      wabc::RemapVertices(wabc::make_span(mTexCoords), remap);
+   }
+
+   // The deltas of each target are stored like the vertices
+   unsigned int numVertices = mMorphTargets.GetNumVertices();
+   if (HasMorphTargets() && numVertices == mPositions.size())
+   {
+      for (unsigned int target = 0; target < mMorphTargets.GetNumTargets(); ++target)
+      {
+         size_t offset = static_cast<size_t>(target) * numVertices;
+         wabc::RemapVertices(wabc::make_span(mMorphTargets.GetPositionDeltas().data() + offset, numVertices), remap);
+         wabc::RemapVertices(wabc::make_span(mMorphTargets.GetNormalDeltas().data() + offset, numVertices), remap);
+      }
+   }
+
+   return true;
+}
+
 // TODO: Experiment with GL_STATIC_DRAW, GL_STREAM_DRAW and GL_DYNAMIC_DRAW to see which is faster
 void StaticMesh::LoadBuffers()
 {
-   glBindVertexArray(mVAO);
+   unsigned int numVertices = static_cast<unsigned int>(mPositions.size());
 
-   // Load the mesh's data into the buffers
+   // Encode the attributes in the vertex format
+   // Normals and texture coordinates that don't match the positions are dropped, since they can't be interleaved with them
+   std::array<std::vector<unsigned char>, 3> encoded;
+   mAttributes = {};
 
    // Positions
-   if (mPositions.size() > 0)
+   if (numVertices > 0)
    {
-      glBindBuffer(GL_ARRAY_BUFFER, mVBOs[VBOTypes::positions]);
-      glBufferData(GL_ARRAY_BUFFER, mPositions.size() * sizeof(glm::vec3), &mPositions[0], GL_STATIC_DRAW);
+      if (mVertexFormat.position == VertexFormat::Position::UNorm16)
+      {
+         // Quantize to the bounding box, whose flat axes keep a scale of 1 to avoid dividing by 0
+         glm::vec3 minDimensions, maxDimensions;
+         GetMinAndMaxDimensions(minDimensions, maxDimensions);
+         mPositionOffset = minDimensions;
+         mPositionScale  = maxDimensions - minDimensions;
+         for (int i = 0; i < 3; ++i)
+         {
+            if (mPositionScale[i] <= 0.0f)
+            {
+               mPositionScale[i] = 1.0f;
+            }
+         }
+
+         encoded[VBOTypes::positions] = VertexEncoding::EncodeAttribute<std::array<uint16_t, 3>>(mPositions, [this](const glm::vec3& position) {
+            glm::vec3 normalized = (position - mPositionOffset) / mPositionScale;
+            return std::array<uint16_t, 3>{ VertexEncoding::FloatToUNorm16(normalized.x),
+                                            VertexEncoding::FloatToUNorm16(normalized.y),
+                                            VertexEncoding::FloatToUNorm16(normalized.z) };
+         });
+         mAttributes[VBOTypes::positions] = VertexEncoding::DescribeAttribute(3, GL_UNSIGNED_SHORT, true, 6);
+      }
+      else
+      {
+         mPositionOffset = glm::vec3(0.0f);
+         mPositionScale  = glm::vec3(1.0f);
+
+         encoded[VBOTypes::positions] = VertexEncoding::EncodeAttribute<glm::vec3>(mPositions, [](const glm::vec3& position) { return position; });
+         mAttributes[VBOTypes::positions] = VertexEncoding::DescribeAttribute(3, GL_FLOAT, false, sizeof(glm::vec3));
+      }
    }
 
    // Normals
-   if (mNormals.size() > 0)
+   if (numVertices > 0 && mNormals.size() == numVertices)
    {
-      glBindBuffer(GL_ARRAY_BUFFER, mVBOs[VBOTypes::normals]);
-      glBufferData(GL_ARRAY_BUFFER, mNormals.size() * sizeof(glm::vec3), &mNormals[0], GL_STATIC_DRAW);
+      if (mVertexFormat.normal == VertexFormat::Normal::Octahedral16)
+      {
+         encoded[VBOTypes::normals] = VertexEncoding::EncodeAttribute<std::array<int16_t, 2>>(mNormals, [](const glm::vec3& normal) {
+            glm::vec2 encodedNormal = VertexEncoding::OctahedralEncode(normal);
+            return std::array<int16_t, 2>{ VertexEncoding::FloatToSNorm16(encodedNormal.x), VertexEncoding::FloatToSNorm16(encodedNormal.y) };
+         });
+         mAttributes[VBOTypes::normals] = VertexEncoding::DescribeAttribute(2, GL_SHORT, true, 4);
+      }
+      else if (mVertexFormat.normal == VertexFormat::Normal::Packed1010102)
+      {
+         encoded[VBOTypes::normals] = VertexEncoding::EncodeAttribute<uint32_t>(mNormals, [](const glm::vec3& normal) {
+            return VertexEncoding::PackInt2101010(normal);
+         });
+         mAttributes[VBOTypes::normals] = VertexEncoding::DescribeAttribute(4, GL_INT_2_10_10_10_REV, true, 4);
+      }
+      else
+      {
+         encoded[VBOTypes::normals] = VertexEncoding::EncodeAttribute<glm::vec3>(mNormals, [](const glm::vec3& normal) { return normal; });
+         mAttributes[VBOTypes::normals] = VertexEncoding::DescribeAttribute(3, GL_FLOAT, false, sizeof(glm::vec3));
+      }
    }
 
    // Texture coordinates
-   if (mTexCoords.size() > 0)
+   if (numVertices > 0 && mTexCoords.size() == numVertices)
    {
-      glBindBuffer(GL_ARRAY_BUFFER, mVBOs[VBOTypes::texCoords]);
-      glBufferData(GL_ARRAY_BUFFER, mTexCoords.size() * sizeof(glm::vec2), &mTexCoords[0], GL_STATIC_DRAW);
+      if (mVertexFormat.texCoord == VertexFormat::TexCoord::Half16)
+      {
+         encoded[VBOTypes::texCoords] = VertexEncoding::EncodeAttribute<std::array<uint16_t, 2>>(mTexCoords, [](const glm::vec2& texCoord) {
+            return std::array<uint16_t, 2>{ VertexEncoding::FloatToHalf(texCoord.x), VertexEncoding::FloatToHalf(texCoord.y) };
+         });
+         mAttributes[VBOTypes::texCoords] = VertexEncoding::DescribeAttribute(2, GL_HALF_FLOAT, false, 4);
+      }
+      else
+      {
+         encoded[VBOTypes::texCoords] = VertexEncoding::EncodeAttribute<glm::vec2>(mTexCoords, [](const glm::vec2& texCoord) { return texCoord; });
+         mAttributes[VBOTypes::texCoords] = VertexEncoding::DescribeAttribute(2, GL_FLOAT, false, sizeof(glm::vec2));
+      }
    }
 
-   glBindBuffer(GL_ARRAY_BUFFER, 0);
-
-   // Indices
-   if (mIndices.size() > 0)
+   // Load the mesh's data into its allocation of the vertex heap
+   // In the split layout the attributes are one after another, each of them tightly packed
+   std::vector<unsigned char> vertexData;
+   if (mVertexFormat.layout == VertexLayout::Interleaved)
    {
-      glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mEBO);
-      glBufferData(GL_ELEMENT_ARRAY_BUFFER, mIndices.size() * sizeof(unsigned int), &mIndices[0], GL_STATIC_DRAW);
+      unsigned int stride = 0;
+      for (VertexAttribute& attribute : mAttributes)
+      {
+         if (attribute.IsEnabled())
+         {
+            attribute.offset = stride;
+            stride += AlignVertexAttributeSize(attribute.size);
+         }
+      }
+
+      vertexData.resize(static_cast<size_t>(numVertices) * stride);
+      for (size_t type = 0; type < mAttributes.size(); ++type)
+      {
+         VertexAttribute& attribute = mAttributes[type];
+         if (!attribute.IsEnabled())
+         {
+            continue;
+         }
+
+         attribute.stride = stride;
+         for (size_t vertex = 0; vertex < numVertices; ++vertex)
+         {
+            std::memcpy(&vertexData[vertex * stride + attribute.offset], &encoded[type][vertex * attribute.size], attribute.size);
+         }
+      }
+   }
+   else
+   {
+      for (size_t type = 0; type < mAttributes.size(); ++type)
+      {
+         VertexAttribute& attribute = mAttributes[type];
+         if (!attribute.IsEnabled())
+         {
+            continue;
+         }
+
+         attribute.offset = AlignVertexAttributeSize(static_cast<unsigned int>(vertexData.size()));
+         vertexData.resize(attribute.offset + encoded[type].size());
+         std::memcpy(&vertexData[attribute.offset], encoded[type].data(), encoded[type].size());
+      }
    }
 
-   // Unbind the VAO first, then the EBO
-   glBindVertexArray(0);
-   glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+   GPUHeap& vertexHeap = GPUHeap::Vertices();
+   vertexHeap.Free(mVertexAllocation);
+   mVertexAllocation = vertexHeap.Allocate(vertexData.size());
+   vertexHeap.Upload(mVertexAllocation, vertexData.data(), vertexData.size());
+   mVertexBufferSize = vertexData.size();
+
+   mNumVertices  = numVertices;
+   mNumIndices   = static_cast<unsigned int>(mIndices.size());
+
+   LoadIndices();
+
+   // The deltas are uploaded last, in the order in which Optimize left the vertices
+   mMorphTargets.LoadTexture();
 
-   mNumVertices = static_cast<unsigned int>(mPositions.size());
-   mNumIndices  = static_cast<unsigned int>(mIndices.size());
+   if (!mInstanceMatrices.empty())
+   {
+      LoadInstanceMatrices(mInstanceMatrices);
+   }
 
    // This data has already been passed to the GPU, so it's not necessary to store it anymore
    mPositions.clear();
    mNormals.clear();
    mTexCoords.clear();
    mIndices.clear();
+   mInstanceMatrices.clear();
+}
+
+// The matrices of the instances are static, so they share the vertex heap with the geometry instead of having a buffer
+// of their own. The allocation is only replaced when the number of instances changes
+void StaticMesh::LoadInstanceMatrices(const std::vector<glm::mat4>& matrices)
+{
+   GPUHeap& vertexHeap = GPUHeap::Vertices();
+   size_t   size       = matrices.size() * sizeof(glm::mat4);
+
+   if (vertexHeap.GetSize(mInstanceAllocation) != size)
+   {
+      vertexHeap.Free(mInstanceAllocation);
+      mInstanceAllocation = vertexHeap.Allocate(size);
+   }
+
+   vertexHeap.Upload(mInstanceAllocation, matrices.data(), size);
+   mNumInstances = static_cast<unsigned int>(matrices.size());
 }
 
+// Indices are 16-bit whenever possible, which halves their memory and bandwidth
+// Meshes with more than 65535 vertices are split into chunks when their triangles allow it, which they do once
+// Optimize has put the vertices in the order in which the triangles use them
+// The morph target shader finds the deltas of a vertex with gl_VertexID, which doesn't include the base vertex of a
+// chunk, so meshes with morph targets are only split if they fit in a single chunk
+void StaticMesh::LoadIndices()
+{
+   DeleteIndexChunks();
+   GPUHeap::Indices().Free(mIndexAllocation);
+   mIndexAllocation = GPUHeap::kInvalidHandle;
+   mIndexType       = GL_UNSIGNED_INT;
+   mIndexBufferSize = 0;
+
+   if (mIndices.empty())
+   {
+      return;
+   }
+
+   wabc::RawVector<wabc::IndexRange> ranges;
+   bool use16Bit = wabc::SplitIndices16(ranges, wabc::make_span(mIndices), mNumVertices);
+   if (use16Bit && HasMorphTargets() && (ranges.size() != 1 || ranges[0].base_vertex != 0))
+   {
+      use16Bit = false;
+   }
+
+   // The index buffer of the heap is bound to the VAOs by ConfigureVAO
+   GPUHeap& indexHeap = GPUHeap::Indices();
+   if (use16Bit)
+   {
+      wabc::RawVector<uint16_t> indices16;
+      indices16.resize(mIndices.size());
+      wabc::ConvertIndices16(wabc::make_span(indices16), wabc::make_span(mIndices), wabc::make_span(ranges));
+
+      mIndexAllocation = indexHeap.Allocate(indices16.size_bytes());
+      indexHeap.Upload(mIndexAllocation, indices16.data(), indices16.size_bytes());
+
+      mIndexType       = GL_UNSIGNED_SHORT;
+      mIndexBufferSize = indices16.size_bytes();
+   }
+   else
+   {
+      mIndexAllocation = indexHeap.Allocate(mIndices.size() * sizeof(unsigned int));
+      indexHeap.Upload(mIndexAllocation, mIndices.data(), mIndices.size() * sizeof(unsigned int));
+
+      ranges.clear();
+      ranges.push_back({ 0, mIndices.size(), 0 });
+      mIndexBufferSize = mIndices.size() * sizeof(unsigned int);
+   }
+
+   size_t indexSize = use16Bit ? sizeof(uint16_t) : sizeof(unsigned int);
+   mIndexChunks.clear();
+   for (const wabc::IndexRange& range : ranges)
+   {
+      IndexChunk chunk;
+      chunk.VAO         = mVAO;
+      chunk.numIndices  = static_cast<unsigned int>(range.num_indices);
+      chunk.indexOffset = range.first_index * indexSize;
+      chunk.baseVertex  = range.base_vertex;
+      if (!mIndexChunks.empty())
+      {
+         glGenVertexArrays(1, &chunk.VAO);
+      }
+
+      mIndexChunks.push_back(chunk);
+   }
+}
+
+void StaticMesh::DeleteIndexChunks()
+{
+   for (size_t i = 1; i < mIndexChunks.size(); ++i)
+   {
+      glDeleteVertexArrays(1, &mIndexChunks[i].VAO);
+   }
+
+   mIndexChunks.clear();
+   mIndexChunks.push_back({ mVAO, 0, 0, 0 });
+}
+
+void StaticMesh::BindVertexFormat(const Shader& shader) const
+{
+   shader.setUniformVec3("positionOffset", mPositionOffset);
+   shader.setUniformVec3("positionScale", mPositionScale);
+   shader.setUniformBool("octahedralNormals", mVertexFormat.normal == VertexFormat::Normal::Octahedral16);
+}
+
+void StaticMesh::BindFloatVertexFormat(const Shader& shader)
+{
+   shader.setUniformVec3("positionOffset", glm::vec3(0.0f));
+   shader.setUniformVec3("positionScale", glm::vec3(1.0f));
+   shader.setUniformBool("octahedralNormals", false);
+}
+
+// The locations are remembered so that the VAOs can be configured again when the heaps are defragmented
 void StaticMesh::ConfigureVAO(int posAttribLocation,
                               int normalAttribLocation,
-                              int texCoordsAttribLocation)
+                              int texCoordsAttribLocation,
+                              int instanceMatrixAttribLocation)
 {
-   glBindVertexArray(mVAO);
+   mAttribLocations = { posAttribLocation, normalAttribLocation, texCoordsAttribLocation, instanceMatrixAttribLocation };
+   mHeapGeneration  = GPUHeap::GetGeneration();
+
+   std::array<VertexAttribute, 3> attributes = GetHeapAttributes();
+   unsigned int indexBuffer    = GPUHeap::Indices().GetBuffer(mIndexAllocation);
+   unsigned int instanceBuffer = GPUHeap::Vertices().GetBuffer(mInstanceAllocation);
+   size_t       instanceOffset = GPUHeap::Vertices().GetOffset(mInstanceAllocation);
 
    // Set the vertex attribute pointers
-   BindFloatAttribute(posAttribLocation,       mVBOs[VBOTypes::positions], 3);
-   BindFloatAttribute(normalAttribLocation,    mVBOs[VBOTypes::normals], 3);
-   BindFloatAttribute(texCoordsAttribLocation, mVBOs[VBOTypes::texCoords], 2);
+   // The normalized integer formats are converted to floats by the vertex fetch, so the shaders still see vec3s and vec2s
+   // The instance matrices are per instance, so they aren't offset by the base vertex of the chunks
+   for (const IndexChunk& chunk : mIndexChunks)
+   {
+      glBindVertexArray(chunk.VAO);
+
+      BindAttribute(posAttribLocation,       attributes[VBOTypes::positions], chunk.baseVertex);
+      BindAttribute(normalAttribLocation,    attributes[VBOTypes::normals],   chunk.baseVertex);
+      BindAttribute(texCoordsAttribLocation, attributes[VBOTypes::texCoords], chunk.baseVertex);
+      BindMat4InstanceAttribute(instanceMatrixAttribLocation, instanceBuffer, instanceOffset);
+
+      // The element array buffer binding is part of the state of a VAO
+      if (indexBuffer != 0)
+      {
+         glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
+      }
+   }
 
+   // Unbind the VAO first, then the EBO
    glBindVertexArray(0);
+   glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+}
+
+// The attributes with the buffer and the offset of the allocation of the mesh in the vertex heap
+std::array<VertexAttribute, 3> StaticMesh::GetHeapAttributes() const
+{
+   GPUHeap& vertexHeap = GPUHeap::Vertices();
+   unsigned int buffer = vertexHeap.GetBuffer(mVertexAllocation);
+   size_t       offset = vertexHeap.GetOffset(mVertexAllocation);
+
+   std::array<VertexAttribute, 3> attributes = mAttributes;
+   for (VertexAttribute& attribute : attributes)
+   {
+      attribute.VBO     = buffer;
+      attribute.offset += offset;
+   }
+   return attributes;
+}
+
+void StaticMesh::UpdateVAOs()
+{
+   if (mHeapGeneration != GPUHeap::GetGeneration())
+   {
+      ConfigureVAO(mAttribLocations[VBOTypes::positions],
+                   mAttribLocations[VBOTypes::normals],
+                   mAttribLocations[VBOTypes::texCoords],
+                   mAttribLocations[VBOTypes::instanceMatrices]);
+   }
 }
 
 void StaticMesh::UnconfigureVAO(int posAttribLocation,
                                   int normalAttribLocation,
-                                  int texCoordsAttribLocation)
+                                  int texCoordsAttribLocation,
+                                  int instanceMatrixAttribLocation)
 {
-   glBindVertexArray(mVAO);
+   unsigned int buffer         = GPUHeap::Vertices().GetBuffer(mVertexAllocation);
+   unsigned int instanceBuffer = GPUHeap::Vertices().GetBuffer(mInstanceAllocation);
 
    // Unset the vertex attribute pointers
-   UnbindAttribute(posAttribLocation,       mVBOs[VBOTypes::positions]);
-   UnbindAttribute(normalAttribLocation,    mVBOs[VBOTypes::normals]);
-   UnbindAttribute(texCoordsAttribLocation, mVBOs[VBOTypes::texCoords]);
+   for (const IndexChunk& chunk : mIndexChunks)
+   {
+      glBindVertexArray(chunk.VAO);
+
+      UnbindAttribute(posAttribLocation,       buffer);
+      UnbindAttribute(normalAttribLocation,    buffer);
+      UnbindAttribute(texCoordsAttribLocation, buffer);
+      UnbindMat4InstanceAttribute(instanceMatrixAttribLocation, instanceBuffer);
+   }
 
    glBindVertexArray(0);
 }
 
 void StaticMesh::BindFloatAttribute(int attribLocation, unsigned int VBO, int numComponents)
 {
-   if (attribLocation >= 0)
+   VertexAttribute attribute = VertexEncoding::DescribeAttribute(numComponents, GL_FLOAT, false, numComponents * sizeof(float));
+   attribute.VBO = VBO;
+   BindAttribute(attribLocation, attribute);
+}
+
+// Attributes that the mesh doesn't have are left disabled, so the shader reads their default value
+void StaticMesh::BindAttribute(int attribLocation, const VertexAttribute& attribute, unsigned int baseVertex)
+{
+   if (attribLocation >= 0 && attribute.IsEnabled())
    {
-      glBindBuffer(GL_ARRAY_BUFFER, VBO);
+      size_t offset = attribute.offset + static_cast<size_t>(baseVertex) * (attribute.stride ? attribute.stride : attribute.size);
+
+      glBindBuffer(GL_ARRAY_BUFFER, attribute.VBO);
       glEnableVertexAttribArray(attribLocation);
-      glVertexAttribPointer(attribLocation, numComponents, GL_FLOAT, GL_FALSE, 0, (void*)0);
+      glVertexAttribPointer(attribLocation, attribute.numComponents, attribute.type, attribute.normalized ? GL_TRUE : GL_FALSE,
+                            attribute.stride, (void*)offset);
       glBindBuffer(GL_ARRAY_BUFFER, 0);
    }
 }
@@ -175,18 +671,54 @@ void StaticMesh::UnbindAttribute(int attribLocation, unsigned int VBO)
    }
 }
 
+// Meshes without instance matrices leave the attribute disabled
+void StaticMesh::BindMat4InstanceAttribute(int attribLocation, unsigned int VBO, size_t offset)
+{
+   if (attribLocation >= 0 && VBO != 0)
+   {
+      glBindBuffer(GL_ARRAY_BUFFER, VBO);
+      for (int i = 0; i < 4; ++i)
+      {
+         glEnableVertexAttribArray(attribLocation + i);
+         glVertexAttribPointer(attribLocation + i, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), (void*)(offset + sizeof(glm::vec4) * i));
+         glVertexAttribDivisor(attribLocation + i, 1);
+      }
+      glBindBuffer(GL_ARRAY_BUFFER, 0);
+   }
+}
+
+void StaticMesh::UnbindMat4InstanceAttribute(int attribLocation, unsigned int VBO)
+{
+   if (attribLocation >= 0)
+   {
+      glBindBuffer(GL_ARRAY_BUFFER, VBO);
+      for (int i = 0; i < 4; ++i)
+      {
+         glVertexAttribDivisor(attribLocation + i, 0);
+         glDisableVertexAttribArray(attribLocation + i);
+      }
+      glBindBuffer(GL_ARRAY_BUFFER, 0);
+   }
+}
+
 // TODO: GL_TRIANGLES shouldn't be hardcoded here
 //       Can we load that from the GLTF file?
 void StaticMesh::Render()
 {
-   glBindVertexArray(mVAO);
+   UpdateVAOs();
 
    if (mNumIndices > 0)
    {
-      glDrawElements(GL_TRIANGLES, mNumIndices, GL_UNSIGNED_INT, 0);
+      size_t indexOffset = GPUHeap::Indices().GetOffset(mIndexAllocation);
+      for (const IndexChunk& chunk : mIndexChunks)
+      {
+         glBindVertexArray(chunk.VAO);
+         glDrawElements(GL_TRIANGLES, chunk.numIndices, mIndexType, (void*)(indexOffset + chunk.indexOffset));
+      }
    }
    else
    {
+      glBindVertexArray(mVAO);
       glDrawArrays(GL_TRIANGLES, 0, mNumVertices);
    }
 
@@ -197,16 +729,106 @@ void StaticMesh::Render()
 //       Can we load that from the GLTF file?
 void StaticMesh::RenderInstanced(unsigned int numInstances)
 {
-   glBindVertexArray(mVAO);
+   UpdateVAOs();
 
    if (mNumIndices > 0)
    {
-      glDrawElementsInstanced(GL_TRIANGLES, mNumIndices, GL_UNSIGNED_INT, 0, numInstances);
+      size_t indexOffset = GPUHeap::Indices().GetOffset(mIndexAllocation);
+      for (const IndexChunk& chunk : mIndexChunks)
+      {
+         glBindVertexArray(chunk.VAO);
+         glDrawElementsInstanced(GL_TRIANGLES, chunk.numIndices, mIndexType, (void*)(indexOffset + chunk.indexOffset), numInstances);
+      }
    }
    else
    {
+      glBindVertexArray(mVAO);
       glDrawArraysInstanced(GL_TRIANGLES, 0, mNumVertices, numInstances);
    }
 
    glBindVertexArray(0);
 }
+
+void StaticMesh::RenderRanges(const std::vector<DrawRange>& ranges)
+{
+   if (mNumIndices == 0 || ranges.empty())
+   {
+      return;
+   }
+
+   UpdateVAOs();
+
+   size_t indexSize   = (mIndexType == GL_UNSIGNED_SHORT) ? sizeof(uint16_t) : sizeof(unsigned int);
+   size_t indexOffset = GPUHeap::Indices().GetOffset(mIndexAllocation);
+   bool   multiDraw   = MultiDrawIsAvailable();
+
+   std::vector<GLsizei>&     counts  = mDrawCounts;
+   std::vector<const void*>& offsets = mDrawOffsets;
+
+   for (const IndexChunk& chunk : mIndexChunks)
+   {
+      // Clip the ranges to the indices of the chunk, merging the ones that follow each other
+      size_t chunkBegin = chunk.indexOffset / indexSize;
+      size_t chunkEnd   = chunkBegin + chunk.numIndices;
+
+      counts.clear();
+      offsets.clear();
+      size_t prevEnd = 0;
+      for (const DrawRange& range : ranges)
+      {
+         size_t begin = std::max<size_t>(range.firstIndex, chunkBegin);
+         size_t end   = std::min<size_t>(static_cast<size_t>(range.firstIndex) + range.numIndices, chunkEnd);
+         if (begin >= end)
+         {
+            continue;
+         }
+
+         if (!counts.empty() && begin == prevEnd)
+         {
+            counts.back() += static_cast<GLsizei>(end - begin);
+         }
+         else
+         {
+            counts.push_back(static_cast<GLsizei>(end - begin));
+            offsets.push_back((const void*)(indexOffset + begin * indexSize));
+         }
+         prevEnd = end;
+      }
+
+      if (counts.empty())
+      {
+         continue;
+      }
+
+      glBindVertexArray(chunk.VAO);
+
+      if (multiDraw && counts.size() > 1)
+      {
+#ifdef __EMSCRIPTEN__
+         glMultiDrawElementsWEBGL(GL_TRIANGLES, counts.data(), mIndexType, offsets.data(), static_cast<GLsizei>(counts.size()));
+#else
+         glMultiDrawElements(GL_TRIANGLES, counts.data(), mIndexType, offsets.data(), static_cast<GLsizei>(counts.size()));
+#endif
+      }
+      else
+      {
+         for (size_t i = 0; i < counts.size(); ++i)
+         {
+            glDrawElements(GL_TRIANGLES, counts[i], mIndexType, offsets[i]);
+         }
+      }
+   }
+
+   glBindVertexArray(0);
+}
+
+// The extension has to be enabled on the WebGL context before its functions can be called
+bool StaticMesh::MultiDrawIsAvailable()
+{
+#ifdef __EMSCRIPTEN__
+   static bool available = emscripten_webgl_enable_WEBGL_multi_draw(emscripten_webgl_get_current_context());
+   return available;
+#else
+   return glMultiDrawElements != nullptr;
+#endif
+}
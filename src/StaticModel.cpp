@@ -0,0 +1,213 @@
+#include <numeric>
+
+#include "StaticModel.h"
+#include "Shader.h"
+
+void StaticModel::Build(std::vector<StaticMesh>&& meshes, const StaticMesh::VertexFormat& vertexFormat)
+{
+   mSeparateMeshes.clear();
+   mPrimitives.clear();
+   mAllPrimitives.clear();
+
+   // The buffers of the merged mesh are reused when the model is built again
+   std::vector<glm::vec3>&    mergedPositions = mMergedMesh.GetPositions();
+   std::vector<glm::vec3>&    mergedNormals   = mMergedMesh.GetNormals();
+   std::vector<glm::vec2>&    mergedTexCoords = mMergedMesh.GetTexCoords();
+   std::vector<unsigned int>& mergedIndices   = mMergedMesh.GetIndices();
+   mergedPositions.clear();
+   mergedNormals.clear();
+   mergedTexCoords.clear();
+   mergedIndices.clear();
+
+   // An attribute that only some of the primitives have is filled with zeros for the others
+   bool hasNormals   = false;
+   bool hasTexCoords = false;
+   for (StaticMesh& mesh : meshes)
+   {
+      if (!mesh.HasMorphTargets())
+      {
+         hasNormals   = hasNormals   || mesh.GetNormals().size()   == mesh.GetPositions().size();
+         hasTexCoords = hasTexCoords || mesh.GetTexCoords().size() == mesh.GetPositions().size();
+      }
+   }
+
+   for (StaticMesh& mesh : meshes)
+   {
+      Primitive primitive;
+
+      if (mesh.HasMorphTargets())
+      {
+         primitive.separateMesh = static_cast<int>(mSeparateMeshes.size());
+         primitive.range        = { 0, static_cast<unsigned int>(mesh.GetIndices().size()) };
+
+         mesh.SetVertexFormat(vertexFormat);
+         mesh.LoadBuffers();
+         mSeparateMeshes.push_back(std::move(mesh));
+         mPrimitives.push_back(primitive);
+         continue;
+      }
+
+      std::vector<glm::vec3>&    positions = mesh.GetPositions();
+      std::vector<glm::vec3>&    normals   = mesh.GetNormals();
+      std::vector<glm::vec2>&    texCoords = mesh.GetTexCoords();
+      std::vector<unsigned int>& indices   = mesh.GetIndices();
+
+      // The indices of the merged mesh are a single triangle list, so non-indexed primitives get sequential indices
+      if (indices.empty())
+      {
+         indices.resize(positions.size());
+         std::iota(indices.begin(), indices.end(), 0u);
+      }
+
+      unsigned int baseVertex = static_cast<unsigned int>(mergedPositions.size());
+      primitive.separateMesh  = -1;
+      primitive.range         = { static_cast<unsigned int>(mergedIndices.size()), static_cast<unsigned int>(indices.size()) };
+
+      mergedPositions.insert(mergedPositions.end(), positions.begin(), positions.end());
+      if (hasNormals)
+      {
+         if (normals.size() == positions.size())
+         {
+            mergedNormals.insert(mergedNormals.end(), normals.begin(), normals.end());
+         }
+         else
+         {
+            mergedNormals.resize(mergedPositions.size(), glm::vec3(0.0f));
+         }
+      }
+      if (hasTexCoords)
+      {
+         if (texCoords.size() == positions.size())
+         {
+            mergedTexCoords.insert(mergedTexCoords.end(), texCoords.begin(), texCoords.end());
+         }
+         else
+         {
+            mergedTexCoords.resize(mergedPositions.size(), glm::vec2(0.0f));
+         }
+      }
+
+      for (unsigned int index : indices)
+      {
+         mergedIndices.push_back(baseVertex + index);
+      }
+
+      mPrimitives.push_back(primitive);
+   }
+
+   meshes.clear();
+
+   mAllPrimitives.resize(mPrimitives.size());
+   std::iota(mAllPrimitives.begin(), mAllPrimitives.end(), 0u);
+
+   // The primitives were optimized on their own, and concatenating them keeps the vertices in the order in which the
+   // triangles use them, which lets LoadBuffers split the indices into as few 16-bit chunks as possible
+   // The positions of a compact vertex format are quantized to the bounding box of the whole model
+   mMergedMesh.SetVertexFormat(vertexFormat);
+   mMergedMesh.LoadBuffers();
+}
+
+size_t StaticModel::GetBufferSize() const
+{
+   size_t size = mMergedMesh.GetVertexBufferSize() + mMergedMesh.GetIndexBufferSize();
+   for (const StaticMesh& mesh : mSeparateMeshes)
+   {
+      size += mesh.GetVertexBufferSize() + mesh.GetIndexBufferSize();
+   }
+   return size;
+}
+
+void StaticModel::ConfigureVAO(int posAttribLocation,
+                               int normalAttribLocation,
+                               int texCoordsAttribLocation)
+{
+   mAttribLocations = { posAttribLocation, normalAttribLocation, texCoordsAttribLocation };
+
+   mMergedMesh.ConfigureVAO(posAttribLocation, normalAttribLocation, texCoordsAttribLocation);
+   for (StaticMesh& mesh : mSeparateMeshes)
+   {
+      mesh.ConfigureVAO(posAttribLocation, normalAttribLocation, texCoordsAttribLocation);
+   }
+}
+
+void StaticModel::UnconfigureVAO(int posAttribLocation,
+                                 int normalAttribLocation,
+                                 int texCoordsAttribLocation)
+{
+   mMergedMesh.UnconfigureVAO(posAttribLocation, normalAttribLocation, texCoordsAttribLocation);
+   for (StaticMesh& mesh : mSeparateMeshes)
+   {
+      mesh.UnconfigureVAO(posAttribLocation, normalAttribLocation, texCoordsAttribLocation);
+   }
+}
+
+void StaticModel::ConfigureMorphTargetsVAO(int posAttribLocation,
+                                           int normalAttribLocation,
+                                           int texCoordsAttribLocation)
+{
+   for (StaticMesh& mesh : mSeparateMeshes)
+   {
+      mesh.UnconfigureVAO(mAttribLocations[0], mAttribLocations[1], mAttribLocations[2]);
+      mesh.ConfigureVAO(posAttribLocation, normalAttribLocation, texCoordsAttribLocation);
+   }
+}
+
+void StaticModel::Render(const Shader& shader, const Shader* morphTargetsShader)
+{
+   RenderPrimitives(shader, mAllPrimitives, morphTargetsShader);
+}
+
+// The primitives of the merged mesh are submitted together, and the separate meshes one by one
+void StaticModel::RenderPrimitives(const Shader& shader, const std::vector<unsigned int>& primitives, const Shader* morphTargetsShader)
+{
+   mDrawRanges.clear();
+   for (unsigned int primitiveIndex : primitives)
+   {
+      const Primitive& primitive = mPrimitives[primitiveIndex];
+      if (primitive.separateMesh < 0)
+      {
+         mDrawRanges.push_back(primitive.range);
+      }
+   }
+
+   if (!mDrawRanges.empty())
+   {
+      mMergedMesh.BindVertexFormat(shader);
+      mMergedMesh.RenderRanges(mDrawRanges);
+   }
+
+   const Shader& separateMeshShader = morphTargetsShader ? *morphTargetsShader : shader;
+   bool          switchedShaders    = false;
+   for (unsigned int primitiveIndex : primitives)
+   {
+      const Primitive& primitive = mPrimitives[primitiveIndex];
+      if (primitive.separateMesh < 0)
+      {
+         continue;
+      }
+
+      if (morphTargetsShader && !switchedShaders)
+      {
+         morphTargetsShader->use(true);
+         switchedShaders = true;
+      }
+
+      StaticMesh& mesh = mSeparateMeshes[primitive.separateMesh];
+      mesh.BindVertexFormat(separateMeshShader);
+      if (morphTargetsShader)
+      {
+         mesh.GetMorphTargets().Bind(*morphTargetsShader, kMorphTargetsTextureUnit);
+         mesh.Render();
+         mesh.GetMorphTargets().Unbind(kMorphTargetsTextureUnit);
+      }
+      else
+      {
+         mesh.Render();
+      }
+   }
+
+   if (switchedShaders)
+   {
+      shader.use(true);
+   }
+}
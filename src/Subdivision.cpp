@@ -0,0 +1,388 @@
+#include <unordered_map>
+
+#include "pch.h"
+#include "Subdivision.h"
+#include "Parallel.h"
+
+namespace wabc {
+
+namespace {
+
+// sparse row under construction. stencils of a single level only touch a handful of points.
+struct StencilRow
+{
+    RawVector<int> sources;
+    RawVector<float> weights;
+
+    void clear()
+    {
+        sources.clear();
+        weights.clear();
+    }
+
+    void add(int src, float w)
+    {
+        size_t n = sources.size();
+        for (size_t i = 0; i < n; ++i) {
+            if (sources[i] == src) {
+                weights[i] += w;
+                return;
+            }
+        }
+        sources.push_back(src);
+        weights.push_back(w);
+    }
+};
+
+// stencils in compressed sparse rows
+struct StencilTable
+{
+    RawVector<int> offsets;
+    RawVector<int> sources;
+    RawVector<float> weights;
+
+    int getNumRows() const { return (int)offsets.size() - 1; }
+
+    void setIdentity(int n)
+    {
+        offsets.resize(n + 1);
+        sources.resize(n);
+        weights.resize(n);
+        for (int i = 0; i < n; ++i) {
+            offsets[i] = i;
+            sources[i] = i;
+            weights[i] = 1.0f;
+        }
+        offsets[n] = n;
+    }
+
+    void beginRows()
+    {
+        offsets.clear();
+        sources.clear();
+        weights.clear();
+        offsets.push_back(0);
+    }
+
+    void addRow(const StencilRow& row)
+    {
+        sources.insert(sources.end(), row.sources.begin(), row.sources.end());
+        weights.insert(weights.end(), row.weights.begin(), row.weights.end());
+        offsets.push_back((int)sources.size());
+    }
+};
+
+struct Edge
+{
+    int v0, v1;
+    int f0 = -1, f1 = -1;
+    int num_faces = 0;
+};
+
+// one level of Catmull-Clark. dst_rows are stencils over the points of the source level.
+// refined points are laid out as [vertex points][edge points][face points]. dst faces are quads.
+void SubdivideOnce(
+    const RawVector<int>& counts, const RawVector<int>& indices, int num_points,
+    RawVector<int>& dst_counts, RawVector<int>& dst_indices, int& dst_num_points, StencilTable& dst_rows)
+{
+    int num_faces = (int)counts.size();
+    RawVector<int> face_starts;
+    face_starts.resize(num_faces);
+    int num_corners = 0;
+    for (int fi = 0; fi < num_faces; ++fi) {
+        face_starts[fi] = num_corners;
+        num_corners += counts[fi];
+    }
+
+    // edges
+    std::vector<Edge> edges;
+    std::unordered_map<uint64_t, int> edge_table;
+    edge_table.reserve(num_corners);
+    RawVector<int> corner_edges; // edge from corner i to corner i + 1
+    corner_edges.resize(num_corners);
+    for (int fi = 0; fi < num_faces; ++fi) {
+        int start = face_starts[fi];
+        int c = counts[fi];
+        for (int i = 0; i < c; ++i) {
+            int a = indices[start + i];
+            int b = indices[start + (i + 1) % c];
+            uint64_t key = ((uint64_t)std::min(a, b) << 32) | (uint64_t)std::max(a, b);
+            auto it = edge_table.find(key);
+            if (it == edge_table.end()) {
+                it = edge_table.insert({ key, (int)edges.size() }).first;
+                Edge e;
+                e.v0 = a;
+                e.v1 = b;
+                edges.push_back(e);
+            }
+            Edge& e = edges[it->second];
+            if (e.num_faces == 0)
+                e.f0 = fi;
+            else if (e.num_faces == 1)
+                e.f1 = fi;
+            ++e.num_faces;
+            corner_edges[start + i] = it->second;
+        }
+    }
+    int num_edges = (int)edges.size();
+
+    // faces and edges around each vertex
+    RawVector<int> vf_offsets, vf_faces, ve_offsets, ve_edges;
+    vf_offsets.resize(num_points + 1, 0);
+    ve_offsets.resize(num_points + 1, 0);
+    for (int ci = 0; ci < num_corners; ++ci)
+        ++vf_offsets[indices[ci] + 1];
+    for (auto& e : edges) {
+        ++ve_offsets[e.v0 + 1];
+        ++ve_offsets[e.v1 + 1];
+    }
+    for (int vi = 0; vi < num_points; ++vi) {
+        vf_offsets[vi + 1] += vf_offsets[vi];
+        ve_offsets[vi + 1] += ve_offsets[vi];
+    }
+    vf_faces.resize(num_corners);
+    ve_edges.resize(num_edges * 2);
+    {
+        RawVector<int> vf_pos(vf_offsets), ve_pos(ve_offsets);
+        for (int fi = 0; fi < num_faces; ++fi) {
+            int start = face_starts[fi];
+            for (int i = 0; i < counts[fi]; ++i)
+                vf_faces[vf_pos[indices[start + i]]++] = fi;
+        }
+        for (int ei = 0; ei < num_edges; ++ei) {
+            ve_edges[ve_pos[edges[ei].v0]++] = ei;
+            ve_edges[ve_pos[edges[ei].v1]++] = ei;
+        }
+    }
+
+    auto add_face_point = [&](StencilRow& row, int fi, float w) {
+        int start = face_starts[fi];
+        int c = counts[fi];
+        float fw = w / (float)c;
+        for (int i = 0; i < c; ++i)
+            row.add(indices[start + i], fw);
+    };
+
+    StencilRow row;
+    dst_rows.beginRows();
+
+    // vertex points
+    for (int vi = 0; vi < num_points; ++vi) {
+        row.clear();
+        int nf = vf_offsets[vi + 1] - vf_offsets[vi];
+        int ne = ve_offsets[vi + 1] - ve_offsets[vi];
+        int num_boundary = 0;
+        bool manifold = true;
+        int boundary_neighbors[2]{};
+        for (int k = ve_offsets[vi]; k < ve_offsets[vi + 1]; ++k) {
+            const Edge& e = edges[ve_edges[k]];
+            if (e.num_faces == 1) {
+                if (num_boundary < 2)
+                    boundary_neighbors[num_boundary] = e.v0 == vi ? e.v1 : e.v0;
+                ++num_boundary;
+            }
+            else if (e.num_faces > 2) {
+                manifold = false;
+            }
+        }
+
+        if (manifold && num_boundary == 0 && ne >= 3 && nf == ne) {
+            // (Q + 2R + (n - 3)P) / n
+            float n = (float)ne;
+            row.add(vi, (n - 3.0f) / n);
+            for (int k = ve_offsets[vi]; k < ve_offsets[vi + 1]; ++k) {
+                const Edge& e = edges[ve_edges[k]];
+                row.add(e.v0, 1.0f / (n * n));
+                row.add(e.v1, 1.0f / (n * n));
+            }
+            for (int k = vf_offsets[vi]; k < vf_offsets[vi + 1]; ++k)
+                add_face_point(row, vf_faces[k], 1.0f / (n * n));
+        }
+        else if (manifold && num_boundary == 2) {
+            row.add(vi, 0.75f);
+            row.add(boundary_neighbors[0], 0.125f);
+            row.add(boundary_neighbors[1], 0.125f);
+        }
+        else {
+            // corners, non-manifold and unreferenced points stay where they are
+            row.add(vi, 1.0f);
+        }
+        dst_rows.addRow(row);
+    }
+
+    // edge points
+    for (auto& e : edges) {
+        row.clear();
+        if (e.num_faces == 2) {
+            row.add(e.v0, 0.25f);
+            row.add(e.v1, 0.25f);
+            add_face_point(row, e.f0, 0.25f);
+            add_face_point(row, e.f1, 0.25f);
+        }
+        else {
+            row.add(e.v0, 0.5f);
+            row.add(e.v1, 0.5f);
+        }
+        dst_rows.addRow(row);
+    }
+
+    // face points
+    for (int fi = 0; fi < num_faces; ++fi) {
+        row.clear();
+        add_face_point(row, fi, 1.0f);
+        dst_rows.addRow(row);
+    }
+
+    // one quad per face corner
+    int edge_base = num_points;
+    int face_base = num_points + num_edges;
+    dst_num_points = face_base + num_faces;
+    dst_counts.resize(num_corners);
+    dst_indices.resize(num_corners * 4);
+    int* dst = dst_indices.data();
+    for (int fi = 0; fi < num_faces; ++fi) {
+        int start = face_starts[fi];
+        int c = counts[fi];
+        for (int i = 0; i < c; ++i) {
+            dst_counts[start + i] = 4;
+            *dst++ = indices[start + i];
+            *dst++ = edge_base + corner_edges[start + i];
+            *dst++ = face_base + fi;
+            *dst++ = edge_base + corner_edges[start + (i + c - 1) % c];
+        }
+    }
+}
+
+// dst = rows * base. the result is expressed in terms of the points base is expressed in.
+void Compose(StencilTable& dst, const StencilTable& rows, const StencilTable& base, int num_base_sources)
+{
+    RawVector<float> acc;
+    RawVector<char> touched;
+    RawVector<int> touched_list;
+    acc.resize(num_base_sources, 0.0f);
+    touched.resize(num_base_sources, 0);
+
+    dst.beginRows();
+    int num_rows = rows.getNumRows();
+    for (int ri = 0; ri < num_rows; ++ri) {
+        touched_list.clear();
+        for (int k = rows.offsets[ri]; k < rows.offsets[ri + 1]; ++k) {
+            int mid = rows.sources[k];
+            float w = rows.weights[k];
+            for (int j = base.offsets[mid]; j < base.offsets[mid + 1]; ++j) {
+                int src = base.sources[j];
+                if (!touched[src]) {
+                    touched[src] = 1;
+                    touched_list.push_back(src);
+                }
+                acc[src] += w * base.weights[j];
+            }
+        }
+
+        for (int src : touched_list) {
+            dst.sources.push_back(src);
+            dst.weights.push_back(acc[src]);
+            acc[src] = 0.0f;
+            touched[src] = 0;
+        }
+        dst.offsets.push_back((int)dst.sources.size());
+    }
+}
+
+} // namespace
+
+
+bool SubdivisionStencils::build(span<int> counts, span<int> indices, int num_points, int level)
+{
+    clear();
+    if (num_points <= 0 || level < 0 || level > kMaxLevel)
+        return false;
+
+    // copy the cage, dropping lines, points and faces that reference missing points
+    RawVector<int> face_counts, face_indices;
+    {
+        const int* src = indices.data();
+        const int* src_end = src + indices.size();
+        for (int c : counts) {
+            if (c < 0 || src + c > src_end)
+                break;
+            bool valid = c >= 3;
+            for (int i = 0; valid && i < c; ++i)
+                valid = src[i] >= 0 && src[i] < num_points;
+            if (valid) {
+                face_counts.push_back(c);
+                face_indices.insert(face_indices.end(), src, src + c);
+            }
+            src += c;
+        }
+    }
+
+    StencilTable stencils, rows, composed;
+    stencils.setIdentity(num_points);
+    int level_num_points = num_points;
+    RawVector<int> next_counts, next_indices;
+    for (int li = 0; li < level; ++li) {
+        int next_num_points = 0;
+        SubdivideOnce(face_counts, face_indices, level_num_points, next_counts, next_indices, next_num_points, rows);
+        Compose(composed, rows, stencils, num_points);
+
+        stencils.offsets.swap(composed.offsets);
+        stencils.sources.swap(composed.sources);
+        stencils.weights.swap(composed.weights);
+        face_counts.swap(next_counts);
+        face_indices.swap(next_indices);
+        level_num_points = next_num_points;
+    }
+
+    m_level = level;
+    m_num_src_points = num_points;
+    m_offsets.swap(stencils.offsets);
+    m_sources.swap(stencils.sources);
+    m_weights.swap(stencils.weights);
+
+    // triangulate for rendering
+    const int* src = face_indices.data();
+    for (int c : face_counts) {
+        for (int i = 0; i < c - 2; ++i) {
+            m_counts.push_back(3);
+            m_indices.push_back(src[0]);
+            m_indices.push_back(src[i + 1]);
+            m_indices.push_back(src[i + 2]);
+        }
+        src += c;
+    }
+    return true;
+}
+
+void SubdivisionStencils::clear()
+{
+    m_level = 0;
+    m_num_src_points = 0;
+    m_offsets.clear();
+    m_sources.clear();
+    m_weights.clear();
+    m_counts.clear();
+    m_indices.clear();
+}
+
+bool SubdivisionStencils::refine(span<float3> dst, span<float3> src) const
+{
+    if ((int)src.size() != m_num_src_points || (int)dst.size() != getNumDstPoints()) {
+        printf("SubdivisionStencils::refine(): point count mismatch\n");
+        return false;
+    }
+
+    ParallelFor(dst.size(), 1024, [&](size_t begin, size_t end) {
+        const int* sources = m_sources.data();
+        const float* weights = m_weights.data();
+        for (size_t i = begin; i < end; ++i) {
+            float3 r{};
+            for (int k = m_offsets[i]; k < m_offsets[i + 1]; ++k)
+                r += src[sources[k]] * weights[k];
+            dst[i] = r;
+        }
+    });
+    return true;
+}
+
+} // namespace wabc
@@ -0,0 +1,225 @@
+#include <algorithm>
+#include <cmath>
+
+#include "Track.h"
+
+namespace TrackHelpers
+{
+   // Number of keyframes that we step over linearly before falling back on a binary search
+   const unsigned int kMaxLinearSteps = 4;
+
+   glm::vec3 Interpolate(const glm::vec3& a, const glm::vec3& b, float t)
+   {
+      return a + (b - a) * t;
+   }
+
+   Q::quat Interpolate(const Q::quat& a, const Q::quat& b, float t)
+   {
+      // Make sure that we take the shortest path between a and b
+      if (Q::dot(a, b) < 0.0f)
+      {
+         return Q::nlerp(a, -b, t);
+      }
+
+      return Q::nlerp(a, b, t);
+   }
+
+   glm::vec3 AdjustHermiteResult(const glm::vec3& v)
+   {
+      return v;
+   }
+
+   Q::quat AdjustHermiteResult(const Q::quat& q)
+   {
+      return Q::normalized(q);
+   }
+
+   // Vectors can be interpolated from any value to any other
+   void Neighborhood(const glm::vec3& /*a*/, glm::vec3& /*b*/)
+   {
+
+   }
+
+   void Neighborhood(const Q::quat& a, Q::quat& b)
+   {
+      if (Q::dot(a, b) < 0.0f)
+      {
+         b = -b;
+      }
+   }
+
+   // Cubic Hermite spline
+   // p1 and p2 are the values of the keyframes, and s1 and s2 are their tangents scaled by the duration of the segment
+   template<typename T>
+   T Hermite(float t, const T& p1, const T& s1, const T& _p2, const T& s2)
+   {
+      float tt  = t * t;
+      float ttt = tt * t;
+
+      T p2 = _p2;
+      Neighborhood(p1, p2);
+
+      float h1 = 2.0f * ttt - 3.0f * tt + 1.0f;
+      float h2 = -2.0f * ttt + 3.0f * tt;
+      float h3 = ttt - 2.0f * tt + t;
+      float h4 = ttt - tt;
+
+      T result = p1 * h1 + p2 * h2 + s1 * h3 + s2 * h4;
+      return AdjustHermiteResult(result);
+   }
+}
+
+template<typename T>
+Track<T>::Track()
+   : mInterpolation(Interpolation::Linear)
+   , mSampleRate(0.0f)
+{
+
+}
+
+template<typename T>
+void Track<T>::SetKeyframes(std::vector<float>&& times, std::vector<T>&& values, Interpolation interpolation)
+{
+   mTimes         = std::move(times);
+   mValues        = std::move(values);
+   mInterpolation = interpolation;
+   mSampleRate    = 0.0f;
+}
+
+template<typename T>
+float Track<T>::GetStartTime() const
+{
+   return mTimes.empty() ? 0.0f : mTimes.front();
+}
+
+template<typename T>
+float Track<T>::GetEndTime() const
+{
+   return mTimes.empty() ? 0.0f : mTimes.back();
+}
+
+template<typename T>
+const T& Track<T>::GetValue(unsigned int keyframe) const
+{
+   // Cubic keyframes store the in-tangent, the value and the out-tangent
+   return mInterpolation == Interpolation::Cubic ? mValues[keyframe * 3 + 1] : mValues[keyframe];
+}
+
+// Returns the index of the keyframe that starts the segment that contains the time
+// The result is always smaller than the index of the last keyframe
+template<typename T>
+unsigned int Track<T>::FindKeyframe(float time, unsigned int& cursor) const
+{
+   unsigned int numKeyframes = static_cast<unsigned int>(mTimes.size());
+   unsigned int lastSegment  = numKeyframes - 2;
+
+   if (time <= mTimes[0])
+   {
+      cursor = 0;
+      return cursor;
+   }
+
+   if (time >= mTimes[numKeyframes - 1])
+   {
+      cursor = lastSegment;
+      return cursor;
+   }
+
+   // Uniformly spaced keyframes can be computed directly
+   if (mSampleRate > 0.0f)
+   {
+      cursor = std::min(static_cast<unsigned int>((time - mTimes[0]) * mSampleRate), lastSegment);
+      return cursor;
+   }
+
+   // Start from the keyframe that was used by the previous sample and step forward
+   unsigned int keyframe = std::min(cursor, lastSegment);
+   if (mTimes[keyframe] <= time)
+   {
+      for (unsigned int step = 0; step < TrackHelpers::kMaxLinearSteps && keyframe <= lastSegment; ++step, ++keyframe)
+      {
+         if (time < mTimes[keyframe + 1])
+         {
+            cursor = keyframe;
+            return cursor;
+         }
+      }
+   }
+
+   // The playback jumped backwards or far ahead
+   std::vector<float>::const_iterator it = std::upper_bound(mTimes.begin(), mTimes.end(), time);
+   cursor = std::min(static_cast<unsigned int>(it - mTimes.begin()) - 1, lastSegment);
+   return cursor;
+}
+
+template<typename T>
+T Track<T>::Sample(float time, unsigned int& cursor) const
+{
+   unsigned int numKeyframes = static_cast<unsigned int>(mTimes.size());
+   if (numKeyframes == 0)
+   {
+      return T();
+   }
+
+   if (numKeyframes == 1)
+   {
+      return GetValue(0);
+   }
+
+   unsigned int thisKeyframe = FindKeyframe(time, cursor);
+   unsigned int nextKeyframe = thisKeyframe + 1;
+
+   if (mInterpolation == Interpolation::Constant)
+   {
+      return GetValue(time >= mTimes[nextKeyframe] ? nextKeyframe : thisKeyframe);
+   }
+
+   float segmentDuration = mTimes[nextKeyframe] - mTimes[thisKeyframe];
+   float t = 0.0f;
+   if (segmentDuration > 0.0f)
+   {
+      t = glm::clamp((time - mTimes[thisKeyframe]) / segmentDuration, 0.0f, 1.0f);
+   }
+
+   if (mInterpolation == Interpolation::Linear)
+   {
+      return TrackHelpers::Interpolate(GetValue(thisKeyframe), GetValue(nextKeyframe), t);
+   }
+
+   // The out-tangent of this keyframe and the in-tangent of the next one
+   T thisOutTangent = mValues[thisKeyframe * 3 + 2] * segmentDuration;
+   T nextInTangent  = mValues[nextKeyframe * 3 + 0] * segmentDuration;
+   return TrackHelpers::Hermite(t, GetValue(thisKeyframe), thisOutTangent, GetValue(nextKeyframe), nextInTangent);
+}
+
+template<typename T>
+void Track<T>::Resample(float sampleRate)
+{
+   if (mTimes.size() < 2 || sampleRate <= 0.0f)
+   {
+      return;
+   }
+
+   float        startTime  = mTimes.front();
+   float        endTime    = mTimes.back();
+   unsigned int numSamples = static_cast<unsigned int>(std::ceil((endTime - startTime) * sampleRate)) + 1;
+
+   std::vector<float> times(numSamples);
+   std::vector<T>     values(numSamples);
+
+   unsigned int cursor = 0;
+   for (unsigned int i = 0; i < numSamples; ++i)
+   {
+      // The last sample is clamped to the end of the track, so it may be closer to the previous one than the others are
+      times[i]  = std::min(startTime + static_cast<float>(i) / sampleRate, endTime);
+      values[i] = Sample(times[i], cursor);
+   }
+
+   mTimes         = std::move(times);
+   mValues        = std::move(values);
+   mInterpolation = mInterpolation == Interpolation::Constant ? Interpolation::Constant : Interpolation::Linear;
+   mSampleRate    = sampleRate;
+}
+
+template class Track<glm::vec3>;
+template class Track<Q::quat>;
@@ -1,3 +1,5 @@
+#include <cstring>
+
 #include "glm/gtx/norm.hpp"
 
 #include "Utility.h"
@@ -36,3 +38,19 @@ glm::vec3 Utility::hexToColor(int hex)
 
    return glm::vec3(r, g, b);
 }
+
+static_assert(sizeof(glm::mat4) == sizeof(wabc::float4x4), "glm::mat4 and wabc::float4x4 must have the same size");
+
+glm::mat4 Utility::toMat4(const wabc::float4x4& m)
+{
+   glm::mat4 result;
+   memcpy(&result[0][0], &m, sizeof(glm::mat4));
+   return result;
+}
+
+wabc::float4x4 Utility::toFloat4x4(const glm::mat4& m)
+{
+   wabc::float4x4 result;
+   memcpy(&result, &m[0][0], sizeof(wabc::float4x4));
+   return result;
+}
@@ -0,0 +1,47 @@
+#include "pch.h"
+#include "VectorMathBatch.h"
+#include "CpuDispatch.h"
+
+namespace wabc {
+
+void mul_p(span<float3> dst, span<float3> src, const float4x4& m)
+{
+    GetMathKernels().mul_p(dst.data(), src.data(), std::min(dst.size(), src.size()), m);
+}
+
+void mul_v(span<float3> dst, span<float3> src, const float4x4& m)
+{
+    GetMathKernels().mul_v(dst.data(), src.data(), std::min(dst.size(), src.size()), m);
+}
+
+void normalize(span<float3> dst, span<float3> src)
+{
+    GetMathKernels().normalize(dst.data(), src.data(), std::min(dst.size(), src.size()));
+}
+
+void triangle_normals(span<float3> dst, span<float3> points, span<int> indices)
+{
+    GetMathKernels().triangle_normals(dst.data(), points.data(), indices.data(), indices.size() / 3);
+}
+
+void bounds(span<float3> src, float3& bmin, float3& bmax)
+{
+    GetMathKernels().bounds(src.data(), src.size(), bmin, bmax);
+}
+
+void mul_p(float3_soa dst, float3_soa src, size_t n, const float4x4& m)
+{
+    GetMathKernels().mul_p_soa(dst, src, n, m);
+}
+
+void mul_v(float3_soa dst, float3_soa src, size_t n, const float4x4& m)
+{
+    GetMathKernels().mul_v_soa(dst, src, n, m);
+}
+
+void normalize(float3_soa dst, float3_soa src, size_t n)
+{
+    GetMathKernels().normalize_soa(dst, src, n);
+}
+
+} // namespace wabc
@@ -0,0 +1,486 @@
+#include "pch.h"
+#include "sfbxAllocator.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+
+#if defined(__linux__) && !defined(__EMSCRIPTEN__)
+    #define sfbxEnableHugePages
+    #include <sys/mman.h>
+#endif
+
+namespace sfbx {
+
+namespace {
+
+struct AllocatorRegistry
+{
+    std::mutex mutex;
+    std::vector<Allocator*> allocators;
+
+    static AllocatorRegistry& instance()
+    {
+        static AllocatorRegistry s_instance;
+        return s_instance;
+    }
+};
+
+size_t AlignUp(size_t v, size_t alignment)
+{
+    return (v + alignment - 1) & ~(alignment - 1);
+}
+
+bool IsLarge(size_t size)
+{
+#ifdef sfbxEnableHugePages
+    return size >= HeapAllocator::kLargeBlockSize;
+#else
+    (void)size;
+    return false;
+#endif
+}
+
+#ifdef sfbxEnableHugePages
+const size_t kPageSize = 4096;
+
+void* MapLarge(size_t size)
+{
+    size = AlignUp(size, kPageSize);
+    void* ret = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (ret == MAP_FAILED)
+        return nullptr;
+    // the 2MB aligned ranges of the block can be backed by huge pages, which saves tlb misses on large meshes
+    madvise(ret, size, MADV_HUGEPAGE);
+    return ret;
+}
+
+void* RemapLarge(void* addr, size_t old_size, size_t new_size)
+{
+    old_size = AlignUp(old_size, kPageSize);
+    new_size = AlignUp(new_size, kPageSize);
+    if (old_size == new_size)
+        return addr;
+    // moves the pages instead of copying them
+    void* ret = mremap(addr, old_size, new_size, MREMAP_MAYMOVE);
+    if (ret == MAP_FAILED)
+        return nullptr;
+    madvise(ret, new_size, MADV_HUGEPAGE);
+    return ret;
+}
+
+void UnmapLarge(void* addr, size_t size)
+{
+    munmap(addr, AlignUp(size, kPageSize));
+}
+#endif
+
+thread_local size_t t_heap_allocations = 0;
+
+// memory from the system. size has to be the same when it is freed.
+void* SystemAllocate(size_t size, size_t alignment)
+{
+    ++t_heap_allocations;
+#ifdef sfbxEnableHugePages
+    if (IsLarge(size))
+        return MapLarge(size);
+#endif
+    if (alignment <= alignof(std::max_align_t))
+        return malloc(size);
+#ifdef _WIN32
+    return _aligned_malloc(size, alignment);
+#else
+    void* ret = nullptr;
+    if (posix_memalign(&ret, alignment, size) != 0)
+        return nullptr;
+    return ret;
+#endif
+}
+
+void SystemFree(void* addr, size_t size, size_t alignment)
+{
+#ifdef sfbxEnableHugePages
+    if (IsLarge(size)) {
+        UnmapLarge(addr, size);
+        return;
+    }
+#endif
+    (void)size;
+#ifdef _WIN32
+    if (alignment > alignof(std::max_align_t)) {
+        _aligned_free(addr);
+        return;
+    }
+#endif
+    (void)alignment;
+    free(addr);
+}
+
+// resizes without an explicit copy if the system allows it. null if it does not.
+void* SystemReallocate(void* addr, size_t old_size, size_t new_size, size_t alignment)
+{
+    ++t_heap_allocations;
+#ifdef sfbxEnableHugePages
+    if (IsLarge(old_size) || IsLarge(new_size))
+        return IsLarge(old_size) && IsLarge(new_size) ? RemapLarge(addr, old_size, new_size) : nullptr;
+#endif
+    (void)old_size;
+    if (alignment <= alignof(std::max_align_t))
+        return realloc(addr, new_size);
+#ifdef _WIN32
+    return _aligned_realloc(addr, new_size, alignment);
+#else
+    return nullptr;
+#endif
+}
+
+} // namespace
+
+
+Allocator::Allocator(const char* name, size_t alignment)
+    : m_name(name)
+    , m_alignment(alignment)
+{
+    auto& registry = AllocatorRegistry::instance();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    registry.allocators.push_back(this);
+}
+
+Allocator::~Allocator()
+{
+    auto& registry = AllocatorRegistry::instance();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    auto& v = registry.allocators;
+    v.erase(std::remove(v.begin(), v.end(), this), v.end());
+}
+
+Allocator::Stats Allocator::getStats() const
+{
+    Stats ret;
+    ret.bytes = m_bytes;
+    ret.peak_bytes = m_peak_bytes;
+    ret.reserved_bytes = m_reserved_bytes;
+    ret.allocations = m_allocations;
+    ret.total_allocations = m_total_allocations;
+    ret.total_bytes = m_total_bytes;
+    ret.reallocations = m_reallocations;
+    ret.copied_bytes = m_copied_bytes;
+    return ret;
+}
+
+void* Allocator::reallocate(void* addr, size_t old_size, size_t new_size, size_t used_size)
+{
+    if (new_size == 0) {
+        if (addr)
+            deallocate(addr, old_size);
+        return nullptr;
+    }
+    void* ret = allocate(new_size);
+    if (addr) {
+        size_t copy_size = std::min(used_size, new_size);
+        memcpy(ret, addr, copy_size);
+        deallocate(addr, old_size);
+        ++m_reallocations;
+        m_copied_bytes += copy_size;
+    }
+    return ret;
+}
+
+void Allocator::onAllocate(size_t size)
+{
+    size_t bytes = m_bytes += size;
+    size_t peak = m_peak_bytes;
+    while (bytes > peak && !m_peak_bytes.compare_exchange_weak(peak, bytes)) {}
+    ++m_allocations;
+    ++m_total_allocations;
+    m_total_bytes += size;
+}
+
+void Allocator::onDeallocate(size_t size, size_t count)
+{
+    m_bytes -= size;
+    m_allocations -= count;
+}
+
+void Allocator::onResize(size_t old_size, size_t new_size)
+{
+    size_t bytes = m_bytes += new_size - old_size; // wraps around correctly when shrinking
+    size_t peak = m_peak_bytes;
+    while (bytes > peak && !m_peak_bytes.compare_exchange_weak(peak, bytes)) {}
+    if (new_size > old_size)
+        m_total_bytes += new_size - old_size;
+    ++m_reallocations;
+}
+
+void Allocator::onReserve(ptrdiff_t size)
+{
+    m_reserved_bytes += size;
+}
+
+
+HeapAllocator::HeapAllocator(const char* name, size_t alignment)
+    : Allocator(name, alignment)
+{
+}
+
+void* HeapAllocator::allocate(size_t size)
+{
+    void* ret = SystemAllocate(size, getAlignment());
+    if (!ret) {
+        printf("HeapAllocator::allocate(): %s failed to allocate %zu bytes\n", getName(), size);
+        return nullptr;
+    }
+    onAllocate(size);
+    return ret;
+}
+
+void HeapAllocator::deallocate(void* addr, size_t size)
+{
+    SystemFree(addr, size, getAlignment());
+    onDeallocate(size);
+}
+
+void* HeapAllocator::reallocate(void* addr, size_t old_size, size_t new_size, size_t used_size)
+{
+    if (addr && new_size != 0) {
+        if (void* ret = SystemReallocate(addr, old_size, new_size, getAlignment())) {
+            onResize(old_size, new_size);
+            return ret;
+        }
+    }
+    return Allocator::reallocate(addr, old_size, new_size, used_size);
+}
+
+
+ArenaAllocator::ArenaAllocator(const char* name, size_t block_size, size_t alignment)
+    : Allocator(name, alignment)
+    , m_block_size(block_size)
+{
+}
+
+ArenaAllocator::~ArenaAllocator()
+{
+    for (auto& b : m_blocks) {
+        SystemFree(b.data, b.size, getAlignment());
+        onReserve(-(ptrdiff_t)b.size);
+    }
+}
+
+char* ArenaAllocator::bump(size_t size)
+{
+    size = AlignUp(size, getAlignment());
+    while (m_block_index < m_blocks.size()) {
+        Block& b = m_blocks[m_block_index];
+        if (m_offset + size <= b.size) {
+            char* ret = b.data + m_offset;
+            m_offset += size;
+            return ret;
+        }
+        ++m_block_index;
+        m_offset = 0;
+    }
+
+    Block b;
+    b.size = std::max(m_block_size, size);
+    b.data = (char*)SystemAllocate(b.size, getAlignment());
+    if (!b.data) {
+        printf("ArenaAllocator::bump(): %s failed to allocate %zu bytes\n", getName(), b.size);
+        return nullptr;
+    }
+    onReserve(b.size);
+    m_blocks.push_back(b);
+    m_block_index = m_blocks.size() - 1;
+    m_offset = size;
+    return b.data;
+}
+
+void* ArenaAllocator::allocate(size_t size)
+{
+    char* ret = bump(size);
+    if (ret)
+        onAllocate(size);
+    m_last = ret;
+    return ret;
+}
+
+void ArenaAllocator::deallocate(void* addr, size_t size)
+{
+    if (addr == m_last) {
+        // the most recent allocation can be given back
+        m_offset = m_last - m_blocks[m_block_index].data;
+        m_last = nullptr;
+    }
+    onDeallocate(size);
+}
+
+void* ArenaAllocator::reallocate(void* addr, size_t old_size, size_t new_size, size_t used_size)
+{
+    if (addr && addr == m_last && new_size != 0) {
+        const Block& b = m_blocks[m_block_index];
+        size_t begin = m_last - b.data;
+        size_t end = begin + AlignUp(new_size, getAlignment());
+        if (end <= b.size) {
+            m_offset = end;
+            onResize(old_size, new_size);
+            return addr;
+        }
+    }
+    return Allocator::reallocate(addr, old_size, new_size, used_size);
+}
+
+void ArenaAllocator::reset()
+{
+    Stats stats = getStats();
+    onDeallocate(stats.bytes, stats.allocations);
+
+    if (m_blocks.size() > 1) {
+        // replace the blocks with a single one that holds all of them, so that the next round fits in it
+        size_t total = 0;
+        for (auto& b : m_blocks) {
+            total += b.size;
+            SystemFree(b.data, b.size, getAlignment());
+            onReserve(-(ptrdiff_t)b.size);
+        }
+        m_blocks.clear();
+
+        Block b;
+        b.size = total;
+        b.data = (char*)SystemAllocate(total, getAlignment());
+        if (b.data) {
+            onReserve(total);
+            m_blocks.push_back(b);
+        }
+    }
+    m_block_index = 0;
+    m_offset = 0;
+    m_last = nullptr;
+}
+
+ArenaAllocator::Marker ArenaAllocator::getMarker() const
+{
+    return { m_block_index, m_offset };
+}
+
+void ArenaAllocator::rewind(const Marker& marker)
+{
+    // the arena only moves back. it can already be behind the marker if reset() was called since it was taken.
+    if (marker.block_index < m_block_index || (marker.block_index == m_block_index && marker.offset <= m_offset)) {
+        m_block_index = marker.block_index;
+        m_offset = marker.offset;
+        m_last = nullptr;
+    }
+}
+
+
+PoolAllocator::PoolAllocator(const char* name, size_t max_block_size, size_t alignment)
+    : Allocator(name, alignment)
+    , m_max_block_size(std::min<size_t>(max_block_size, (size_t)1 << (kMaxClasses - 1)))
+{
+}
+
+PoolAllocator::~PoolAllocator()
+{
+    for (auto& c : m_chunks) {
+        SystemFree(c.first, c.second, getAlignment());
+        onReserve(-(ptrdiff_t)c.second);
+    }
+}
+
+int PoolAllocator::getClass(size_t size) const
+{
+    size = std::max(size, getAlignment());
+    int ret = kMinClass;
+    while (((size_t)1 << ret) < size)
+        ++ret;
+    return ret;
+}
+
+void* PoolAllocator::allocate(size_t size)
+{
+    if (size > m_max_block_size) {
+        void* ret = SystemAllocate(size, getAlignment());
+        if (ret)
+            onAllocate(size);
+        return ret;
+    }
+
+    int c = getClass(size);
+    std::lock_guard<std::mutex> lock(m_mutex);
+    FreeBlock*& head = m_free_lists[c];
+    if (!head) {
+        // carve a new chunk into blocks of this class
+        size_t block_size = (size_t)1 << c;
+        size_t chunk_size = std::max<size_t>(64 * 1024, block_size * 8);
+        char* chunk = (char*)SystemAllocate(chunk_size, getAlignment());
+        if (!chunk) {
+            printf("PoolAllocator::allocate(): %s failed to allocate %zu bytes\n", getName(), chunk_size);
+            return nullptr;
+        }
+        onReserve(chunk_size);
+        m_chunks.push_back({ chunk, chunk_size });
+        for (size_t offset = chunk_size; offset >= block_size; offset -= block_size) {
+            auto* b = (FreeBlock*)(chunk + offset - block_size);
+            b->next = head;
+            head = b;
+        }
+    }
+    FreeBlock* ret = head;
+    head = ret->next;
+    onAllocate(size);
+    return ret;
+}
+
+void PoolAllocator::deallocate(void* addr, size_t size)
+{
+    onDeallocate(size);
+    if (size > m_max_block_size) {
+        SystemFree(addr, size, getAlignment());
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto* b = (FreeBlock*)addr;
+    FreeBlock*& head = m_free_lists[getClass(size)];
+    b->next = head;
+    head = b;
+}
+
+void* PoolAllocator::reallocate(void* addr, size_t old_size, size_t new_size, size_t used_size)
+{
+    if (addr && new_size != 0 && old_size <= m_max_block_size && new_size <= m_max_block_size &&
+        getClass(old_size) == getClass(new_size)) {
+        // the block already has room
+        onResize(old_size, new_size);
+        return addr;
+    }
+    return Allocator::reallocate(addr, old_size, new_size, used_size);
+}
+
+
+Allocator* GetDefaultAllocator()
+{
+    static HeapAllocator s_instance("default", alignof(std::max_align_t));
+    return &s_instance;
+}
+
+Allocator* GetAlignedAllocator()
+{
+    static HeapAllocator s_instance("aligned", 64);
+    return &s_instance;
+}
+
+void EachAllocator(const std::function<void(Allocator&)>& f)
+{
+    auto& registry = AllocatorRegistry::instance();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    for (Allocator* a : registry.allocators)
+        f(*a);
+}
+
+size_t GetThreadHeapAllocations()
+{
+    return t_heap_allocations;
+}
+
+} // namespace sfbx